@@ -0,0 +1,118 @@
+#ifndef FIRMWARE_ARXIDENTIFIER_H
+#define FIRMWARE_ARXIDENTIFIER_H
+
+#pragma once
+
+/**
+ * @file ArxIdentifier.h
+ * @brief Online identification of the VPPE (setpoint -> feedback pressure)
+ * with recursive least squares.
+ *
+ * Model, one sample per update():
+ *   y[k] = -a1 y[k-1] - a2 y[k-2] + b1 u[k-1-d] + b2 u[k-2-d] + c
+ * u is the commanded setpoint, y the measured feedback (both in bar), d the
+ * dead time in samples and c absorbs calibration offsets.
+ *
+ * The dead time is found by running one RLS estimator per candidate
+ * d = 0..kMaxDelay on the same data and picking the one with the lowest
+ * smoothed prediction error. kMaxDelay covers the VPPE's ~12 ms at the
+ * 1 kHz control rate with some margin, so the model can go straight into
+ * SmithPredictor; each candidate costs ~60 MACs and 124 bytes. Everything
+ * is fixed-size, and update() costs the same every call.
+ *
+ * The forgetting factor lets the model follow drift with supply pressure
+ * and temperature. To stop covariance wind-up when the input is not
+ * exciting (constant setpoint), forgetting is suspended while trace(P) is
+ * above a limit.
+ *
+ * The current model is published through a sequence counter, so a
+ * controller in another task can read it with model() at any time. A
+ * reader that preempted the publish cannot wait for it to finish, so
+ * model() gives up after kReadAttempts tries and the controller keeps the
+ * model it has.
+ */
+
+#include <atomic>
+#include <stdint.h>
+
+class ArxIdentifier {
+public:
+    static constexpr uint32_t kNa = 2;
+    static constexpr uint32_t kNb = 2;
+    static constexpr uint32_t kMaxDelay = 16; // samples
+    static constexpr uint32_t kParams = kNa + kNb + 1;
+    static constexpr uint32_t kReadAttempts = 4;
+
+    struct Config {
+        float period_s;           // time between update() calls
+        float lambda;             // forgetting factor, 0.98..1
+        float initialCovariance;  // P0 = initialCovariance * I
+        float maxCovarianceTrace; // forgetting stops above this
+        float errorSmoothing;     // weight of new squared errors in the delay choice
+        uint32_t warmupSamples;   // updates before the model is marked valid
+    };
+
+    /**
+     * @brief Published model.
+     */
+    struct ArxModel {
+        float a[kNa];
+        float b[kNb];
+        float bias;
+        uint8_t delay;        // dead time, samples
+        float period_s;
+        float dcGain;         // sum(b) / (1 + sum(a)), bar per bar
+        float errorVariance;  // smoothed one-step prediction error, bar^2
+        uint32_t samples;
+        bool valid;
+    };
+
+    static constexpr Config kDefaultConfig = {0.001f, 0.995f, 1000.0f, 10000.0f, 0.01f, 500U};
+
+    explicit ArxIdentifier(const Config& config = kDefaultConfig);
+
+    /**
+     * @brief Restarts identification from scratch.
+     */
+    void reset();
+
+    /**
+     * @brief One sample: the feedback just measured and the setpoint being
+     * applied now. Call at the fixed rate given in the config.
+     */
+    void update(float setpoint_bar, float feedback_bar);
+
+    /**
+     * @brief Copies the latest published model. Safe from any task.
+     * @return false if no model has been published yet, or one was being
+     * published for kReadAttempts tries.
+     */
+    bool model(ArxModel& out) const;
+
+private:
+    /**
+     * @brief One RLS estimator, for one dead-time candidate.
+     */
+    struct Estimator {
+        float theta[kParams];
+        float P[kParams][kParams];
+        float error; // smoothed squared a-priori error
+    };
+
+    void resetEstimator(Estimator& est);
+    void updateEstimator(Estimator& est, const float* phi, float y);
+    void publish(const Estimator& est, uint8_t delay);
+
+    Config m_config;
+    Estimator m_estimators[kMaxDelay + 1];
+
+    // History, newest first
+    float m_y[kNa];
+    float m_u[kMaxDelay + kNb];
+    uint32_t m_samples;
+
+    std::atomic<uint32_t> m_modelSeq; // odd while being written
+    ArxModel m_model;
+};
+
+#endif //FIRMWARE_ARXIDENTIFIER_H
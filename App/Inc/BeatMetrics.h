@@ -0,0 +1,144 @@
+#ifndef FIRMWARE_BEATMETRICS_H
+#define FIRMWARE_BEATMETRICS_H
+
+#pragma once
+
+/**
+ * @file BeatMetrics.h
+ * @brief Streaming per-beat hemodynamic metrics.
+ *
+ * addSample() does O(1) work per pressure sample and keeps only running
+ * values (extremes, integral, dP/dt extremes and their times), so memory is
+ * fixed no matter how long a beat is. When a beat ends, one BeatRecord is
+ * produced.
+ *
+ * Beats are segmented in one of two ways:
+ *  - External: the cycle state machine calls markBeatStart() when it starts
+ *    a new systole.
+ *  - Feature: an upstroke detector fires when pressure rises through the
+ *    midpoint of the previous beat (with hysteresis and a refractory
+ *    interval). The beat boundary is then moved back to the foot of the
+ *    upstroke: the last sample within footBand_bar of the diastolic
+ *    minimum before the crossing, i.e. where the upstroke leaves the floor.
+ *    The band has to clear the sensor noise; with the bare minimum, noise
+ *    on a flat floor moved the boundary by hundreds of ms. The upstroke and
+ *    its dP/dt max belong to the new beat. This needs a second running
+ *    accumulator from the foot candidate and a copy of the old one taken
+ *    there, still O(1).
+ *
+ * No HAL here: the same class runs on host builds, fed from recordings or
+ * the plant simulator.
+ */
+
+#include <stdint.h>
+
+class BeatMetrics {
+public:
+    enum class Segmentation {
+        External,
+        Feature
+    };
+
+    struct Config {
+        Segmentation segmentation;
+        float hysteresis_bar;       // feature mode: re-arm margin below the midpoint
+        float footBand_bar;         // feature mode: foot = last sample this close to the minimum
+        uint32_t minBeatInterval_us; // feature mode: refractory period (caps the rate)
+        uint32_t maxBeatInterval_us; // longer beats are dropped as invalid
+    };
+
+    /**
+     * @brief One beat. Times are relative to start_us.
+     */
+    struct BeatRecord {
+        uint32_t beat;
+        uint32_t start_us;
+        uint32_t duration_us;
+        float systolic_bar;
+        float diastolic_bar;
+        float mean_bar;        // time-weighted
+        float dpdtMax_bar_s;
+        float dpdtMin_bar_s;
+        uint32_t peak_us;      // time of systolic peak
+        uint32_t dpdtMax_us;   // onset of ejection
+        uint32_t dpdtMin_us;   // end of ejection
+        float rate_bpm;
+    };
+
+    static constexpr Config kDefaultConfig = {Segmentation::Feature, 0.05f, 0.02f, 250000U, 3000000U};
+
+    explicit BeatMetrics(const Config& config = kDefaultConfig);
+
+    /**
+     * @brief Feeds one sample.
+     * @return true if a beat was completed; read it with lastBeat().
+     */
+    bool addSample(float bar, uint32_t t_us);
+
+    /**
+     * @brief External segmentation: closes the running beat and starts a
+     * new one at @p t_us.
+     * @return true if a beat was completed.
+     */
+    bool markBeatStart(uint32_t t_us);
+
+    const BeatRecord& lastBeat() const { return m_last; }
+
+    /**
+     * @brief Beats completed since construction. Never goes back, also
+     * across reset() and a lost rhythm.
+     */
+    uint32_t beatCount() const { return m_beatCount; }
+
+    /**
+     * @brief Forgets the running beat (e.g. after a pause in pumping).
+     */
+    void reset();
+
+private:
+    /**
+     * @brief Running values of one beat.
+     */
+    struct Accumulator {
+        uint32_t start_us;
+        float max;
+        float min;
+        uint32_t max_us;
+        double integral; // bar*us
+        float dpdtMax;
+        float dpdtMin;
+        uint32_t dpdtMax_us;
+        uint32_t dpdtMin_us;
+
+        void start(float bar, uint32_t t_us);
+        void add(float prevBar, float bar, uint32_t dt_us, uint32_t t_us);
+    };
+
+    bool finish(const Accumulator& beat, uint32_t end_us);
+    bool detectUpstroke(float bar, uint32_t t_us);
+
+    Config m_config;
+
+    bool m_inBeat;
+    Accumulator m_beat;
+
+    // Previous sample
+    bool m_havePrev;
+    float m_prevBar;
+    uint32_t m_prev_us;
+
+    // Feature detector
+    bool m_armed;
+    bool m_learning; // threshold from the range seen, not from a beat
+    float m_threshold;
+    float m_seenMin; // before the first beat
+    float m_seenMax;
+    float m_footBar;
+    Accumulator m_atFoot; // m_beat as it was at the foot candidate
+    Accumulator m_next;   // new beat, from the foot candidate on
+
+    uint32_t m_beatCount;
+    BeatRecord m_last;
+};
+
+#endif //FIRMWARE_BEATMETRICS_H
@@ -0,0 +1,114 @@
+#ifndef FIRMWARE_ENSEMBLEAVERAGER_H
+#define FIRMWARE_ENSEMBLEAVERAGER_H
+
+#pragma once
+
+/**
+ * @file EnsembleAverager.h
+ * @brief Beat-synchronous ensemble average of the pressure waveform.
+ *
+ * Samples of the running beat are buffered. When the beat ends
+ * (markBeatStart()), the beat is resampled onto kBins phase bins (0 = beat
+ * start, 1 = next beat start), so beats of any length line up. Each bin
+ * then gets a Welford update of its mean and variance. A change of heart
+ * rate just changes how many samples map onto a bin.
+ *
+ * The first beat after construction or reset() has nothing to be checked
+ * against: it only sets the running period and is counted as warm-up,
+ * neither averaged nor rejected. Beats much shorter or longer than the
+ * running period (missed or false triggers, ectopic beats) are rejected. The beat buffer has a fixed size:
+ * if a beat overflows it, every other sample is dropped and the buffer
+ * keeps going at half rate.
+ *
+ * Cost: O(1) per sample, O(kBins) per beat. The variance across beats
+ * gives the noise floor: sensor noise plus beat-to-beat variation.
+ *
+ * encode() publishes the averaged waveform for telemetry; it can run in
+ * another task (sequence-counter retry, at most kReadAttempts times so a
+ * reader that preempted the beat update does not wait on it for ever).
+ */
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class EnsembleAverager {
+public:
+    static constexpr uint32_t kBins = 128;
+    static constexpr uint32_t kBeatSamples = 1024;
+    static constexpr uint32_t kMagic = 0x4D534E45U; // "ENSM"
+    static constexpr uint32_t kReadAttempts = 4;
+
+#pragma pack(push, 1)
+    struct Header {
+        uint32_t magic;          // kMagic
+        uint16_t bins;
+        uint16_t warmup;         // 1 once the first beat has set the period
+        uint32_t beats;          // beats in the average
+        uint32_t rejected;       // beats thrown away, warm-up not included
+        uint32_t meanPeriod_us;
+        float noiseFloor_bar;    // RMS of the per-bin standard deviations
+    };
+
+    struct Bin {
+        float mean_bar;
+        float stddev_bar;
+    };
+#pragma pack(pop)
+
+    /**
+     * @param tolerance accepted beat length, as a fraction of the running
+     * period (0.3: 70..130 %).
+     */
+    explicit EnsembleAverager(float tolerance = 0.3f);
+
+    /**
+     * @brief Adds a pressure sample of the running beat.
+     */
+    void addSample(float bar);
+
+    /**
+     * @brief Closes the running beat and starts the next one.
+     * @return true if the closed beat went into the average.
+     */
+    bool markBeatStart(uint32_t t_us);
+
+    /**
+     * @brief Forgets the average.
+     */
+    void reset();
+
+    uint32_t beats() const { return m_beats; }
+    uint32_t rejected() const { return m_rejected; }
+    float noiseFloor() const;
+
+    /**
+     * @brief Header followed by kBins Bin entries.
+     * @return bytes written, 0 if @p len is too small or a beat was being
+     * folded in for kReadAttempts tries (call again later).
+     */
+    size_t encode(uint8_t* buf, size_t len) const;
+
+private:
+    void accumulateBeat();
+
+    float m_tolerance;
+
+    // Running beat
+    float m_samples[kBeatSamples];
+    uint32_t m_count;
+    uint32_t m_stride;  // input samples per stored sample
+    uint32_t m_skip;
+    bool m_haveStart;
+    uint32_t m_start_us;
+
+    // Average
+    uint32_t m_beats;
+    uint32_t m_rejected;
+    float m_period_us; // running beat period
+    float m_mean[kBins];
+    float m_m2[kBins]; // Welford sum of squared deviations
+    std::atomic<uint32_t> m_seq; // odd while the average is updated
+};
+
+#endif //FIRMWARE_ENSEMBLEAVERAGER_H
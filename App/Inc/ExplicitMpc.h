@@ -0,0 +1,109 @@
+#ifndef FIRMWARE_EXPLICITMPC_H
+#define FIRMWARE_EXPLICITMPC_H
+
+#pragma once
+
+/**
+ * @file ExplicitMpc.h
+ * @brief Evaluator for an explicit (precomputed) MPC law.
+ *
+ * Tools/mpc_generate.py solves the constrained MPC problem offline for all
+ * states and references. The solution is piecewise affine over
+ *     theta = (y[k], y[k-1], u[k-1], r)
+ * and is stored as a binary search tree of hyperplanes (Node) with an
+ * affine law (Law) at each leaf. The table is constexpr, so it stays in
+ * flash.
+ *
+ * One step walks at most Table::depth nodes (4 MACs each) and applies one
+ * law, so the cost per control period is bounded and small. As a safety
+ * net the result is clamped to the setpoint range and slew limit the law
+ * was generated for.
+ *
+ * The law is solved for the delay-free part of the plant. step() takes
+ * care of the dead time the way SmithPredictor does: it runs the table's
+ * model without the delay and, with d the dead time in periods, feeds
+ *     y[k] + ym[k] - ym[k-d]
+ * to the law, the measurement plus what the moves still in the pipe will
+ * add to it. compute() is the bare law, without this compensation.
+ */
+
+#include "Interfaces/IPressureControl.h"
+
+#include <stdint.h>
+
+class ExplicitMpc {
+public:
+    static constexpr uint32_t kParams = 4; // y, y_prev, u_prev, r
+    static constexpr uint32_t kMaxDelay = 64; // periods, as SmithPredictor
+
+    /**
+     * @brief Tree node: go to child[0] if a.theta <= b, else child[1].
+     * A negative child is a leaf holding law ~child.
+     */
+    struct Node {
+        float a[kParams];
+        float b;
+        int16_t child[2];
+    };
+
+    /**
+     * @brief First move of the MPC solution in one region: u = f.theta + g.
+     */
+    struct Law {
+        float f[kParams];
+        float g;
+    };
+
+    struct Table {
+        const Node* nodes;
+        uint16_t nodeCount; // 0: a single law, no tree
+        const Law* laws;
+        uint16_t lawCount;
+        uint8_t depth;
+        float period_s;
+        float u_min;
+        float u_max;
+        float slew; // bar per period
+        // Plant model the law was generated for, SmithPredictor's form:
+        // y[k] = -a1 y[k-1] - a2 y[k-2] + b1 u[k-1-d] + b2 u[k-2-d]
+        float a[2];
+        float b[2];
+        uint16_t delay; // d, periods; clamped to kMaxDelay
+    };
+
+    /**
+     * @brief Constructor.
+     * @param plant pressure regulator to drive.
+     * @param table generated law, usually MpcLawTable::kTable.
+     */
+    ExplicitMpc(IPressureControl& plant, const Table& table);
+
+    /**
+     * @brief One control period (Table::period_s): reads the plant, sets its
+     * new setpoint, with the dead time compensated.
+     * @return the setpoint sent to the plant.
+     */
+    float step(float reference_bar);
+
+    /**
+     * @brief The control law alone, without touching the plant.
+     */
+    float compute(float y, float yPrev, float uPrev, float reference_bar) const;
+
+    /**
+     * @brief Starts from a known state, e.g. when switching from another
+     * controller: the plant settled at y with the setpoint held at u.
+     */
+    void reset(float y, float u);
+
+private:
+    IPressureControl& m_plant;
+    const Table& m_table;
+    float m_yPrev; // compensated
+    float m_uPrev;
+    float m_model[kMaxDelay + 1]; // delay-free model output, ring
+    float m_modelPrev;            // its value one period before the head
+    uint32_t m_head;
+};
+
+#endif //FIRMWARE_EXPLICITMPC_H
@@ -0,0 +1,82 @@
+/**
+ * @file MpcLawTable.h
+ * @brief Explicit MPC law, GENERATED by Tools/mpc_generate.py. Do not edit.
+ *
+ * model  a1=-1.84328634 a2=0.847893704 b1=0.00460736235 b2=0, period 0.001 s, dead time 12 periods
+ * limits u in [0, 1.8] bar, |du| <= 0.05 bar per step
+ * cost   N=3 moves, Np=60 steps, rho=0.05
+ * 37 regions, 14 laws, 31 nodes, depth 9; validation: 4/5000 points off, max error 0.054 bar
+ */
+
+#ifndef FIRMWARE_MPCLAWTABLE_H
+#define FIRMWARE_MPCLAWTABLE_H
+
+#pragma once
+
+#include "ExplicitMpc.h"
+
+namespace MpcLawTable {
+
+inline constexpr ExplicitMpc::Node kNodes[] = {
+    {{0.766735364f, -0.632011506f, -0.024917379f, -0.109806479f}, 0.0011075586f, {1, 20}},
+    {{-0.745449503f, 0.635200946f, 0.00274052608f, 0.202032887f}, 0.000928888923f, {2, 5}},
+    {{-0.757218157f, 0.636305862f, 0.0f, 0.147429685f}, -0.0f, {3, 4}},
+    {{0.710848123f, -0.620068028f, 0.184925035f, -0.27570513f}, 0.0087589348f, {-5, -2}},
+    {{-0.745134159f, 0.635578452f, 0.0f, 0.202027517f}, -0.0f, {-11, -12}},
+    {{-0.72429964f, 0.631144405f, 0.000444973891f, 0.277572647f}, 0.31482951f, {6, 13}},
+    {{0.766735364f, -0.632011506f, -0.024917379f, -0.109806479f}, -0.0042726879f, {7, 9}},
+    {{-0.712288589f, 0.620678146f, -0.181359221f, 0.272969664f}, -0.00853573111f, {8, -1}},
+    {{-0.712288589f, 0.620678146f, -0.181359221f, 0.272969664f}, -0.0267154127f, {-2, -3}},
+    {{-0.760496809f, 0.634143315f, -0.0127319383f, 0.139085433f}, -0.0013790016f, {-2, 10}},
+    {{0.762860127f, -0.635045025f, -0.00648851229f, -0.12132659f}, -0.00150955446f, {11, 12}},
+    {{0.759001271f, -0.633473777f, 0.0231125268f, -0.14864002f}, -0.00130807111f, {-1, -8}},
+    {{-0.760496809f, 0.634143315f, -0.0127319383f, 0.139085433f}, 0.0013790016f, {-9, -1}},
+    {{-0.759001271f, 0.633473777f, -0.0231125268f, 0.14864002f}, -0.00130807111f, {-2, 14}},
+    {{0.0f, 0.0f, 1.0f, 0.0f}, 1.75f, {15, 16}},
+    {{0.759001271f, -0.633473777f, 0.0231125268f, -0.14864002f}, -0.00130807111f, {-1, -9}},
+    {{0.617477223f, -0.631070534f, 0.338745048f, -0.325151737f}, -0.050304364f, {-4, 17}},
+    {{-0.72429964f, 0.631144405f, 0.000444973891f, 0.277572647f}, 0.35067508f, {18, -4}},
+    {{-0.72332037f, 0.630947486f, -0.00296586917f, 0.280542538f}, 0.333019238f, {19, -4}},
+    {{0.764330398f, -0.635442225f, -0.0213967859f, -0.107491387f}, -0.00161011959f, {-4, -9}},
+    {{0.712288589f, -0.620678146f, 0.181359221f, -0.272969664f}, -0.00853573111f, {21, 25}},
+    {{0.762860127f, -0.635045025f, -0.00648851229f, -0.12132659f}, 0.00150955446f, {22, 23}},
+    {{0.759369549f, -0.634791554f, 0.0172022971f, -0.141780293f}, -0.0020492975f, {-1, -7}},
+    {{0.712288589f, -0.620678146f, 0.181359221f, -0.272969664f}, -0.0267154127f, {-1, 24}},
+    {{-0.766735364f, 0.632011506f, 0.024917379f, 0.109806479f}, -0.0042726879f, {-6, -10}},
+    {{0.75695207f, -0.636082264f, 0.0265080715f, -0.147377878f}, -0.00344467594f, {-13, 26}},
+    {{-0.761723183f, 0.633189615f, 0.0208392021f, 0.135699785f}, -0.0f, {27, 28}},
+    {{0.0f, 0.0f, -1.0f, 0.0f}, -0.05f, {-2, -5}},
+    {{-0.759001271f, 0.633473777f, -0.0231125268f, 0.14864002f}, -0.00130807111f, {29, 30}},
+    {{-0.760496809f, 0.634143315f, -0.0127319383f, 0.139085433f}, -0.0013790016f, {-2, -9}},
+    {{0.762860127f, -0.635045025f, -0.00648851229f, -0.12132659f}, 0.00150955446f, {-9, -10}},
+};
+
+inline constexpr ExplicitMpc::Law kLaws[] = {
+    {{0.0f, 0.0f, 1.0f, 0.0f}, 0.05f},
+    {{0.0f, 0.0f, 1.0f, 0.0f}, -0.05f},
+    {{-3.91804767f, 3.41413101f, 0.00240705479f, 1.5015096f}, 0.0969520386f},
+    {{0.0f, 0.0f, 0.0f, 0.0f}, 1.8f},
+    {{-0.0f, -0.0f, -0.0f, -0.0f}, 0.0f},
+    {{-3.91804767f, 3.41413101f, 0.00240705479f, 1.5015096f}, -0.0969520386f},
+    {{-27.8841259f, 23.3096094f, 0.368329927f, 5.20618654f}, -0.0252504093f},
+    {{-17.870295f, 14.9148147f, 0.455827428f, 3.49965293f}, 0.0192021377f},
+    {{-27.5741815f, 22.9928419f, 0.538363905f, 5.04297576f}, 0.0f},
+    {{-17.870295f, 14.9148147f, 0.455827428f, 3.49965293f}, -0.0192021377f},
+    {{-27.9741503f, 23.7584406f, 0.435449606f, 7.57187293f}, 0.0f},
+    {{-40.2846969f, 34.2483139f, 0.480707365f, 10.9082965f}, 0.0f},
+    {{-3.91804767f, 3.41413101f, 0.00240705479f, 1.5015096f}, -0.000952054176f},
+    {{-40.2846969f, 34.2483139f, 0.480707365f, 10.9082965f}, -7.83471742f},
+};
+
+inline constexpr ExplicitMpc::Table kTable = {
+    kNodes, 31,
+    kLaws, 14,
+    9, // tree depth
+    0.001f, 0.0f, 1.8f, 0.05f,
+    {-1.84328634f, 0.847893704f}, {0.00460736235f, 0.0f}, // model a, b
+    12, // dead time, periods
+};
+
+} // namespace MpcLawTable
+
+#endif //FIRMWARE_MPCLAWTABLE_H
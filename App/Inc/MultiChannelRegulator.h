@@ -0,0 +1,132 @@
+#ifndef FIRMWARE_MULTICHANNELREGULATOR_H
+#define FIRMWARE_MULTICHANNELREGULATOR_H
+
+#pragma once
+
+/**
+ * @file MultiChannelRegulator.h
+ * @brief Up to kMaxChannels pressure loops (biventricular, several
+ * chambers) run together from one tick.
+ *
+ * Each channel is a VPPE regulator (setpoint DAC + feedback ADC), an
+ * optional valve and its own settings, given once as a Channel descriptor.
+ * Internally everything is stored per field, one array per field indexed
+ * by channel (struct of arrays), and tick() runs three passes over them:
+ *   1. acquire: read every feedback voltage,
+ *   2. control: reference, PI trim and calibration for all channels, plain
+ *      arithmetic over the arrays, no calls,
+ *   3. actuate: write every setpoint and the valve edges.
+ * So a channel adds one sensor read, one DAC write and a few flops, and
+ * there are no per-channel objects or calls in the control pass.
+ *
+ * All channels play the same preset at the same rate, from one
+ * WaveformTimeline: presets change at a beat boundary and crossfade, as in
+ * WaveformPlayer. Each channel adds its phaseOffset (beat fraction) and
+ * scales the amplitude, e.g. the right side a quarter of the left, or
+ * chambers staggered by 1/N beat.
+ *
+ * Commands are clamped to the overpressure configuration's
+ * max_setpoint_bar, below the hardware trip.
+ *
+ * The PI trim corrects what the VPPE's own regulation leaves (kp = ki = 0
+ * is plain feed-forward, like PressureRegulatorDriver). The valve, if any,
+ * is open in the [valveOpen, valveClose) part of the channel's beat.
+ *
+ * Tests/bench_multi_channel_regulator.cpp times tick() for 1..kMaxChannels
+ * channels on fake IO, i.e. the framework's cost without the converters.
+ */
+
+#include "OverpressureThreshold.h"
+#include "WaveformPlayer.h"
+#include "Interfaces/IAnalogActuator.h"
+#include "Interfaces/IAnalogSensor.h"
+#include "Interfaces/ISolenoidValve.h"
+
+#include <atomic>
+#include <stdint.h>
+
+class MultiChannelRegulator {
+public:
+    static constexpr uint32_t kMaxChannels = 8;
+    static constexpr float kIntegralLimit_bar = 0.2f;
+    static constexpr uint32_t kDefaultFadeBeats = 2;
+
+    /**
+     * @brief Channel descriptor, copied by addChannel().
+     */
+    struct Channel {
+        IAnalogSensor* feedback;   // VPPE feedback voltage
+        IAnalogActuator* setpoint; // VPPE setpoint voltage
+        ISolenoidValve* valve;     // optional
+        float phaseOffset;         // beat fraction, 0..1
+        float amplitudeScale;      // scales systolic - diastolic
+        float kp;                  // bar per bar
+        float ki;                  // bar per bar.s
+        float valveOpen;           // beat fractions, may wrap
+        float valveClose;
+    };
+
+    /**
+     * @param tick_s time between tick() calls.
+     * @param maxSetpoint_bar highest pressure commanded on any channel.
+     */
+    explicit MultiChannelRegulator(float tick_s,
+                                   float maxSetpoint_bar = OverpressureThreshold::kDefaultConfig.max_setpoint_bar);
+
+    /**
+     * @brief Adds a channel. Not while tick() may run.
+     * @return the channel index, -1 if full or the descriptor has no
+     * feedback or setpoint.
+     */
+    int32_t addChannel(const Channel& channel);
+
+    /**
+     * @brief Waveform for all channels, taken at the next beat boundary
+     * and crossfaded over @p fadeBeats. Safe from another task; nullptr
+     * fades every channel out to 0 bar.
+     */
+    void play(const WaveformPreset* preset, float rateScale, uint32_t fadeBeats = kDefaultFadeBeats);
+
+    /**
+     * @brief Changes a channel's offset from the next tick. Safe from
+     * another task.
+     */
+    void setPhaseOffset(uint32_t channel, float phaseOffset);
+
+    /**
+     * @brief One control period for every channel.
+     */
+    void tick();
+
+    uint32_t channelCount() const { return m_count; }
+    float target(uint32_t channel) const { return m_target[channel]; }
+    float measured(uint32_t channel) const { return m_measured[channel]; }
+    float phase() const { return m_timeline.phase(); }
+
+private:
+    float m_tick_s;
+    float m_maxSetpoint_bar;
+    uint32_t m_count;
+    WaveformTimeline m_timeline;
+
+    // Channel descriptors, one array per field
+    IAnalogSensor* m_feedback[kMaxChannels];
+    IAnalogActuator* m_setpoint[kMaxChannels];
+    ISolenoidValve* m_valve[kMaxChannels];
+    std::atomic<float> m_offset[kMaxChannels];
+    float m_amplitude[kMaxChannels];
+    float m_kp[kMaxChannels];
+    float m_ki[kMaxChannels];
+    float m_valveOpen[kMaxChannels];
+    float m_valveClose[kMaxChannels];
+
+    // Loop state
+    float m_volts[kMaxChannels]; // feedback in, setpoint out
+    float m_integral[kMaxChannels];
+    float m_target[kMaxChannels];
+    float m_measured[kMaxChannels];
+    bool m_open[kMaxChannels];
+    bool m_valveState[kMaxChannels];
+};
+
+#endif //FIRMWARE_MULTICHANNELREGULATOR_H
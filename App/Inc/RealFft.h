@@ -0,0 +1,49 @@
+#ifndef FIRMWARE_REALFFT_H
+#define FIRMWARE_REALFFT_H
+
+#pragma once
+
+/**
+ * @file RealFft.h
+ * @brief Fixed-size real FFT: CMSIS-DSP when available, portable otherwise.
+ *
+ * With CMSIS-DSP (arm_math.h found and ARM_MATH_CM4 defined, see
+ * CMakeLists.txt) this is arm_rfft_fast_f32. Without it (host builds, or a
+ * tree without the library) a radix-2 FFT of N/2 complex points plus the
+ * real split step is used, with twiddles precomputed in the object.
+ *
+ * Output layout is the CMSIS one for both:
+ *   out[0] = Re X[0], out[1] = Re X[N/2], out[2k], out[2k+1] = X[k], 0 < k < N/2
+ */
+
+#include <stdint.h>
+
+#if defined(ARM_MATH_CM4) && defined(__has_include)
+#if __has_include("arm_math.h")
+#define REALFFT_USE_CMSIS_DSP 1
+#include "arm_math.h"
+#endif
+#endif
+
+class RealFft {
+public:
+    static constexpr uint32_t kSize = 256;
+
+    RealFft();
+
+    /**
+     * @brief Forward transform. @p in is used as scratch and destroyed.
+     */
+    void forward(float* in, float* out);
+
+private:
+#if defined(REALFFT_USE_CMSIS_DSP)
+    arm_rfft_fast_instance_f32 m_instance;
+#else
+    float m_cos[kSize / 2]; // cos(2 pi k / N)
+    float m_sin[kSize / 2]; // sin(2 pi k / N)
+    uint16_t m_reverse[kSize / 2];
+#endif
+};
+
+#endif //FIRMWARE_REALFFT_H
@@ -0,0 +1,105 @@
+#ifndef FIRMWARE_SMITHPREDICTOR_H
+#define FIRMWARE_SMITHPREDICTOR_H
+
+#pragma once
+
+/**
+ * @file SmithPredictor.h
+ * @brief PI pressure controller with optional dead-time compensation.
+ *
+ * In Smith mode the PI acts on
+ *     y + ym0[k] - ym0[k-d]
+ * where ym0 is the output of a delay-free internal model of the VPPE and
+ * d the dead time in samples. If the model is right, the loop sees the
+ * plant without its dead time and the PI can be tuned much harder. Model
+ * mismatch only appears through y - ym0[k-d], like a disturbance.
+ *
+ * The internal model has the ArxIdentifier form (2 poles, 2 zeros), so
+ * it can be set by hand or taken from the online identifier. Changing the
+ * delay or the model is bumpless: the model history is kept for the
+ * largest delay.
+ *
+ * Uses IPressureControl, so it runs the same against the VPPE driver or a
+ * host plant simulation.
+ */
+
+#include "ArxIdentifier.h"
+#include "Interfaces/IPressureControl.h"
+
+#include <stdint.h>
+
+class SmithPredictor {
+public:
+    static constexpr uint32_t kMaxDelay = 64; // samples
+
+    enum class Mode {
+        Pi,   // plain PI on the measured pressure
+        Smith // PI on the dead-time compensated pressure
+    };
+
+    struct Gains {
+        float kp;       // bar per bar
+        float ki;       // bar per bar*s
+        float min_bar;  // setpoint limits sent to the plant
+        float max_bar;
+    };
+
+    /**
+     * @brief Constructor.
+     * @param plant pressure regulator to drive.
+     * @param period_s time between step() calls.
+     */
+    SmithPredictor(IPressureControl& plant, float period_s, const Gains& gains);
+
+    void setGains(const Gains& gains) { m_gains = gains; }
+    void setMode(Mode mode) { m_mode = mode; }
+    Mode mode() const { return m_mode; }
+
+    /**
+     * @brief Sets the internal model: y[k] = -a1 y[k-1] - a2 y[k-2]
+     * + b1 u[k-1-d] + b2 u[k-2-d].
+     * @return false if @p delay is larger than kMaxDelay.
+     */
+    bool setModel(const float a[2], const float b[2], uint32_t delay);
+
+    /**
+     * @brief Takes the latest model from the identifier, if it is valid.
+     * @return false if there is none yet, or the identifier does not run
+     * at the period of this controller.
+     */
+    bool updateModel(const ArxIdentifier& identifier);
+
+    /**
+     * @brief One control period: reads the plant, sets its new setpoint.
+     * @return the setpoint sent to the plant.
+     */
+    float step(float reference_bar);
+
+    /**
+     * @brief The control law alone, without touching the plant.
+     */
+    float compute(float reference_bar, float measured_bar);
+
+    /**
+     * @brief Clears the integrator and the model history.
+     */
+    void reset();
+
+private:
+    IPressureControl& m_plant;
+    float m_period_s;
+    Gains m_gains;
+    Mode m_mode;
+
+    float m_integral;
+
+    // Internal model
+    float m_a[2];
+    float m_b[2];
+    uint32_t m_delay;
+    float m_u[2];                 // last commands, newest first
+    float m_ym[kMaxDelay + 2];    // delay-free model output history (ring)
+    uint32_t m_ymHead;            // index of ym0[k]
+};
+
+#endif //FIRMWARE_SMITHPREDICTOR_H
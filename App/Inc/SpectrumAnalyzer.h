@@ -0,0 +1,145 @@
+#ifndef FIRMWARE_SPECTRUMANALYZER_H
+#define FIRMWARE_SPECTRUMANALYZER_H
+
+#pragma once
+
+/**
+ * @file SpectrumAnalyzer.h
+ * @brief Background spectra of the pressure signals (resonances, valve
+ * chatter, harmonic content of the beat).
+ *
+ * The control loop hands each sample over with pushSample(): one store into
+ * a per-channel ring, wait-free, so it adds no jitter. All the work happens
+ * in service(), run by a task at osPriorityIdle (startTask()), so it only
+ * uses time nothing else wants.
+ *
+ * service() takes kFftSize-sample blocks with 50 % overlap, applies a Hann
+ * window, runs the real FFT (CMSIS-DSP if present, see RealFft.h) and
+ * averages the power per bin over kAverages blocks (a running mean, then
+ * exponential). Amplitudes are scaled so a sine of amplitude A centred on
+ * a bin reads A.
+ *
+ * If service() falls behind by more than the ring, old samples are
+ * skipped and counted as overruns. The same happens to a block the
+ * producer overwrites while it is being copied: it is discarded, never
+ * analysed torn.
+ */
+
+#include "RealFft.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class SpectrumAnalyzer {
+public:
+    static constexpr uint32_t kChannels = 2;
+    static constexpr uint32_t kFftSize = RealFft::kSize;
+    static constexpr uint32_t kBins = kFftSize / 2 + 1;
+    static constexpr uint32_t kHop = kFftSize / 2;
+    static constexpr uint32_t kRingSize = 2 * kFftSize;
+    static constexpr uint32_t kAverages = 16;
+    static constexpr uint32_t kHarmonics = 8;
+    static constexpr uint32_t kMagic = 0x43455053U; // "SPEC"
+    static constexpr uint32_t kReadAttempts = 4;
+
+    struct Peak {
+        float frequency_hz;
+        float amplitude;
+    };
+
+#pragma pack(push, 1)
+    struct Header {
+        uint32_t magic;        // kMagic
+        uint8_t channel;
+        uint8_t harmonics;     // kHarmonics
+        uint16_t bins;         // kBins
+        float binWidth_hz;
+        uint32_t blocks;       // blocks averaged so far
+        uint32_t overruns;
+        float fundamental_hz;
+        float thd;             // sqrt(sum A2..An^2) / A1
+        // followed by: float harmonic[kHarmonics], float amplitude[kBins]
+    };
+#pragma pack(pop)
+
+    explicit SpectrumAnalyzer(float sampleRate_hz);
+
+    /**
+     * @brief One sample of @p channel. Control loop, wait-free.
+     */
+    void pushSample(uint32_t channel, float value)
+    {
+        Channel& c = m_channels[channel];
+        uint32_t head = c.head.load(std::memory_order_relaxed);
+        c.ring[head % kRingSize] = value;
+        c.head.store(head + 1U, std::memory_order_release);
+    }
+
+    /**
+     * @brief Sets the frequency whose harmonics are tracked (e.g. the beat
+     * rate / 60). 0 disables the harmonic analysis.
+     */
+    void setFundamental(uint32_t channel, float hz);
+
+    /**
+     * @brief Processes every complete block waiting in the rings.
+     * @return number of blocks processed.
+     */
+    uint32_t service();
+
+    /**
+     * @brief Averaged amplitude of one bin.
+     */
+    float amplitude(uint32_t channel, uint32_t bin) const;
+
+    /**
+     * @brief Largest peak at or above @p minHz, with parabolic
+     * interpolation between bins.
+     */
+    Peak dominantPeak(uint32_t channel, float minHz) const;
+
+    /**
+     * @brief Header, harmonics and the averaged amplitude spectrum.
+     * Safe from another task. Any caller outranks the idle-priority
+     * service() task, so it cannot wait for an update it interrupted: it
+     * gives up after kReadAttempts tries.
+     * @return bytes written, 0 if @p len is too small or the results were
+     * being updated (call again later).
+     */
+    size_t encode(uint32_t channel, uint8_t* buf, size_t len) const;
+
+#if defined(USE_HAL_DRIVER)
+    /**
+     * @brief Starts a static idle-priority task calling service().
+     */
+    void startTask();
+#endif
+
+private:
+    struct Channel {
+        float ring[kRingSize];
+        std::atomic<uint32_t> head; // written by pushSample()
+        uint32_t tail;              // start of the next block
+        uint32_t blocks;
+        uint32_t overruns;
+        float fundamental_hz;
+        float power[kBins];         // averaged amplitude^2
+        float harmonic[kHarmonics];
+        float thd;
+        std::atomic<uint32_t> seq;  // odd while results are updated
+    };
+
+    bool loadBlock(Channel& c);
+    void processBlock(Channel& c);
+    void updateHarmonics(Channel& c);
+
+    float m_sampleRate_hz;
+    float m_window[kFftSize];
+    float m_block[kFftSize];
+    float m_spectrum[kFftSize];
+    RealFft m_fft;
+    Channel m_channels[kChannels];
+};
+
+#endif //FIRMWARE_SPECTRUMANALYZER_H
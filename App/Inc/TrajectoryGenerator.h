@@ -0,0 +1,148 @@
+#ifndef FIRMWARE_TRAJECTORYGENERATOR_H
+#define FIRMWARE_TRAJECTORYGENERATOR_H
+
+#pragma once
+
+/**
+ * @file TrajectoryGenerator.h
+ * @brief Smooth pressure setpoint trajectories from waypoint lists.
+ *
+ * Sits between the application and IPressureControl. The application
+ * loads a list of waypoints (pressure + segment duration) and tick() is
+ * called once per control period to send the next setpoint.
+ *
+ * Two shapes:
+ *  - JerkLimited: rest-to-rest S-curve moves (7 constant-jerk phases)
+ *    within the velocity, acceleration and jerk limits, then a hold until
+ *    the waypoint's duration is used up. A move that cannot fit in the
+ *    duration takes longer. Position, velocity and acceleration are
+ *    continuous.
+ *  - CubicSpline: a cubic spline through the waypoints at the given times,
+ *    starting from the current pressure and slope, natural at the end.
+ *    Position and velocity are continuous everywhere, acceleration inside
+ *    the path.
+ *
+ * Both shapes are made of cubic pieces, so a tick is evaluated by forward
+ * differencing: three adds. Phase times are whole ticks. The jerk of each
+ * move is rescaled after rounding, so waypoints are still hit exactly. The
+ * exact state is recomputed at every piece boundary, so rounding does not
+ * accumulate. Planning a waypoint, a few dozen flops, happens only when the
+ * previous one finishes.
+ *
+ * load() never cuts the running path: the new one takes over when the
+ * current one ends (the beat boundary for a cycle waveform), starting from
+ * the current state. A jerk-limited path that starts while the pressure is
+ * still moving first brakes to rest within the limits.
+ */
+
+#include "Interfaces/IPressureControl.h"
+
+#include <atomic>
+#include <stdint.h>
+
+class TrajectoryGenerator {
+public:
+    static constexpr uint32_t kMaxWaypoints = 16;
+
+    enum class Shape {
+        JerkLimited,
+        CubicSpline
+    };
+
+    struct Waypoint {
+        float bar;
+        float duration_s; // time from the previous waypoint (or path start)
+    };
+
+    struct Limits {
+        float velocity;     // bar/s
+        float acceleration; // bar/s^2
+        float jerk;         // bar/s^3
+    };
+
+    /**
+     * @brief Constructor.
+     * @param output regulator that receives the setpoints.
+     * @param tick_s time between tick() calls.
+     */
+    TrajectoryGenerator(IPressureControl& output, float tick_s, const Limits& limits);
+
+    /**
+     * @brief Queues a path. It starts when the running path ends, or on the
+     * next tick() if idle.
+     * @param loop repeat the path until another one is loaded.
+     * @return false if a path is already queued or the list is invalid.
+     */
+    bool load(const Waypoint* points, uint32_t count, Shape shape, bool loop);
+
+    /**
+     * @brief Advances one tick and sends the setpoint.
+     * @return the setpoint sent.
+     */
+    float tick();
+
+    float setpoint() const { return m_out; }
+    bool isIdle() const { return m_idle; }
+
+private:
+    static constexpr uint32_t kMaxPieces = 8; // S-curve phases + hold
+
+    struct Path {
+        Waypoint points[kMaxWaypoints];
+        uint32_t count;
+        Shape shape;
+        bool loop;
+    };
+
+    /**
+     * @brief Constant-jerk piece, starting from the current exact state.
+     */
+    struct Piece {
+        float jerk;
+        uint32_t ticks;
+    };
+
+    void startPath();
+    bool planNext();
+    void planBrake();
+    void planMove(float target, uint32_t durationTicks);
+    void planSplinePiece(uint32_t index);
+    void solveSpline();
+    void addPiece(float jerk, uint32_t ticks);
+    void startPiece();
+    void finishPiece();
+    uint32_t toTicks(float seconds) const;
+
+    IPressureControl& m_output;
+    float m_tick_s;
+    Limits m_limits;
+
+    // Exact state at the start of the current piece
+    float m_p;
+    float m_v;
+    float m_a;
+
+    // Forward differences of the current piece
+    float m_out;
+    float m_d1;
+    float m_d2;
+    float m_d3;
+    uint32_t m_ticksLeft;
+
+    Piece m_pieces[kMaxPieces];
+    uint32_t m_pieceCount;
+    uint32_t m_pieceIndex;
+
+    Path m_active;
+    uint32_t m_waypoint; // next waypoint to plan
+    bool m_idle;
+
+    // Spline knots and second derivatives, for CubicSpline paths
+    float m_knots[kMaxWaypoints + 1];
+    float m_curvature[kMaxWaypoints + 1];
+
+    Path m_pending;
+    std::atomic<bool> m_pendingReady;
+};
+
+#endif //FIRMWARE_TRAJECTORYGENERATOR_H
@@ -0,0 +1,196 @@
+#ifndef FIRMWARE_WAVEFORMPLAYER_H
+#define FIRMWARE_WAVEFORMPLAYER_H
+
+#pragma once
+
+/**
+ * @file WaveformPlayer.h
+ * @brief Plays physiological pressure presets from flash, with heart rate
+ * and amplitude scaling and beat-boundary crossfades.
+ *
+ * A preset is one beat of normalised shape (Q15, 0 = diastolic, 32767 =
+ * systolic) plus its nominal rate and pressures. The tables are constexpr
+ * (WaveformPresetTable.h, generated by Tools/waveform_encode.py), so they
+ * stay in flash.
+ *
+ * select() only stores a pointer; the switch happens at the next beat
+ * boundary. The old and new waveforms are then evaluated at the same phase
+ * and mixed, and the weight of the new one rises linearly over K beats. The
+ * rate is mixed the same way, so the plant sees neither a step nor a
+ * jump in period. Each tick is O(1): a phase step and one or two
+ * interpolated table reads.
+ *
+ * Rate scaling stretches the whole beat uniformly.
+ *
+ * The clock, requests and crossfade are WaveformTimeline, so other users
+ * of the presets (MultiChannelRegulator) switch and fade the same way.
+ */
+
+#include "Interfaces/IPressureControl.h"
+
+#include <atomic>
+#include <stdint.h>
+
+struct WaveformPreset {
+    const char* name;
+    float rate_bpm;
+    float diastolic_bar;
+    float systolic_bar;
+    uint16_t count;      // samples per beat
+    const int16_t* shape; // Q15, 0..32767
+};
+
+/**
+ * @class WaveformTimeline
+ * @brief The beat clock behind WaveformPlayer: phase, the selection being
+ * played, pending requests and the crossfade, without an output.
+ *
+ * Each tick is begin(), any number of value() reads, end(). value() takes
+ * a phase offset and an amplitude scale, so several outputs can follow one
+ * timeline (MultiChannelRegulator) and all switch and fade together.
+ */
+class WaveformTimeline {
+public:
+    /**
+     * @brief What is playing: a preset and how it is scaled.
+     */
+    struct Selection {
+        const WaveformPreset* preset;
+        float rateScale;      // 1 = preset rate
+        float amplitudeScale; // scales systolic - diastolic
+    };
+
+    explicit WaveformTimeline(float tick_s);
+
+    /**
+     * @brief Requests a new selection. It takes over at the next beat
+     * boundary (at once if nothing plays) and is faded in over
+     * @p fadeBeats beats (0 = hard switch at the boundary). With nothing
+     * playing it fades in from the level passed to begin(). A nullptr
+     * preset fades out to 0 bar and stops. Safe from another task. A
+     * request not yet taken over is replaced.
+     */
+    void select(const Selection& selection, uint32_t fadeBeats);
+
+    /**
+     * @brief Starts a tick; takes a pending request at a beat boundary.
+     * @param idle_bar level held while nothing plays, where a fade-in
+     * from nothing starts.
+     * @return true if a new beat starts on this tick.
+     */
+    bool begin(float idle_bar = 0.0f);
+
+    /**
+     * @brief Pressure at the current phase + @p phaseOffset (beats, 0..1),
+     * with the pulse scaled by @p amplitudeScale, crossfaded. 0 when
+     * nothing plays.
+     */
+    float value(float phaseOffset = 0.0f, float amplitudeScale = 1.0f) const
+    {
+        float phase = m_phase + phaseOffset;
+        phase -= (phase >= 1.0f) ? 1.0f : 0.0f;
+        float out = sample(m_current, phase, amplitudeScale);
+        if (m_fadeBeats > 0U)
+        {
+            float w = ((float)m_fadeBeat + m_phase) / (float)m_fadeBeats;
+            float from = (m_previous.preset != nullptr) ? sample(m_previous, phase, amplitudeScale)
+                                                        : m_from_bar;
+            out = from + (out - from) * w;
+        }
+        return out;
+    }
+
+    /**
+     * @brief Ends the tick: advances the phase at the (crossfaded) rate.
+     */
+    void end();
+
+    bool isPlaying() const { return m_current.preset != nullptr || m_previous.preset != nullptr; }
+    bool isFading() const { return m_fadeBeats > 0U; }
+    float phase() const { return m_phase; }
+
+    /**
+     * @brief One preset at @p phase (0..1), linear between table entries.
+     */
+    static float sample(const Selection& selection, float phase, float amplitudeScale = 1.0f)
+    {
+        const WaveformPreset* p = selection.preset;
+        if (p == nullptr)
+        {
+            return 0.0f;
+        }
+        float x = phase * (float)p->count;
+        uint32_t i0 = (uint32_t)x;
+        float frac = x - (float)i0;
+        i0 %= p->count;
+        uint32_t i1 = (i0 + 1U == p->count) ? 0U : i0 + 1U; // the beat is periodic
+        float q15 = (float)p->shape[i0] + ((float)p->shape[i1] - (float)p->shape[i0]) * frac;
+        float pulse = (p->systolic_bar - p->diastolic_bar) * selection.amplitudeScale * amplitudeScale;
+        return p->diastolic_bar + pulse * q15 * (1.0f / 32767.0f);
+    }
+
+private:
+    void onBeatBoundary(float idle_bar);
+
+    float m_tick_s;
+
+    Selection m_current;  // faded in, or the only one playing
+    Selection m_previous; // faded out while m_fadeBeats > 0
+    float m_from_bar;     // faded out instead when m_previous is none
+    uint32_t m_fadeBeats;
+    uint32_t m_fadeBeat;  // beats done in the current fade
+    float m_phase;        // 0..1 within the beat
+
+    // Request from select(): written by the caller, taken by begin()
+    Selection m_request;
+    uint32_t m_requestFade;
+    std::atomic<uint32_t> m_requestSeq; // odd while being written
+    uint32_t m_takenSeq;
+};
+
+class WaveformPlayer {
+public:
+    using Selection = WaveformTimeline::Selection;
+
+    /**
+     * @brief Constructor.
+     * @param output regulator that receives the setpoints.
+     * @param tick_s time between tick() calls.
+     */
+    WaveformPlayer(IPressureControl& output, float tick_s);
+
+    /**
+     * @brief See WaveformTimeline::select().
+     */
+    void select(const Selection& selection, uint32_t fadeBeats) { m_timeline.select(selection, fadeBeats); }
+
+    /**
+     * @brief Advances one tick and sends the setpoint.
+     * @return the setpoint sent.
+     */
+    float tick();
+
+    /**
+     * @brief True on the tick where a new beat started, e.g. for
+     * BeatMetrics::markBeatStart(). tick() also passes it on to
+     * RuntimeStats::notifyBeat().
+     */
+    bool beatStarted() const { return m_beatStarted; }
+
+    bool isFading() const { return m_timeline.isFading(); }
+
+    /**
+     * @brief Sends @p bar as a steady setpoint while nothing plays. The
+     * next selection fades in from the last setpoint sent, this or the
+     * last of a waveform.
+     */
+    void hold(float bar);
+
+private:
+    IPressureControl& m_output;
+    WaveformTimeline m_timeline;
+    bool m_beatStarted;
+    float m_setpoint_bar; // last sent
+};
+
+#endif //FIRMWARE_WAVEFORMPLAYER_H
@@ -0,0 +1,79 @@
+/**
+ * @file WaveformPresetTable.h
+ * @brief Waveform presets, GENERATED by Tools/waveform_encode.py. Do not edit.
+ */
+
+#ifndef FIRMWARE_WAVEFORMPRESETTABLE_H
+#define FIRMWARE_WAVEFORMPRESETTABLE_H
+
+#pragma once
+
+#include "WaveformPlayer.h"
+
+namespace WaveformPresetTable {
+
+enum PresetId : uint8_t {
+    Rest,
+    Exercise,
+    HeartFailure,
+    AorticStenosis,
+    MitralRegurgitation,
+    PresetCount
+};
+
+inline constexpr int16_t kRestShape[64] = {
+    0, 997, 3866, 8258, 13639, 19354, 24708, 29048, 31848, 32767, 32550, 31945,
+    30983, 29717, 28216, 26561, 24843, 23156, 21589, 20230, 19152, 18413, 18054, 17219,
+    15955, 14779, 13685, 12667, 11720, 10839, 10019, 9256, 8547, 7886, 7272, 6700,
+    6168, 5674, 5213, 4785, 4386, 4015, 3670, 3349, 3050, 2772, 2514, 2273,
+    2049, 1841, 1647, 1467, 1299, 1143, 998, 863, 737, 620, 511, 410,
+    316, 228, 147, 71,
+};
+
+inline constexpr int16_t kExerciseShape[64] = {
+    0, 789, 3081, 6655, 11166, 16179, 21213, 25781, 29443, 31848, 32762, 32689,
+    32430, 31996, 31399, 30657, 29790, 28823, 27782, 26697, 25599, 24517, 23484, 22527,
+    21674, 20948, 20370, 19957, 19719, 19403, 18162, 16988, 15880, 14833, 13844, 12909,
+    12026, 11192, 10404, 9659, 8956, 8291, 7663, 7070, 6509, 5980, 5480, 5007,
+    4561, 4139, 3740, 3364, 3008, 2672, 2354, 2054, 1771, 1503, 1250, 1011,
+    785, 572, 370, 180,
+};
+
+inline constexpr int16_t kHeartFailureShape[64] = {
+    0, 341, 1352, 2989, 5184, 7846, 10864, 14112, 17455, 20753, 23869, 26673,
+    29048, 30895, 32137, 32723, 32673, 32158, 31241, 30008, 28573, 27071, 25642, 24419,
+    23517, 23020, 22295, 20760, 19322, 17975, 16713, 15530, 14422, 13384, 12411, 11499,
+    10645, 9845, 9095, 8393, 7734, 7118, 6540, 5998, 5491, 5015, 4570, 4153,
+    3762, 3395, 3052, 2730, 2429, 2147, 1882, 1634, 1402, 1184, 980, 789,
+    610, 442, 285, 138,
+};
+
+inline constexpr int16_t kAorticStenosisShape[64] = {
+    0, 251, 997, 2214, 3866, 5901, 8258, 10864, 13639, 16498, 19354, 22119,
+    24708, 27041, 29048, 30667, 31848, 32554, 32762, 31902, 29697, 26513, 22873, 19379,
+    16607, 15015, 14268, 13137, 12092, 11125, 10231, 9404, 8639, 7932, 7278, 6673,
+    6113, 5596, 5117, 4675, 4265, 3887, 3537, 3213, 2913, 2636, 2380, 2143,
+    1924, 1721, 1534, 1361, 1200, 1052, 915, 788, 671, 562, 462, 369,
+    283, 204, 131, 63,
+};
+
+inline constexpr int16_t kMitralRegurgitationShape[64] = {
+    0, 2377, 8818, 17455, 25781, 31380, 32752, 32357, 31450, 30080, 28322, 26270,
+    24038, 21745, 19517, 17476, 15731, 14378, 13491, 13118, 12186, 11125, 10153, 9265,
+    8453, 7710, 7031, 6409, 5841, 5321, 4846, 4411, 4013, 3650, 3317, 3013,
+    2735, 2480, 2247, 2035, 1840, 1662, 1499, 1350, 1214, 1089, 975, 871,
+    776, 689, 609, 536, 469, 408, 353, 302, 255, 212, 173, 138,
+    105, 75, 48, 23,
+};
+
+inline constexpr WaveformPreset kPresets[PresetCount] = {
+    {"rest", 70.0f, 0.2f, 1.2f, 64, kRestShape},
+    {"exercise", 130.0f, 0.2f, 1.6f, 64, kExerciseShape},
+    {"heart_failure", 95.0f, 0.3f, 0.8f, 64, kHeartFailureShape},
+    {"aortic_stenosis", 72.0f, 0.2f, 1.8f, 64, kAorticStenosisShape},
+    {"mitral_regurgitation", 85.0f, 0.2f, 1.0f, 64, kMitralRegurgitationShape},
+};
+
+} // namespace WaveformPresetTable
+
+#endif //FIRMWARE_WAVEFORMPRESETTABLE_H
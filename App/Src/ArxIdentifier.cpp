@@ -0,0 +1,156 @@
+/**
+ * @file ArxIdentifier.cpp
+ * @brief RLS update with forgetting, dead-time selection and publishing.
+ */
+
+#include "ArxIdentifier.h"
+
+#include <string.h>
+
+
+ArxIdentifier::ArxIdentifier(const Config& config)
+        : m_config(config),
+          m_modelSeq(0),
+          m_model{}
+{
+    reset();
+}
+
+void ArxIdentifier::reset()
+{
+    for (Estimator& est : m_estimators)
+    {
+        resetEstimator(est);
+    }
+    memset(m_y, 0, sizeof(m_y));
+    memset(m_u, 0, sizeof(m_u));
+    m_samples = 0;
+}
+
+void ArxIdentifier::resetEstimator(Estimator& est)
+{
+    memset(&est, 0, sizeof(est));
+    for (uint32_t i = 0; i < kParams; ++i)
+    {
+        est.P[i][i] = m_config.initialCovariance;
+    }
+}
+
+void ArxIdentifier::updateEstimator(Estimator& est, const float* phi, float y)
+{
+    float Pphi[kParams];
+    float denom = 0.0f;
+    float prediction = 0.0f;
+    float trace = 0.0f;
+    for (uint32_t i = 0; i < kParams; ++i)
+    {
+        float sum = 0.0f;
+        for (uint32_t j = 0; j < kParams; ++j)
+        {
+            sum += est.P[i][j] * phi[j];
+        }
+        Pphi[i] = sum;
+        denom += phi[i] * sum;
+        prediction += est.theta[i] * phi[i];
+        trace += est.P[i][i];
+    }
+
+    float lambda = (trace > m_config.maxCovarianceTrace) ? 1.0f : m_config.lambda;
+    denom += lambda;
+    float error = y - prediction;
+    est.error += m_config.errorSmoothing * (error * error - est.error);
+
+    float invDenom = 1.0f / denom;
+    float invLambda = 1.0f / lambda;
+    for (uint32_t i = 0; i < kParams; ++i)
+    {
+        est.theta[i] += Pphi[i] * invDenom * error;
+    }
+    // P = (P - Pphi Pphi' / denom) / lambda, kept symmetric
+    for (uint32_t i = 0; i < kParams; ++i)
+    {
+        for (uint32_t j = i; j < kParams; ++j)
+        {
+            float value = (est.P[i][j] - Pphi[i] * Pphi[j] * invDenom) * invLambda;
+            est.P[i][j] = value;
+            est.P[j][i] = value;
+        }
+    }
+}
+
+void ArxIdentifier::update(float setpoint_bar, float feedback_bar)
+{
+    float phi[kParams];
+    phi[0] = -m_y[0];
+    phi[1] = -m_y[1];
+    phi[kParams - 1] = 1.0f;
+
+    uint32_t best = 0;
+    for (uint32_t d = 0; d <= kMaxDelay; ++d)
+    {
+        phi[2] = m_u[d];
+        phi[3] = m_u[d + 1];
+        updateEstimator(m_estimators[d], phi, feedback_bar);
+        if (m_estimators[d].error < m_estimators[best].error)
+        {
+            best = d;
+        }
+    }
+
+    memmove(&m_y[1], &m_y[0], (kNa - 1U) * sizeof(float));
+    m_y[0] = feedback_bar;
+    memmove(&m_u[1], &m_u[0], (kMaxDelay + kNb - 1U) * sizeof(float));
+    m_u[0] = setpoint_bar;
+    m_samples++;
+
+    publish(m_estimators[best], (uint8_t)best);
+}
+
+void ArxIdentifier::publish(const Estimator& est, uint8_t delay)
+{
+    uint32_t seq = m_modelSeq.load(std::memory_order_relaxed);
+    m_modelSeq.store(seq + 1U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ArxModel& m = m_model;
+    float sumA = 0.0f;
+    float sumB = 0.0f;
+    for (uint32_t i = 0; i < kNa; ++i)
+    {
+        m.a[i] = est.theta[i];
+        sumA += est.theta[i];
+    }
+    for (uint32_t i = 0; i < kNb; ++i)
+    {
+        m.b[i] = est.theta[kNa + i];
+        sumB += est.theta[kNa + i];
+    }
+    m.bias = est.theta[kParams - 1];
+    m.delay = delay;
+    m.period_s = m_config.period_s;
+    m.dcGain = (1.0f + sumA != 0.0f) ? sumB / (1.0f + sumA) : 0.0f;
+    m.errorVariance = est.error;
+    m.samples = m_samples;
+    m.valid = (m_samples >= m_config.warmupSamples);
+
+    m_modelSeq.store(seq + 2U, std::memory_order_release);
+}
+
+bool ArxIdentifier::model(ArxModel& out) const
+{
+    for (uint32_t attempt = 0; attempt < kReadAttempts; ++attempt)
+    {
+        uint32_t before = m_modelSeq.load(std::memory_order_acquire);
+        if ((before & 1U) != 0U)
+        {
+            continue;
+        }
+        memcpy(&out, &m_model, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_modelSeq.load(std::memory_order_relaxed) == before)
+        {
+            return before != 0U;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,220 @@
+/**
+ * @file BeatMetrics.cpp
+ * @brief Running per-beat extremes, integral and dP/dt, plus the upstroke
+ * detector used for feature-based segmentation.
+ */
+
+#include "BeatMetrics.h"
+
+#include <float.h>
+
+
+void BeatMetrics::Accumulator::start(float bar, uint32_t t_us)
+{
+    start_us = t_us;
+    max = bar;
+    min = bar;
+    max_us = t_us;
+    integral = 0.0;
+    dpdtMax = -FLT_MAX;
+    dpdtMin = FLT_MAX;
+    dpdtMax_us = t_us;
+    dpdtMin_us = t_us;
+}
+
+void BeatMetrics::Accumulator::add(float prevBar, float bar, uint32_t dt_us, uint32_t t_us)
+{
+    integral += 0.5 * (double)(bar + prevBar) * (double)dt_us;
+    float dpdt = (bar - prevBar) * (1.0e6f / (float)dt_us);
+    if (dpdt > dpdtMax)
+    {
+        dpdtMax = dpdt;
+        dpdtMax_us = t_us;
+    }
+    if (dpdt < dpdtMin)
+    {
+        dpdtMin = dpdt;
+        dpdtMin_us = t_us;
+    }
+    if (bar > max)
+    {
+        max = bar;
+        max_us = t_us;
+    }
+    if (bar < min)
+    {
+        min = bar;
+    }
+}
+
+
+BeatMetrics::BeatMetrics(const Config& config)
+        : m_config(config),
+          m_beatCount(0),
+          m_last{}
+{
+    reset();
+}
+
+void BeatMetrics::reset()
+{
+    m_inBeat = false;
+    m_beat.start(0.0f, 0);
+    m_havePrev = false;
+    m_prevBar = 0.0f;
+    m_prev_us = 0;
+    m_armed = false;
+    m_learning = true;
+    m_threshold = 0.0f;
+    m_seenMin = FLT_MAX;
+    m_seenMax = -FLT_MAX;
+    m_footBar = FLT_MAX;
+    m_atFoot = m_beat;
+    m_next = m_beat;
+}
+
+bool BeatMetrics::finish(const Accumulator& beat, uint32_t end_us)
+{
+    uint32_t duration = end_us - beat.start_us;
+    if (duration == 0U || duration > m_config.maxBeatInterval_us || beat.dpdtMax == -FLT_MAX)
+    {
+        return false;
+    }
+
+    BeatRecord& r = m_last;
+    r.beat = ++m_beatCount;
+    r.start_us = beat.start_us;
+    r.duration_us = duration;
+    r.systolic_bar = beat.max;
+    r.diastolic_bar = beat.min;
+    r.mean_bar = (float)(beat.integral / (double)duration);
+    r.dpdtMax_bar_s = beat.dpdtMax;
+    r.dpdtMin_bar_s = beat.dpdtMin;
+    r.peak_us = beat.max_us - beat.start_us;
+    r.dpdtMax_us = beat.dpdtMax_us - beat.start_us;
+    r.dpdtMin_us = beat.dpdtMin_us - beat.start_us;
+    r.rate_bpm = 60.0e6f / (float)duration;
+
+    m_threshold = 0.5f * (beat.max + beat.min);
+    m_learning = false;
+    return true;
+}
+
+/**
+ * @brief Rising crossing of the midpoint of the previous beat. Before the
+ * first beat (and after losing the rhythm) the midpoint of everything seen
+ * since is used.
+ */
+bool BeatMetrics::detectUpstroke(float bar, uint32_t t_us)
+{
+    if (m_learning)
+    {
+        if (bar < m_seenMin)
+        {
+            m_seenMin = bar;
+        }
+        if (bar > m_seenMax)
+        {
+            m_seenMax = bar;
+        }
+        if (m_seenMax - m_seenMin < 4.0f * m_config.hysteresis_bar)
+        {
+            return false; // no pulsation yet
+        }
+        m_threshold = 0.5f * (m_seenMin + m_seenMax);
+    }
+
+    if (!m_armed)
+    {
+        if (bar < m_threshold - m_config.hysteresis_bar)
+        {
+            m_armed = true;
+            m_footBar = FLT_MAX;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (bar <= m_footBar + m_config.footBand_bar)
+    {
+        // Still on the diastolic floor: the foot candidate follows to this
+        // sample, so the old beat would end here and the new one start.
+        // Taking the last sample near the minimum, not the minimum itself,
+        // keeps noise on a flat floor from throwing the boundary anywhere
+        // across it; the foot stays where the upstroke leaves the floor.
+        if (bar < m_footBar)
+        {
+            m_footBar = bar;
+        }
+        m_atFoot = m_beat;
+        m_next.start(bar, t_us);
+        return false;
+    }
+    if (bar < m_threshold)
+    {
+        return false;
+    }
+
+    m_armed = false;
+    if (m_inBeat && (t_us - m_beat.start_us) < m_config.minBeatInterval_us)
+    {
+        return false; // ripple inside the refractory period
+    }
+    return true;
+}
+
+bool BeatMetrics::addSample(float bar, uint32_t t_us)
+{
+    uint32_t dt = t_us - m_prev_us;
+    bool step = m_havePrev && dt > 0U;
+    if (step)
+    {
+        m_beat.add(m_prevBar, bar, dt, t_us);
+    }
+
+    bool done = false;
+    if (m_config.segmentation == Segmentation::Feature)
+    {
+        bool wasArmed = m_armed;
+        bool upstroke = detectUpstroke(bar, t_us);
+        if (wasArmed && step && m_next.start_us != t_us)
+        {
+            m_next.add(m_prevBar, bar, dt, t_us);
+        }
+
+        if (upstroke)
+        {
+            if (m_inBeat)
+            {
+                done = finish(m_atFoot, m_next.start_us);
+            }
+            m_beat = m_next;
+            m_inBeat = true;
+        }
+        else if (m_inBeat && (t_us - m_beat.start_us) > m_config.maxBeatInterval_us)
+        {
+            // Lost the rhythm: drop the beat and re-learn the threshold.
+            // Beat numbers keep counting.
+            m_inBeat = false;
+            m_learning = true;
+            m_seenMin = FLT_MAX;
+            m_seenMax = -FLT_MAX;
+            m_armed = false;
+        }
+    }
+
+    m_havePrev = true;
+    m_prevBar = bar;
+    m_prev_us = t_us;
+    return done;
+}
+
+bool BeatMetrics::markBeatStart(uint32_t t_us)
+{
+    bool done = m_inBeat && finish(m_beat, t_us);
+    m_beat.start(m_havePrev ? m_prevBar : 0.0f, t_us);
+    m_inBeat = true;
+    return done;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file EnsembleAverager.cpp
+ * @brief Beat buffering, phase resampling and Welford updates.
+ */
+
+#include "EnsembleAverager.h"
+
+#include <math.h>
+#include <string.h>
+
+
+EnsembleAverager::EnsembleAverager(float tolerance)
+        : m_tolerance(tolerance),
+          m_seq(0)
+{
+    reset();
+}
+
+void EnsembleAverager::reset()
+{
+    uint32_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_count = 0;
+    m_stride = 1;
+    m_skip = 0;
+    m_haveStart = false;
+    m_start_us = 0;
+    m_beats = 0;
+    m_rejected = 0;
+    m_period_us = 0.0f;
+    memset(m_mean, 0, sizeof(m_mean));
+    memset(m_m2, 0, sizeof(m_m2));
+
+    m_seq.store(seq + 2U, std::memory_order_release);
+}
+
+void EnsembleAverager::addSample(float bar)
+{
+    if (!m_haveStart)
+    {
+        return;
+    }
+    if (m_skip > 0U)
+    {
+        m_skip--;
+        return;
+    }
+    if (m_count == kBeatSamples)
+    {
+        // Beat longer than the buffer: keep every other sample from now on.
+        for (uint32_t i = 0; i < kBeatSamples / 2U; ++i)
+        {
+            m_samples[i] = m_samples[2U * i];
+        }
+        m_count = kBeatSamples / 2U;
+        m_stride *= 2U;
+    }
+    m_samples[m_count++] = bar;
+    m_skip = m_stride - 1U;
+}
+
+bool EnsembleAverager::markBeatStart(uint32_t t_us)
+{
+    bool accepted = false;
+    if (m_haveStart && m_count >= 2U)
+    {
+        float period = (float)(t_us - m_start_us);
+        if (m_period_us == 0.0f)
+        {
+            m_period_us = period; // warm-up: the first beat only sets the period
+        }
+        else if (fabsf(period - m_period_us) <= m_tolerance * m_period_us)
+        {
+            accumulateBeat();
+            m_period_us += 0.125f * (period - m_period_us);
+            accepted = true;
+        }
+        else
+        {
+            m_rejected++;
+            // Follow a real rate change after a few rejected beats in a row.
+            m_period_us += 0.25f * (period - m_period_us);
+        }
+    }
+
+    m_haveStart = true;
+    m_start_us = t_us;
+    m_count = 0;
+    m_stride = 1;
+    m_skip = 0;
+    return accepted;
+}
+
+/**
+ * @brief Resamples the buffered beat onto the phase bins and updates each
+ * bin. Nearest sample rather than interpolation: interpolating averages
+ * neighbours and would make the noise floor read low.
+ */
+void EnsembleAverager::accumulateBeat()
+{
+    uint32_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_beats++;
+    float n = (float)m_beats;
+    float scale = (float)m_count / (float)kBins;
+    for (uint32_t bin = 0; bin < kBins; ++bin)
+    {
+        uint32_t i = (uint32_t)((float)bin * scale + 0.5f);
+        float value = m_samples[(i < m_count) ? i : m_count - 1U];
+
+        float delta = value - m_mean[bin];
+        m_mean[bin] += delta / n;
+        m_m2[bin] += delta * (value - m_mean[bin]);
+    }
+
+    m_seq.store(seq + 2U, std::memory_order_release);
+}
+
+float EnsembleAverager::noiseFloor() const
+{
+    if (m_beats < 2U)
+    {
+        return 0.0f;
+    }
+    float sum = 0.0f;
+    for (uint32_t bin = 0; bin < kBins; ++bin)
+    {
+        sum += m_m2[bin];
+    }
+    return sqrtf(sum / ((float)kBins * (float)(m_beats - 1U)));
+}
+
+size_t EnsembleAverager::encode(uint8_t* buf, size_t len) const
+{
+    size_t needed = sizeof(Header) + kBins * sizeof(Bin);
+    if (buf == nullptr || len < needed)
+    {
+        return 0;
+    }
+
+    for (uint32_t attempt = 0; attempt < kReadAttempts; ++attempt)
+    {
+        uint32_t before = m_seq.load(std::memory_order_acquire);
+        if ((before & 1U) != 0U)
+        {
+            continue;
+        }
+
+        Header header;
+        header.magic = kMagic;
+        header.bins = (uint16_t)kBins;
+        header.warmup = (m_period_us != 0.0f) ? 1U : 0U;
+        header.beats = m_beats;
+        header.rejected = m_rejected;
+        header.meanPeriod_us = (uint32_t)m_period_us;
+        header.noiseFloor_bar = noiseFloor();
+        memcpy(buf, &header, sizeof(header));
+
+        uint8_t* out = buf + sizeof(Header);
+        float divisor = (m_beats > 1U) ? (float)(m_beats - 1U) : 1.0f;
+        for (uint32_t bin = 0; bin < kBins; ++bin)
+        {
+            Bin row;
+            row.mean_bar = m_mean[bin];
+            row.stddev_bar = sqrtf(m_m2[bin] / divisor);
+            memcpy(out + bin * sizeof(Bin), &row, sizeof(row));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_seq.load(std::memory_order_relaxed) == before)
+        {
+            return needed;
+        }
+    }
+    return 0;
+}
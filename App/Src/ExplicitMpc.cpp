@@ -0,0 +1,88 @@
+/**
+ * @file ExplicitMpc.cpp
+ * @brief Tree walk and affine law of the explicit MPC, and the dead-time
+ * compensation around it.
+ */
+
+#include "ExplicitMpc.h"
+
+
+ExplicitMpc::ExplicitMpc(IPressureControl& plant, const Table& table)
+        : m_plant(plant),
+          m_table(table),
+          m_yPrev(0.0f),
+          m_uPrev(0.0f),
+          m_model{},
+          m_modelPrev(0.0f),
+          m_head(0)
+{
+
+}
+
+void ExplicitMpc::reset(float y, float u)
+{
+    // The model's steady state for u: the compensation starts at zero.
+    const Table& t = m_table;
+    float den = 1.0f + t.a[0] + t.a[1];
+    float settled = (den > 0.0f) ? (t.b[0] + t.b[1]) * u / den : 0.0f;
+    for (float& v : m_model)
+    {
+        v = settled;
+    }
+    m_modelPrev = settled;
+    m_yPrev = y;
+    m_uPrev = u;
+}
+
+float ExplicitMpc::compute(float y, float yPrev, float uPrev, float reference_bar) const
+{
+    const float theta[kParams] = {y, yPrev, uPrev, reference_bar};
+    const Table& t = m_table;
+
+    int32_t ref = (t.nodeCount > 0U) ? 0 : -1;
+    for (uint32_t level = 0; level < t.depth && ref >= 0; ++level)
+    {
+        const Node& node = t.nodes[ref];
+        float s = node.a[0] * theta[0] + node.a[1] * theta[1] + node.a[2] * theta[2] + node.a[3] * theta[3];
+        ref = node.child[(s <= node.b) ? 0 : 1];
+    }
+    if (ref >= 0 || (uint32_t)~ref >= t.lawCount)
+    {
+        ref = -1; // malformed table: fall back to the first law
+    }
+
+    const Law& law = t.laws[~ref];
+    float u = law.f[0] * theta[0] + law.f[1] * theta[1] + law.f[2] * theta[2] + law.f[3] * theta[3] + law.g;
+
+    float lo = (uPrev - t.slew > t.u_min) ? uPrev - t.slew : t.u_min;
+    float hi = (uPrev + t.slew < t.u_max) ? uPrev + t.slew : t.u_max;
+    if (u < lo)
+    {
+        u = lo;
+    }
+    if (u > hi)
+    {
+        u = hi;
+    }
+    return u;
+}
+
+float ExplicitMpc::step(float reference_bar)
+{
+    const Table& t = m_table;
+    constexpr uint32_t kRing = kMaxDelay + 1U;
+    uint32_t delay = (t.delay < kMaxDelay) ? t.delay : kMaxDelay;
+
+    float model = m_model[m_head];
+    float y = m_plant.getActualPressure() + model - m_model[(m_head + kRing - delay) % kRing];
+    float u = compute(y, m_yPrev, m_uPrev, reference_bar);
+    m_plant.setPressure(u);
+
+    float next = -t.a[0] * model - t.a[1] * m_modelPrev + t.b[0] * u + t.b[1] * m_uPrev;
+    m_modelPrev = model;
+    m_head = (m_head + 1U) % kRing;
+    m_model[m_head] = next;
+    m_yPrev = y;
+    m_uPrev = u;
+    return u;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file MultiChannelRegulator.cpp
+ * @brief The three passes of the multi-channel loop.
+ */
+
+#include "MultiChannelRegulator.h"
+#include "VppeCalibration.h"
+
+MultiChannelRegulator::MultiChannelRegulator(float tick_s, float maxSetpoint_bar)
+        : m_tick_s(tick_s),
+          m_maxSetpoint_bar(maxSetpoint_bar),
+          m_count(0),
+          m_timeline(tick_s),
+          m_feedback{},
+          m_setpoint{},
+          m_valve{},
+          m_offset{},
+          m_amplitude{},
+          m_kp{},
+          m_ki{},
+          m_valveOpen{},
+          m_valveClose{},
+          m_volts{},
+          m_integral{},
+          m_target{},
+          m_measured{},
+          m_open{},
+          m_valveState{}
+{
+
+}
+
+int32_t MultiChannelRegulator::addChannel(const Channel& channel)
+{
+    if (m_count >= kMaxChannels || channel.feedback == nullptr || channel.setpoint == nullptr)
+    {
+        return -1;
+    }
+    uint32_t i = m_count;
+    m_feedback[i] = channel.feedback;
+    m_setpoint[i] = channel.setpoint;
+    m_valve[i] = channel.valve;
+    m_amplitude[i] = channel.amplitudeScale;
+    m_kp[i] = channel.kp;
+    m_ki[i] = channel.ki;
+    m_valveOpen[i] = channel.valveOpen;
+    m_valveClose[i] = channel.valveClose;
+    m_integral[i] = 0.0f;
+    m_valveState[i] = false;
+    setPhaseOffset(i, channel.phaseOffset);
+    if (m_valve[i] != nullptr)
+    {
+        m_valve[i]->deactivate();
+    }
+    m_count = i + 1U;
+    return (int32_t)i;
+}
+
+void MultiChannelRegulator::play(const WaveformPreset* preset, float rateScale, uint32_t fadeBeats)
+{
+    m_timeline.select({preset, rateScale, 1.0f}, fadeBeats);
+}
+
+void MultiChannelRegulator::setPhaseOffset(uint32_t channel, float phaseOffset)
+{
+    if (channel >= kMaxChannels)
+    {
+        return;
+    }
+    phaseOffset -= (float)(int32_t)phaseOffset;
+    phaseOffset += (phaseOffset < 0.0f) ? 1.0f : 0.0f;
+    m_offset[channel].store(phaseOffset, std::memory_order_relaxed);
+}
+
+void MultiChannelRegulator::tick()
+{
+    const uint32_t n = m_count;
+
+    // 1. acquire
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        m_volts[i] = m_feedback[i]->readVoltage();
+    }
+
+    // 2. control
+    m_timeline.begin();
+    const bool playing = m_timeline.isPlaying();
+    const float beatPhase = m_timeline.phase();
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        float offset = m_offset[i].load(std::memory_order_relaxed);
+        float phase = beatPhase + offset;
+        phase -= (phase >= 1.0f) ? 1.0f : 0.0f;
+
+        float target = m_timeline.value(offset, m_amplitude[i]);
+
+        float measured = VppeCalibration::voltsToBar(m_volts[i]);
+
+        float error = target - measured;
+        float integral = m_integral[i] + m_ki[i] * error * m_tick_s;
+        integral = (integral > kIntegralLimit_bar) ? kIntegralLimit_bar : integral;
+        integral = (integral < -kIntegralLimit_bar) ? -kIntegralLimit_bar : integral;
+        float command = target + m_kp[i] * error + integral;
+        command = (command < 0.0f) ? 0.0f : command;
+        command = (command > m_maxSetpoint_bar) ? m_maxSetpoint_bar : command;
+
+        m_integral[i] = integral;
+        m_target[i] = target;
+        m_measured[i] = measured;
+        m_volts[i] = VppeCalibration::barToVolts(command);
+
+        float open = m_valveOpen[i];
+        float close = m_valveClose[i];
+        m_open[i] = playing
+                    && ((open <= close) ? (phase >= open && phase < close) : (phase >= open || phase < close));
+    }
+
+    // 3. actuate
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        m_setpoint[i]->setVoltage(m_volts[i]);
+    }
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        if (m_valve[i] != nullptr && m_open[i] != m_valveState[i])
+        {
+            m_valveState[i] = m_open[i];
+            if (m_open[i])
+            {
+                m_valve[i]->activate();
+            }
+            else
+            {
+                m_valve[i]->deactivate();
+            }
+        }
+    }
+
+    m_timeline.end();
+}
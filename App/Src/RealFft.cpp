@@ -0,0 +1,128 @@
+/**
+ * @file RealFft.cpp
+ * @brief CMSIS-DSP wrapper and portable fallback.
+ */
+
+#include "RealFft.h"
+
+#include <math.h>
+
+namespace {
+
+constexpr uint32_t kHalf = RealFft::kSize / 2U;
+static_assert((RealFft::kSize & (RealFft::kSize - 1U)) == 0U, "FFT size must be a power of two");
+
+} // namespace
+
+#if defined(REALFFT_USE_CMSIS_DSP)
+
+RealFft::RealFft()
+{
+    arm_rfft_fast_init_f32(&m_instance, kSize);
+}
+
+void RealFft::forward(float* in, float* out)
+{
+    arm_rfft_fast_f32(&m_instance, in, out, 0);
+}
+
+#else
+
+RealFft::RealFft()
+{
+    const float step = 2.0f * 3.14159265358979f / (float)kSize;
+    for (uint32_t k = 0; k < kHalf; ++k)
+    {
+        m_cos[k] = cosf(step * (float)k);
+        m_sin[k] = sinf(step * (float)k);
+    }
+
+    uint32_t bits = 0;
+    while ((1U << bits) < kHalf)
+    {
+        bits++;
+    }
+    for (uint32_t i = 0; i < kHalf; ++i)
+    {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; ++b)
+        {
+            r |= ((i >> b) & 1U) << (bits - 1U - b);
+        }
+        m_reverse[i] = (uint16_t)r;
+    }
+}
+
+void RealFft::forward(float* in, float* out)
+{
+    // Even/odd samples as N/2 complex points, bit-reversed into out.
+    for (uint32_t i = 0; i < kHalf; ++i)
+    {
+        uint32_t r = m_reverse[i];
+        out[2U * r] = in[2U * i];
+        out[2U * r + 1U] = in[2U * i + 1U];
+    }
+
+    // Radix-2 butterflies; twiddle W_{N/2}^m = W_N^{2m}.
+    for (uint32_t len = 2; len <= kHalf; len <<= 1)
+    {
+        uint32_t stride = 2U * (kHalf / len);
+        for (uint32_t start = 0; start < kHalf; start += len)
+        {
+            for (uint32_t m = 0; m < len / 2U; ++m)
+            {
+                float wr = m_cos[m * stride];
+                float wi = -m_sin[m * stride];
+                float* a = &out[2U * (start + m)];
+                float* b = &out[2U * (start + m + len / 2U)];
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+
+    // Split: X[k] = (Z[k] + Z*[M-k]) / 2 - j W^k (Z[k] - Z*[M-k]) / 2
+    float z0r = out[0];
+    float z0i = out[1];
+    for (uint32_t k = 1; k < kHalf / 2U + 1U; ++k)
+    {
+        uint32_t m = kHalf - k;
+        float ar = out[2U * k];
+        float ai = out[2U * k + 1U];
+        float br = out[2U * m];
+        float bi = out[2U * m + 1U];
+
+        float er = 0.5f * (ar + br);
+        float ei = 0.5f * (ai - bi);
+        float orr = 0.5f * (ai + bi);
+        float oi = -0.5f * (ar - br);
+        float wr = m_cos[k];
+        float wi = -m_sin[k];
+        float tr = orr * wr - oi * wi;
+        float ti = orr * wi + oi * wr;
+
+        out[2U * k] = er + tr;
+        out[2U * k + 1U] = ei + ti;
+        if (m != k)
+        {
+            // X[M-k] from the same pair: conjugate symmetry of the halves.
+            float wmr = m_cos[m];
+            float wmi = -m_sin[m];
+            float orm = 0.5f * (bi + ai);
+            float oim = -0.5f * (br - ar);
+            float tmr = orm * wmr - oim * wmi;
+            float tmi = orm * wmi + oim * wmr;
+            out[2U * m] = er + tmr;
+            out[2U * m + 1U] = -ei + tmi;
+        }
+    }
+    out[0] = z0r + z0i; // X[0]
+    out[1] = z0r - z0i; // X[N/2]
+    (void)in;
+}
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file SmithPredictor.cpp
+ * @brief PI law, internal model and delay line of the Smith predictor.
+ */
+
+#include "SmithPredictor.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+constexpr uint32_t kHistory = SmithPredictor::kMaxDelay + 2U;
+
+} // namespace
+
+
+SmithPredictor::SmithPredictor(IPressureControl& plant, float period_s, const Gains& gains)
+        : m_plant(plant),
+          m_period_s(period_s),
+          m_gains(gains),
+          m_mode(Mode::Pi),
+          m_a{0.0f, 0.0f},
+          m_b{0.0f, 0.0f},
+          m_delay(0)
+{
+    reset();
+}
+
+void SmithPredictor::reset()
+{
+    m_integral = 0.0f;
+    memset(m_u, 0, sizeof(m_u));
+    memset(m_ym, 0, sizeof(m_ym));
+    m_ymHead = 0;
+}
+
+bool SmithPredictor::setModel(const float a[2], const float b[2], uint32_t delay)
+{
+    if (delay > kMaxDelay)
+    {
+        return false;
+    }
+    m_a[0] = a[0];
+    m_a[1] = a[1];
+    m_b[0] = b[0];
+    m_b[1] = b[1];
+    m_delay = delay;
+    return true;
+}
+
+bool SmithPredictor::updateModel(const ArxIdentifier& identifier)
+{
+    ArxIdentifier::ArxModel model;
+    if (!identifier.model(model) || !model.valid
+        || fabsf(model.period_s - m_period_s) > 1e-3f * m_period_s)
+    {
+        return false; // a model at another rate would be wrong here
+    }
+    return setModel(model.a, model.b, model.delay);
+}
+
+float SmithPredictor::compute(float reference_bar, float measured_bar)
+{
+    // Advance the delay-free model to ym0[k] with the commands already sent.
+    float ym1 = m_ym[m_ymHead];
+    float ym2 = m_ym[(m_ymHead + kHistory - 1U) % kHistory];
+    float ym = -m_a[0] * ym1 - m_a[1] * ym2 + m_b[0] * m_u[0] + m_b[1] * m_u[1];
+    m_ymHead = (m_ymHead + 1U) % kHistory;
+    m_ym[m_ymHead] = ym;
+
+    float feedback = measured_bar;
+    if (m_mode == Mode::Smith)
+    {
+        float delayed = m_ym[(m_ymHead + kHistory - m_delay) % kHistory];
+        feedback += ym - delayed;
+    }
+
+    float error = reference_bar - feedback;
+    float integral = m_integral + m_gains.ki * error * m_period_s;
+    float out = m_gains.kp * error + integral;
+
+    // Conditional integration: only keep the new integral if it does not
+    // push further into a limit.
+    if (out > m_gains.max_bar)
+    {
+        out = m_gains.max_bar;
+        if (error < 0.0f)
+        {
+            m_integral = integral;
+        }
+    }
+    else if (out < m_gains.min_bar)
+    {
+        out = m_gains.min_bar;
+        if (error > 0.0f)
+        {
+            m_integral = integral;
+        }
+    }
+    else
+    {
+        m_integral = integral;
+    }
+
+    m_u[1] = m_u[0];
+    m_u[0] = out;
+    return out;
+}
+
+float SmithPredictor::step(float reference_bar)
+{
+    float out = compute(reference_bar, m_plant.getActualPressure());
+    m_plant.setPressure(out);
+    return out;
+}
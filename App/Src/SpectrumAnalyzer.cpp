@@ -0,0 +1,281 @@
+/**
+ * @file SpectrumAnalyzer.cpp
+ * @brief Block windowing, power averaging, peaks and harmonics.
+ */
+
+#include "SpectrumAnalyzer.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(USE_HAL_DRIVER)
+#include "StaticThread.h"
+#include "cmsis_os.h"
+#include "main.h"
+#endif
+
+
+SpectrumAnalyzer::SpectrumAnalyzer(float sampleRate_hz)
+        : m_sampleRate_hz(sampleRate_hz),
+          m_block{},
+          m_spectrum{}
+{
+    const float step = 2.0f * 3.14159265358979f / (float)kFftSize;
+    for (uint32_t i = 0; i < kFftSize; ++i)
+    {
+        m_window[i] = 0.5f - 0.5f * cosf(step * (float)i); // Hann
+    }
+    for (Channel& c : m_channels)
+    {
+        memset(c.ring, 0, sizeof(c.ring));
+        c.head.store(0, std::memory_order_relaxed);
+        c.tail = 0;
+        c.blocks = 0;
+        c.overruns = 0;
+        c.fundamental_hz = 0.0f;
+        memset(c.power, 0, sizeof(c.power));
+        memset(c.harmonic, 0, sizeof(c.harmonic));
+        c.thd = 0.0f;
+        c.seq.store(0, std::memory_order_relaxed);
+    }
+}
+
+void SpectrumAnalyzer::setFundamental(uint32_t channel, float hz)
+{
+    m_channels[channel].fundamental_hz = hz;
+}
+
+uint32_t SpectrumAnalyzer::service()
+{
+    uint32_t processed = 0;
+    for (Channel& c : m_channels)
+    {
+        for (;;)
+        {
+            uint32_t head = c.head.load(std::memory_order_acquire);
+            if (head - c.tail > kRingSize - kHop)
+            {
+                // Fell behind: the oldest samples may be overwritten any time.
+                c.overruns++;
+                c.tail = head - kFftSize;
+            }
+            if (head - c.tail < kFftSize)
+            {
+                break;
+            }
+            if (!loadBlock(c))
+            {
+                // Lapped while copying: the block mixes old and new samples.
+                c.overruns++;
+                c.tail = c.head.load(std::memory_order_acquire) - kFftSize;
+                continue;
+            }
+            processBlock(c);
+            c.tail += kHop;
+            processed++;
+        }
+    }
+    return processed;
+}
+
+/**
+ * @brief Copies the block at c.tail into m_block, windowed.
+ * @return false if pushSample() may have overwritten part of it meanwhile:
+ * the write of sample `head` can be in flight before head is published, so
+ * the copy is only intact while head - tail stays below the ring size.
+ */
+bool SpectrumAnalyzer::loadBlock(Channel& c)
+{
+    for (uint32_t i = 0; i < kFftSize; ++i)
+    {
+        m_block[i] = c.ring[(c.tail + i) % kRingSize] * m_window[i];
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t head = c.head.load(std::memory_order_relaxed);
+    return head - c.tail < kRingSize;
+}
+
+void SpectrumAnalyzer::processBlock(Channel& c)
+{
+    m_fft.forward(m_block, m_spectrum);
+
+    // Single-sided amplitude, Hann coherent gain 0.5: A = 4 |X| / N (DC: 2 |X| / N).
+    const float scale = 4.0f / (float)kFftSize;
+    uint32_t n = (c.blocks < kAverages) ? c.blocks + 1U : kAverages;
+    float weight = 1.0f / (float)n;
+
+    uint32_t seq = c.seq.load(std::memory_order_relaxed);
+    c.seq.store(seq + 1U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (uint32_t k = 0; k < kBins; ++k)
+    {
+        float re;
+        float im;
+        if (k == 0U)
+        {
+            re = 0.5f * m_spectrum[0];
+            im = 0.0f;
+        }
+        else if (k == kBins - 1U)
+        {
+            re = 0.5f * m_spectrum[1];
+            im = 0.0f;
+        }
+        else
+        {
+            re = m_spectrum[2U * k];
+            im = m_spectrum[2U * k + 1U];
+        }
+        float power = (re * re + im * im) * scale * scale;
+        c.power[k] += (power - c.power[k]) * weight;
+    }
+    c.blocks++;
+    updateHarmonics(c);
+
+    c.seq.store(seq + 2U, std::memory_order_release);
+}
+
+/**
+ * @brief Amplitude of each harmonic of the fundamental: the largest bin
+ * within one bin of k * f0. A Hann main lobe is 4 bins wide, so this picks
+ * up the peak even between bins.
+ */
+void SpectrumAnalyzer::updateHarmonics(Channel& c)
+{
+    float binWidth = m_sampleRate_hz / (float)kFftSize;
+    float sumSquares = 0.0f;
+    for (uint32_t h = 0; h < kHarmonics; ++h)
+    {
+        float amplitude = 0.0f;
+        float f = c.fundamental_hz * (float)(h + 1U);
+        uint32_t bin = (uint32_t)(f / binWidth + 0.5f);
+        if (c.fundamental_hz > 0.0f && bin >= 1U && bin + 1U < kBins)
+        {
+            float best = c.power[bin - 1U];
+            best = (c.power[bin] > best) ? c.power[bin] : best;
+            best = (c.power[bin + 1U] > best) ? c.power[bin + 1U] : best;
+            amplitude = sqrtf(best);
+        }
+        c.harmonic[h] = amplitude;
+        if (h > 0U)
+        {
+            sumSquares += amplitude * amplitude;
+        }
+    }
+    c.thd = (c.harmonic[0] > 0.0f) ? sqrtf(sumSquares) / c.harmonic[0] : 0.0f;
+}
+
+float SpectrumAnalyzer::amplitude(uint32_t channel, uint32_t bin) const
+{
+    return (bin < kBins) ? sqrtf(m_channels[channel].power[bin]) : 0.0f;
+}
+
+SpectrumAnalyzer::Peak SpectrumAnalyzer::dominantPeak(uint32_t channel, float minHz) const
+{
+    const Channel& c = m_channels[channel];
+    float binWidth = m_sampleRate_hz / (float)kFftSize;
+    uint32_t first = (uint32_t)ceilf(minHz / binWidth);
+    first = (first < 1U) ? 1U : first;
+
+    uint32_t best = first;
+    for (uint32_t k = first; k + 1U < kBins; ++k)
+    {
+        if (c.power[k] > c.power[best])
+        {
+            best = k;
+        }
+    }
+
+    float offset = 0.0f;
+    if (best > 0U && best + 1U < kBins)
+    {
+        float a = sqrtf(c.power[best - 1U]);
+        float b = sqrtf(c.power[best]);
+        float d = sqrtf(c.power[best + 1U]);
+        float denom = a - 2.0f * b + d;
+        offset = (denom != 0.0f) ? 0.5f * (a - d) / denom : 0.0f;
+    }
+
+    Peak peak;
+    peak.frequency_hz = ((float)best + offset) * binWidth;
+    peak.amplitude = sqrtf(c.power[best]);
+    return peak;
+}
+
+size_t SpectrumAnalyzer::encode(uint32_t channel, uint8_t* buf, size_t len) const
+{
+    size_t needed = sizeof(Header) + (kHarmonics + kBins) * sizeof(float);
+    if (buf == nullptr || len < needed || channel >= kChannels)
+    {
+        return 0;
+    }
+
+    const Channel& c = m_channels[channel];
+    for (uint32_t attempt = 0; attempt < kReadAttempts; ++attempt)
+    {
+        uint32_t before = c.seq.load(std::memory_order_acquire);
+        if ((before & 1U) != 0U)
+        {
+            continue;
+        }
+
+        Header header;
+        header.magic = kMagic;
+        header.channel = (uint8_t)channel;
+        header.harmonics = (uint8_t)kHarmonics;
+        header.bins = (uint16_t)kBins;
+        header.binWidth_hz = m_sampleRate_hz / (float)kFftSize;
+        header.blocks = c.blocks;
+        header.overruns = c.overruns;
+        header.fundamental_hz = c.fundamental_hz;
+        header.thd = c.thd;
+        memcpy(buf, &header, sizeof(header));
+
+        uint8_t* out = buf + sizeof(Header);
+        memcpy(out, c.harmonic, sizeof(c.harmonic));
+        out += sizeof(c.harmonic);
+        for (uint32_t k = 0; k < kBins; ++k)
+        {
+            float a = sqrtf(c.power[k]);
+            memcpy(out + k * sizeof(float), &a, sizeof(a));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (c.seq.load(std::memory_order_relaxed) == before)
+        {
+            return needed;
+        }
+    }
+    return 0;
+}
+
+#if defined(USE_HAL_DRIVER)
+
+namespace {
+
+StaticThread<> s_thread;
+
+void spectrumTask(void* argument)
+{
+    SpectrumAnalyzer* analyzer = static_cast<SpectrumAnalyzer*>(argument);
+    for (;;)
+    {
+        if (analyzer->service() == 0U)
+        {
+            osDelay(1); // nothing waiting: sleep a tick instead of spinning
+        }
+    }
+}
+
+} // namespace
+
+void SpectrumAnalyzer::startTask()
+{
+    if (s_thread.start("Spectrum", osPriorityIdle, spectrumTask, this) == nullptr)
+    {
+        Error_Handler();
+    }
+}
+
+#endif
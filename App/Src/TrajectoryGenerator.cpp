@@ -0,0 +1,359 @@
+/**
+ * @file TrajectoryGenerator.cpp
+ * @brief S-curve and spline planning, and the forward-differenced tick.
+ */
+
+#include "TrajectoryGenerator.h"
+
+#include <math.h>
+
+namespace {
+
+constexpr float kAtRest = 1e-6f;
+
+} // namespace
+
+
+TrajectoryGenerator::TrajectoryGenerator(IPressureControl& output, float tick_s, const Limits& limits)
+        : m_output(output),
+          m_tick_s(tick_s),
+          m_limits(limits),
+          m_p(0.0f),
+          m_v(0.0f),
+          m_a(0.0f),
+          m_out(0.0f),
+          m_d1(0.0f),
+          m_d2(0.0f),
+          m_d3(0.0f),
+          m_ticksLeft(0),
+          m_pieces{},
+          m_pieceCount(0),
+          m_pieceIndex(0),
+          m_active{},
+          m_waypoint(0),
+          m_idle(true),
+          m_knots{},
+          m_curvature{},
+          m_pending{},
+          m_pendingReady(false)
+{
+
+}
+
+bool TrajectoryGenerator::load(const Waypoint* points, uint32_t count, Shape shape, bool loop)
+{
+    if (points == nullptr || count == 0U || count > kMaxWaypoints
+        || m_pendingReady.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!(points[i].duration_s >= 0.0f))
+        {
+            return false;
+        }
+        m_pending.points[i] = points[i];
+    }
+    m_pending.count = count;
+    m_pending.shape = shape;
+    m_pending.loop = loop;
+    m_pendingReady.store(true, std::memory_order_release);
+    return true;
+}
+
+float TrajectoryGenerator::tick()
+{
+    if (m_ticksLeft == 0U)
+    {
+        // Bounded: every waypoint plans at least one piece unless it is empty.
+        for (uint32_t guard = 0; guard <= kMaxWaypoints + 1U; ++guard)
+        {
+            if (m_pieceIndex < m_pieceCount)
+            {
+                startPiece();
+                break;
+            }
+            if (!planNext())
+            {
+                break;
+            }
+        }
+    }
+
+    float out = m_out;
+    if (m_ticksLeft > 0U)
+    {
+        m_out += m_d1;
+        m_d1 += m_d2;
+        m_d2 += m_d3;
+        if (--m_ticksLeft == 0U)
+        {
+            finishPiece();
+        }
+    }
+    m_output.setPressure(out);
+    return out;
+}
+
+uint32_t TrajectoryGenerator::toTicks(float seconds) const
+{
+    return (uint32_t)(seconds / m_tick_s + 0.5f);
+}
+
+void TrajectoryGenerator::addPiece(float jerk, uint32_t ticks)
+{
+    if (ticks > 0U && m_pieceCount < kMaxPieces)
+    {
+        m_pieces[m_pieceCount].jerk = jerk;
+        m_pieces[m_pieceCount].ticks = ticks;
+        m_pieceCount++;
+    }
+}
+
+void TrajectoryGenerator::startPiece()
+{
+    const Piece& piece = m_pieces[m_pieceIndex];
+    float h = m_tick_s;
+    float j = piece.jerk;
+    m_out = m_p;
+    m_d1 = m_v * h + m_a * h * h * 0.5f + j * h * h * h * (1.0f / 6.0f);
+    m_d2 = m_a * h * h + j * h * h * h;
+    m_d3 = j * h * h * h;
+    m_ticksLeft = piece.ticks;
+}
+
+/**
+ * @brief Moves the exact state to the end of the piece, so forward
+ * differencing error never carries over.
+ */
+void TrajectoryGenerator::finishPiece()
+{
+    const Piece& piece = m_pieces[m_pieceIndex];
+    float t = (float)piece.ticks * m_tick_s;
+    float j = piece.jerk;
+    m_p += m_v * t + m_a * t * t * 0.5f + j * t * t * t * (1.0f / 6.0f);
+    m_v += m_a * t + j * t * t * 0.5f;
+    m_a += j * t;
+    m_out = m_p;
+    m_pieceIndex++;
+}
+
+void TrajectoryGenerator::startPath()
+{
+    m_idle = false;
+    m_waypoint = 0;
+    if (m_active.shape == Shape::CubicSpline)
+    {
+        solveSpline();
+    }
+}
+
+/**
+ * @brief Plans the pieces for the next waypoint, switching paths at the
+ * end of the current one.
+ * @return false when there is nothing left to do (idle).
+ */
+bool TrajectoryGenerator::planNext()
+{
+    m_pieceCount = 0;
+    m_pieceIndex = 0;
+
+    if (m_idle || m_waypoint >= m_active.count)
+    {
+        if (m_pendingReady.load(std::memory_order_acquire))
+        {
+            m_active = m_pending;
+            m_pendingReady.store(false, std::memory_order_release);
+            startPath();
+        }
+        else if (!m_idle && m_active.loop)
+        {
+            startPath();
+        }
+        else
+        {
+            m_idle = true;
+            m_v = 0.0f;
+            m_a = 0.0f;
+            m_out = m_p;
+            return false;
+        }
+    }
+
+    if (m_active.shape == Shape::JerkLimited)
+    {
+        if (fabsf(m_v) > kAtRest || fabsf(m_a) > kAtRest)
+        {
+            planBrake(); // same waypoint again once stopped
+            return true;
+        }
+        const Waypoint& w = m_active.points[m_waypoint];
+        planMove(w.bar, toTicks(w.duration_s));
+    }
+    else
+    {
+        planSplinePiece(m_waypoint);
+    }
+    m_waypoint++;
+    return true;
+}
+
+void TrajectoryGenerator::planBrake()
+{
+    float sign = (m_v > 0.0f) ? 1.0f : -1.0f;
+    float speed = fabsf(m_v);
+    float jmax = m_limits.jerk;
+    float amax = m_limits.acceleration;
+    m_a = 0.0f;
+
+    float tj;
+    float tc = 0.0f;
+    if (speed * jmax <= amax * amax)
+    {
+        tj = sqrtf(speed / jmax);
+    }
+    else
+    {
+        tj = amax / jmax;
+        tc = speed / amax - tj;
+    }
+    uint32_t nj = (uint32_t)ceilf(tj / m_tick_s);
+    uint32_t nc = (uint32_t)ceilf(tc / m_tick_s - 1e-3f);
+    nj = (nj == 0U) ? 1U : nj;
+    float Tj = (float)nj * m_tick_s;
+    float Tc = (float)nc * m_tick_s;
+    float j = speed / (Tj * (Tj + Tc));
+
+    addPiece(-sign * j, nj);
+    addPiece(0.0f, nc);
+    addPiece(sign * j, nj);
+}
+
+/**
+ * @brief Rest-to-rest S-curve to @p target, then a hold for whatever is
+ * left of @p durationTicks.
+ */
+void TrajectoryGenerator::planMove(float target, uint32_t durationTicks)
+{
+    float distance = target - m_p;
+    float d = fabsf(distance);
+    m_v = 0.0f;
+    m_a = 0.0f;
+    if (d < kAtRest)
+    {
+        addPiece(0.0f, durationTicks);
+        return;
+    }
+
+    float vmax = m_limits.velocity;
+    float amax = m_limits.acceleration;
+    float jmax = m_limits.jerk;
+
+    // Peak velocity, acceleration phase (tj jerk, tc constant) and cruise tv.
+    float v = vmax;
+    float tj;
+    float tc;
+    if (v * jmax <= amax * amax)
+    {
+        tj = sqrtf(v / jmax);
+        tc = 0.0f;
+    }
+    else
+    {
+        tj = amax / jmax;
+        tc = v / amax - tj;
+    }
+    if (v * (2.0f * tj + tc) > d)
+    {
+        // Too short to reach vmax.
+        v = powf(d * sqrtf(jmax) * 0.5f, 2.0f / 3.0f);
+        if (v * jmax <= amax * amax)
+        {
+            tj = sqrtf(v / jmax);
+            tc = 0.0f;
+        }
+        else
+        {
+            tj = amax / jmax;
+            v = 0.5f * amax * (-tj + sqrtf(tj * tj + 4.0f * d / amax));
+            tc = v / amax - tj;
+        }
+    }
+    float tv = (d - v * (2.0f * tj + tc)) / v;
+
+    // Whole ticks, rounded up, then the jerk that lands exactly on target.
+    uint32_t nj = (uint32_t)ceilf(tj / m_tick_s);
+    uint32_t nc = (tc > 0.0f) ? (uint32_t)ceilf(tc / m_tick_s - 1e-3f) : 0U;
+    uint32_t nv = (tv > 0.0f) ? (uint32_t)ceilf(tv / m_tick_s - 1e-3f) : 0U;
+    nj = (nj == 0U) ? 1U : nj;
+    float Tj = (float)nj * m_tick_s;
+    float Tc = (float)nc * m_tick_s;
+    float Tv = (float)nv * m_tick_s;
+    float j = distance / (Tj * (Tj + Tc) * (2.0f * Tj + Tc + Tv));
+
+    addPiece(j, nj);
+    addPiece(0.0f, nc);
+    addPiece(-j, nj);
+    addPiece(0.0f, nv);
+    addPiece(-j, nj);
+    addPiece(0.0f, nc);
+    addPiece(j, nj);
+
+    uint32_t moveTicks = 4U * nj + 2U * nc + nv;
+    addPiece(0.0f, (durationTicks > moveTicks) ? durationTicks - moveTicks : 0U);
+}
+
+/**
+ * @brief Second derivatives of the spline through the current pressure and
+ * the waypoints: clamped to the current slope at the start, natural at the
+ * end. Tridiagonal, solved with the Thomas algorithm.
+ */
+void TrajectoryGenerator::solveSpline()
+{
+    uint32_t n = m_active.count;
+    float h[kMaxWaypoints];
+    float cPrime[kMaxWaypoints + 1];
+    float dPrime[kMaxWaypoints + 1];
+
+    m_knots[0] = m_p;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        uint32_t ticks = toTicks(m_active.points[i].duration_s);
+        h[i] = (float)((ticks == 0U) ? 1U : ticks) * m_tick_s;
+        m_knots[i + 1] = m_active.points[i].bar;
+    }
+
+    // Row 0: 2 h0 M0 + h0 M1 = 6 (s0 - v0)
+    float s0 = (m_knots[1] - m_knots[0]) / h[0];
+    cPrime[0] = 0.5f;
+    dPrime[0] = 3.0f * (s0 - m_v) / h[0];
+    for (uint32_t i = 1; i < n; ++i)
+    {
+        float sPrev = (m_knots[i] - m_knots[i - 1]) / h[i - 1];
+        float s = (m_knots[i + 1] - m_knots[i]) / h[i];
+        float diag = 2.0f * (h[i - 1] + h[i]) - h[i - 1] * cPrime[i - 1];
+        cPrime[i] = h[i] / diag;
+        dPrime[i] = (6.0f * (s - sPrev) - h[i - 1] * dPrime[i - 1]) / diag;
+    }
+
+    m_curvature[n] = 0.0f;
+    for (uint32_t i = n; i-- > 0U;)
+    {
+        m_curvature[i] = dPrime[i] - cPrime[i] * m_curvature[i + 1];
+    }
+}
+
+void TrajectoryGenerator::planSplinePiece(uint32_t index)
+{
+    uint32_t ticks = toTicks(m_active.points[index].duration_s);
+    ticks = (ticks == 0U) ? 1U : ticks;
+    float h = (float)ticks * m_tick_s;
+    float m0 = m_curvature[index];
+    float m1 = m_curvature[index + 1];
+
+    m_p = m_knots[index];
+    m_v = (m_knots[index + 1] - m_knots[index]) / h - h * (2.0f * m0 + m1) * (1.0f / 6.0f);
+    m_a = m0;
+    addPiece((m1 - m0) / h, ticks);
+}
@@ -0,0 +1,149 @@
+/**
+ * @file WaveformPlayer.cpp
+ * @brief Phase accumulator, beat-boundary requests and crossfade.
+ */
+
+#include "WaveformPlayer.h"
+#include "RuntimeStats.h"
+
+namespace {
+
+constexpr WaveformTimeline::Selection kNone = {nullptr, 1.0f, 1.0f};
+
+float rateOf(const WaveformTimeline::Selection& s)
+{
+    return s.preset->rate_bpm * s.rateScale;
+}
+
+} // namespace
+
+
+//               TIMELINE
+
+WaveformTimeline::WaveformTimeline(float tick_s)
+        : m_tick_s(tick_s),
+          m_current(kNone),
+          m_previous(kNone),
+          m_from_bar(0.0f),
+          m_fadeBeats(0),
+          m_fadeBeat(0),
+          m_phase(0.0f),
+          m_request(kNone),
+          m_requestFade(0),
+          m_requestSeq(0),
+          m_takenSeq(0)
+{
+
+}
+
+void WaveformTimeline::select(const Selection& selection, uint32_t fadeBeats)
+{
+    uint32_t seq = m_requestSeq.load(std::memory_order_relaxed);
+    m_requestSeq.store(seq + 1U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_request = selection;
+    m_requestFade = fadeBeats;
+    m_requestSeq.store(seq + 2U, std::memory_order_release);
+}
+
+void WaveformTimeline::onBeatBoundary(float idle_bar)
+{
+    if (m_fadeBeats > 0U && ++m_fadeBeat >= m_fadeBeats)
+    {
+        m_fadeBeats = 0;
+        m_previous = kNone;
+    }
+    if (m_fadeBeats > 0U)
+    {
+        return; // finish this fade before taking another request
+    }
+
+    uint32_t seq = m_requestSeq.load(std::memory_order_acquire);
+    if ((seq & 1U) != 0U || seq == m_takenSeq)
+    {
+        return;
+    }
+    Selection request = m_request;
+    uint32_t fade = m_requestFade;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_requestSeq.load(std::memory_order_relaxed) != seq
+        || (request.preset != nullptr && request.preset->count == 0U))
+    {
+        return; // being rewritten, or unusable: try again next beat
+    }
+    m_takenSeq = seq;
+    if (request.preset == nullptr && m_current.preset == nullptr)
+    {
+        return; // already stopped
+    }
+
+    m_previous = (fade > 0U) ? m_current : kNone;
+    m_from_bar = idle_bar; // only used when nothing was playing
+    m_current = request;
+    m_fadeBeats = fade;
+    m_fadeBeat = 0;
+}
+
+bool WaveformTimeline::begin(float idle_bar)
+{
+    if (m_phase < 1.0f && isPlaying())
+    {
+        return false;
+    }
+    m_phase = (m_phase >= 1.0f) ? m_phase - 1.0f : 0.0f;
+    onBeatBoundary(idle_bar);
+    return isPlaying();
+}
+
+void WaveformTimeline::end()
+{
+    if (!isPlaying())
+    {
+        return;
+    }
+    const Selection& lead = (m_current.preset != nullptr) ? m_current : m_previous;
+    float rate = rateOf(lead);
+    if (m_fadeBeats > 0U && m_current.preset != nullptr && m_previous.preset != nullptr)
+    {
+        float w = ((float)m_fadeBeat + m_phase) / (float)m_fadeBeats;
+        rate = rateOf(m_previous) + (rate - rateOf(m_previous)) * w;
+    }
+    m_phase += rate * (1.0f / 60.0f) * m_tick_s;
+}
+
+
+//               PLAYER
+
+WaveformPlayer::WaveformPlayer(IPressureControl& output, float tick_s)
+        : m_output(output),
+          m_timeline(tick_s),
+          m_beatStarted(false),
+          m_setpoint_bar(0.0f)
+{
+
+}
+
+float WaveformPlayer::tick()
+{
+    m_beatStarted = m_timeline.begin(m_setpoint_bar);
+    if (m_beatStarted)
+    {
+        RuntimeStats::notifyBeat();
+    }
+    if (!m_timeline.isPlaying())
+    {
+        return 0.0f;
+    }
+
+    float out = m_timeline.value();
+    m_timeline.end();
+    m_output.setPressure(out);
+    m_setpoint_bar = out;
+    return out;
+}
+
+void WaveformPlayer::hold(float bar)
+{
+    m_output.setPressure(bar);
+    m_setpoint_bar = bar;
+}
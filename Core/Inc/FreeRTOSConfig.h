@@ -50,6 +50,9 @@
 /* Ensure definitions are only used by the compiler, and not by the assembler. */
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
   #include <stdint.h>
+  #include "stm32g4xx.h"
+  #include "RuntimeStats.h"
+  #include "TraceRecorder.h"
   extern uint32_t SystemCoreClock;
 #endif
 #ifndef CMSIS_device_header
@@ -116,6 +119,7 @@ to exclude the API function. */
 #define INCLUDE_uxTaskGetStackHighWaterMark  1
 #define INCLUDE_xTaskGetCurrentTaskHandle    1
 #define INCLUDE_eTaskGetState                1
+#define INCLUDE_xTaskGetIdleTaskHandle       1
 
 /*
  * The CMSIS-RTOS V2 FreeRTOS wrapper is dependent on the heap implementation used
@@ -165,6 +169,29 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+
+/* Run-time stats counted on the TIM2 1 MHz timebase (Timebase.h, started in main()
+before the kernel). Reading the counter is one load, so no configure step is needed. */
+#define configGENERATE_RUN_TIME_STATS            1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()         (TIM2->CNT)
+#define traceTASK_SWITCHED_IN()                  do { RuntimeStats_TaskSwitchedIn(pxCurrentTCB->uxTCBNumber); \
+                                                      TraceRecorder_Record(TRACE_EVT_TASK_SWITCH, (uint8_t)pxCurrentTCB->uxTCBNumber, 0U); } while (0)
+#define traceTASK_DELETE(pxTaskToDelete)         RuntimeStats_TaskDeleted((pxTaskToDelete)->uxTCBNumber)
+
+/* Kernel trace (TraceRecorder.h). Queues are numbered at creation so events can name them. */
+#define traceTASK_CREATE(pxNewTCB)                 TraceRecorder_TaskCreated((pxNewTCB)->uxTCBNumber, (pxNewTCB)->pcTaskName)
+#define traceQUEUE_CREATE(pxNewQueue)              ((pxNewQueue)->uxQueueNumber = TraceRecorder_NextQueueNumber())
+#define traceQUEUE_SEND(pxQueue)                   TraceRecorder_Record(TRACE_EVT_QUEUE_SEND, (uint8_t)(pxQueue)->uxQueueNumber, (uint16_t)(pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)          TraceRecorder_Record(TRACE_EVT_QUEUE_SEND | TRACE_FROM_ISR, (uint8_t)(pxQueue)->uxQueueNumber, (uint16_t)(pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_RECEIVE(pxQueue)                TraceRecorder_Record(TRACE_EVT_QUEUE_RECEIVE, (uint8_t)(pxQueue)->uxQueueNumber, (uint16_t)(pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)       TraceRecorder_Record(TRACE_EVT_QUEUE_RECEIVE | TRACE_FROM_ISR, (uint8_t)(pxQueue)->uxQueueNumber, (uint16_t)(pxQueue)->uxMessagesWaiting)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)    TraceRecorder_Record(TRACE_EVT_QUEUE_BLOCK, (uint8_t)(pxQueue)->uxQueueNumber, 0U)
+#define traceTASK_NOTIFY()                         TraceRecorder_Record(TRACE_EVT_NOTIFY, (uint8_t)pxTCB->uxTCBNumber, 0U)
+#define traceTASK_NOTIFY_FROM_ISR()                TraceRecorder_Record(TRACE_EVT_NOTIFY | TRACE_FROM_ISR, (uint8_t)pxTCB->uxTCBNumber, 0U)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR()           TraceRecorder_Record(TRACE_EVT_NOTIFY | TRACE_FROM_ISR, (uint8_t)pxTCB->uxTCBNumber, 1U)
+#define traceTASK_NOTIFY_TAKE_BLOCK()              TraceRecorder_Record(TRACE_EVT_NOTIFY_WAIT, (uint8_t)pxCurrentTCB->uxTCBNumber, 0U)
+#define traceTASK_NOTIFY_WAIT_BLOCK()              TraceRecorder_Record(TRACE_EVT_NOTIFY_WAIT, (uint8_t)pxCurrentTCB->uxTCBNumber, 0U)
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -53,6 +53,13 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
+void OverpressureProtection_IRQHandler(void);
+void Timebase_IRQHandler(void);
+void EventScheduler_IRQHandler(void);
+void CyclicExecutive_IRQHandler(uint32_t entryCount);
+void LatencyBench_IRQHandler(uint32_t entryCycles);
+void AnalogWatchdog_IRQHandler(void);
+int FlashPages_NMIHandler(void);
 
 /* USER CODE END EFP */
 
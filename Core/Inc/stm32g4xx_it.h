@@ -56,6 +56,12 @@ void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
 /* USER CODE BEGIN EFP */
+void COMP1_2_3_IRQHandler(void);
+void TIM2_IRQHandler(void);
+void TIM6_DAC_IRQHandler(void);
+void TIM7_DAC_IRQHandler(void);
+void ADC3_IRQHandler(void);
+void ADC4_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -1,5 +1,12 @@
 #include "main.h"
 #include "cmsis_os.h"
+#include "Timebase.h"
+#include "EventScheduler.h"
+#include "RuntimeStats.h"
+#include "TraceRecorder.h"
+#include "DataBus.h"
+#include "MemoryPools.h"
+#include "SystemRoot.h"
 
 // C++ Linkage & System Clock
 #ifdef __cplusplus
@@ -39,7 +46,22 @@ int main(void) {
 
     HAL_Init();
     SystemClock_Config();
+    Timebase::init();
+    EventScheduler::init();
+    RuntimeStats::init();
+#if defined(MEASURE_COSTS)
+    DataBus::measureCosts();
+#endif
+    System::init();
+    TraceRecorder::start();
     osKernelInitialize();
+    System::start();
+    RuntimeStats::start();
+#if defined(MEMORY_POOLS_TRAP)
+    MemoryPools::onSchedulerStart(MemoryPools::Mode::Trap);
+#else
+    MemoryPools::onSchedulerStart(MemoryPools::Mode::Pools);
+#endif
     osKernelStart();
 
 
@@ -22,6 +22,8 @@
 #include "stm32g4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "RuntimeStats.h"
+#include "TraceRecorder.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -70,7 +72,10 @@ extern TIM_HandleTypeDef htim1;
 void NMI_Handler(void)
 {
   /* USER CODE BEGIN NonMaskableInt_IRQn 0 */
-
+  if (FlashPages_NMIHandler() != 0)
+  {
+    return; /* ECC error on a checked black-box read: reported to the reader */
+  }
   /* USER CODE END NonMaskableInt_IRQn 0 */
   /* USER CODE BEGIN NonMaskableInt_IRQn 1 */
    while (1)
@@ -165,14 +170,96 @@ void DebugMon_Handler(void)
 void TIM1_UP_TIM16_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM1_UP_TIM16_IRQn 0 */
-
+  RuntimeStats_IsrEnter();
+  TraceRecorder_IsrEnter(TRACE_ISR_HAL_TICK);
   /* USER CODE END TIM1_UP_TIM16_IRQn 0 */
   HAL_TIM_IRQHandler(&htim1);
   /* USER CODE BEGIN TIM1_UP_TIM16_IRQn 1 */
-
+  TraceRecorder_IsrExit(TRACE_ISR_HAL_TICK);
+  RuntimeStats_IsrExit();
   /* USER CODE END TIM1_UP_TIM16_IRQn 1 */
 }
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles COMP1, COMP2 and COMP3 interrupts through EXTI lines 21, 22 and 29.
+  * Priority 0, above configMAX_SYSCALL_INTERRUPT_PRIORITY: no stats or trace
+  * hooks, nothing between the trip and the handler.
+  */
+void COMP1_2_3_IRQHandler(void)
+{
+  OverpressureProtection_IRQHandler();
+}
+
+/**
+  * @brief This function handles TIM2 global interrupt (microsecond timebase
+  * overflow and event scheduler compare).
+  */
+void TIM2_IRQHandler(void)
+{
+  RuntimeStats_IsrEnter();
+  TraceRecorder_IsrEnter(TRACE_ISR_TIMEBASE);
+  Timebase_IRQHandler();
+  EventScheduler_IRQHandler();
+  TraceRecorder_IsrExit(TRACE_ISR_TIMEBASE);
+  RuntimeStats_IsrExit();
+}
+
+/**
+  * @brief This function handles TIM6 global interrupt (latency benchmark trigger).
+  * The counter is read before the stats and trace hooks so their cost is
+  * not counted as interrupt latency.
+  */
+void TIM6_DAC_IRQHandler(void)
+{
+  uint32_t entry = TIM6->CNT;
+  RuntimeStats_IsrEnter();
+  TraceRecorder_IsrEnter(TRACE_ISR_LATENCY_BENCH);
+  LatencyBench_IRQHandler(entry);
+  TraceRecorder_IsrExit(TRACE_ISR_LATENCY_BENCH);
+  RuntimeStats_IsrExit();
+}
+
+/**
+  * @brief This function handles TIM7 global interrupt (cyclic executive frame).
+  * As for TIM6, the counter is taken ahead of the hooks: it is the frame's
+  * release latency.
+  */
+void TIM7_DAC_IRQHandler(void)
+{
+  uint32_t entry = TIM7->CNT;
+  RuntimeStats_IsrEnter();
+  TraceRecorder_IsrEnter(TRACE_ISR_EXECUTIVE);
+  CyclicExecutive_IRQHandler(entry);
+  TraceRecorder_IsrExit(TRACE_ISR_EXECUTIVE);
+  RuntimeStats_IsrExit();
+}
+
+/**
+  * @brief This function handles ADC3 global interrupt (pressure pair, first
+  * channel analog watchdog).
+  */
+void ADC3_IRQHandler(void)
+{
+  RuntimeStats_IsrEnter();
+  TraceRecorder_IsrEnter(TRACE_ISR_ANALOG_WATCHDOG);
+  AnalogWatchdog_IRQHandler();
+  TraceRecorder_IsrExit(TRACE_ISR_ANALOG_WATCHDOG);
+  RuntimeStats_IsrExit();
+}
+
+/**
+  * @brief This function handles ADC4 global interrupt (pressure pair, second
+  * channel analog watchdog).
+  */
+void ADC4_IRQHandler(void)
+{
+  RuntimeStats_IsrEnter();
+  TraceRecorder_IsrEnter(TRACE_ISR_ANALOG_WATCHDOG);
+  AnalogWatchdog_IRQHandler();
+  TraceRecorder_IsrExit(TRACE_ISR_ANALOG_WATCHDOG);
+  RuntimeStats_IsrExit();
+}
+
 /* USER CODE END 1 */
@@ -0,0 +1,102 @@
+#ifndef FIRMWARE_EVENTSCHEDULER_H
+#define FIRMWARE_EVENTSCHEDULER_H
+
+#pragma once
+
+/**
+ * @file EventScheduler.h
+ * @brief Microsecond event scheduler for valve edges and DAC steps, on
+ * TIM2 compare channel 1.
+ *
+ * FreeRTOS software timers run on the 1 ms tick. Here an event is due at
+ * an absolute Timebase::now_us() time, and TIM2 (the 1 MHz timebase
+ * itself) raises CC1 when the earliest one comes up, so events are on the
+ * same clock as every timestamp in the system.
+ *
+ * Pending events sit in a binary min-heap over a static pool of kMaxEvents
+ * nodes. schedule() and cancel() are O(log n) (9 levels at 256 events),
+ * done with interrupts masked for that long: about a microsecond. Handles
+ * carry a generation, so cancelling an event that already ran (or whose
+ * slot was reused) is a safe no-op.
+ *
+ * Callbacks run in the TIM2 interrupt (NVIC priority 1, above the kernel):
+ * they must be short and must not call FreeRTOS. They may schedule or
+ * cancel events, e.g. the next edge of a valve pattern. At most
+ * kMaxPerIrq events run per interrupt, so a burst cannot hold the CPU; the
+ * rest follow in the next one. An event due in less than kMinLead_us (or
+ * already late) is run by forcing the compare event by software, so none
+ * is missed.
+ *
+ * Timestamps wrap every ~71 minutes; events must be due less than ~35
+ * minutes ahead.
+ */
+
+#include <stdint.h>
+
+namespace EventScheduler {
+
+constexpr uint32_t kMaxEvents = 256;
+constexpr uint32_t kMaxPerIrq = 16;
+constexpr uint32_t kMinLead_us = 2;
+
+/**
+ * @param context as given to schedule().
+ * @param due_us when the event was due (now_us() may be a little later).
+ */
+using Callback = void (*)(void* context, uint32_t due_us);
+
+using Handle = uint32_t;  // 0 = none
+constexpr Handle kNoEvent = 0;
+
+struct Stats {
+    uint32_t dispatched;
+    uint32_t cancelled;
+    uint32_t rejected;       // pool full
+    uint32_t maxLateness_us; // dispatch time - due time
+    uint16_t pending;
+    uint16_t maxPending;
+};
+
+/**
+ * @brief Enables the TIM2 compare interrupt. Call after Timebase::init().
+ */
+void init();
+
+/**
+ * @brief Runs @p callback at @p at_us (Timebase::now_us() time).
+ * Safe from tasks and ISRs, including callbacks.
+ * @return the event's handle, kNoEvent if the pool is full.
+ */
+Handle schedule(uint32_t at_us, Callback callback, void* context);
+
+/**
+ * @brief schedule() at now + @p delay_us.
+ */
+Handle scheduleIn(uint32_t delay_us, Callback callback, void* context);
+
+/**
+ * @brief Removes a pending event.
+ * @return false if it already ran, was cancelled, or @p handle is stale.
+ */
+bool cancel(Handle handle);
+
+/**
+ * @brief Runs every due event (at most kMaxPerIrq) and re-arms the
+ * compare. Called from the TIM2 interrupt; host builds call it directly.
+ */
+void dispatch();
+
+Stats stats();
+
+#if defined(USE_HAL_DRIVER)
+
+/**
+ * @brief Called from TIM2_IRQHandler.
+ */
+void onCompareIrq();
+
+#endif
+
+} // namespace EventScheduler
+
+#endif //FIRMWARE_EVENTSCHEDULER_H
@@ -0,0 +1,503 @@
+#ifndef FIRMWARE_HOSTBOARD_H
+#define FIRMWARE_HOSTBOARD_H
+
+#pragma once
+
+/**
+ * @file HostBoard.h
+ * @brief Stand-in for Stm32Board in host builds, so SystemRoot and the
+ * application code above it build and run on a PC.
+ *
+ * The VPPE is modelled as an ideal follower: the feedback voltage is the
+ * setpoint voltage, unless a test forces it with setVoltage().
+ *
+ * FakeFlashPages keeps its pages in RAM and can cut the power in the middle
+ * of any program or erase, for the black-box recovery tests.
+ *
+ * The pressure pair is fed by the test: setVoltages() then produce() adds
+ * pairs whose two halves are exactly coincident, as the dual ADC gives.
+ * The analog watchdogs are driven the same way: convert() checks one
+ * sample against the window and calls the handler as the ADC interrupt
+ * would.
+ */
+
+#include "Interfaces/IAnalogActuator.h"
+#include "Interfaces/IAnalogSensor.h"
+#include "Interfaces/IAnalogPairSensor.h"
+#include "Interfaces/IAnalogWatchdog.h"
+#include "Interfaces/IFlashPages.h"
+#include "OverpressureThreshold.h"
+#include "Timebase.h"
+
+#include <string.h>
+
+class FakeAnalogOut final : public IAnalogActuator {
+public:
+    bool setVoltage(float voltage) override
+    {
+        m_voltage = voltage;
+        m_blockCount = 0; // cuts a block short
+        m_writes++;
+        return true;
+    }
+
+    /**
+     * @brief Paced on the (virtual) timebase, as the DAC is by its timer:
+     * voltage() steps through the block as time goes by.
+     */
+    size_t writeVoltageBlock(const float* src, size_t count, uint32_t period_us,
+                             SampleStamp* stamp = nullptr) override
+    {
+        if (src == nullptr || count == 0U || count > kMaxBlock || period_us == 0U || isBlockPlaying())
+        {
+            return 0;
+        }
+        m_voltage = voltage();
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_block[i] = src[i];
+        }
+        m_blockCount = count;
+        m_blockPeriod_us = period_us;
+        m_blockStart_us = Timebase::now_us();
+        m_writes += (uint32_t)count;
+        if (stamp != nullptr)
+        {
+            stamp->first_us = m_blockStart_us + period_us;
+            stamp->last_us = m_blockStart_us + (uint32_t)count * period_us;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Codes of a 3.3 V, 12-bit converter, as FakeAnalogIn reads them.
+     */
+    size_t writeRawBlock(const uint16_t* src, size_t count, uint32_t period_us,
+                         SampleStamp* stamp = nullptr) override
+    {
+        if (src == nullptr || count == 0U || count > kMaxBlock)
+        {
+            return 0;
+        }
+        float volts[kMaxBlock];
+        for (size_t i = 0; i < count; ++i)
+        {
+            volts[i] = (float)((src[i] > 4095U) ? 4095U : src[i]) * (3.3f / 4095.0f);
+        }
+        return writeVoltageBlock(volts, count, period_us, stamp);
+    }
+
+    float voltage() const
+    {
+        if (m_blockCount == 0U)
+        {
+            return m_voltage;
+        }
+        uint32_t played = (Timebase::now_us() - m_blockStart_us) / m_blockPeriod_us;
+        if (played == 0U)
+        {
+            return m_voltage;
+        }
+        return m_block[(played < m_blockCount) ? played - 1U : m_blockCount - 1U];
+    }
+
+    bool isBlockPlaying() const
+    {
+        return m_blockCount > 0U && (Timebase::now_us() - m_blockStart_us) < m_blockCount * m_blockPeriod_us;
+    }
+
+    uint32_t writes() const { return m_writes; }
+
+private:
+    float m_voltage = 0.0f;
+    uint32_t m_writes = 0;
+    float m_block[kMaxBlock] = {};
+    uint32_t m_blockCount = 0;
+    uint32_t m_blockPeriod_us = 1;
+    uint32_t m_blockStart_us = 0;
+};
+
+class FakeAnalogIn final : public IAnalogSensor {
+public:
+    explicit FakeAnalogIn(const FakeAnalogOut* loopback) : m_loopback(loopback) {}
+
+    float readVoltage() override
+    {
+        return m_forced ? m_voltage : (m_loopback != nullptr ? m_loopback->voltage() : 0.0f);
+    }
+
+    /**
+     * @brief The fake holds one level, so a block is that level repeated,
+     * stamped with the current (virtual) time.
+     */
+    size_t readVoltageBlock(float* dst, size_t count, SampleStamp* stamp = nullptr) override
+    {
+        float v = readVoltage();
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[i] = v;
+        }
+        stampNow(stamp);
+        return count;
+    }
+
+    /**
+     * @brief Same level in 12-bit counts of a 3.3 V reference.
+     */
+    size_t readRawBlock(uint16_t* dst, size_t count, SampleStamp* stamp = nullptr) override
+    {
+        float counts = readVoltage() * (4095.0f / 3.3f) + 0.5f;
+        uint16_t raw = (counts <= 0.0f) ? 0U : (counts >= 4095.0f) ? 4095U : (uint16_t)counts;
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[i] = raw;
+        }
+        stampNow(stamp);
+        return count;
+    }
+
+    /**
+     * @brief Forces the reading (e.g. a fault), until release().
+     */
+    void setVoltage(float voltage)
+    {
+        m_voltage = voltage;
+        m_forced = true;
+    }
+
+    void release() { m_forced = false; }
+
+private:
+    static void stampNow(SampleStamp* stamp)
+    {
+        if (stamp != nullptr)
+        {
+            stamp->first_us = Timebase::now_us();
+            stamp->last_us = stamp->first_us;
+        }
+    }
+
+    const FakeAnalogOut* m_loopback;
+    float m_voltage = 0.0f;
+    bool m_forced = false;
+};
+
+class FakeAnalogPairIn final : public IAnalogPairSensor {
+public:
+    static constexpr uint32_t kDepth = 256;
+
+    FakeAnalogPairIn() = default;
+
+    FakeAnalogPairIn(uint32_t samplePeriod_us, float voltsPerCount)
+            : m_samplePeriod_us(samplePeriod_us),
+              m_voltsPerCount(voltsPerCount)
+    {
+    }
+
+    /**
+     * @brief Voltages of the pairs produced from now on.
+     */
+    void setVoltages(float first, float second)
+    {
+        m_next = PackedPair::make(toCounts(first), toCounts(second));
+    }
+
+    /**
+     * @brief Adds @p count pairs, one sample period apart. Beyond kDepth
+     * unread pairs the oldest are dropped, as the DMA would overwrite them.
+     */
+    void produce(uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (m_count == kDepth)
+            {
+                m_tail = (m_tail + 1U) % kDepth;
+                m_count--;
+                m_dropped++;
+            }
+            m_ring[(m_tail + m_count) % kDepth] = m_next;
+            m_count++;
+            m_produced++;
+        }
+    }
+
+    size_t readPairs(uint32_t* dst, size_t count, SampleStamp* stamp = nullptr) override
+    {
+        size_t n = (m_count < count) ? m_count : count;
+        uint32_t firstIndex = m_produced - m_count;
+        for (size_t i = 0; i < n; ++i)
+        {
+            dst[i] = m_ring[m_tail];
+            m_tail = (m_tail + 1U) % kDepth;
+        }
+        m_count -= (uint32_t)n;
+        if (stamp != nullptr)
+        {
+            stamp->first_us = firstIndex * m_samplePeriod_us;
+            stamp->last_us = (firstIndex + (uint32_t)((n > 0U) ? n - 1U : 0U)) * m_samplePeriod_us;
+        }
+        return n;
+    }
+
+    float voltsPerCount() const override { return m_voltsPerCount; }
+    uint32_t dropped() const override { return m_dropped; }
+
+private:
+    uint16_t toCounts(float volts) const
+    {
+        float counts = volts / m_voltsPerCount + 0.5f;
+        return (counts <= 0.0f) ? 0U : (counts >= 4095.0f) ? 4095U : (uint16_t)counts;
+    }
+
+    uint32_t m_samplePeriod_us = 100;
+    float m_voltsPerCount = 3.3f / 4095.0f;
+    uint32_t m_next = 0;
+    uint32_t m_ring[kDepth] = {};
+    uint32_t m_tail = 0;
+    uint32_t m_count = 0;
+    uint32_t m_produced = 0;
+    uint32_t m_dropped = 0;
+};
+
+class FakeAnalogWatchdog final : public IAnalogWatchdog {
+public:
+    void setWindow(uint16_t low, uint16_t high) override
+    {
+        m_low = low;
+        m_high = high;
+    }
+
+    void attach(Handler handler, void* context) override
+    {
+        m_handler = handler;
+        m_context = context;
+    }
+
+    float voltsPerCount() const override { return 3.3f / 4095.0f; }
+
+    /**
+     * @brief One conversion of @p counts at @p time_us.
+     */
+    void convert(uint16_t counts, uint32_t time_us)
+    {
+        if ((counts < m_low || counts > m_high) && m_handler != nullptr)
+        {
+            m_interrupts++;
+            m_handler(m_context, counts, time_us);
+        }
+    }
+
+    void convertVolts(float volts, uint32_t time_us)
+    {
+        float counts = volts / voltsPerCount() + 0.5f;
+        convert((counts <= 0.0f) ? 0U : (counts >= 4095.0f) ? 4095U : (uint16_t)counts, time_us);
+    }
+
+    uint16_t low() const { return m_low; }
+    uint16_t high() const { return m_high; }
+    uint32_t interrupts() const { return m_interrupts; }
+
+private:
+    uint16_t m_low = 0;
+    uint16_t m_high = 4095;
+    Handler m_handler = nullptr;
+    void* m_context = nullptr;
+    uint32_t m_interrupts = 0;
+};
+
+/**
+ * @brief Flash pages in RAM, with the G4 rules: an erase sets 0xFF, a
+ * double-word is programmed once per erase (a second program fails and is
+ * counted in reprograms()).
+ *
+ * cutPowerAfter(n) lets n more program/erase operations complete and tears
+ * the next one. A torn program leaves its word failing the ECC check; a torn
+ * erase leaves the page erased up to some word, that word torn and the rest
+ * as it was. Every operation fails from the cut until powerOn().
+ */
+template <uint32_t PageCount, uint32_t PageSize = 2048>
+class FakeFlashPages final : public IFlashPages {
+public:
+    static constexpr uint32_t kWords = PageSize / 8U;
+    static constexpr uint32_t kNever = 0xFFFFFFFFU;
+
+    FakeFlashPages()
+    {
+        for (uint32_t page = 0; page < PageCount; ++page)
+        {
+            eraseWords(page, kWords);
+        }
+    }
+
+    uint32_t pageCount() const override { return PageCount; }
+    uint32_t pageSize() const override { return PageSize; }
+
+    const uint8_t* pageData(uint32_t page) const override
+    {
+        return (page < PageCount) ? m_data[page] : nullptr;
+    }
+
+    bool readDoubleWord(uint32_t page, uint32_t offset, uint64_t& value) const override
+    {
+        if (page >= PageCount || offset > PageSize - 8U || (offset & 7U) != 0U)
+        {
+            return false;
+        }
+        if (m_torn[page][offset / 8U])
+        {
+            m_eccErrors++;
+            return false;
+        }
+        memcpy(&value, &m_data[page][offset], sizeof(value));
+        return true;
+    }
+
+    bool erasePage(uint32_t page) override
+    {
+        if (page >= PageCount)
+        {
+            return false;
+        }
+        switch (nextOperation())
+        {
+            case Power::On:
+                eraseWords(page, kWords);
+                return true;
+            case Power::Tear:
+            {
+                uint32_t word = noise() % kWords;
+                eraseWords(page, word);
+                tear(page, word);
+                return false;
+            }
+            default:
+                return false;
+        }
+    }
+
+    bool programDoubleWord(uint32_t page, uint32_t offset, uint64_t value) override
+    {
+        if (page >= PageCount || offset > PageSize - 8U || (offset & 7U) != 0U)
+        {
+            return false;
+        }
+        uint32_t word = offset / 8U;
+        uint64_t current;
+        memcpy(&current, &m_data[page][offset], sizeof(current));
+        if (m_torn[page][word] || current != 0xFFFFFFFFFFFFFFFFULL)
+        {
+            m_reprograms++;
+            return false;
+        }
+        switch (nextOperation())
+        {
+            case Power::On:
+                memcpy(&m_data[page][offset], &value, sizeof(value));
+                return true;
+            case Power::Tear:
+                tear(page, word);
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @brief Lets @p operations more program/erase calls through, then tears
+     * the next one and stays off. kNever disarms.
+     */
+    void cutPowerAfter(uint32_t operations) { m_cutAfter = operations; }
+
+    void powerOn()
+    {
+        m_off = false;
+        m_cutAfter = kNever;
+    }
+
+    bool isOff() const { return m_off; }
+    uint32_t operations() const { return m_operations; }
+    uint32_t reprograms() const { return m_reprograms; }
+    uint32_t eccErrors() const { return m_eccErrors; }
+
+private:
+    enum class Power { On, Tear, Off };
+
+    Power nextOperation()
+    {
+        if (m_off)
+        {
+            return Power::Off;
+        }
+        if (m_cutAfter == 0U)
+        {
+            m_off = true;
+            return Power::Tear;
+        }
+        if (m_cutAfter != kNever)
+        {
+            m_cutAfter--;
+        }
+        m_operations++;
+        return Power::On;
+    }
+
+    void eraseWords(uint32_t page, uint32_t words)
+    {
+        memset(m_data[page], 0xFF, words * 8U);
+        memset(m_torn[page], 0, words);
+    }
+
+    void tear(uint32_t page, uint32_t word)
+    {
+        uint64_t garbage = ((uint64_t)noise() << 32) | noise();
+        memcpy(&m_data[page][word * 8U], &garbage, sizeof(garbage));
+        m_torn[page][word] = true;
+    }
+
+    uint32_t noise()
+    {
+        m_noise = m_noise * 1664525U + 1013904223U;
+        return m_noise;
+    }
+
+    uint8_t m_data[PageCount][PageSize];
+    bool m_torn[PageCount][kWords];
+    uint32_t m_cutAfter = kNever;
+    bool m_off = false;
+    uint32_t m_operations = 0;
+    uint32_t m_reprograms = 0;
+    mutable uint32_t m_eccErrors = 0;
+    uint32_t m_noise = 12345U;
+};
+
+struct HostBoard {
+    using Feedback = FakeAnalogIn;
+    using Output = FakeAnalogOut;
+    using PressurePair = FakeAnalogPairIn;
+    using Watchdog = FakeAnalogWatchdog;
+
+    static constexpr OverpressureConfig kOverpressure = OverpressureThreshold::kDefaultConfig;
+    static constexpr uint32_t kPairPeriod_us = 100; // FakeAnalogPairIn's default
+
+    static void init()
+    {
+        s_output = FakeAnalogOut();
+        s_feedback = FakeAnalogIn(&s_output);
+        s_pressurePair = FakeAnalogPairIn();
+        s_pairWatchdogs[0] = FakeAnalogWatchdog();
+        s_pairWatchdogs[1] = FakeAnalogWatchdog();
+    }
+
+    static Feedback& feedback() { return s_feedback; }
+    static Output& output() { return s_output; }
+    static PressurePair& pressurePair() { return s_pressurePair; }
+    static Watchdog& pairWatchdog(uint32_t index) { return s_pairWatchdogs[(index != 0U) ? 1 : 0]; }
+
+    static inline FakeAnalogOut s_output;
+    static inline FakeAnalogIn s_feedback{&s_output};
+    static inline FakeAnalogPairIn s_pressurePair;
+    static inline FakeAnalogWatchdog s_pairWatchdogs[2];
+};
+
+#endif //FIRMWARE_HOSTBOARD_H
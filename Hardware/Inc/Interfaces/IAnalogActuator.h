@@ -17,8 +17,18 @@
 
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SampleBlock.h"
+
 class IAnalogActuator {
 public:
+    /**
+     * @brief Most samples one block write takes.
+     */
+    static constexpr size_t kMaxBlock = 256;
+
     /**
      * @brief Virtual destructor.
      */
@@ -29,6 +39,43 @@ public:
      * @param voltage The desired voltage.
      */
     virtual bool setVoltage(float voltage) = 0;
+
+    /**
+     * @brief Plays a block of voltages on the output, one every @p period_us.
+     *
+     * Returns at once: the block is copied and paced out by the hardware.
+     * Sample [0] appears one period after the call, the last one stays on
+     * the output. A block still playing refuses the next one (returns 0);
+     * setVoltage() cuts it short.
+     *
+     * The default has no sample clock and writes nothing: back-to-back
+     * setVoltage() calls would only leave the last value on the output.
+     *
+     * @param src Voltages to output, at least @p count entries.
+     * @param count Number of samples, up to kMaxBlock.
+     * @param period_us Time between samples.
+     * @param stamp Optional, filled with the planned first/last sample time.
+     * @return Number of samples queued (0 if refused).
+     */
+    virtual size_t writeVoltageBlock(const float* src, size_t count, uint32_t period_us,
+                                     SampleStamp* stamp = nullptr)
+    {
+        (void)src; (void)count; (void)period_us; (void)stamp;
+        return 0;
+    }
+
+    /**
+     * @brief Same as writeVoltageBlock(), in raw converter codes.
+     *
+     * Actuators without a raw representation return 0.
+     * @return Number of samples queued.
+     */
+    virtual size_t writeRawBlock(const uint16_t* src, size_t count, uint32_t period_us,
+                                 SampleStamp* stamp = nullptr)
+    {
+        (void)src; (void)count; (void)period_us; (void)stamp;
+        return 0;
+    }
 };
 
 
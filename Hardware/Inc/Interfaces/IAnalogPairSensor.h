@@ -0,0 +1,81 @@
+#ifndef FIRMWARE_IANALOGPAIRSENSOR_H
+#define FIRMWARE_IANALOGPAIRSENSOR_H
+
+#pragma once
+
+/**
+ * @file IAnalogPairSensor.h
+ * @brief Two analog channels converted at the same instant, e.g. ventricle
+ * and aorta for the transvalvular gradient.
+ *
+ * A pair is one uint32_t: first channel in bits 0..15, second in 16..31.
+ * That is the layout of the G4 dual-ADC common data register, so the DMA
+ * words are used as they are, and differences are taken on the packed
+ * words without splitting them into two arrays first.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SampleBlock.h"
+
+namespace PackedPair {
+
+inline uint32_t make(uint16_t first, uint16_t second)
+{
+    return (uint32_t)first | ((uint32_t)second << 16);
+}
+
+inline uint16_t first(uint32_t pair) { return (uint16_t)pair; }
+inline uint16_t second(uint32_t pair) { return (uint16_t)(pair >> 16); }
+
+/**
+ * @brief first - second, in counts.
+ */
+inline int32_t difference(uint32_t pair)
+{
+    return (int32_t)(pair & 0xFFFFU) - (int32_t)(pair >> 16);
+}
+
+/**
+ * @brief first - second for a block of pairs, in volts. With the same
+ * linear calibration on both sensors the offsets cancel, so a pressure
+ * gradient is this times the bar-per-volt slope.
+ */
+inline void differenceVolts(const uint32_t* pairs, size_t count, float voltsPerCount, float* dst)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        dst[i] = (float)difference(pairs[i]) * voltsPerCount;
+    }
+}
+
+} // namespace PackedPair
+
+class IAnalogPairSensor {
+public:
+    /**
+     * @brief Virtual destructor.
+     */
+    virtual ~IAnalogPairSensor() = default;
+
+    /**
+     * @brief Copies the pairs converted since the last call, oldest first.
+     * Pairs beyond @p count stay for the next call.
+     * @param stamp Optional, filled with the first/last pair time.
+     * @return Number of pairs written to @p dst.
+     */
+    virtual size_t readPairs(uint32_t* dst, size_t count, SampleStamp* stamp = nullptr) = 0;
+
+    /**
+     * @brief Scale from counts to volts, the same for both channels.
+     */
+    virtual float voltsPerCount() const = 0;
+
+    /**
+     * @brief Pairs lost because the reader fell more than a buffer behind.
+     */
+    virtual uint32_t dropped() const { return 0; }
+};
+
+#endif //FIRMWARE_IANALOGPAIRSENSOR_H
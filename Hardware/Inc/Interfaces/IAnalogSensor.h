@@ -11,6 +11,11 @@
  * @brief An abstract interface for any generic analog sensor.
  */
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SampleBlock.h"
+
 class IAnalogSensor {
 public:
     /**
@@ -22,6 +27,33 @@ public:
      * @return The measured voltage
      */
     virtual float readVoltage() = 0;
+
+    /**
+     * @brief Reads a block of samples in volts into a caller buffer.
+     *
+     * The default just calls readVoltage() per sample, so every sensor
+     * supports it. Concrete sensors override it to pay the dispatch and the
+     * scaling once per block. Defined in AnalogSensor.cpp, so this header
+     * stays free of the timebase.
+     *
+     * @param dst Output buffer, at least @p count entries.
+     * @param count Number of samples to read.
+     * @param stamp Optional, filled with the first/last sample time.
+     * @return Number of samples written to @p dst (< count on error).
+     */
+    virtual size_t readVoltageBlock(float* dst, size_t count, SampleStamp* stamp = nullptr);
+
+    /**
+     * @brief Reads a block of raw converter counts into a caller buffer.
+     *
+     * Sensors without a raw representation return 0.
+     * @return Number of samples written to @p dst.
+     */
+    virtual size_t readRawBlock(uint16_t* dst, size_t count, SampleStamp* stamp = nullptr)
+    {
+        (void)dst; (void)count; (void)stamp;
+        return 0;
+    }
 };
 
 
@@ -0,0 +1,47 @@
+#ifndef FIRMWARE_IANALOGWATCHDOG_H
+#define FIRMWARE_IANALOGWATCHDOG_H
+
+#pragma once
+
+/**
+ * @file IAnalogWatchdog.h
+ * @brief A converter channel compared against a window in hardware.
+ *
+ * Every conversion is checked without the CPU; the handler runs (in an
+ * interrupt on the target) only when a result is outside [low, high].
+ * The window can be moved at any time, also from the handler.
+ */
+
+#include <stdint.h>
+
+class IAnalogWatchdog {
+public:
+    /**
+     * @param context as given to attach().
+     * @param counts the conversion that left the window.
+     * @param time_us Timebase time of the event.
+     */
+    using Handler = void (*)(void* context, uint16_t counts, uint32_t time_us);
+
+    /**
+     * @brief Virtual destructor.
+     */
+    virtual ~IAnalogWatchdog() = default;
+
+    /**
+     * @brief Sets the window, in counts. [0, 4095] never triggers.
+     */
+    virtual void setWindow(uint16_t low, uint16_t high) = 0;
+
+    /**
+     * @brief Sets who is called when a conversion leaves the window.
+     */
+    virtual void attach(Handler handler, void* context) = 0;
+
+    /**
+     * @brief Scale from counts to volts.
+     */
+    virtual float voltsPerCount() const = 0;
+};
+
+#endif //FIRMWARE_IANALOGWATCHDOG_H
@@ -0,0 +1,59 @@
+#ifndef FIRMWARE_IFLASHPAGES_H
+#define FIRMWARE_IFLASHPAGES_H
+
+/**
+ * @file IFlashPages.h
+ * @brief Abstract interface for a block of erasable flash pages.
+ *
+ * Pages are read through memory (flash is memory-mapped), erased whole and
+ * programmed one 64-bit double-word at a time, which is how the STM32G4
+ * flash works. A double-word can only be programmed once after an erase.
+ *
+ * A program or erase cut by a reset can leave a double-word whose ECC does
+ * not match. Reading it through pageData() raises an NMI on the G4, so
+ * content that may be torn is read with readDoubleWord(), which reports
+ * such a word instead of faulting.
+ *
+ * implemented in "Peripherals.cpp" (wrapping HAL_FLASH) and used by the
+ * BlackBox recorder.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class IFlashPages {
+public:
+    /**
+     * @brief Virtual destructor.
+     */
+    virtual ~IFlashPages() = default;
+
+    virtual uint32_t pageCount() const = 0;
+    virtual uint32_t pageSize() const = 0;
+
+    /**
+     * @brief Read-only view of a page.
+     */
+    virtual const uint8_t* pageData(uint32_t page) const = 0;
+
+    /**
+     * @brief Reads one double-word, checking its ECC.
+     * @param offset Byte offset inside the page, multiple of 8.
+     * @return false if the word is unreadable (double ECC error) or out of range.
+     */
+    virtual bool readDoubleWord(uint32_t page, uint32_t offset, uint64_t& value) const = 0;
+
+    /**
+     * @brief Erases one page (all bytes become 0xFF).
+     */
+    virtual bool erasePage(uint32_t page) = 0;
+
+    /**
+     * @brief Programs one double-word.
+     * @param offset Byte offset inside the page, multiple of 8.
+     */
+    virtual bool programDoubleWord(uint32_t page, uint32_t offset, uint64_t value) = 0;
+};
+
+#endif //FIRMWARE_IFLASHPAGES_H
@@ -0,0 +1,22 @@
+#ifndef FIRMWARE_SAMPLEBLOCK_H
+#define FIRMWARE_SAMPLEBLOCK_H
+
+/**
+ * @file SampleBlock.h
+ * @brief Timestamp record shared by the block read/write APIs.
+ *
+ * A block of N samples carries the time of its first and its last sample.
+ * Samples in between are evenly spaced, so a consumer can interpolate the
+ * time of sample i instead of storing one timestamp per sample.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct SampleStamp {
+    uint32_t first_us; // time of sample [0]
+    uint32_t last_us;  // time of sample [count - 1]
+};
+
+#endif //FIRMWARE_SAMPLEBLOCK_H
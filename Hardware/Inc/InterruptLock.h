@@ -0,0 +1,73 @@
+#ifndef FIRMWARE_INTERRUPTLOCK_H
+#define FIRMWARE_INTERRUPTLOCK_H
+
+#pragma once
+
+/**
+ * @file InterruptLock.h
+ * @brief Scoped interrupts-off section for state shared with ISRs.
+ *
+ * On the target it saves PRIMASK, disables interrupts and restores PRIMASK
+ * on exit. So it nests, works from ISRs and before the scheduler, and also
+ * holds off interrupts above configMAX_SYSCALL_INTERRUPT_PRIORITY, which
+ * taskENTER_CRITICAL would not.
+ *
+ * On the host, "interrupts" are other threads or fakes that call the
+ * handler synchronously. The lock is a spinlock shared by every user, as
+ * PRIMASK is. It counts its nesting per thread, so a handler called from
+ * inside a locked section on the same thread takes it again.
+ */
+
+#include <stdint.h>
+
+#if defined(USE_HAL_DRIVER)
+
+#include "main.h"
+
+class InterruptLock {
+public:
+    InterruptLock() : m_primask(__get_PRIMASK()) { __disable_irq(); }
+    ~InterruptLock() { __set_PRIMASK(m_primask); }
+
+    InterruptLock(const InterruptLock&) = delete;
+    InterruptLock& operator=(const InterruptLock&) = delete;
+
+private:
+    uint32_t m_primask;
+};
+
+#else
+
+#include <atomic>
+
+class InterruptLock {
+public:
+    InterruptLock()
+    {
+        if (s_depth++ == 0U)
+        {
+            while (s_flag.test_and_set(std::memory_order_acquire))
+            {
+            }
+        }
+    }
+
+    ~InterruptLock()
+    {
+        if (--s_depth == 0U)
+        {
+            s_flag.clear(std::memory_order_release);
+        }
+    }
+
+    InterruptLock(const InterruptLock&) = delete;
+    InterruptLock& operator=(const InterruptLock&) = delete;
+
+private:
+    static inline std::atomic_flag s_flag = ATOMIC_FLAG_INIT;
+    static inline thread_local uint32_t s_depth = 0;
+};
+
+#endif
+
+#endif //FIRMWARE_INTERRUPTLOCK_H
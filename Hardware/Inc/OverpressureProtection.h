@@ -0,0 +1,172 @@
+#ifndef FIRMWARE_OVERPRESSUREPROTECTION_H
+#define FIRMWARE_OVERPRESSUREPROTECTION_H
+
+#pragma once
+
+#include "Interfaces/IAnalogActuator.h"
+#include "Interfaces/ISolenoidValve.h"
+#include "OverpressureThreshold.h"
+
+#include "main.h"
+#include <stdint.h>
+
+/**
+ * @file OverpressureProtection.h
+ * @brief Hardware overpressure trip, independent of any RTOS task.
+ *
+ * Routing (fixed by the board):
+ *   PA1 (chamber pressure, divided) -> COMP1 INP
+ *   DAC3 CH1 (internal, threshold)  -> COMP1 INM
+ *   COMP1 out -> TIM8 BRK  : MOE drops, vent valve pin (PC6, TIM8_CH1)
+ *                            goes to its idle level = valve open. ~ns, no CPU.
+ *   COMP1 out -> EXTI 21   : COMP1_2_3 IRQ at priority 0 writes 0 to the VPPE
+ *                            setpoint DAC and logs the trip. ~us.
+ *
+ * Once tripped the break stays latched (AOE = 0) until rearm() is called
+ * with the pressure back under the threshold.
+ */
+
+/**
+ * @brief One entry of the trip log.
+ */
+struct TripEvent {
+    uint32_t time_us;        // when the IRQ ran
+    uint16_t threshold_code; // DAC3 code that was active
+    uint16_t sequence;       // running trip number
+};
+
+class OverpressureProtection {
+public:
+    static constexpr uint32_t kLogSize = 8;
+
+    explicit OverpressureProtection(const OverpressureConfig& config);
+
+    /**
+     * @brief Configures DAC3, COMP1, TIM8 break and EXTI, then arms the trip.
+     * @param setpointDac The DAC driving the VPPE setpoint (zeroed on trip).
+     * @param setpointChannel DAC_CHANNEL_1 or DAC_CHANNEL_2.
+     * @return false if the configuration is invalid.
+     */
+    bool init(DAC_TypeDef* setpointDac, uint32_t setpointChannel);
+
+    /**
+     * @brief Moves the threshold at runtime. Rejected if it would make the
+     * configuration invalid.
+     */
+    bool setTripPressure(float bar);
+
+    /**
+     * @brief True while the break is latched.
+     */
+    bool isTripped() const
+    {
+        return m_tripped || ((TIM8->BDTR & TIM_BDTR_MOE) == 0U);
+    }
+
+    /**
+     * @brief Clears the latch if the pressure is back under the threshold.
+     * @return false if the comparator is still high.
+     */
+    bool rearm();
+
+    uint32_t tripCount() const { return m_tripCount; }
+
+    /**
+     * @brief Reads the trip log.
+     * @param index 0 = most recent.
+     */
+    bool getTrip(uint32_t index, TripEvent& out) const;
+
+    /**
+     * @brief Called from COMP1_2_3_IRQHandler.
+     */
+    void onComparatorIrq();
+
+    static OverpressureProtection* instance() { return s_instance; }
+
+private:
+    OverpressureConfig m_config;
+    DAC_TypeDef* m_setpointDac;
+    uint32_t m_setpointChannel;
+    uint32_t m_thresholdCode;
+
+    volatile bool m_tripped;
+    volatile uint32_t m_tripCount;
+    TripEvent m_log[kLogSize];
+
+    static OverpressureProtection* s_instance;
+};
+
+
+/**
+ * @class TripGuardedActuator
+ * @brief Wraps the VPPE setpoint output so software cannot drive it again
+ * while the trip is latched.
+ *
+ * Inject this into PressureRegulatorDriver instead of the raw STM32_AnalogOut.
+ * Templated on the wrapped output and defined here so the regulator's
+ * setVoltage() reaches the DAC through a direct call instead of a second
+ * vtable hop (Output is expected to be final).
+ */
+template <typename Output>
+class TripGuardedActuator final : public IAnalogActuator {
+public:
+    TripGuardedActuator(Output& output, const OverpressureProtection& protection)
+            : m_output(output),
+              m_protection(protection)
+    {
+
+    }
+
+    bool setVoltage(float voltage) override
+    {
+        if (m_protection.isTripped())
+        {
+            return false; // setpoint stays at 0 until rearm()
+        }
+        return m_output.setVoltage(voltage);
+    }
+
+    size_t writeVoltageBlock(const float* src, size_t count, uint32_t period_us,
+                             SampleStamp* stamp = nullptr) override
+    {
+        if (m_protection.isTripped())
+        {
+            return 0;
+        }
+        return m_output.writeVoltageBlock(src, count, period_us, stamp);
+    }
+
+    size_t writeRawBlock(const uint16_t* src, size_t count, uint32_t period_us,
+                         SampleStamp* stamp = nullptr) override
+    {
+        if (m_protection.isTripped())
+        {
+            return 0;
+        }
+        return m_output.writeRawBlock(src, count, period_us, stamp);
+    }
+
+private:
+    Output& m_output;
+    const OverpressureProtection& m_protection;
+};
+
+
+/**
+ * @class BreakVentValve
+ * @brief Vent valve driven from TIM8_CH1 so the break can force it open.
+ *
+ * In normal operation the channel is in forced active/inactive mode, so
+ * activate()/deactivate() behave like a GPIO. OverpressureProtection::init()
+ * must have run first.
+ */
+class BreakVentValve final : public ISolenoidValve {
+public:
+    BreakVentValve() = default;
+
+    void activate() override;
+    void deactivate() override;
+};
+
+#endif //FIRMWARE_OVERPRESSUREPROTECTION_H
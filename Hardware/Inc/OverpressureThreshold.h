@@ -0,0 +1,89 @@
+#ifndef FIRMWARE_OVERPRESSURETHRESHOLD_H
+#define FIRMWARE_OVERPRESSURETHRESHOLD_H
+
+#pragma once
+
+#include "VppeCalibration.h"
+
+#include <stdint.h>
+
+/**
+ * @file OverpressureThreshold.h
+ * @brief Configuration and threshold math for the hardware overpressure trip.
+ *
+ * Kept free of HAL includes so the same model compiles on the host and
+ * can be checked with static_assert against the configuration in use.
+ *
+ * Signal chain: VPPE feedback (0.1-10V for 0.02-2 bar) -> voltage divider
+ * (sensor_multiplier, same value the feedback STM32_AnalogIn uses) -> COMP1
+ * plus input. The minus input is DAC3 CH1 (internal), loaded with the code
+ * returned by dacCode().
+ */
+
+struct OverpressureConfig {
+    float trip_bar;          // chamber pressure that trips the protection
+    float max_setpoint_bar;  // highest setpoint commanded; BasicPressureRegulator caps at it
+    float sensor_multiplier; // divider ratio between the VPPE feedback and the pin
+    uint8_t hysteresis;      // COMP HYST field, 0..7 (0mV .. 70mV)
+};
+
+namespace OverpressureThreshold {
+
+constexpr float kFullScaleBar = 2.0f; // VPPE range
+constexpr float kVref = 3.3f;         // DAC3 / COMP reference
+constexpr float kMarginBar = 0.05f;   // trip must sit this far above the highest setpoint
+
+/**
+ * @brief VPPE calibration, see VppeCalibration.h.
+ */
+constexpr float barToFeedbackVolts(float bar)
+{
+    return VppeCalibration::barToVolts(bar);
+}
+
+/**
+ * @brief Voltage seen on the comparator pin for a given pressure.
+ */
+constexpr float barToPinVolts(float bar, float sensor_multiplier)
+{
+    return barToFeedbackVolts(bar) / sensor_multiplier;
+}
+
+/**
+ * @brief 12-bit DAC3 code that puts the comparator threshold at @p bar.
+ */
+constexpr uint32_t dacCode(float bar, float sensor_multiplier)
+{
+    float code = (barToPinVolts(bar, sensor_multiplier) / kVref) * 4095.0f;
+    if (code < 0.0f) code = 0.0f;
+    if (code > 4095.0f) code = 4095.0f;
+    return (uint32_t)(code + 0.5f);
+}
+
+/**
+ * @brief Checks that a configuration can actually protect the rig.
+ *
+ * The trip must sit above every setpoint we command (with margin), inside
+ * the VPPE range, and map to a pin voltage the DAC can reach.
+ */
+constexpr bool isValid(const OverpressureConfig& config)
+{
+    return config.sensor_multiplier > 0.0f
+        && config.max_setpoint_bar >= 0.0f
+        && config.trip_bar >= config.max_setpoint_bar + kMarginBar
+        && config.trip_bar <= kFullScaleBar
+        && barToPinVolts(config.trip_bar, config.sensor_multiplier) < kVref
+        && config.hysteresis <= 7U;
+}
+
+/**
+ * @brief Rig default: trip at 1.9 bar, setpoints capped at 1.8 bar,
+ * 0-10V feedback divided down to 0-3.3V, 20mV hysteresis.
+ */
+constexpr OverpressureConfig kDefaultConfig = {1.9f, 1.8f, 10.0f / 3.3f, 2U};
+
+static_assert(isValid(kDefaultConfig), "default overpressure trip configuration is unsafe");
+
+} // namespace OverpressureThreshold
+
+#endif //FIRMWARE_OVERPRESSURETHRESHOLD_H
@@ -13,8 +13,11 @@
 
 
 #include "Interfaces/IAnalogSensor.h"
+#include "Interfaces/IAnalogPairSensor.h"
+#include "Interfaces/IAnalogWatchdog.h"
 #include "Interfaces/IAnalogActuator.h"
 #include "Interfaces/IDigitalActuator.h"
+#include "Interfaces/IFlashPages.h"
 
 
 #include "main.h"
@@ -29,7 +32,7 @@
  *
  * job is to ----> how to interact to a single ADC peripheral to read a voltage.
  */
-class STM32_AnalogIn : public IAnalogSensor {
+class STM32_AnalogIn final : public IAnalogSensor {
 public:
     /**
      * @brief Constructor.
@@ -47,9 +50,135 @@ public:
      */
     float readVoltage() override;
 
+    /**
+     * @brief Reads @p count conversions back-to-back, scaled to volts.
+     */
+    size_t readVoltageBlock(float* dst, size_t count, SampleStamp* stamp = nullptr) override;
+
+    /**
+     * @brief Reads @p count conversions back-to-back as 12-bit counts.
+     */
+    size_t readRawBlock(uint16_t* dst, size_t count, SampleStamp* stamp = nullptr) override;
+
+    /**
+     * @brief Converts a block of raw counts (e.g. a DMA half-buffer) to volts.
+     * No hardware access, safe to call on data captured elsewhere.
+     */
+    void rawToVolts(const uint16_t* raw, float* dst, size_t count) const;
+
+    /**
+     * @brief Timebase stamp of the last conversion done by readVoltage().
+     */
+    uint32_t lastSample_us() const { return m_lastSample_us; }
+
 private:
+    /**
+     * @brief Runs one polled conversion. ADC must already be started.
+     */
+    bool convertOnce(uint32_t& rawValue);
+
     ADC_HandleTypeDef* m_hadc; // A pointer to the HAL ADC peripheral
     float m_multiplier;      // The scaling factor for our voltage divider
+    float m_voltsPerCount;   // 3.3V / 4095 * multiplier, computed once
+    uint32_t m_lastSample_us;
+};
+
+
+//               ANALOG INPUT PAIR (DUAL ADC)
+
+/**
+ * @class STM32_AnalogPairIn
+ * @brief IAnalogPairSensor on two ADCs in dual regular-simultaneous mode.
+ *
+ * The master ADC's trigger converts both channels at once, and DMA writes
+ * every pair (common data register, 32-bit) into a circular buffer. No
+ * interrupt: readPairs() takes the DMA write position from the channel
+ * counter. Read at least once per buffer length of pairs.
+ *
+ * The handles are set up by the board (dual mode, circular DMA linked to
+ * the master).
+ */
+class STM32_AnalogPairIn final : public IAnalogPairSensor {
+public:
+    /**
+     * @brief Constructor.
+     * @param master the master ADC's HAL handle.
+     * @param dma the DMA channel linked to it.
+     * @param buffer circular buffer of @p length pairs.
+     * @param samplePeriod_us time between pairs (the trigger period).
+     * @param voltage_multiplier as for STM32_AnalogIn, both channels.
+     */
+    STM32_AnalogPairIn(ADC_HandleTypeDef* master, DMA_HandleTypeDef* dma, uint32_t* buffer, uint32_t length,
+                       uint32_t samplePeriod_us, float voltage_multiplier = 1.0f);
+
+    /**
+     * @brief Starts both ADCs and the DMA. Conversions then follow the
+     * master's trigger.
+     */
+    bool start();
+
+    size_t readPairs(uint32_t* dst, size_t count, SampleStamp* stamp = nullptr) override;
+    float voltsPerCount() const override { return m_voltsPerCount; }
+    uint32_t dropped() const override { return m_dropped; }
+
+private:
+    uint32_t writeIndex() const;
+
+    ADC_HandleTypeDef* m_hadc;
+    DMA_HandleTypeDef* m_hdma;
+    uint32_t* m_buffer;
+    uint32_t m_length;
+    uint32_t m_samplePeriod_us;
+    float m_voltsPerCount;
+    uint32_t m_readIndex;
+    uint32_t m_lastRead_us;
+    uint32_t m_dropped;
+};
+
+
+//               ANALOG WATCHDOG
+
+/**
+ * @class STM32_AnalogWatchdog
+ * @brief IAnalogWatchdog on one of an ADC's three analog watchdogs.
+ *
+ * Watchdog 1 compares all 12 bits; 2 and 3 only the top 8, so their
+ * window moves in steps of 16 counts. setWindow() writes the threshold
+ * register directly, so it is cheap and safe from the handler.
+ */
+class STM32_AnalogWatchdog final : public IAnalogWatchdog {
+public:
+    /**
+     * @brief Constructor.
+     * @param hadc the ADC converting the watched channel.
+     * @param number watchdog 1..3.
+     * @param voltage_multiplier as for STM32_AnalogIn.
+     */
+    STM32_AnalogWatchdog(ADC_HandleTypeDef* hadc, uint32_t number, float voltage_multiplier = 1.0f);
+
+    /**
+     * @brief Watches @p channel with a window that never triggers, and
+     * enables the watchdog interrupt in the ADC. Before the ADC starts.
+     */
+    bool init(uint32_t channel);
+
+    void setWindow(uint16_t low, uint16_t high) override;
+    void attach(Handler handler, void* context) override;
+    float voltsPerCount() const override { return m_voltsPerCount; }
+
+    /**
+     * @brief Called from the ADC interrupt: checks this watchdog's flag
+     * and runs the handler.
+     */
+    void onIrq();
+
+private:
+    ADC_HandleTypeDef* m_hadc;
+    uint32_t m_number;
+    uint32_t m_flag; // ADC_FLAG_AWDx
+    float m_voltsPerCount;
+    Handler m_handler;
+    void* m_context;
 };
 
 
@@ -60,8 +189,14 @@ private:
  * @brief implementation for the IAnalogActuator interface.
  *
  * responsible to interact with the DAC peripheral to set a voltage.
+ *
+ * With a DMA channel and a pacing timer, it also plays blocks: the timer's
+ * TRGO moves the DAC holding register to the output, and each move asks
+ * the DMA for the next code. No interrupt: the block ends on the clock,
+ * and the next block write or setVoltage() hands the channel back to
+ * software writes.
  */
-class STM32_AnalogOut : public IAnalogActuator {
+class STM32_AnalogOut final : public IAnalogActuator {
 public:
     /**
      * @brief Constructor.
@@ -70,21 +205,67 @@ public:
      * @param divider_ratio The voltage divider ratio.
      * Used to scale a high-level voltage (0-10V) down to the
      * DAC's 0-3.3V range.
+     * @param blockDma DMA channel for block writes (memory to the channel's
+     * 12-bit right-aligned register, half-words, normal mode), or nullptr.
+     * @param pacer 1 MHz timer whose update is the DAC trigger, or nullptr.
+     * @param pacerTrigger the DAC_TRIGGER_xxx for @p pacer's TRGO.
      */
-    STM32_AnalogOut(DAC_HandleTypeDef* hdac, uint32_t channel, float divider_ratio = 1.0f);
+    STM32_AnalogOut(DAC_HandleTypeDef* hdac, uint32_t channel, float divider_ratio = 1.0f,
+                    DMA_HandleTypeDef* blockDma = nullptr, TIM_TypeDef* pacer = nullptr,
+                    uint32_t pacerTrigger = DAC_TRIGGER_NONE);
     virtual ~STM32_AnalogOut();
 
 
     /**
-     * @brief Sets the output voltage.
+     * @brief Sets the output voltage. Cuts short a block still playing.
      * @param voltage The desired real-world voltage.
      */
     bool setVoltage(float voltage) override;
 
+    /**
+     * @brief Converts and clamps the block, then plays it as writeRawBlock().
+     */
+    size_t writeVoltageBlock(const float* src, size_t count, uint32_t period_us,
+                             SampleStamp* stamp = nullptr) override;
+
+    /**
+     * @brief Plays 12-bit codes (clamped to 4095), one every @p period_us
+     * (1..65536, the pacer is 16-bit).
+     */
+    size_t writeRawBlock(const uint16_t* src, size_t count, uint32_t period_us,
+                         SampleStamp* stamp = nullptr) override;
+
+    /**
+     * @brief True until the last sample of the current block is out.
+     */
+    bool isBlockPlaying() const;
+
+    /**
+     * @brief Converts real-world voltages to clamped 12-bit codes.
+     * No hardware access.
+     */
+    void voltsToRaw(const float* src, uint16_t* dst, size_t count) const;
+
+    /**
+     * @brief Timebase stamp of the last setVoltage() that reached the DAC.
+     */
+    uint32_t lastUpdate_us() const { return m_lastUpdate_us; }
+
 private:
+    size_t playBlock(size_t count, uint32_t period_us, SampleStamp* stamp);
+    void finishBlock();
+
     DAC_HandleTypeDef* m_hdac;
     uint32_t m_channel;
     float m_divider_ratio;
+    float m_countsPerVolt; // 4095 / (3.3V * divider_ratio), computed once
+    uint32_t m_lastUpdate_us;
+    DMA_HandleTypeDef* m_hdma;
+    TIM_TypeDef* m_pacer;
+    bool m_blockActive;
+    uint32_t m_blockStart_us;
+    uint32_t m_blockLength_us;
+    uint16_t m_block[kMaxBlock];
 };
 
 
@@ -97,7 +278,7 @@ private:
  *
  * talk to a GPIO pin to set it high or low.
  */
-class STM32_DigitalOut : public IDigitalActuator {
+class STM32_DigitalOut final : public IDigitalActuator {
 public:
     /**
      * @brief Constructor.
@@ -119,9 +300,56 @@ public:
      */
     void setLow() override;
 
+    /**
+     * @brief Timebase stamp of the last setHigh()/setLow() (valve edge).
+     */
+    uint32_t lastEdge_us() const { return m_lastEdge_us; }
+
 private:
     GPIO_TypeDef* m_port; // The GPIO port
     uint16_t m_pin;       // The GPIO pin
+    uint32_t m_lastEdge_us;
+};
+
+
+
+//               INTERNAL FLASH (HAL_FLASH)
+
+/**
+ * @class STM32_FlashPages
+ * @brief implementation for the IFlashPages interface.
+ *
+ * A run of pages in flash bank 2. Code runs from bank 1, so erasing or
+ * programming here does not stall instruction fetch (read-while-write);
+ * only the calling task waits for the HAL to finish.
+ */
+class STM32_FlashPages final : public IFlashPages {
+public:
+    /**
+     * @brief Constructor.
+     * @param firstPage First page number inside bank 2.
+     * @param count Number of pages.
+     */
+    STM32_FlashPages(uint32_t firstPage, uint32_t count);
+    virtual ~STM32_FlashPages() = default;
+
+    uint32_t pageCount() const override;
+    uint32_t pageSize() const override;
+    const uint8_t* pageData(uint32_t page) const override;
+
+    /**
+     * @brief Reads with the ECC check armed: a double error on this read is
+     * taken by FlashPages_NMIHandler() and reported here as false.
+     */
+    bool readDoubleWord(uint32_t page, uint32_t offset, uint64_t& value) const override;
+    bool erasePage(uint32_t page) override;
+    bool programDoubleWord(uint32_t page, uint32_t offset, uint64_t value) override;
+
+private:
+    uint32_t address(uint32_t page) const;
+
+    uint32_t m_firstPage; // page number inside bank 2
+    uint32_t m_count;
 };
 
 
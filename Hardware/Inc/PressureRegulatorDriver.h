@@ -10,6 +10,8 @@
 #include "Interfaces/IPressureControl.h"
 #include "Interfaces/IAnalogSensor.h"
 #include "Interfaces/IAnalogActuator.h"
+#include "OverpressureThreshold.h"
+#include "VppeCalibration.h"
 
 /**
  * @file PressureRegulatorDriver.h
@@ -20,34 +22,78 @@
  * (from the App layer) into "Volts" (for the Peripherals layer).
  *
  * It USES the low-level peripherals.cpp to get the work done.
+ *
+ * The pin types are template parameters. With the concrete (final)
+ * peripheral classes, as SystemRoot wires it, the calls to the DAC/ADC are
+ * direct and can be inlined. PressureRegulatorDriver is the same driver on
+ * the interfaces, for wiring at run time.
+ *
+ * Setpoints above max_setpoint_bar are capped, not refused: whatever the
+ * App layer asks for, the VPPE is never commanded into the overpressure
+ * trip's margin (see OverpressureThreshold.h).
  */
-class PressureRegulatorDriver : public IPressureControl {
+template <typename Actuator, typename Sensor>
+class BasicPressureRegulator final : public IPressureControl {
 public:
     /**
      * @brief Constructs a new PressureRegulatorDriver.
      * @param setpointPin setting the output voltage (DAC).
      * @param feedbackPin reading the feedback voltage (ADC).
+     * @param maxSetpoint_bar highest pressure setPressure() will command.
      */
-    PressureRegulatorDriver(IAnalogActuator& setpointPin, IAnalogSensor& feedbackPin);
+    BasicPressureRegulator(Actuator& setpointPin, Sensor& feedbackPin,
+                           float maxSetpoint_bar = OverpressureThreshold::kDefaultConfig.max_setpoint_bar)
+            : m_setpointPin(setpointPin),
+              m_feedbackPin(feedbackPin),
+              m_maxSetpoint_bar(maxSetpoint_bar)
+    {
+        // setting the pressure to 0 when the system boots. (I need to ask this)
+        setPressure(0.0f);
+    }
 
     /**
      * @brief Sets the target pressure.
      * Translates Bar -> Volts and tells the DAC.
-     * @param bar The desired pressure in Bar.
+     * @param bar The desired pressure in Bar, capped at maxSetpoint().
      */
-    bool setPressure(float bar) override;
+    bool setPressure(float bar) override
+    {
+        if (bar > m_maxSetpoint_bar)
+        {
+            bar = m_maxSetpoint_bar;
+        }
+
+        // the calibration formula, see VppeCalibration.h
+        float voltage_to_set = VppeCalibration::barToVolts(bar);
+
+        // to set that calculated voltage by DAC wrapper
+        return m_setpointPin.setVoltage(voltage_to_set);
+    }
 
     /**
      * @brief Reads the actual pressure.
      * Reads Volts from the ADC and translates Volts -> Bar.
      * @return The measured pressure in Bar.
      */
-    float getActualPressure() override;
+    float getActualPressure() override
+    {
+        // asking from (the ADC wrapper) to read the voltage.
+        float feedback_voltage = m_feedbackPin.readVoltage();
+
+        // Now, apply formula to convert Volts -> Bar (clamped to 0 for
+        // voltages under 0.1 V)
+        return VppeCalibration::voltsToBar(feedback_voltage);
+    }
+
+    float maxSetpoint() const { return m_maxSetpoint_bar; }
 
 private:
     // These are the "Specialists" (Building Blocks) this driver uses.
-    IAnalogActuator& m_setpointPin; // Our "tool" to set the voltage
-    IAnalogSensor& m_feedbackPin;   // Our "tool" to read the voltage
+    Actuator& m_setpointPin; // Our "tool" to set the voltage
+    Sensor& m_feedbackPin;   // Our "tool" to read the voltage
+    float m_maxSetpoint_bar;
 };
 
-#endif //FIRMWARE_PRESSUREREGULATORDRIVER_H
\ No newline at end of file
+using PressureRegulatorDriver = BasicPressureRegulator<IAnalogActuator, IAnalogSensor>;
+
+#endif //FIRMWARE_PRESSUREREGULATORDRIVER_H
@@ -0,0 +1,46 @@
+#ifndef FIRMWARE_STATICINSTANCE_H
+#define FIRMWARE_STATICINSTANCE_H
+
+#pragma once
+
+/**
+ * @file StaticInstance.h
+ * @brief Static storage for one object that is constructed later, at a
+ * point chosen by the code (not by static initialisation order).
+ *
+ * constructWith(make) builds the object in place from what @p make
+ * returns; the return value is never copied or moved (guaranteed copy
+ * elision), so non-copyable drivers work too. The object is never
+ * destroyed.
+ */
+
+#include <new>
+#include <stdint.h>
+
+template <typename T>
+class StaticInstance {
+public:
+    constexpr StaticInstance() : m_storage{}, m_constructed(false) {}
+
+    StaticInstance(const StaticInstance&) = delete;
+    StaticInstance& operator=(const StaticInstance&) = delete;
+
+    template <typename Make>
+    T& constructWith(Make make)
+    {
+        T* object = ::new (static_cast<void*>(m_storage)) T(make());
+        m_constructed = true;
+        return *object;
+    }
+
+    bool isConstructed() const { return m_constructed; }
+
+    T& operator*() { return *std::launder(reinterpret_cast<T*>(m_storage)); }
+    T* operator->() { return std::launder(reinterpret_cast<T*>(m_storage)); }
+
+private:
+    alignas(T) uint8_t m_storage[sizeof(T)];
+    bool m_constructed;
+};
+
+#endif //FIRMWARE_STATICINSTANCE_H
@@ -0,0 +1,62 @@
+#ifndef FIRMWARE_STM32BOARD_H
+#define FIRMWARE_STM32BOARD_H
+
+#pragma once
+
+/**
+ * @file Stm32Board.h
+ * @brief The rig: which peripheral drives what, and its calibration.
+ *
+ * Used by SystemRoot as the Board parameter. init() brings the driver
+ * graph up in a fixed order, all in static storage:
+ *   1. ADC1 (PA1, VPPE feedback) and DAC1 CH1 (PA4, VPPE setpoint) HAL
+ *      handles,
+ *   2. the overpressure trip, armed before anything can command pressure,
+ *   3. feedback input, DAC output and the trip guard around it (block
+ *      writes paced by TIM4, DMA1 CH2),
+ *   4. the pressure pair: ADC3 (PB1) and ADC4 (PB12) in dual simultaneous
+ *      mode, triggered by TIM3 every kPairPeriod_us, DMA1 CH1 into a
+ *      circular buffer, with analog watchdog 1 of each ADC on its channel
+ *      (ADC3/ADC4 interrupts at NVIC priority 5).
+ *
+ * The output handed to the regulator is the TripGuardedActuator, so
+ * software cannot drive the VPPE again while the trip is latched.
+ */
+
+#include "Peripherals.h"
+#include "OverpressureProtection.h"
+#include "OverpressureThreshold.h"
+
+struct Stm32Board {
+    using Feedback = STM32_AnalogIn;
+    using Output = TripGuardedActuator<STM32_AnalogOut>;
+    using PressurePair = STM32_AnalogPairIn;
+    using Watchdog = STM32_AnalogWatchdog;
+
+    static constexpr OverpressureConfig kOverpressure = OverpressureThreshold::kDefaultConfig;
+    static constexpr float kFeedbackMultiplier = kOverpressure.sensor_multiplier; // same PA1 divider
+    static constexpr float kSetpointDivider = 10.0f / 3.3f; // 0-3.3V DAC -> 0-10V VPPE input
+    static constexpr uint32_t kFeedbackChannel = ADC_CHANNEL_2; // PA1 = ADC12_IN2
+    static constexpr uint32_t kSetpointChannel = DAC_CHANNEL_1; // PA4
+    static constexpr uint32_t kSetpointTrigger = DAC_TRIGGER_T4_TRGO; // block write pacer
+    static constexpr uint32_t kPairChannelFirst = ADC_CHANNEL_1;  // PB1 = ADC3_IN1, ventricle
+    static constexpr uint32_t kPairChannelSecond = ADC_CHANNEL_3; // PB12 = ADC4_IN3, aorta
+    static constexpr uint32_t kPairPeriod_us = 100;               // 10 kHz
+    static constexpr uint32_t kPairBufferLength = 256;            // 25.6 ms of pairs
+    static constexpr float kPairMultiplier = 1.0f;
+    static constexpr uint32_t kWatchdogIrqPriority = 5; // may notify tasks
+
+    static void init();
+
+    static Feedback& feedback();
+    static Output& output();
+    static OverpressureProtection& protection();
+    static PressurePair& pressurePair();
+
+    /**
+     * @brief Watchdog on the pair's first (0) or second (1) channel.
+     */
+    static Watchdog& pairWatchdog(uint32_t index);
+};
+
+#endif //FIRMWARE_STM32BOARD_H
@@ -0,0 +1,97 @@
+#ifndef FIRMWARE_TIMEBASE_H
+#define FIRMWARE_TIMEBASE_H
+
+#pragma once
+
+/**
+ * @file Timebase.h
+ * @brief Free-running 1 MHz monotonic timebase on TIM2 (32-bit).
+ *
+ * now_us() is a single register read and is safe in any ISR. It wraps every
+ * ~71.6 minutes; differences of two now_us() values are correct across the
+ * wrap as long as the interval is shorter than that (use unsigned subtract).
+ *
+ * now_us64() extends the counter with an overflow count kept by the TIM2
+ * update interrupt, so it never wraps.
+ *
+ * TIM1 stays the HAL tick (stm32g4xx_hal_timebase_tim.c); this one is only
+ * for timestamps.
+ *
+ * Host builds (no USE_HAL_DRIVER) get a fake clock that runs either on
+ * virtual time, advanced explicitly by the simulation, or on wall time.
+ */
+
+#include <stdint.h>
+
+#if defined(USE_HAL_DRIVER)
+#include "main.h"
+#endif
+
+namespace Timebase {
+
+/**
+ * @brief Starts TIM2 at 1 MHz. Call once, after SystemClock_Config().
+ */
+void init();
+
+/**
+ * @brief 64-bit microseconds since init(). Never wraps.
+ */
+uint64_t now_us64();
+
+#if defined(USE_HAL_DRIVER)
+
+/**
+ * @brief 32-bit microseconds since init(). One load, no locking.
+ */
+static inline uint32_t now_us()
+{
+    return TIM2->CNT;
+}
+
+/**
+ * @brief Called from TIM2_IRQHandler on counter overflow.
+ */
+void onOverflowIrq();
+
+/**
+ * @brief Input clock of the APB1 timers (TIM2..TIM7). It is PCLK1 when
+ * the APB1 prescaler is 1, as SystemClock_Config() sets it, and twice
+ * PCLK1 otherwise.
+ */
+static inline uint32_t apb1TimerClock_hz()
+{
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    return ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_HCLK_DIV1) ? pclk1 : 2U * pclk1;
+}
+
+#else
+
+enum class HostMode {
+    Virtual, // time only moves when advance() is called
+    Wall     // steady_clock since init()
+};
+
+void setHostMode(HostMode mode);
+HostMode hostMode();
+
+/**
+ * @brief Moves virtual time forward. Ignored in Wall mode.
+ */
+void advance(uint32_t us);
+
+uint32_t now_us();
+
+#endif
+
+/**
+ * @brief Elapsed time since @p start_us, correct across one 32-bit wrap.
+ */
+static inline uint32_t elapsed_us(uint32_t start_us)
+{
+    return now_us() - start_us;
+}
+
+} // namespace Timebase
+
+#endif //FIRMWARE_TIMEBASE_H
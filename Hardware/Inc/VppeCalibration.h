@@ -0,0 +1,42 @@
+#ifndef FIRMWARE_VPPECALIBRATION_H
+#define FIRMWARE_VPPECALIBRATION_H
+
+#pragma once
+
+/**
+ * @file VppeCalibration.h
+ * @brief Bar <-> volts for the Festo VPPE, the one copy of its calibration.
+ *
+ * Pressure = (V - 0.1) * (1.98 / 9.9) + 0.02
+ *          = (V - 0.1) * 0.2 + 0.02
+ * and the reverse, to solve for the setpoint voltage:
+ * V = ((Pressure - 0.02) * (9.9 / 1.98)) + 0.1
+ *   = ((Pressure - 0.02) * 5.0) + 0.1
+ *
+ * Used by BasicPressureRegulator, MultiChannelRegulator and the
+ * overpressure threshold.
+ */
+
+namespace VppeCalibration {
+
+/**
+ * @brief Setpoint (or feedback) voltage for a pressure.
+ */
+constexpr float barToVolts(float bar)
+{
+    return ((bar - 0.02f) * 5.0f) + 0.1f;
+}
+
+/**
+ * @brief Pressure for a feedback voltage. Below 0.1 V the formula goes
+ * negative (e.g. 0 V, sensor unpowered), so it is clamped to 0 bar.
+ */
+constexpr float voltsToBar(float volts)
+{
+    float bar = ((volts - 0.1f) * 0.2f) + 0.02f;
+    return (bar < 0.0f) ? 0.0f : bar;
+}
+
+} // namespace VppeCalibration
+
+#endif //FIRMWARE_VPPECALIBRATION_H
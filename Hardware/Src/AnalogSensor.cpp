@@ -0,0 +1,28 @@
+/**
+ * @file AnalogSensor.cpp
+ * @brief Default block read of IAnalogSensor, stamped with the timebase.
+ */
+
+#include "Interfaces/IAnalogSensor.h"
+#include "Timebase.h"
+
+size_t IAnalogSensor::readVoltageBlock(float* dst, size_t count, SampleStamp* stamp)
+{
+    uint32_t first = Timebase::now_us();
+    size_t n = 0;
+    for (; n < count; ++n)
+    {
+        float v = readVoltage();
+        if (v < 0.0f)
+        {
+            break; // the single-sample API reports errors as -1
+        }
+        dst[n] = v;
+    }
+    if (stamp != nullptr)
+    {
+        stamp->first_us = first;
+        stamp->last_us = Timebase::now_us();
+    }
+    return n;
+}
@@ -0,0 +1,282 @@
+/**
+ * @file EventScheduler.cpp
+ * @brief Event heap and the TIM2 CC1 driver.
+ */
+
+#include "EventScheduler.h"
+#include "InterruptLock.h"
+#include "Timebase.h"
+
+namespace {
+
+using EventScheduler::kMaxEvents;
+
+constexpr uint16_t kNotQueued = 0xFFFFU;
+
+struct Node {
+    uint32_t due_us;
+    EventScheduler::Callback callback;
+    void* context;
+    uint16_t heapIndex;  // position in s_heap, kNotQueued when free
+    uint16_t generation; // bumped every time the node is released
+};
+
+Node s_nodes[kMaxEvents];
+uint16_t s_heap[kMaxEvents]; // node indices, earliest first
+uint16_t s_free[kMaxEvents]; // stack of free node indices
+uint32_t s_count = 0;
+uint32_t s_freeCount = 0;
+bool s_initialised = false;
+EventScheduler::Stats s_stats = {};
+
+void initialise()
+{
+    for (uint32_t i = 0; i < kMaxEvents; ++i)
+    {
+        s_nodes[i].heapIndex = kNotQueued;
+        s_nodes[i].generation = 1;
+        s_free[i] = (uint16_t)(kMaxEvents - 1U - i);
+    }
+    s_freeCount = kMaxEvents;
+    s_count = 0;
+    s_initialised = true;
+}
+
+bool earlier(uint16_t a, uint16_t b)
+{
+    return (int32_t)(s_nodes[a].due_us - s_nodes[b].due_us) < 0;
+}
+
+void place(uint32_t position, uint16_t node)
+{
+    s_heap[position] = node;
+    s_nodes[node].heapIndex = (uint16_t)position;
+}
+
+void siftUp(uint32_t position)
+{
+    uint16_t node = s_heap[position];
+    while (position > 0U)
+    {
+        uint32_t parent = (position - 1U) / 2U;
+        if (!earlier(node, s_heap[parent]))
+        {
+            break;
+        }
+        place(position, s_heap[parent]);
+        position = parent;
+    }
+    place(position, node);
+}
+
+void siftDown(uint32_t position)
+{
+    uint16_t node = s_heap[position];
+    for (;;)
+    {
+        uint32_t child = 2U * position + 1U;
+        if (child >= s_count)
+        {
+            break;
+        }
+        if (child + 1U < s_count && earlier(s_heap[child + 1U], s_heap[child]))
+        {
+            child++;
+        }
+        if (!earlier(s_heap[child], node))
+        {
+            break;
+        }
+        place(position, s_heap[child]);
+        position = child;
+    }
+    place(position, node);
+}
+
+/**
+ * @brief Takes @p node out of the heap and returns it to the pool.
+ */
+void remove(uint16_t node)
+{
+    uint32_t position = s_nodes[node].heapIndex;
+    s_count--;
+    if (position != s_count)
+    {
+        place(position, s_heap[s_count]);
+        if (position > 0U && earlier(s_heap[position], s_heap[(position - 1U) / 2U]))
+        {
+            siftUp(position);
+        }
+        else
+        {
+            siftDown(position);
+        }
+    }
+    s_nodes[node].heapIndex = kNotQueued;
+    s_nodes[node].generation++;
+    s_free[s_freeCount++] = node;
+}
+
+EventScheduler::Handle handleOf(uint16_t node)
+{
+    return ((uint32_t)s_nodes[node].generation << 16) | (uint32_t)(node + 1U);
+}
+
+/**
+ * @brief Points CC1 at the earliest event. If it is already (nearly) due,
+ * the counter may pass it before the write lands, so the compare event is
+ * raised by software instead.
+ */
+void armCompare()
+{
+#if defined(USE_HAL_DRIVER)
+    if (s_count == 0U)
+    {
+        return;
+    }
+    uint32_t due = s_nodes[s_heap[0]].due_us;
+    TIM2->CCR1 = due;
+    if ((int32_t)(due - Timebase::now_us()) <= (int32_t)EventScheduler::kMinLead_us)
+    {
+        TIM2->EGR = TIM_EGR_CC1G;
+    }
+#endif
+}
+
+} // namespace
+
+
+void EventScheduler::init()
+{
+    InterruptLock lock;
+    if (!s_initialised)
+    {
+        initialise();
+    }
+#if defined(USE_HAL_DRIVER)
+    CLEAR_BIT(TIM2->CCMR1, TIM_CCMR1_OC1M); // frozen: compare only sets CC1IF
+    TIM2->SR = (uint32_t)~TIM_SR_CC1IF;
+    SET_BIT(TIM2->DIER, TIM_DIER_CC1IE);
+#endif
+}
+
+EventScheduler::Handle EventScheduler::schedule(uint32_t at_us, Callback callback, void* context)
+{
+    if (callback == nullptr)
+    {
+        return kNoEvent;
+    }
+    InterruptLock lock;
+    if (!s_initialised)
+    {
+        initialise();
+    }
+    if (s_freeCount == 0U)
+    {
+        s_stats.rejected++;
+        return kNoEvent;
+    }
+    uint16_t node = s_free[--s_freeCount];
+    s_nodes[node].due_us = at_us;
+    s_nodes[node].callback = callback;
+    s_nodes[node].context = context;
+    place(s_count, node);
+    s_count++;
+    siftUp(s_count - 1U);
+
+    s_stats.maxPending = (s_count > s_stats.maxPending) ? (uint16_t)s_count : s_stats.maxPending;
+    if (s_heap[0] == node)
+    {
+        armCompare();
+    }
+    return handleOf(node);
+}
+
+EventScheduler::Handle EventScheduler::scheduleIn(uint32_t delay_us, Callback callback, void* context)
+{
+    return schedule(Timebase::now_us() + delay_us, callback, context);
+}
+
+bool EventScheduler::cancel(Handle handle)
+{
+    uint32_t index = (handle & 0xFFFFU);
+    if (index == 0U || index > kMaxEvents)
+    {
+        return false;
+    }
+    uint16_t node = (uint16_t)(index - 1U);
+    InterruptLock lock;
+    if (s_nodes[node].heapIndex == kNotQueued || s_nodes[node].generation != (uint16_t)(handle >> 16))
+    {
+        return false;
+    }
+    bool wasFirst = (s_heap[0] == node);
+    remove(node);
+    s_stats.cancelled++;
+    if (wasFirst)
+    {
+        armCompare();
+    }
+    return true;
+}
+
+void EventScheduler::dispatch()
+{
+    for (uint32_t n = 0; n < kMaxPerIrq; ++n)
+    {
+        Callback callback;
+        void* context;
+        uint32_t due;
+        {
+            InterruptLock lock;
+            if (s_count == 0U)
+            {
+                return;
+            }
+            uint16_t node = s_heap[0];
+            due = s_nodes[node].due_us;
+            uint32_t now = Timebase::now_us();
+            if ((int32_t)(due - now) > 0)
+            {
+                armCompare();
+                return;
+            }
+            callback = s_nodes[node].callback;
+            context = s_nodes[node].context;
+            remove(node);
+            uint32_t lateness = now - due;
+            s_stats.maxLateness_us = (lateness > s_stats.maxLateness_us) ? lateness : s_stats.maxLateness_us;
+            s_stats.dispatched++;
+        }
+        callback(context, due); // outside the lock: it may schedule
+    }
+    InterruptLock lock;
+    armCompare(); // more due: the next interrupt picks them up
+}
+
+EventScheduler::Stats EventScheduler::stats()
+{
+    InterruptLock lock;
+    Stats stats = s_stats;
+    stats.pending = (uint16_t)s_count;
+    return stats;
+}
+
+#if defined(USE_HAL_DRIVER)
+
+void EventScheduler::onCompareIrq()
+{
+    if ((TIM2->SR & TIM_SR_CC1IF) == 0U)
+    {
+        return;
+    }
+    TIM2->SR = (uint32_t)~TIM_SR_CC1IF;
+    dispatch();
+}
+
+extern "C" void EventScheduler_IRQHandler(void)
+{
+    EventScheduler::onCompareIrq();
+}
+
+#endif
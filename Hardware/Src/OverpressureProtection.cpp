@@ -0,0 +1,213 @@
+/**
+ * @file OverpressureProtection.cpp
+ * @brief Register-level setup of the COMP1 / DAC3 / TIM8 break overpressure trip.
+ *
+ * The HAL COMP module is not part of this build, so COMP1, DAC3 and the
+ * TIM8 break are programmed directly through their registers.
+ */
+
+#include "OverpressureProtection.h"
+#include "Timebase.h"
+#include "DeferredLog.h"
+
+OverpressureProtection* OverpressureProtection::s_instance = nullptr;
+
+namespace {
+
+constexpr uint32_t kCompInmDac3Ch1 = 0x4U;  // COMP1 INMSEL: DAC3_CH1
+constexpr uint32_t kDacModeInternal = 0x3U; // DAC MODE: internal only, buffer off
+constexpr uint32_t kOcForceInactive = 0x4U; // OC1M forced inactive
+constexpr uint32_t kOcForceActive = 0x5U;   // OC1M forced active
+
+/**
+ * @brief Stops a block write first (DMA requests and the pacer trigger off),
+ * so the zero reaches the pin at once and nothing overwrites it.
+ */
+void writeSetpointZero(DAC_TypeDef* dac, uint32_t channel)
+{
+    CLEAR_BIT(dac->CR, (DAC_CR_DMAEN1 | DAC_CR_TEN1) << (channel & 0x10U));
+    if (channel == DAC_CHANNEL_1)
+    {
+        dac->DHR12R1 = 0U;
+    }
+    else
+    {
+        dac->DHR12R2 = 0U;
+    }
+}
+
+void setVentOutputMode(uint32_t mode)
+{
+    uint32_t ccmr = TIM8->CCMR1 & ~TIM_CCMR1_OC1M;
+    TIM8->CCMR1 = ccmr | (mode << TIM_CCMR1_OC1M_Pos);
+}
+
+} // namespace
+
+
+OverpressureProtection::OverpressureProtection(const OverpressureConfig& config)
+        : m_config(config),
+          m_setpointDac(nullptr),
+          m_setpointChannel(DAC_CHANNEL_1),
+          m_thresholdCode(0),
+          m_tripped(false),
+          m_tripCount(0),
+          m_log{}
+{
+
+}
+
+bool OverpressureProtection::init(DAC_TypeDef* setpointDac, uint32_t setpointChannel)
+{
+    if (setpointDac == nullptr || !OverpressureThreshold::isValid(m_config))
+    {
+        return false;
+    }
+    m_setpointDac = setpointDac;
+    m_setpointChannel = setpointChannel;
+    m_thresholdCode = OverpressureThreshold::dacCode(m_config.trip_bar, m_config.sensor_multiplier);
+    s_instance = this;
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    __HAL_RCC_SYSCFG_CLK_ENABLE();
+    __HAL_RCC_DAC3_CLK_ENABLE();
+    __HAL_RCC_TIM8_CLK_ENABLE();
+
+    // 1. Pins: PA1 analog (COMP1_INP), PC6 TIM8_CH1 (vent valve)
+    GPIO_InitTypeDef gpio = {0};
+    gpio.Pin = GPIO_PIN_1;
+    gpio.Mode = GPIO_MODE_ANALOG;
+    gpio.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &gpio);
+
+    gpio.Pin = GPIO_PIN_6;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    gpio.Alternate = GPIO_AF4_TIM8;
+    HAL_GPIO_Init(GPIOC, &gpio);
+
+    // 2. Threshold: DAC3 CH1 internal, high-frequency interface for 170MHz AHB
+    DAC3->MCR = (DAC3->MCR & ~(DAC_MCR_MODE1 | DAC_MCR_HFSEL))
+              | (kDacModeInternal << DAC_MCR_MODE1_Pos)
+              | DAC_MCR_HFSEL_1;
+    DAC3->DHR12R1 = m_thresholdCode;
+    SET_BIT(DAC3->CR, DAC_CR_EN1);
+    HAL_Delay(1); // DAC wake-up time before the comparator can trust it
+
+    // 3. Vent valve channel: forced inactive (closed), idle level high (open)
+    setVentOutputMode(kOcForceInactive);
+    SET_BIT(TIM8->CR2, TIM_CR2_OIS1);
+    SET_BIT(TIM8->CCER, TIM_CCER_CC1E);
+    SET_BIT(TIM8->AF1, TIM1_AF1_BKCMP1E);
+    TIM8->BDTR = TIM_BDTR_BKE | TIM_BDTR_BKP | TIM_BDTR_OSSI | TIM_BDTR_OSSR;
+    TIM8->SR = (uint32_t)~TIM_SR_BIF;
+    SET_BIT(TIM8->BDTR, TIM_BDTR_MOE);
+    SET_BIT(TIM8->CR1, TIM_CR1_CEN);
+
+    // 4. Comparator: PA1 vs DAC3_CH1, output high above the threshold
+    COMP1->CSR = (kCompInmDac3Ch1 << COMP_CSR_INMSEL_Pos)
+               | ((uint32_t)m_config.hysteresis << COMP_CSR_HYST_Pos);
+    SET_BIT(COMP1->CSR, COMP_CSR_EN);
+
+    // 5. EXTI line 21 (COMP1 output), rising edge, above the RTOS syscall priority
+    EXTI->PR1 = EXTI_PR1_PIF21;
+    SET_BIT(EXTI->RTSR1, EXTI_RTSR1_RT21);
+    SET_BIT(EXTI->IMR1, EXTI_IMR1_IM21);
+    HAL_NVIC_SetPriority(COMP1_2_3_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(COMP1_2_3_IRQn);
+
+    return true;
+}
+
+bool OverpressureProtection::setTripPressure(float bar)
+{
+    OverpressureConfig candidate = m_config;
+    candidate.trip_bar = bar;
+    if (!OverpressureThreshold::isValid(candidate))
+    {
+        return false;
+    }
+    m_config = candidate;
+    m_thresholdCode = OverpressureThreshold::dacCode(bar, m_config.sensor_multiplier);
+    DAC3->DHR12R1 = m_thresholdCode;
+    return true;
+}
+
+bool OverpressureProtection::rearm()
+{
+    if ((COMP1->CSR & COMP_CSR_VALUE) != 0U)
+    {
+        return false; // still above the threshold
+    }
+    TIM8->SR = (uint32_t)~TIM_SR_BIF;
+    SET_BIT(TIM8->BDTR, TIM_BDTR_MOE);
+    m_tripped = false;
+    return true;
+}
+
+bool OverpressureProtection::getTrip(uint32_t index, TripEvent& out) const
+{
+    uint32_t count = m_tripCount;
+    if (index >= count || index >= kLogSize)
+    {
+        return false;
+    }
+    out = m_log[(count - 1U - index) % kLogSize];
+    return true;
+}
+
+/**
+ * @brief Runs at priority 0. The vent valve is already open by the time we
+ * get here (TIM8 break); this zeroes the VPPE setpoint and logs the trip.
+ */
+void OverpressureProtection::onComparatorIrq()
+{
+    if ((EXTI->PR1 & EXTI_PR1_PIF21) == 0U)
+    {
+        return;
+    }
+    EXTI->PR1 = EXTI_PR1_PIF21;
+
+    if (m_setpointDac != nullptr)
+    {
+        writeSetpointZero(m_setpointDac, m_setpointChannel);
+    }
+    m_tripped = true;
+
+    uint32_t count = m_tripCount;
+    TripEvent& event = m_log[count % kLogSize];
+    event.time_us = Timebase::now_us();
+    event.threshold_code = (uint16_t)m_thresholdCode;
+    event.sequence = (uint16_t)count;
+    m_tripCount = count + 1U;
+
+    LOG_ERROR("overpressure trip #%u, threshold code %u", count, m_thresholdCode);
+}
+
+
+//               VENT VALVE (TIM8_CH1)
+
+void BreakVentValve::activate()
+{
+    setVentOutputMode(kOcForceActive);
+}
+
+void BreakVentValve::deactivate()
+{
+    setVentOutputMode(kOcForceInactive);
+}
+
+
+extern "C" void OverpressureProtection_IRQHandler(void)
+{
+    OverpressureProtection* protection = OverpressureProtection::instance();
+    if (protection != nullptr)
+    {
+        protection->onComparatorIrq();
+    }
+    else
+    {
+        EXTI->PR1 = EXTI_PR1_PIF21;
+    }
+}
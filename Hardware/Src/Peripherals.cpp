@@ -11,6 +11,7 @@
  */
 
 #include "Peripherals.h"
+#include "Timebase.h"
 
 //               ANALOG INPUT (ADC)
 /**
@@ -18,7 +19,9 @@
  */
 STM32_AnalogIn::STM32_AnalogIn(ADC_HandleTypeDef* hadc, float voltage_multiplier)
         : m_hadc(hadc),        // Store the pointer to the ADC
-          m_multiplier(voltage_multiplier) // Store the voltage divider ratio
+          m_multiplier(voltage_multiplier), // Store the voltage divider ratio
+          m_voltsPerCount((3.3f / 4095.0f) * voltage_multiplier),
+          m_lastSample_us(0)
 {
 
 }
@@ -51,6 +54,7 @@ float STM32_AnalogIn::readVoltage()
 
     // 3. Get the 12-bit raw value (0-4095)
     uint32_t rawValue = HAL_ADC_GetValue(m_hadc);
+    m_lastSample_us = Timebase::now_us();
 
     // 4. Stop the ADC
 
@@ -63,22 +67,316 @@ float STM32_AnalogIn::readVoltage()
     return adcVoltage * m_multiplier;
 }
 
+/**
+ * @brief Polls one conversion and fetches the 12-bit result.
+ */
+bool STM32_AnalogIn::convertOnce(uint32_t& rawValue)
+{
+    if (HAL_ADC_Start(m_hadc) != HAL_OK)
+    {
+        return false;
+    }
+    if (HAL_ADC_PollForConversion(m_hadc, 10) != HAL_OK)
+    {
+        return false;
+    }
+    rawValue = HAL_ADC_GetValue(m_hadc);
+    return true;
+}
+
+/**
+ * @brief Reads a block of raw counts. The ADC is stopped once at the end
+ * instead of after every sample.
+ */
+size_t STM32_AnalogIn::readRawBlock(uint16_t* dst, size_t count, SampleStamp* stamp)
+{
+    if (m_hadc == nullptr || dst == nullptr)
+    {
+        return 0;
+    }
+
+    uint32_t first = Timebase::now_us();
+    size_t n = 0;
+    uint32_t rawValue = 0;
+    while (n < count && convertOnce(rawValue))
+    {
+        dst[n++] = (uint16_t)rawValue;
+    }
+    HAL_ADC_Stop(m_hadc);
+
+    if (stamp != nullptr)
+    {
+        stamp->first_us = first;
+        stamp->last_us = Timebase::now_us();
+    }
+    if (n < count)
+    {
+        Error_Handler();
+    }
+    return n;
+}
+
+/**
+ * @brief Reads a block of samples in volts using the precomputed scale.
+ */
+size_t STM32_AnalogIn::readVoltageBlock(float* dst, size_t count, SampleStamp* stamp)
+{
+    if (m_hadc == nullptr || dst == nullptr)
+    {
+        return 0;
+    }
+
+    uint32_t first = Timebase::now_us();
+    size_t n = 0;
+    uint32_t rawValue = 0;
+    while (n < count && convertOnce(rawValue))
+    {
+        dst[n++] = (float)rawValue * m_voltsPerCount;
+    }
+    HAL_ADC_Stop(m_hadc);
+
+    if (stamp != nullptr)
+    {
+        stamp->first_us = first;
+        stamp->last_us = Timebase::now_us();
+    }
+    if (n < count)
+    {
+        Error_Handler();
+    }
+    return n;
+}
+
+/**
+ * @brief Scales raw counts to volts. Pure math, no HAL.
+ */
+void STM32_AnalogIn::rawToVolts(const uint16_t* raw, float* dst, size_t count) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        dst[i] = (float)raw[i] * m_voltsPerCount;
+    }
+}
+
+
+
+//               ANALOG INPUT PAIR (DUAL ADC)
+
+STM32_AnalogPairIn::STM32_AnalogPairIn(ADC_HandleTypeDef* master, DMA_HandleTypeDef* dma, uint32_t* buffer,
+                                       uint32_t length, uint32_t samplePeriod_us, float voltage_multiplier)
+        : m_hadc(master),
+          m_hdma(dma),
+          m_buffer(buffer),
+          m_length(length),
+          m_samplePeriod_us(samplePeriod_us),
+          m_voltsPerCount((3.3f / 4095.0f) * voltage_multiplier),
+          m_readIndex(0),
+          m_lastRead_us(0),
+          m_dropped(0)
+{
+
+}
+
+bool STM32_AnalogPairIn::start()
+{
+    if (m_hadc == nullptr || m_hdma == nullptr || m_buffer == nullptr || m_length == 0U)
+    {
+        return false;
+    }
+    m_readIndex = 0;
+    m_lastRead_us = Timebase::now_us();
+    if (HAL_ADCEx_MultiModeStart_DMA(m_hadc, m_buffer, m_length) != HAL_OK)
+    {
+        return false;
+    }
+    // The HAL turns the overrun interrupt on for any DMA start. Nothing
+    // services it (the ADC3/ADC4 vectors are the analog watchdogs'), so one
+    // overrun would keep the vector pending; a lost pair already shows up
+    // in dropped().
+    __HAL_ADC_DISABLE_IT(m_hadc, ADC_IT_OVR);
+    return true;
+}
+
+/**
+ * @brief Index of the next pair the DMA writes. The counter goes
+ * length..1 and reloads in circular mode.
+ */
+uint32_t STM32_AnalogPairIn::writeIndex() const
+{
+    uint32_t remaining = __HAL_DMA_GET_COUNTER(m_hdma);
+    return (remaining == 0U || remaining > m_length) ? 0U : m_length - remaining;
+}
+
+/**
+ * @brief Copies the pairs between the last read and the DMA position. If
+ * more than a buffer's worth of trigger periods went by, the DMA lapped the
+ * reader: only the newest pairs are still there.
+ */
+size_t STM32_AnalogPairIn::readPairs(uint32_t* dst, size_t count, SampleStamp* stamp)
+{
+    if (m_buffer == nullptr || dst == nullptr)
+    {
+        return 0;
+    }
+
+    uint32_t now = Timebase::now_us();
+    uint32_t write = writeIndex();
+    uint32_t available = (write + m_length - m_readIndex) % m_length;
+    uint32_t elapsed = (m_samplePeriod_us > 0U) ? (now - m_lastRead_us) / m_samplePeriod_us : 0U;
+    if (elapsed >= m_length)
+    {
+        m_dropped += elapsed - (m_length - 1U);
+        m_readIndex = (write + 1U) % m_length; // oldest pair not yet overwritten
+        available = m_length - 1U;
+    }
+
+    size_t n = (available < count) ? available : count;
+    for (size_t i = 0; i < n; ++i)
+    {
+        dst[i] = m_buffer[m_readIndex];
+        m_readIndex = (m_readIndex + 1U == m_length) ? 0U : m_readIndex + 1U;
+    }
+    // The newest pair in the buffer is at most one period old.
+    uint32_t last = now - (available - (uint32_t)n) * m_samplePeriod_us;
+    m_lastRead_us = last;
+
+    if (stamp != nullptr)
+    {
+        stamp->last_us = last;
+        stamp->first_us = (n > 0U) ? last - ((uint32_t)n - 1U) * m_samplePeriod_us : last;
+    }
+    return n;
+}
+
+
+//               ANALOG WATCHDOG
+
+STM32_AnalogWatchdog::STM32_AnalogWatchdog(ADC_HandleTypeDef* hadc, uint32_t number, float voltage_multiplier)
+        : m_hadc(hadc),
+          m_number(number),
+          m_flag((number == 3U) ? ADC_FLAG_AWD3 : (number == 2U) ? ADC_FLAG_AWD2 : ADC_FLAG_AWD1),
+          m_voltsPerCount((3.3f / 4095.0f) * voltage_multiplier),
+          m_handler(nullptr),
+          m_context(nullptr)
+{
+
+}
+
+bool STM32_AnalogWatchdog::init(uint32_t channel)
+{
+    if (m_hadc == nullptr || m_number < 1U || m_number > 3U)
+    {
+        return false;
+    }
+    ADC_AnalogWDGConfTypeDef config = {0};
+    config.WatchdogNumber = (m_number == 3U) ? ADC_ANALOGWATCHDOG_3
+                            : (m_number == 2U) ? ADC_ANALOGWATCHDOG_2 : ADC_ANALOGWATCHDOG_1;
+    config.WatchdogMode = ADC_ANALOGWATCHDOG_SINGLE_REG;
+    config.Channel = channel;
+    config.ITMode = ENABLE;
+    config.HighThreshold = 4095;
+    config.LowThreshold = 0;
+    config.FilteringConfig = ADC_AWD_FILTERING_NONE;
+    if (HAL_ADC_AnalogWDGConfig(m_hadc, &config) != HAL_OK)
+    {
+        return false;
+    }
+    __HAL_ADC_CLEAR_FLAG(m_hadc, m_flag);
+    return true;
+}
+
+/**
+ * @brief The threshold registers may be written while converting; the new
+ * window applies from the next conversion.
+ */
+void STM32_AnalogWatchdog::setWindow(uint16_t low, uint16_t high)
+{
+    ADC_TypeDef* adc = m_hadc->Instance;
+    if (m_number == 1U)
+    {
+        adc->TR1 = (adc->TR1 & ADC_TR1_AWDFILT) | ((uint32_t)high << ADC_TR1_HT1_Pos) | (uint32_t)low;
+    }
+    else
+    {
+        uint32_t tr = ((uint32_t)(high >> 4) << ADC_TR2_HT2_Pos) | (uint32_t)(low >> 4);
+        if (m_number == 2U)
+        {
+            adc->TR2 = tr;
+        }
+        else
+        {
+            adc->TR3 = tr;
+        }
+    }
+}
+
+void STM32_AnalogWatchdog::attach(Handler handler, void* context)
+{
+    m_context = context;
+    m_handler = handler;
+}
+
+void STM32_AnalogWatchdog::onIrq()
+{
+    if (!__HAL_ADC_GET_FLAG(m_hadc, m_flag))
+    {
+        return;
+    }
+    uint32_t now = Timebase::now_us();
+    __HAL_ADC_CLEAR_FLAG(m_hadc, m_flag);
+    if (m_handler != nullptr)
+    {
+        m_handler(m_context, (uint16_t)m_hadc->Instance->DR, now);
+    }
+}
 
 
 //               ANALOG OUTPUT (DAC) IMPLEMENTATION
 
+namespace {
+constexpr uint32_t kPacerMaxPeriod_us = 0x10000U; // 16-bit auto-reload at 1 MHz
+
+// Channel 2's bits in CR and SR sit 16 above channel 1's.
+uint32_t channelShift(uint32_t channel)
+{
+    return channel & 0x10U;
+}
+
+volatile uint32_t* holdingRegister(DAC_TypeDef* dac, uint32_t channel)
+{
+    return (channel == DAC_CHANNEL_1) ? &dac->DHR12R1 : &dac->DHR12R2;
+}
+}
+
 /**
- * @brief Constructor: Stores the DAC handle, channel, and starts the DAC.
+ * @brief Constructor: Stores the handles and starts the DAC. The pacer's
+ * trigger is selected here, while the channel is still off; it only takes
+ * effect once a block sets TEN.
  */
-STM32_AnalogOut::STM32_AnalogOut(DAC_HandleTypeDef* hdac, uint32_t channel, float divider_ratio)
+STM32_AnalogOut::STM32_AnalogOut(DAC_HandleTypeDef* hdac, uint32_t channel, float divider_ratio,
+                                 DMA_HandleTypeDef* blockDma, TIM_TypeDef* pacer, uint32_t pacerTrigger)
         : m_hdac(hdac),
           m_channel(channel),
-          m_divider_ratio(divider_ratio)
+          m_divider_ratio(divider_ratio),
+          m_countsPerVolt(4095.0f / (3.3f * divider_ratio)),
+          m_lastUpdate_us(0),
+          m_hdma(blockDma),
+          m_pacer(pacer),
+          m_blockActive(false),
+          m_blockStart_us(0),
+          m_blockLength_us(0),
+          m_block{}
 {
     if (m_hdac == nullptr)
     {
         Error_Handler();
     }
+    if (m_hdma != nullptr && m_pacer != nullptr)
+    {
+        uint32_t shift = channelShift(m_channel);
+        m_hdac->Instance->CR = (m_hdac->Instance->CR & ~(DAC_CR_TSEL1 << shift))
+                             | ((pacerTrigger & DAC_CR_TSEL1) << shift);
+    }
     // Start the DAC peripheral.
     HAL_DAC_Start(m_hdac, m_channel);
 }
@@ -90,6 +388,7 @@ STM32_AnalogOut::~STM32_AnalogOut()
 {
     if (m_hdac != nullptr)
     {
+        finishBlock();
         HAL_DAC_Stop(m_hdac, m_channel);
     }
 }
@@ -103,6 +402,7 @@ bool STM32_AnalogOut::setVoltage(float voltage)
     {
         return false;
     }
+    finishBlock();
 
     // 1. Scale the desired real-world voltage down to
     //    the DAC's 0-3.3V range.
@@ -122,9 +422,120 @@ bool STM32_AnalogOut::setVoltage(float voltage)
         Error_Handler();
         return false;
     }
+    m_lastUpdate_us = Timebase::now_us();
     return true;
 }
 
+/**
+ * @brief Converts volts to 12-bit codes, clamped to 0..4095.
+ */
+void STM32_AnalogOut::voltsToRaw(const float* src, uint16_t* dst, size_t count) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        float code = src[i] * m_countsPerVolt;
+        if (code < 0.0f) code = 0.0f;
+        if (code > 4095.0f) code = 4095.0f;
+        dst[i] = (uint16_t)code;
+    }
+}
+
+size_t STM32_AnalogOut::writeVoltageBlock(const float* src, size_t count, uint32_t period_us, SampleStamp* stamp)
+{
+    if (src == nullptr || count == 0U || count > kMaxBlock || isBlockPlaying())
+    {
+        return 0;
+    }
+    finishBlock();
+    voltsToRaw(src, m_block, count);
+    return playBlock(count, period_us, stamp);
+}
+
+size_t STM32_AnalogOut::writeRawBlock(const uint16_t* src, size_t count, uint32_t period_us, SampleStamp* stamp)
+{
+    if (src == nullptr || count == 0U || count > kMaxBlock || isBlockPlaying())
+    {
+        return 0;
+    }
+    finishBlock();
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_block[i] = (src[i] > 4095U) ? 4095U : src[i];
+    }
+    return playBlock(count, period_us, stamp);
+}
+
+bool STM32_AnalogOut::isBlockPlaying() const
+{
+    return m_blockActive && (Timebase::now_us() - m_blockStart_us) < m_blockLength_us;
+}
+
+/**
+ * @brief Plays m_block[0..count). The first code goes into the holding
+ * register with the trigger already on, so it waits for the first pacer
+ * update; the DMA then refills the register after every update.
+ */
+size_t STM32_AnalogOut::playBlock(size_t count, uint32_t period_us, SampleStamp* stamp)
+{
+    if (m_hdma == nullptr || m_pacer == nullptr || period_us == 0U || period_us > kPacerMaxPeriod_us)
+    {
+        return 0;
+    }
+    DAC_TypeDef* dac = m_hdac->Instance;
+    uint32_t shift = channelShift(m_channel);
+    volatile uint32_t* holding = holdingRegister(dac, m_channel);
+
+    // Reload the pacer before the trigger is on: UG raises TRGO too.
+    m_pacer->CR1 = 0U;
+    m_pacer->ARR = period_us - 1U;
+    m_pacer->CNT = 0U;
+    m_pacer->EGR = TIM_EGR_UG;
+    m_pacer->SR = 0U;
+
+    SET_BIT(dac->CR, DAC_CR_TEN1 << shift);
+    *holding = m_block[0];
+    if (count > 1U)
+    {
+        if (HAL_DMA_Start(m_hdma, (uint32_t)(uintptr_t)&m_block[1], (uint32_t)(uintptr_t)holding,
+                          count - 1U) != HAL_OK)
+        {
+            CLEAR_BIT(dac->CR, DAC_CR_TEN1 << shift);
+            return 0;
+        }
+        SET_BIT(dac->CR, DAC_CR_DMAEN1 << shift);
+    }
+    m_pacer->CR1 = TIM_CR1_CEN;
+
+    m_blockStart_us = Timebase::now_us();
+    m_blockLength_us = (uint32_t)count * period_us;
+    m_blockActive = true;
+    if (stamp != nullptr)
+    {
+        stamp->first_us = m_blockStart_us + period_us;
+        stamp->last_us = m_blockStart_us + m_blockLength_us;
+    }
+    return count;
+}
+
+/**
+ * @brief Back to software writes. Clearing TEN moves whatever the holding
+ * register has (the last sample, or the current one if cut short) to the
+ * output at once, so the output does not glitch.
+ */
+void STM32_AnalogOut::finishBlock()
+{
+    if (!m_blockActive)
+    {
+        return;
+    }
+    DAC_TypeDef* dac = m_hdac->Instance;
+    uint32_t shift = channelShift(m_channel);
+    m_pacer->CR1 = 0U;
+    CLEAR_BIT(dac->CR, (DAC_CR_DMAEN1 | DAC_CR_TEN1) << shift);
+    dac->SR = DAC_SR_DMAUDR1 << shift; // the pacer's update after the last sample finds no DMA
+    (void)HAL_DMA_Abort(m_hdma);
+    m_blockActive = false;
+}
 
 
 //               DIGITAL OUTPUT (GPIO) IMPLEMENTATION
@@ -135,7 +546,8 @@ bool STM32_AnalogOut::setVoltage(float voltage)
  */
 STM32_DigitalOut::STM32_DigitalOut(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState initialState)
         : m_port(port),
-          m_pin(pin)
+          m_pin(pin),
+          m_lastEdge_us(0)
 {
     if (m_port == nullptr)
     {
@@ -151,6 +563,7 @@ STM32_DigitalOut::STM32_DigitalOut(GPIO_TypeDef* port, uint16_t pin, GPIO_PinSta
 void STM32_DigitalOut::setHigh()
 {
     HAL_GPIO_WritePin(m_port, m_pin, GPIO_PIN_SET);
+    m_lastEdge_us = Timebase::now_us();
 }
 
 /**
@@ -159,6 +572,130 @@ void STM32_DigitalOut::setHigh()
 void STM32_DigitalOut::setLow()
 {
     HAL_GPIO_WritePin(m_port, m_pin, GPIO_PIN_RESET);
+    m_lastEdge_us = Timebase::now_us();
+}
+
+
+
+//               INTERNAL FLASH (HAL_FLASH) IMPLEMENTATION
+
+/**
+ * @brief Constructor: Stores the page range inside bank 2.
+ */
+STM32_FlashPages::STM32_FlashPages(uint32_t firstPage, uint32_t count)
+        : m_firstPage(firstPage),
+          m_count(count)
+{
+
+}
+
+uint32_t STM32_FlashPages::pageCount() const
+{
+    return m_count;
+}
+
+uint32_t STM32_FlashPages::pageSize() const
+{
+    return FLASH_PAGE_SIZE;
+}
+
+/**
+ * @brief Absolute address of a page (bank 2 starts half-way through flash).
+ */
+uint32_t STM32_FlashPages::address(uint32_t page) const
+{
+    return FLASH_BASE + FLASH_BANK_SIZE + ((m_firstPage + page) * FLASH_PAGE_SIZE);
+}
+
+const uint8_t* STM32_FlashPages::pageData(uint32_t page) const
+{
+    if (page >= m_count)
+    {
+        return nullptr;
+    }
+    return (const uint8_t*)address(page);
+}
+
+namespace {
+// Set around the loads in readDoubleWord(); the NMI handler only swallows a
+// double ECC error raised while it is set.
+volatile bool s_eccProbe = false;
+volatile bool s_eccError = false;
+}
+
+bool STM32_FlashPages::readDoubleWord(uint32_t page, uint32_t offset, uint64_t& value) const
+{
+    if (page >= m_count || offset > FLASH_PAGE_SIZE - 8U || (offset & 7U) != 0U)
+    {
+        return false;
+    }
+
+    const volatile uint32_t* word = (const volatile uint32_t*)(address(page) + offset);
+    s_eccError = false;
+    s_eccProbe = true;
+    uint32_t low = word[0];
+    uint32_t high = word[1];
+    __DSB();
+    __ISB(); // the NMI, if any, has run by now
+    s_eccProbe = false;
+
+    value = ((uint64_t)high << 32) | low;
+    return !s_eccError;
 }
 
+/**
+ * @brief Called first in NMI_Handler.
+ * @return 1 if the NMI was a double ECC error raised by readDoubleWord(),
+ * which is then cleared and reported to it; 0 for anything else.
+ */
+extern "C" int FlashPages_NMIHandler(void)
+{
+    uint32_t eccr = FLASH->ECCR;
+    if ((eccr & (FLASH_ECCR_ECCD | FLASH_ECCR_ECCD2)) == 0U || !s_eccProbe)
+    {
+        return 0;
+    }
+    // Write-1-to-clear: keep the enable bit, leave the correction flags alone.
+    FLASH->ECCR = (eccr & FLASH_ECCR_ECCIE) | FLASH_ECCR_ECCD | FLASH_ECCR_ECCD2;
+    s_eccError = true;
+    return 1;
+}
 
+/**
+ * @brief Erases one page of bank 2.
+ */
+bool STM32_FlashPages::erasePage(uint32_t page)
+{
+    if (page >= m_count)
+    {
+        return false;
+    }
+
+    FLASH_EraseInitTypeDef erase = {0};
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks = FLASH_BANK_2;
+    erase.Page = m_firstPage + page;
+    erase.NbPages = 1;
+    uint32_t pageError = 0;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &pageError);
+    HAL_FLASH_Lock();
+    return status == HAL_OK;
+}
+
+/**
+ * @brief Programs one 64-bit double-word.
+ */
+bool STM32_FlashPages::programDoubleWord(uint32_t page, uint32_t offset, uint64_t value)
+{
+    if (page >= m_count || offset >= FLASH_PAGE_SIZE || (offset & 7U) != 0U)
+    {
+        return false;
+    }
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address(page) + offset, value);
+    HAL_FLASH_Lock();
+    return status == HAL_OK;
+}
@@ -0,0 +1,329 @@
+/**
+ * @file Stm32Board.cpp
+ * @brief HAL handle setup and construction order of the rig drivers.
+ */
+
+#include "Stm32Board.h"
+#include "StaticInstance.h"
+
+namespace {
+
+ADC_HandleTypeDef s_hadc1;
+DAC_HandleTypeDef s_hdac1;
+DMA_HandleTypeDef s_hdmaSetpoint;
+ADC_HandleTypeDef s_hadc3;
+ADC_HandleTypeDef s_hadc4;
+DMA_HandleTypeDef s_hdmaPair;
+uint32_t s_pairBuffer[Stm32Board::kPairBufferLength];
+
+StaticInstance<OverpressureProtection> s_protection;
+StaticInstance<STM32_AnalogIn> s_feedback;
+StaticInstance<STM32_AnalogOut> s_setpointDac;
+StaticInstance<Stm32Board::Output> s_output;
+StaticInstance<STM32_AnalogPairIn> s_pressurePair;
+StaticInstance<STM32_AnalogWatchdog> s_pairWatchdogs[2];
+
+void initPins()
+{
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    GPIO_InitTypeDef gpio = {0};
+    gpio.Pin = GPIO_PIN_1 | GPIO_PIN_4;
+    gpio.Mode = GPIO_MODE_ANALOG;
+    gpio.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &gpio);
+}
+
+void initFeedbackAdc()
+{
+    __HAL_RCC_ADC12_CONFIG(RCC_ADC12CLKSOURCE_SYSCLK);
+    __HAL_RCC_ADC12_CLK_ENABLE();
+
+    s_hadc1.Instance = ADC1;
+    s_hadc1.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV4;
+    s_hadc1.Init.Resolution = ADC_RESOLUTION_12B;
+    s_hadc1.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+    s_hadc1.Init.GainCompensation = 0;
+    s_hadc1.Init.ScanConvMode = ADC_SCAN_DISABLE;
+    s_hadc1.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
+    s_hadc1.Init.LowPowerAutoWait = DISABLE;
+    s_hadc1.Init.ContinuousConvMode = DISABLE;
+    s_hadc1.Init.NbrOfConversion = 1;
+    s_hadc1.Init.DiscontinuousConvMode = DISABLE;
+    s_hadc1.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+    s_hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
+    s_hadc1.Init.DMAContinuousRequests = DISABLE;
+    s_hadc1.Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+    s_hadc1.Init.OversamplingMode = DISABLE;
+    if (HAL_ADC_Init(&s_hadc1) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    ADC_ChannelConfTypeDef channel = {0};
+    channel.Channel = Stm32Board::kFeedbackChannel;
+    channel.Rank = ADC_REGULAR_RANK_1;
+    channel.SamplingTime = ADC_SAMPLETIME_47CYCLES_5;
+    channel.SingleDiff = ADC_SINGLE_ENDED;
+    channel.OffsetNumber = ADC_OFFSET_NONE;
+    channel.Offset = 0;
+    if (HAL_ADC_ConfigChannel(&s_hadc1, &channel) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    if (HAL_ADCEx_Calibration_Start(&s_hadc1, ADC_SINGLE_ENDED) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+
+void initSetpointDac()
+{
+    __HAL_RCC_DAC1_CLK_ENABLE();
+
+    s_hdac1.Instance = DAC1;
+    if (HAL_DAC_Init(&s_hdac1) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    DAC_ChannelConfTypeDef channel = {0};
+    channel.DAC_HighFrequency = DAC_HIGH_FREQUENCY_INTERFACE_MODE_AUTOMATIC;
+    channel.DAC_DMADoubleDataMode = DISABLE;
+    channel.DAC_SignedFormat = DISABLE;
+    channel.DAC_SampleAndHold = DAC_SAMPLEANDHOLD_DISABLE;
+    channel.DAC_Trigger = DAC_TRIGGER_NONE;
+    channel.DAC_Trigger2 = DAC_TRIGGER_NONE;
+    channel.DAC_OutputBuffer = DAC_OUTPUTBUFFER_ENABLE;
+    channel.DAC_ConnectOnChipPeripheral = DAC_CHIPCONNECT_EXTERNAL;
+    channel.DAC_UserTrimming = DAC_TRIMMING_FACTORY;
+    if (HAL_DAC_ConfigChannel(&s_hdac1, &channel, Stm32Board::kSetpointChannel) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // Block writes: DMA1 CH2 feeds the holding register, one half-word per
+    // TIM4 update. Normal mode, interrupt off in the NVIC: the driver
+    // times the block itself.
+    __HAL_RCC_DMAMUX1_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    s_hdmaSetpoint.Instance = DMA1_Channel2;
+    s_hdmaSetpoint.Init.Request = DMA_REQUEST_DAC1_CHANNEL1;
+    s_hdmaSetpoint.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    s_hdmaSetpoint.Init.PeriphInc = DMA_PINC_DISABLE;
+    s_hdmaSetpoint.Init.MemInc = DMA_MINC_ENABLE;
+    s_hdmaSetpoint.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    s_hdmaSetpoint.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    s_hdmaSetpoint.Init.Mode = DMA_NORMAL;
+    s_hdmaSetpoint.Init.Priority = DMA_PRIORITY_MEDIUM;
+    if (HAL_DMA_Init(&s_hdmaSetpoint) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // TIM4 at 1 MHz, update -> TRGO; the driver sets the period per block.
+    __HAL_RCC_TIM4_CLK_ENABLE();
+    TIM4->CR1 = 0U;
+    TIM4->PSC = (HAL_RCC_GetPCLK1Freq() / 1000000U) - 1U;
+    TIM4->CR2 = TIM_CR2_MMS_1; // MMS = update
+    TIM4->SR = 0U;
+}
+
+void initPairAdc(ADC_HandleTypeDef& hadc, ADC_TypeDef* instance, uint32_t channel, uint32_t trigger)
+{
+    hadc.Instance = instance;
+    hadc.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV4;
+    hadc.Init.Resolution = ADC_RESOLUTION_12B;
+    hadc.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+    hadc.Init.GainCompensation = 0;
+    hadc.Init.ScanConvMode = ADC_SCAN_DISABLE;
+    hadc.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
+    hadc.Init.LowPowerAutoWait = DISABLE;
+    hadc.Init.ContinuousConvMode = DISABLE;
+    hadc.Init.NbrOfConversion = 1;
+    hadc.Init.DiscontinuousConvMode = DISABLE;
+    hadc.Init.ExternalTrigConv = trigger;
+    hadc.Init.ExternalTrigConvEdge = (trigger == ADC_SOFTWARE_START) ? ADC_EXTERNALTRIGCONVEDGE_NONE
+                                                                     : ADC_EXTERNALTRIGCONVEDGE_RISING;
+    hadc.Init.DMAContinuousRequests = ENABLE;
+    hadc.Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+    hadc.Init.OversamplingMode = DISABLE;
+    if (HAL_ADC_Init(&hadc) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // Same sampling time on both: the pair is then converted in lockstep.
+    ADC_ChannelConfTypeDef config = {0};
+    config.Channel = channel;
+    config.Rank = ADC_REGULAR_RANK_1;
+    config.SamplingTime = ADC_SAMPLETIME_47CYCLES_5;
+    config.SingleDiff = ADC_SINGLE_ENDED;
+    config.OffsetNumber = ADC_OFFSET_NONE;
+    config.Offset = 0;
+    if (HAL_ADC_ConfigChannel(&hadc, &config) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    if (HAL_ADCEx_Calibration_Start(&hadc, ADC_SINGLE_ENDED) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+
+/**
+ * @brief ADC3 master, ADC4 slave, regular simultaneous. The slave follows
+ * the master's trigger; its own trigger setting is ignored. DMA gets one
+ * 32-bit word per pair from the common data register. The DMA interrupt
+ * is left off in the NVIC: the reader polls the DMA counter.
+ */
+void initPressurePair()
+{
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    GPIO_InitTypeDef gpio = {0};
+    gpio.Pin = GPIO_PIN_1 | GPIO_PIN_12;
+    gpio.Mode = GPIO_MODE_ANALOG;
+    gpio.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOB, &gpio);
+
+    __HAL_RCC_DMAMUX1_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    s_hdmaPair.Instance = DMA1_Channel1;
+    s_hdmaPair.Init.Request = DMA_REQUEST_ADC3;
+    s_hdmaPair.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    s_hdmaPair.Init.PeriphInc = DMA_PINC_DISABLE;
+    s_hdmaPair.Init.MemInc = DMA_MINC_ENABLE;
+    s_hdmaPair.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    s_hdmaPair.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    s_hdmaPair.Init.Mode = DMA_CIRCULAR;
+    s_hdmaPair.Init.Priority = DMA_PRIORITY_HIGH;
+    if (HAL_DMA_Init(&s_hdmaPair) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    __HAL_RCC_ADC345_CONFIG(RCC_ADC345CLKSOURCE_SYSCLK);
+    __HAL_RCC_ADC345_CLK_ENABLE();
+    initPairAdc(s_hadc3, ADC3, Stm32Board::kPairChannelFirst, ADC_EXTERNALTRIG_T3_TRGO);
+    initPairAdc(s_hadc4, ADC4, Stm32Board::kPairChannelSecond, ADC_SOFTWARE_START);
+    s_hadc3.DMA_Handle = &s_hdmaPair;
+    s_hdmaPair.Parent = &s_hadc3;
+
+    ADC_MultiModeTypeDef multimode = {0};
+    multimode.Mode = ADC_DUALMODE_REGSIMULT;
+    multimode.DMAAccessMode = ADC_DMAACCESSMODE_12_10_BITS;
+    multimode.TwoSamplingDelay = ADC_TWOSAMPLINGDELAY_1CYCLE;
+    if (HAL_ADCEx_MultiModeConfigChannel(&s_hadc3, &multimode) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // TIM3 update -> TRGO, every kPairPeriod_us. Started after the DMA.
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    TIM3->CR1 = 0U;
+    TIM3->PSC = (HAL_RCC_GetPCLK1Freq() / 1000000U) - 1U;
+    TIM3->ARR = Stm32Board::kPairPeriod_us - 1U;
+    TIM3->CR2 = TIM_CR2_MMS_1; // MMS = update
+    TIM3->EGR = TIM_EGR_UG;
+    TIM3->SR = 0U;
+}
+
+} // namespace
+
+
+void Stm32Board::init()
+{
+    initPins();
+    initFeedbackAdc();
+    initSetpointDac();
+
+    OverpressureProtection& protection = s_protection.constructWith([] {
+        return OverpressureProtection(kOverpressure);
+    });
+    if (!protection.init(DAC1, kSetpointChannel))
+    {
+        Error_Handler();
+    }
+
+    s_feedback.constructWith([] {
+        return STM32_AnalogIn(&s_hadc1, kFeedbackMultiplier);
+    });
+    s_setpointDac.constructWith([] {
+        return STM32_AnalogOut(&s_hdac1, kSetpointChannel, kSetpointDivider, &s_hdmaSetpoint, TIM4,
+                               kSetpointTrigger);
+    });
+    s_output.constructWith([] {
+        return Stm32Board::Output(*s_setpointDac, *s_protection);
+    });
+
+    initPressurePair();
+    STM32_AnalogWatchdog& first = s_pairWatchdogs[0].constructWith([] {
+        return STM32_AnalogWatchdog(&s_hadc3, 1, kPairMultiplier);
+    });
+    STM32_AnalogWatchdog& second = s_pairWatchdogs[1].constructWith([] {
+        return STM32_AnalogWatchdog(&s_hadc4, 1, kPairMultiplier);
+    });
+    if (!first.init(kPairChannelFirst) || !second.init(kPairChannelSecond))
+    {
+        Error_Handler();
+    }
+    HAL_NVIC_SetPriority(ADC3_IRQn, kWatchdogIrqPriority, 0);
+    HAL_NVIC_SetPriority(ADC4_IRQn, kWatchdogIrqPriority, 0);
+    HAL_NVIC_EnableIRQ(ADC3_IRQn);
+    HAL_NVIC_EnableIRQ(ADC4_IRQn);
+
+    STM32_AnalogPairIn& pair = s_pressurePair.constructWith([] {
+        return STM32_AnalogPairIn(&s_hadc3, &s_hdmaPair, s_pairBuffer, kPairBufferLength, kPairPeriod_us,
+                                  kPairMultiplier);
+    });
+    if (!pair.start())
+    {
+        Error_Handler();
+    }
+    TIM3->CR1 = TIM_CR1_CEN;
+}
+
+Stm32Board::Feedback& Stm32Board::feedback()
+{
+    return *s_feedback;
+}
+
+Stm32Board::Output& Stm32Board::output()
+{
+    return *s_output;
+}
+
+OverpressureProtection& Stm32Board::protection()
+{
+    return *s_protection;
+}
+
+Stm32Board::PressurePair& Stm32Board::pressurePair()
+{
+    return *s_pressurePair;
+}
+
+Stm32Board::Watchdog& Stm32Board::pairWatchdog(uint32_t index)
+{
+    return *s_pairWatchdogs[(index != 0U) ? 1 : 0];
+}
+
+extern "C" void AnalogWatchdog_IRQHandler(void)
+{
+    for (StaticInstance<STM32_AnalogWatchdog>& watchdog : s_pairWatchdogs)
+    {
+        if (watchdog.isConstructed())
+        {
+            watchdog->onIrq();
+        }
+    }
+    // OVR is not enabled as an interrupt (STM32_AnalogPairIn::start()), but
+    // clear it anyway so a stray one can never re-enter this vector.
+    ADC_HandleTypeDef* const pairAdcs[] = {&s_hadc3, &s_hadc4};
+    for (ADC_HandleTypeDef* hadc : pairAdcs)
+    {
+        if (__HAL_ADC_GET_FLAG(hadc, ADC_FLAG_OVR))
+        {
+            __HAL_ADC_CLEAR_FLAG(hadc, ADC_FLAG_OVR);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+/**
+ * @file Timebase.cpp
+ * @brief TIM2 microsecond timebase and its host replacement.
+ */
+
+#include "Timebase.h"
+
+#if defined(USE_HAL_DRIVER)
+
+namespace {
+volatile uint32_t s_overflows = 0; // incremented by the TIM2 update IRQ
+}
+
+void Timebase::init()
+{
+    __HAL_RCC_TIM2_CLK_ENABLE();
+
+    uint32_t prescaler = (apb1TimerClock_hz() / 1000000U) - 1U;
+
+    TIM2->CR1 = 0U;
+    TIM2->PSC = prescaler;
+    TIM2->ARR = 0xFFFFFFFFU;
+    TIM2->CNT = 0U;
+    TIM2->EGR = TIM_EGR_UG;   // load PSC now
+    TIM2->SR = 0U;            // UG sets UIF, clear it
+    TIM2->DIER = TIM_DIER_UIE;
+    s_overflows = 0U;
+
+    // Above configMAX_SYSCALL_INTERRUPT_PRIORITY: the handler only counts,
+    // and must not be held off by kernel critical sections.
+    HAL_NVIC_SetPriority(TIM2_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+
+    TIM2->CR1 = TIM_CR1_CEN;
+}
+
+/**
+ * @brief Reads overflow count and counter consistently.
+ *
+ * If the counter wrapped but the IRQ has not run yet (we are in a higher
+ * priority ISR or interrupts are masked), UIF is still set and the low word
+ * is small: count that pending overflow ourselves.
+ */
+uint64_t Timebase::now_us64()
+{
+    uint32_t hi;
+    uint32_t lo;
+    uint32_t pending;
+    do
+    {
+        hi = s_overflows;
+        lo = TIM2->CNT;
+        pending = TIM2->SR & TIM_SR_UIF;
+    } while (hi != s_overflows);
+
+    if (pending != 0U && lo < 0x80000000U)
+    {
+        hi++;
+    }
+    return ((uint64_t)hi << 32) | lo;
+}
+
+void Timebase::onOverflowIrq()
+{
+    if ((TIM2->SR & TIM_SR_UIF) != 0U)
+    {
+        TIM2->SR = (uint32_t)~TIM_SR_UIF;
+        s_overflows = s_overflows + 1U;
+    }
+}
+
+extern "C" void Timebase_IRQHandler(void)
+{
+    Timebase::onOverflowIrq();
+}
+
+#else
+
+#include <chrono>
+
+namespace {
+Timebase::HostMode s_mode = Timebase::HostMode::Virtual;
+uint64_t s_virtual_us = 0;
+std::chrono::steady_clock::time_point s_start = std::chrono::steady_clock::now();
+}
+
+void Timebase::init()
+{
+    s_virtual_us = 0;
+    s_start = std::chrono::steady_clock::now();
+}
+
+void Timebase::setHostMode(HostMode mode)
+{
+    s_mode = mode;
+}
+
+Timebase::HostMode Timebase::hostMode()
+{
+    return s_mode;
+}
+
+void Timebase::advance(uint32_t us)
+{
+    if (s_mode == HostMode::Virtual)
+    {
+        s_virtual_us += us;
+    }
+}
+
+uint64_t Timebase::now_us64()
+{
+    if (s_mode == HostMode::Virtual)
+    {
+        return s_virtual_us;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - s_start;
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+uint32_t Timebase::now_us()
+{
+    return (uint32_t)now_us64();
+}
+
+#endif
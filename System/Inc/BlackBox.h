@@ -0,0 +1,176 @@
+#ifndef FIRMWARE_BLACKBOX_H
+#define FIRMWARE_BLACKBOX_H
+
+#pragma once
+
+/**
+ * @file BlackBox.h
+ * @brief Flash-backed recorder of beat summaries and pre-fault pressure.
+ *
+ * Storage is a ring of flash pages (IFlashPages). Every page starts with a
+ * header double-word holding a sequence number, so the newest page is found
+ * after reset and pages are reused strictly in order (even wear). The page
+ * after the current one is erased ahead of time, so moving to it never
+ * waits for an erase.
+ *
+ * Record layout, all 8-byte aligned:
+ *   header DW : magic, type, length in DWs, header check, payload CRC16, seq
+ *   payload   : type-specific, padded with 0xFF to a whole DW
+ * The header is programmed first. A record cut by power loss has a valid
+ * header but a bad CRC: readers skip it, and the writer resumes after its
+ * full length, so it never programs a double-word twice. A word torn by the
+ * cut can fail its ECC check; all reads of possibly torn content go through
+ * IFlashPages::readDoubleWord(), and a torn header ends its page. A record
+ * takes its sequence number only once its header is in flash.
+ *
+ * The control loop only touches RAM: logBeat() queues a summary and
+ * pushPressure() feeds the pre-fault ring. fault() freezes that ring.
+ * All flash work happens in service(), called from a low-priority task,
+ * a bounded number of double-words per call.
+ */
+
+#include "Interfaces/IFlashPages.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class BlackBox {
+public:
+    static constexpr uint32_t kPreFaultSamples = 1024; // raw pressure kept in RAM
+    static constexpr uint32_t kBeatQueue = 16;         // summaries waiting for flash
+    static constexpr uint32_t kDoubleWordsPerService = 32;
+    static constexpr uint32_t kSamplesPerRawRecord = 28;
+
+    enum RecordType : uint8_t {
+        RecordBeat = 1,
+        RecordRawPressure = 2,
+        RecordFault = 3
+    };
+
+#pragma pack(push, 1)
+    /**
+     * @brief One beat, quantised to 16 bytes.
+     */
+    struct BeatSummary {
+        uint32_t beat;
+        uint32_t t_ms;
+        uint16_t systolic_mbar;
+        uint16_t diastolic_mbar;
+        uint16_t mean_mbar;
+        uint16_t rate_cpm_x10; // heart rate, 0.1 beats/min
+    };
+
+    struct RawPressureHeader {
+        uint32_t t0_us;     // time of samples[0]
+        uint16_t period_us; // sample spacing
+        uint16_t count;
+    };
+
+    struct FaultInfo {
+        uint32_t t_us;
+        uint32_t code;
+    };
+#pragma pack(pop)
+
+    /**
+     * @brief A record as read back from flash.
+     */
+    struct RecordView {
+        uint8_t type;
+        uint16_t sequence;
+        const uint8_t* payload; // only safe to read if valid
+        uint32_t length; // payload bytes, padding included
+        bool valid;      // readable and CRC matched
+    };
+
+    /**
+     * @brief Read position for readNext().
+     */
+    struct Cursor {
+        uint32_t pageIndex; // 0 = oldest page
+        uint32_t offset;
+    };
+
+    /**
+     * @brief Constructor.
+     * @param flash Page ring to use, at least 2 pages.
+     * @param samplePeriod_us Spacing of pushPressure() calls.
+     */
+    BlackBox(IFlashPages& flash, uint16_t samplePeriod_us);
+
+    /**
+     * @brief Finds the newest page and the write position after a reset.
+     * @return false if the flash could not be prepared.
+     */
+    bool init();
+
+    /**
+     * @brief Queues one beat summary. Control loop, never blocks.
+     * @return false if the queue is full (summary dropped).
+     */
+    bool logBeat(const BeatSummary& summary);
+
+    /**
+     * @brief Adds a pressure sample to the pre-fault ring. Control loop.
+     */
+    void pushPressure(uint16_t mbar);
+
+    /**
+     * @brief Freezes the pre-fault ring and schedules it, plus a fault
+     * record, for writing. Safe from an ISR. Ignored while a previous fault
+     * is still being written.
+     */
+    void fault(uint32_t code);
+
+    /**
+     * @brief Does the pending flash work, bounded per call.
+     * @return true if more work is pending.
+     */
+    bool service();
+
+    /**
+     * @brief Iterates stored records, oldest first.
+     */
+    bool readNext(Cursor& cursor, RecordView& out) const;
+
+    uint32_t droppedBeats() const { return m_droppedBeats; }
+
+private:
+    bool appendRecord(uint8_t type, const void* payload, uint32_t length);
+    bool program(uint64_t value);
+    bool openNextPage();
+    bool eraseAhead();
+    bool writeFaultChunk();
+    uint32_t pageSequence(uint32_t page) const;
+    uint32_t recordsEnd(uint32_t page, uint16_t& nextSequence) const;
+
+    IFlashPages& m_flash;
+    uint16_t m_samplePeriod_us;
+
+    // Flash write position
+    uint32_t m_page;
+    uint32_t m_offset;
+    uint32_t m_pageSequence;
+    uint16_t m_recordSequence;
+    bool m_eraseAheadPending;
+    uint32_t m_budget; // double-words left in this service() call
+
+    // Beat queue: single producer (control task), single consumer (service)
+    BeatSummary m_beats[kBeatQueue];
+    std::atomic<uint32_t> m_beatHead;
+    std::atomic<uint32_t> m_beatTail;
+    uint32_t m_droppedBeats;
+
+    // Pre-fault ring
+    uint16_t m_samples[kPreFaultSamples];
+    std::atomic<uint32_t> m_sampleHead;
+    uint32_t m_lastSample_us;
+    std::atomic<bool> m_frozen;
+    uint32_t m_faultCode;
+    uint32_t m_faultTime_us;
+    uint32_t m_faultHead;    // m_sampleHead when frozen
+    uint32_t m_faultWritten; // samples already written out
+};
+
+#endif //FIRMWARE_BLACKBOX_H
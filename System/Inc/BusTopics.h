@@ -0,0 +1,50 @@
+#ifndef FIRMWARE_BUSTOPICS_H
+#define FIRMWARE_BUSTOPICS_H
+
+#pragma once
+
+/**
+ * @file BusTopics.h
+ * @brief The data bus topics. Add a topic here, define it in DataBus.cpp
+ * and list it in the registry there.
+ */
+
+#include "DataBus.h"
+#include "Interfaces/SampleBlock.h"
+
+namespace Bus {
+
+struct Pressure {
+    uint32_t t_us;
+    float bar;
+};
+
+struct Setpoint {
+    uint32_t t_us;
+    float bar;
+};
+
+struct Valves {
+    uint32_t t_us;
+    uint32_t openMask; // bit n = valve n open
+};
+
+constexpr uint32_t kBlockSamples = 64;
+
+/**
+ * @brief Raw pressure samples at block rate, for the analysis tasks.
+ */
+struct PressureBlock {
+    SampleStamp stamp;
+    uint32_t count;
+    float bar[kBlockSamples];
+};
+
+extern DataBus::Topic<Pressure> pressure;
+extern DataBus::Topic<Setpoint> setpoint;
+extern DataBus::Topic<Valves> valves;
+extern DataBus::HistoryTopic<PressureBlock, 4> pressureBlocks;
+
+} // namespace Bus
+
+#endif //FIRMWARE_BUSTOPICS_H
@@ -0,0 +1,208 @@
+#ifndef FIRMWARE_CYCLICEXECUTIVE_H
+#define FIRMWARE_CYCLICEXECUTIVE_H
+
+#pragma once
+
+/**
+ * @file CyclicExecutive.h
+ * @brief Time-triggered executive for the fast control loop.
+ *
+ * A static table of slots (acquire, filter, control, actuate, publish...)
+ * is run frame by frame from the TIM7 update, every frame_us. A slot runs
+ * in the frames where (frame % period) == offset, in table order, so the
+ * order and the rate of every step are fixed at build time. fits() checks
+ * the worst frame's budget sum against the frame length, for a
+ * static_assert next to the table.
+ *
+ * Mode::Interrupt runs the frame inside the TIM7 interrupt, at NVIC
+ * priority 2: above configMAX_SYSCALL_INTERRUPT_PRIORITY, so no kernel
+ * critical section or context switch delays it. Slots then must not call
+ * FreeRTOS; hand results to tasks through the DataBus. FreeRTOS keeps all
+ * the slower background tasks.
+ *
+ * Mode::Task runs the same table from a top-priority task woken by the
+ * interrupt (at the syscall priority), i.e. the usual task design. Both
+ * modes record the same numbers, so running each once compares them:
+ *   - release latency: TIM7 counter when the frame starts = time since the
+ *     timer fired. max - min is the release jitter.
+ *   - per-slot run time against its budget (overrun count, worst case),
+ *   - frame overruns: latency + frame time past the next release, and
+ *     frames missed altogether (Task mode).
+ * Tests/bench_cyclic_executive.cpp runs both modes against each other on
+ * the host, with a POSIX timer signal standing in for TIM7.
+ */
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class CyclicExecutive {
+public:
+    static constexpr uint32_t kMaxSlots = 8;
+    static constexpr uint32_t kMaxHyperperiod = 256; // frames checked by fits()
+    static constexpr uint32_t kRecordMagic = 0x43455845U; // "EXEC"
+    static constexpr uint32_t kMaxFrame_us = 0xFFFFU;      // RecordHeader::frame_us
+    static constexpr uint32_t kReadAttempts = 4;
+
+    using SlotFunction = void (*)(void* context);
+
+    enum class Mode : uint8_t {
+        Interrupt = 0,
+        Task = 1
+    };
+
+    struct Slot {
+        const char* name;
+        SlotFunction run;
+        void* context;
+        uint16_t period;    // runs every period frames, >= 1
+        uint16_t offset;    // in frame offset of each period
+        uint16_t budget_us; // longer is counted as an overrun
+    };
+
+#pragma pack(push, 1)
+    /**
+     * @brief Record header, followed by slotCount SlotRow entries.
+     */
+    struct RecordHeader {
+        uint32_t magic;          // kRecordMagic
+        uint8_t mode;            // Mode
+        uint8_t slotCount;
+        uint16_t frame_us;
+        uint32_t frames;
+        uint32_t frameOverruns;
+        uint32_t missedFrames;
+        uint16_t latencyMin_us;
+        uint16_t latencyMax_us;
+        uint16_t latencyMean_us;
+        uint16_t frameMax_us;    // longest frame, all slots
+    };
+
+    struct SlotRow {
+        uint32_t runs;
+        uint32_t overruns;
+        uint16_t budget_us;
+        uint16_t max_us;
+    };
+#pragma pack(pop)
+
+    /**
+     * @brief Worst-case sum of slot budgets in any frame of the
+     * hyperperiod is within @p frame_us.
+     */
+    static constexpr bool fits(const Slot* table, uint32_t count, uint32_t frame_us)
+    {
+        if (count == 0U || count > kMaxSlots)
+        {
+            return false;
+        }
+        uint32_t hyperperiod = 1;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (table[i].period == 0U || table[i].offset >= table[i].period || table[i].run == nullptr)
+            {
+                return false;
+            }
+            uint32_t a = hyperperiod;
+            uint32_t b = table[i].period;
+            while (b != 0U)
+            {
+                uint32_t t = a % b;
+                a = b;
+                b = t;
+            }
+            hyperperiod = hyperperiod / a * table[i].period;
+            if (hyperperiod > kMaxHyperperiod)
+            {
+                return false;
+            }
+        }
+        for (uint32_t frame = 0; frame < hyperperiod; ++frame)
+        {
+            uint32_t total = 0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                total += (frame % table[i].period == table[i].offset) ? table[i].budget_us : 0U;
+            }
+            if (total > frame_us)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @param frame_us minor frame length, 2..kMaxFrame_us; start() refuses
+     * anything else.
+     */
+    CyclicExecutive(const Slot* table, uint32_t count, uint32_t frame_us);
+
+    /**
+     * @brief Runs one frame. Called by the timer interrupt or the task;
+     * host builds call it directly.
+     * @param latency_us time since the frame was due.
+     * @param missed releases dropped since the last frame (a task that woke
+     * late runs only the latest one).
+     */
+    void runFrame(uint32_t latency_us, uint32_t missed = 0);
+
+    /**
+     * @brief Header and per-slot rows. Safe from any task.
+     * @return bytes written, 0 if @p len is too small or a frame was
+     * updating the stats for kReadAttempts tries (call again later).
+     */
+    size_t encode(uint8_t* buf, size_t len) const;
+
+#if defined(USE_HAL_DRIVER)
+    /**
+     * @brief Starts TIM7 (and in Task mode the frame task).
+     * @return false if the frame length is out of range, the table does
+     * not fit, or already started.
+     */
+    bool start(Mode mode);
+
+    /**
+     * @brief Stops TIM7. The frame task, if any, stays blocked.
+     */
+    void stop();
+
+    /**
+     * @param entry TIM7->CNT read as the vector's first statement.
+     */
+    void onTimerIrq(uint32_t entry);
+
+    static CyclicExecutive* instance() { return s_instance; }
+#endif
+
+private:
+    struct SlotStats {
+        uint32_t runs;
+        uint32_t overruns;
+        uint32_t max_us;
+    };
+
+    const Slot* m_table;
+    uint32_t m_count;
+    uint32_t m_frame_us;
+    Mode m_mode;
+
+    uint32_t m_frame; // frames run
+    SlotStats m_slots[kMaxSlots];
+    uint32_t m_frameOverruns;
+    uint32_t m_missedFrames;
+    uint32_t m_latencyMin_us;
+    uint32_t m_latencyMax_us;
+    uint64_t m_latencySum_us;
+    uint32_t m_frameMax_us;
+    std::atomic<uint32_t> m_seq; // odd while the stats are updated
+
+#if defined(USE_HAL_DRIVER)
+    static void frameTask(void* argument);
+
+    void* m_task;
+    static CyclicExecutive* s_instance;
+#endif
+};
+
+#endif //FIRMWARE_CYCLICEXECUTIVE_H
@@ -0,0 +1,329 @@
+#ifndef FIRMWARE_DATABUS_H
+#define FIRMWARE_DATABUS_H
+
+#pragma once
+
+/**
+ * @file DataBus.h
+ * @brief Lock-free publish/subscribe for pressure, setpoint, valve state
+ * and the like.
+ *
+ * A topic has one producer and any number of readers, none of which ever
+ * block each other, so nothing here can invert priorities around the
+ * control loop. Topics are statically declared (BusTopics.h) and listed
+ * in a registry for tools and telemetry.
+ *
+ * Topic<T> holds the latest value behind a seqlock: publish() makes the
+ * counter odd, copies, makes it even; read() copies and retries if the
+ * counter moved. Readers never see half of one publish and half of the
+ * next. The producer never waits, and neither does a reader: one that
+ * preempted the producer mid-publish would spin for ever waiting for an
+ * even counter, so read() gives up after kReadAttempts and returns false.
+ *
+ * HistoryTopic<T, Depth> keeps the last Depth values, each slot with its
+ * own sequence tagged with its publish index. A reader walks it with its
+ * own Cursor, so subscribers are independent. Large frames are not
+ * copied: the producer fills the slot in place (beginPublish() /
+ * endPublish()), and a reader can use it in place (peek()), then check
+ * with consume() that it was not overwritten in the meantime. A reader
+ * that falls more than Depth behind skips ahead and counts the dropped
+ * values.
+ *
+ * A T must be trivially copyable.
+ */
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+namespace DataBus {
+
+/**
+ * @brief What the registry knows about a topic, whatever its type.
+ */
+class TopicBase {
+public:
+    constexpr TopicBase(const char* name, uint16_t size, uint16_t depth)
+            : m_name(name),
+              m_size(size),
+              m_depth(depth),
+              m_publishes(0)
+    {
+    }
+
+    const char* name() const { return m_name; }
+    uint16_t size() const { return m_size; }   // bytes per value
+    uint16_t depth() const { return m_depth; } // 1 for latest-value topics
+    uint32_t publishes() const { return m_publishes.load(std::memory_order_acquire); }
+
+protected:
+    const char* m_name;
+    uint16_t m_size;
+    uint16_t m_depth;
+    std::atomic<uint32_t> m_publishes;
+};
+
+template <typename T>
+class Topic : public TopicBase {
+    static_assert(std::is_trivially_copyable<T>::value, "topics are copied with memcpy");
+
+public:
+    static constexpr uint32_t kReadAttempts = 4;
+
+    explicit constexpr Topic(const char* name)
+            : TopicBase(name, (uint16_t)sizeof(T), 1),
+              m_seq(0),
+              m_value{}
+    {
+    }
+
+    /**
+     * @brief Replaces the latest value. Single producer; ISR-safe.
+     */
+    void publish(const T& value)
+    {
+        uint32_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&m_value, &value, sizeof(T));
+        m_seq.store(seq + 2U, std::memory_order_release);
+        m_publishes.store(seq / 2U + 1U, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consistent copy of the latest value.
+     * @return false if nothing was published yet, or if a publish stayed
+     * in progress for kReadAttempts copies (the caller preempted the
+     * producer); @p out is then unspecified.
+     */
+    bool read(T& out) const
+    {
+        for (uint32_t attempt = 0; attempt < kReadAttempts; ++attempt)
+        {
+            uint32_t before = m_seq.load(std::memory_order_acquire);
+            if ((before & 1U) != 0U)
+            {
+                continue;
+            }
+            memcpy(&out, &m_value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_seq.load(std::memory_order_relaxed) == before)
+            {
+                return before != 0U;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Reads only if something was published since @p seen, which
+     * is then updated. Start @p seen at 0. A read that gave up leaves
+     * @p seen alone, so the value is picked up on the next call.
+     */
+    bool readIfNew(T& out, uint32_t& seen) const
+    {
+        uint32_t count = publishes();
+        if (count == seen || !read(out))
+        {
+            return false;
+        }
+        seen = count;
+        return true;
+    }
+
+private:
+    std::atomic<uint32_t> m_seq; // odd while being written
+    T m_value;
+};
+
+template <typename T, uint32_t Depth>
+class HistoryTopic : public TopicBase {
+    static_assert(std::is_trivially_copyable<T>::value, "topics are copied with memcpy");
+    static_assert(Depth >= 2U && Depth <= 0xFFFFU, "depth");
+
+public:
+    /**
+     * @brief A reader's position; one per subscriber.
+     */
+    struct Cursor {
+        uint32_t next = 0;    // publish index to read next
+        uint32_t dropped = 0; // values overwritten before they were read
+    };
+
+    explicit constexpr HistoryTopic(const char* name)
+            : TopicBase(name, (uint16_t)sizeof(T), (uint16_t)Depth),
+              m_slots{}
+    {
+    }
+
+    /**
+     * @brief Cursor for a new subscriber: starts with the next publish.
+     */
+    Cursor subscribe() const
+    {
+        Cursor cursor;
+        cursor.next = publishes();
+        return cursor;
+    }
+
+    /**
+     * @brief Slot to fill in place; call endPublish() when done. Single
+     * producer.
+     */
+    T& beginPublish()
+    {
+        uint32_t index = m_publishes.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[index % Depth];
+        slot.seq.store(2U * index + 1U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return slot.value;
+    }
+
+    void endPublish()
+    {
+        uint32_t index = m_publishes.load(std::memory_order_relaxed);
+        m_slots[index % Depth].seq.store(2U * index + 2U, std::memory_order_release);
+        m_publishes.store(index + 1U, std::memory_order_release);
+    }
+
+    void publish(const T& value)
+    {
+        memcpy(&beginPublish(), &value, sizeof(T));
+        endPublish();
+    }
+
+    /**
+     * @brief Consistent copy of the newest value.
+     * @return false if nothing was published yet.
+     */
+    bool latest(T& out) const
+    {
+        for (;;)
+        {
+            uint32_t count = publishes();
+            if (count == 0U)
+            {
+                return false;
+            }
+            if (copy(count - 1U, out))
+            {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * @brief Copies the next unread value.
+     * @return false if the reader is up to date.
+     */
+    bool next(Cursor& cursor, T& out) const
+    {
+        for (;;)
+        {
+            if (!catchUp(cursor))
+            {
+                return false;
+            }
+            if (copy(cursor.next, out))
+            {
+                cursor.next++;
+                return true;
+            }
+            cursor.dropped++; // overwritten while copying
+            cursor.next++;
+        }
+    }
+
+    /**
+     * @brief The next unread value, in place. Check it with consume()
+     * before trusting what was read from it.
+     * @return nullptr if the reader is up to date.
+     */
+    const T* peek(Cursor& cursor) const
+    {
+        if (!catchUp(cursor))
+        {
+            return nullptr;
+        }
+        return &m_slots[cursor.next % Depth].value;
+    }
+
+    /**
+     * @brief Moves past the value returned by peek().
+     * @return false if it was overwritten while in use: discard it.
+     */
+    bool consume(Cursor& cursor) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        bool intact = m_slots[cursor.next % Depth].seq.load(std::memory_order_relaxed)
+                      == 2U * cursor.next + 2U;
+        cursor.dropped += intact ? 0U : 1U;
+        cursor.next++;
+        return intact;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> seq; // 2 * index + 1 while written, + 2 when done
+        T value;
+    };
+
+    /**
+     * @brief Skips what has already been overwritten.
+     * @return false if nothing is left to read.
+     */
+    bool catchUp(Cursor& cursor) const
+    {
+        uint32_t count = publishes();
+        if (count - cursor.next > Depth - 1U)
+        {
+            // Older than Depth - 1 back: gone, or about to be.
+            uint32_t oldest = count - (Depth - 1U);
+            cursor.dropped += oldest - cursor.next;
+            cursor.next = oldest;
+        }
+        return cursor.next != count;
+    }
+
+    bool copy(uint32_t index, T& out) const
+    {
+        const Slot& slot = m_slots[index % Depth];
+        if (slot.seq.load(std::memory_order_acquire) != 2U * index + 2U)
+        {
+            return false;
+        }
+        memcpy(&out, &slot.value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.seq.load(std::memory_order_relaxed) == 2U * index + 2U;
+    }
+
+    Slot m_slots[Depth];
+};
+
+/**
+ * @brief Every topic declared in BusTopics.h.
+ */
+uint32_t topicCount();
+const TopicBase* topic(uint32_t index);
+const TopicBase* find(const char* name);
+
+struct Costs {
+    uint16_t publish_cycles;      // Topic<Bus::Pressure>::publish()
+    uint16_t read_cycles;         // Topic<Bus::Pressure>::read(), no retry
+    uint16_t blockPublish_cycles; // begin/endPublish() of a PressureBlock, no copy
+};
+
+/**
+ * @brief Measures the bus costs with the DWT cycle counter on scratch
+ * topics. Call after RuntimeStats::init() (which starts the counter);
+ * main() does so only in builds configured with -DMEASURE_COSTS=ON.
+ * Host builds report zeros; Tests/bench_data_bus.cpp times the host side.
+ */
+void measureCosts();
+Costs costs();
+
+} // namespace DataBus
+
+#endif //FIRMWARE_DATABUS_H
@@ -0,0 +1,171 @@
+#ifndef FIRMWARE_DEFERREDLOG_H
+#define FIRMWARE_DEFERREDLOG_H
+
+#pragma once
+
+/**
+ * @file DeferredLog.h
+ * @brief Binary logger that never formats on the target.
+ *
+ *   LOG_INFO("setpoint %f bar, valve %u", bar, valveIndex);
+ *
+ * The format string is placed in the ".logstr" section, which the linker
+ * script marks (INFO): it is kept in the ELF but never loaded into flash.
+ * Its offset in that section is the message ID. In a host build the
+ * section ("logstr" there) is loaded and relocated like any other, so the
+ * ID is taken relative to its start rather than from the address; the
+ * same decoder then reads host and target logs. A log call only stores
+ * the ID, a Timebase stamp and up to kMaxArgs raw 32-bit words (floats are
+ * bit-copied) into a lock-free ring, so it is a few dozen cycles and safe
+ * from any ISR.
+ *
+ * Errors and warnings go to their own ring, so a burst of debug output
+ * cannot push them out before they are drained.
+ *
+ * Tools/log_decode.py reads .logstr from the ELF and renders the drained
+ * records as text. Format specifiers are limited to integers (%d %i %u %x
+ * %X %c) and %f/%e/%g; strings cannot be logged by pointer. A pointer
+ * argument is logged as its address for %x, cut to the low 32 bits on a
+ * 64-bit host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_LEVEL_ERROR 0U
+#define LOG_LEVEL_WARN  1U
+#define LOG_LEVEL_INFO  2U
+#define LOG_LEVEL_DEBUG 3U
+
+/* Calls above this level compile to nothing. */
+#ifndef DEFERRED_LOG_LEVEL
+#define DEFERRED_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#ifndef DEFERRED_LOG_RECORDS
+#define DEFERRED_LOG_RECORDS 64U   /* per ring, power of two */
+#endif
+
+#if defined(USE_HAL_DRIVER)
+#define DEFERRED_LOG_SECTION ".logstr"
+#else
+/* No dot, so the linker defines __start_logstr. */
+#define DEFERRED_LOG_SECTION "logstr"
+extern "C" const char __start_logstr[];
+#endif
+
+namespace DeferredLog {
+
+constexpr uint32_t kMaxArgs = 4;
+constexpr uint32_t kChunkMagic = 0x44474F4CU; // "LOGD"
+
+#pragma pack(push, 1)
+struct Record {
+    uint32_t t_us;
+    uint32_t id;      // offset of the format string in .logstr
+    uint8_t level;
+    uint8_t argCount;
+    uint16_t reserved;
+    uint32_t args[kMaxArgs];
+};
+
+struct ChunkHeader {
+    uint32_t magic;   // kChunkMagic
+    uint16_t count;   // records following
+    uint16_t dropped; // records lost since the last chunk
+};
+#pragma pack(pop)
+
+/**
+ * @brief Stores one record. Use the LOG_* macros instead.
+ */
+void write(uint8_t level, uint32_t id, const uint32_t* args, uint32_t argCount);
+
+/**
+ * @brief Copies pending records (errors/warnings first) into @p buf as one chunk.
+ * Single reader only.
+ * @return Bytes written, 0 if nothing was pending.
+ */
+size_t drain(uint8_t* buf, size_t len);
+
+/**
+ * @brief Message ID of a format string: its offset in the string section.
+ */
+inline uint32_t messageId(const char* fmt)
+{
+#if defined(USE_HAL_DRIVER)
+    return (uint32_t)(uintptr_t)fmt; // .logstr is linked at address 0
+#else
+    return (uint32_t)(fmt - __start_logstr);
+#endif
+}
+
+/**
+ * @brief Argument to raw word. Floats keep their bit pattern.
+ */
+template <typename T>
+inline uint32_t toWord(T value)
+{
+    static_assert(sizeof(T) <= sizeof(uint32_t), "log arguments are limited to 32 bits");
+    return (uint32_t)value;
+}
+
+template <>
+inline uint32_t toWord<float>(float value)
+{
+    uint32_t word;
+    memcpy(&word, &value, sizeof(word));
+    return word;
+}
+
+template <>
+inline uint32_t toWord<double>(double value)
+{
+    return toWord<float>((float)value);
+}
+
+template <typename T>
+inline uint32_t toWord(T* value)
+{
+    return (uint32_t)(uintptr_t)value;
+}
+
+template <typename... Args>
+inline void log(uint8_t level, uint32_t id, Args... args)
+{
+    static_assert(sizeof...(Args) <= kMaxArgs, "too many log arguments");
+    const uint32_t words[sizeof...(Args) + 1] = {toWord(args)..., 0U};
+    write(level, id, words, sizeof...(Args));
+}
+
+} // namespace DeferredLog
+
+#define DEFERRED_LOG_(level, fmt, ...)                                                              \
+    do                                                                                              \
+    {                                                                                               \
+        __attribute__((section(DEFERRED_LOG_SECTION), used)) static const char log_fmt_[] = fmt;    \
+        DeferredLog::log((level), DeferredLog::messageId(log_fmt_), ##__VA_ARGS__);                 \
+    } while (0)
+
+#define LOG_ERROR(fmt, ...) DEFERRED_LOG_(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+#if DEFERRED_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) DEFERRED_LOG_(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) do { } while (0)
+#endif
+
+#if DEFERRED_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) DEFERRED_LOG_(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) do { } while (0)
+#endif
+
+#if DEFERRED_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) DEFERRED_LOG_(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) do { } while (0)
+#endif
+
+#endif //FIRMWARE_DEFERREDLOG_H
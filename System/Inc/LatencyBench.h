@@ -0,0 +1,130 @@
+#ifndef FIRMWARE_LATENCYBENCH_H
+#define FIRMWARE_LATENCYBENCH_H
+
+#pragma once
+
+/**
+ * @file LatencyBench.h
+ * @brief Interrupt and ISR-to-task latency benchmark for the current
+ * FreeRTOS configuration.
+ *
+ * TIM6 fires every 65536 CPU cycles (~385 us). With its prescaler at 1,
+ * its counter runs at the CPU clock and restarts at the update, so the
+ * counter value read first thing in the vector, before the RuntimeStats
+ * and TraceRecorder hooks, is the interrupt latency in cycles. For each
+ * signalling path the ISR then wakes the benchmark task (top priority)
+ * with a DWT cycle stamp, and the task records how long it took to run:
+ *   - Isr:          interrupt entry latency only,
+ *   - Semaphore:    xSemaphoreGiveFromISR -> xSemaphoreTake,
+ *   - Notification: vTaskNotifyGiveFromISR -> ulTaskNotifyTake,
+ *   - Queue:        xQueueSendFromISR -> xQueueReceive (the stamp is the item),
+ *   - StreamBuffer: xStreamBufferSendFromISR -> xStreamBufferReceive.
+ * Each path runs samplesPerPath times, one after the other, into a
+ * histogram.
+ *
+ * An interrupt that comes before the task has taken the previous event
+ * is not measured: the semaphore and the notification would merge the
+ * two into one wake-up, and the queue and stream buffer refuse it when
+ * full. The ISR counts these as missed, per path, so a slow task shows
+ * up as missed events rather than as a short histogram. encode() gives all of them; Tools/latency_report.py prints
+ * percentiles and the histograms.
+ *
+ * Whatever else is running adds to the numbers (kernel critical sections
+ * hold off the ISR, higher ISRs preempt both), so run it on the real
+ * task set. All kernel objects are static.
+ *
+ * Histogram is plain C++ and builds on the host; the benchmark itself is
+ * target only (there is no POSIX FreeRTOS port in this tree).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace LatencyBench {
+
+enum class Path : uint8_t {
+    Isr = 0,
+    Semaphore = 1,
+    Notification = 2,
+    Queue = 3,
+    StreamBuffer = 4
+};
+
+constexpr uint32_t kPathCount = 5;
+constexpr uint32_t kBuckets = 64;          // the last one collects everything above
+constexpr uint32_t kBucket_cycles = 32;    // ~0.19 us at 170 MHz
+constexpr uint32_t kRecordMagic = 0x4254414CU; // "LATB"
+
+class Histogram {
+public:
+    void reset();
+    void add(uint32_t cycles);
+
+    uint32_t count() const { return m_count; }
+    uint32_t min() const { return m_count > 0U ? m_min : 0U; }
+    uint32_t max() const { return m_max; }
+    uint32_t mean() const { return m_count > 0U ? (uint32_t)(m_sum / m_count) : 0U; }
+    uint16_t bucket(uint32_t index) const { return m_buckets[index]; }
+
+private:
+    uint32_t m_count = 0;
+    uint32_t m_min = UINT32_MAX;
+    uint32_t m_max = 0;
+    uint64_t m_sum = 0;
+    uint16_t m_buckets[kBuckets] = {};
+};
+
+#pragma pack(push, 1)
+/**
+ * @brief Record header, followed by pathCount PathRow entries.
+ */
+struct RecordHeader {
+    uint32_t magic;           // kRecordMagic
+    uint8_t pathCount;
+    uint8_t buckets;
+    uint16_t bucket_cycles;
+    uint32_t cpu_hz;
+    uint32_t samplesPerPath;
+};
+
+struct PathRow {
+    uint8_t path;             // Path
+    uint8_t reserved[3];
+    uint32_t count;
+    uint32_t missed;          // events not measured: coalesced or refused
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t mean_cycles;
+    uint16_t buckets[kBuckets];
+};
+#pragma pack(pop)
+
+#if defined(USE_HAL_DRIVER)
+
+/**
+ * @brief Starts the benchmark task; it runs every path once and stops.
+ * Call after osKernelInitialize(). RuntimeStats::init() must have started
+ * the DWT cycle counter.
+ * @return false if it is already running.
+ */
+bool start(uint32_t samplesPerPath);
+
+bool isDone();
+
+/**
+ * @brief Called from TIM6_DAC_IRQHandler.
+ * @param entry TIM6->CNT read as the vector's first statement.
+ */
+void onTimerIrq(uint32_t entry);
+
+#endif
+
+/**
+ * @brief Header and one row per path (zeros until the path has run).
+ * @return bytes written, 0 if @p len is too small.
+ */
+size_t encode(uint8_t* buf, size_t len);
+
+} // namespace LatencyBench
+
+#endif //FIRMWARE_LATENCYBENCH_H
@@ -0,0 +1,141 @@
+#ifndef FIRMWARE_MEMORYPOOLS_H
+#define FIRMWARE_MEMORYPOOLS_H
+
+#pragma once
+
+/**
+ * @file MemoryPools.h
+ * @brief Deterministic memory for the C++ layer: fixed-block pools and a
+ * boot-time arena, with the global operator new/delete routed to them.
+ *
+ * Newlib malloc (via _sbrk, 0x200 bytes of _Min_Heap_Size) takes an
+ * unbounded time and fragments. Here:
+ *   - Boot phase (until onSchedulerStart()): new takes from a monotonic
+ *     arena. Boot objects live forever; delete on them does nothing.
+ *   - Running, Mode::Pools (the firmware default): new takes a block from
+ *     the smallest pool that fits: O(1), a free-list pop under a short
+ *     interrupt lock, so it is ISR-safe. delete pushes it back.
+ *   - Running, Mode::Trap (MEMORY_POOLS_TRAP builds): any new is a bug. It
+ *     stores the size and the caller (lastTrap()) and calls
+ *     Error_Handler().
+ *
+ * Running out (pool empty, request too big, arena full) also ends in
+ * Error_Handler(): there is no malloc to fall back on. The nothrow forms
+ * return nullptr instead. So does a delete the pools refuse: a pointer
+ * into the middle of a block, a block already freed, or memory that never
+ * came from new. lastTrap() says which call it was.
+ *
+ * Over-aligned types (alignas above 8) go through the std::align_val_t
+ * forms of new/delete, routed the same way: pool blocks are aligned to
+ * their own size, so such a request takes a block of at least its
+ * alignment, and the arena pads up to it. Alignments above kMaxAlignment
+ * cannot be met and are treated like running out.
+ *
+ * FreeRTOS objects do not use new (static allocation, or pvPortMalloc on
+ * its own heap), nor does C code using malloc. Neither is affected.
+ *
+ * usage() / encode() give each pool's occupancy, peak and failures, so the
+ * block counts can be sized from a real run.
+ *
+ * Host builds keep the normal global new unless MEMORY_POOLS_ROUTE_NEW is
+ * defined, as for test_memory_pools, which then provides Error_Handler().
+ * The pools and the arena can also be used directly.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace MemoryPools {
+
+enum class Mode : uint8_t {
+    Pools = 0, // new after the scheduler starts is served from the pools
+    Trap = 1   // new after the scheduler starts is fatal
+};
+
+constexpr uint32_t kPoolCount = 5;
+constexpr size_t kMaxAlignment = 256; // the largest block size
+constexpr uint32_t kRecordMagic = 0x4C4F4F50U; // "POOL"
+
+#pragma pack(push, 1)
+/**
+ * @brief Record header, followed by poolCount PoolRow entries.
+ */
+struct RecordHeader {
+    uint32_t magic;        // kRecordMagic
+    uint8_t poolCount;
+    uint8_t mode;          // Mode
+    uint8_t running;       // 1 after onSchedulerStart()
+    uint8_t reserved;
+    uint32_t arenaSize;
+    uint32_t arenaUsed;
+    uint32_t arenaDeletes; // deletes of boot objects (ignored)
+    uint32_t badReleases;  // release() calls refused
+};
+
+struct PoolRow {
+    uint16_t blockSize;
+    uint16_t blocks;
+    uint16_t inUse;
+    uint16_t peak;
+    uint32_t allocations;
+    uint32_t failures;     // empty pool, or nothing big enough
+};
+#pragma pack(pop)
+
+/**
+ * @brief Ends the boot phase. Call just before osKernelStart().
+ */
+void onSchedulerStart(Mode mode);
+
+/**
+ * @brief Block from the smallest pool that fits @p size. Blocks are
+ * aligned to their size, so asking for max(size, alignment) also gives an
+ * aligned block.
+ * @return nullptr if none is free.
+ */
+void* allocate(size_t size);
+
+/**
+ * @brief Returns a block from allocate(). nullptr is a no-op.
+ * @return false, and the block is left alone, if @p block is not the
+ * start of a pool block that is handed out: already released, inside a
+ * block, or not pool memory at all (arena included). Counted in
+ * RecordHeader::badReleases.
+ */
+bool release(void* block);
+
+/**
+ * @brief Bump allocation from the boot arena, aligned to @p alignment (a
+ * power of two, at least 8). Never freed.
+ * @return nullptr if the arena is full.
+ */
+void* allocateBoot(size_t size, size_t alignment = 8);
+
+bool ownsPoolBlock(const void* pointer);
+bool ownsArenaBlock(const void* pointer);
+
+/**
+ * @brief The last new or delete that ended in Error_Handler().
+ */
+struct Trap {
+    size_t size;   // bytes asked for, 0 for a delete
+    void* caller;  // return address of operator new/delete
+    void* pointer; // the refused pointer, for a delete
+};
+
+Trap lastTrap();
+
+/**
+ * @brief Fills @p rows (kPoolCount entries) and returns the header.
+ */
+RecordHeader usage(PoolRow* rows);
+
+/**
+ * @brief Header and rows for the telemetry channel.
+ * @return bytes written, 0 if @p len is too small.
+ */
+size_t encode(uint8_t* buf, size_t len);
+
+} // namespace MemoryPools
+
+#endif //FIRMWARE_MEMORYPOOLS_H
@@ -0,0 +1,161 @@
+#ifndef FIRMWARE_RUNTIMESTATS_H
+#define FIRMWARE_RUNTIMESTATS_H
+
+#pragma once
+
+/**
+ * @file RuntimeStats.h
+ * @brief Per-task CPU accounting on the TIM2 microsecond timebase.
+ *
+ * FreeRTOS does the per-task run-time bookkeeping (configGENERATE_RUN_TIME_STATS
+ * with portGET_RUN_TIME_COUNTER_VALUE() = TIM2->CNT). This module adds:
+ *   - context-switch counts per task (traceTASK_SWITCHED_IN hook),
+ *   - ISR time, for ISRs wrapped in RuntimeStats_IsrEnter()/Exit(),
+ *   - three windows: last beat, last second, since boot,
+ *   - a compact binary record for the telemetry channel.
+ *
+ * Task run time includes any ISR time spent while that task was running;
+ * the ISR total is reported next to it, not subtracted from it.
+ *
+ * Cost: the switch hook and the ISR pair are a few loads/stores each,
+ * measured once at init() with the DWT cycle counter and sent in every
+ * record. onBeatBoundary()/onSecondTick() walk every task stack for the
+ * high-water mark, so they are O(tasks + stack size) and belong in a
+ * low-priority task: start() creates one that closes the second window on
+ * the timebase and the beat window after notifyBeat(), and encodes each.
+ *
+ * Counters live in kMaxTasks slots, claimed by a task on its first switch-in
+ * and freed when it is deleted. Tasks beyond that are left out of the rows,
+ * and the record says how many were (tasksOmitted).
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Called by the FreeRTOS traceTASK_SWITCHED_IN hook (FreeRTOSConfig.h). */
+void RuntimeStats_TaskSwitchedIn(uint32_t tcbNumber);
+
+/* Called by the FreeRTOS traceTASK_DELETE hook: frees the task's counter slot. */
+void RuntimeStats_TaskDeleted(uint32_t tcbNumber);
+
+/* Bracket an ISR body to count its time as ISR time. Nesting is handled. */
+void RuntimeStats_IsrEnter(void);
+void RuntimeStats_IsrExit(void);
+
+#ifdef __cplusplus
+}
+
+#include <stddef.h>
+
+// FreeRTOSConfig.h pulls this header in from inside FreeRTOS.h's extern "C"
+// block; keep the C++ API C++.
+extern "C++" {
+
+namespace RuntimeStats {
+
+constexpr uint32_t kMaxTasks = 12;
+constexpr uint8_t kRecordMagic = 0xC5;
+
+enum class Window : uint8_t {
+    LastBeat = 0,
+    LastSecond = 1,
+    SinceBoot = 2
+};
+
+/**
+ * @brief Receives each encoded record, from the stats task.
+ */
+using RecordSink = void (*)(void* context, const uint8_t* record, size_t length);
+
+#pragma pack(push, 1)
+/**
+ * @brief Record header, followed by taskCount TaskRow entries.
+ */
+struct RecordHeader {
+    uint8_t magic;            // kRecordMagic
+    uint8_t window;           // Window
+    uint8_t taskCount;
+    uint8_t timeShift;        // times below are in (1 << timeShift) us units
+    uint32_t window_time;     // length of the window
+    uint32_t isr_time;        // ISR time inside the window
+    uint16_t cpuLoad_permille;// 1000 - idle share
+    uint16_t hookCost_cycles; // measured cost of one switch hook
+    uint16_t isrCost_cycles;  // measured cost of one enter/exit pair
+    uint16_t sampleCost_us;   // cost of the last window snapshot
+    uint8_t tasksOmitted;     // tasks alive but not in the rows (saturates at 255)
+};
+
+struct TaskRow {
+    uint8_t taskNumber;       // FreeRTOS xTaskNumber (unique per TCB)
+    uint8_t priority;
+    uint16_t stackFree_words; // stack high-water mark
+    uint32_t run_time;        // in header units
+    uint32_t switches;        // times switched in
+};
+#pragma pack(pop)
+
+/**
+ * @brief Starts the ISR/switch counters and measures their cost.
+ * Call after Timebase::init(), before osKernelStart().
+ */
+void init();
+
+/**
+ * @brief Starts the low-priority stats task. Every closed window is encoded,
+ * kept for lastRecord() and passed to @p sink if one is given.
+ * Call after osKernelInitialize().
+ */
+void start(RecordSink sink = nullptr, void* context = nullptr);
+
+/**
+ * @brief Marks a beat boundary; the stats task closes the beat window at
+ * its next poll, up to 5 ms later. Only an atomic increment, no kernel
+ * call, so safe from any task or ISR, including those above
+ * configMAX_SYSCALL_INTERRUPT_PRIORITY. No-op on the host.
+ */
+#if defined(USE_HAL_DRIVER)
+void notifyBeat();
+#else
+inline void notifyBeat() {}
+#endif
+
+/**
+ * @brief The last record the stats task encoded for @p window (also easy to
+ * dump from RAM with the debugger).
+ * @param length Set to its size, 0 before the first one.
+ */
+const uint8_t* lastRecord(Window window, size_t* length);
+
+/**
+ * @brief Closes the "last beat" window. Called by the stats task, or
+ * directly at each beat boundary if start() is not used.
+ */
+void onBeatBoundary();
+
+/**
+ * @brief Closes the "last second" window. Called by the stats task, or
+ * directly once a second if start() is not used.
+ */
+void onSecondTick();
+
+/**
+ * @brief Serialises one window into @p buf.
+ * @return Bytes written, 0 if @p len is too small.
+ */
+size_t encode(Window window, uint8_t* buf, size_t len);
+
+/**
+ * @brief CPU load of a window in permille (1000 = never idle).
+ */
+uint16_t cpuLoad_permille(Window window);
+
+} // namespace RuntimeStats
+
+} // extern "C++"
+
+#endif
+
+#endif //FIRMWARE_RUNTIMESTATS_H
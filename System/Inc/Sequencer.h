@@ -0,0 +1,274 @@
+#ifndef FIRMWARE_SEQUENCER_H
+#define FIRMWARE_SEQUENCER_H
+
+#pragma once
+
+/**
+ * @file Sequencer.h
+ * @brief Stackless (C++20 coroutine) sequences run by one executor.
+ *
+ * Beat phases, valve sequences and calibration routines are written as
+ * straight-line code:
+ *
+ *   Sequence fillChamber(IPressureControl& regulator, ISolenoidValve& inlet)
+ *   {
+ *       inlet.activate();
+ *       regulator.setPressure(1.2f);
+ *       if (!co_await pressureReaches(regulator, 1.1f, 500000))
+ *       {
+ *           inlet.deactivate(); // no pressure after 500 ms
+ *           co_return;
+ *       }
+ *       co_await delay_ms(20);
+ *       inlet.deactivate();
+ *   }
+ *
+ *   sequencer.spawn(fillChamber(regulator, inlet));
+ *
+ * A suspended sequence is only its frame: the locals that live across a
+ * co_await, the promise and a few words of bookkeeping. Frames come from
+ * a static pool (kFrames blocks of kFrameSize bytes), never from the heap.
+ * When the pool is empty, the sequence function returns an empty Sequence
+ * and spawn() refuses it (get_return_object_on_allocation_failure).
+ *
+ * service() resumes every sequence whose wait is over and runs it to its
+ * next co_await, all on the caller's stack. So sequences must not block,
+ * and whatever a sequence does between two co_awaits delays the others.
+ * startTask() runs service() once per RTOS tick from one static task.
+ *
+ * RAM, compared with one task per sequence: a task needs its TCB (96 B)
+ * plus a stack sized for its deepest call chain, at least
+ * configMINIMAL_STACK_SIZE (512 B) and in practice 1 KB+ with floats and
+ * HAL calls; the 3 KB heap holds three or four of them. Here the executor
+ * task has one 1 KB stack and each sequence costs one pool block; stats()
+ * reports the largest frame actually requested, so kFrameSize can be
+ * trimmed to what the sequences need.
+ *
+ * Latency: a wait is checked on every service() call, so with the task it
+ * ends on the first tick at or after the deadline, as osDelay() would in
+ * a dedicated task. stats() keeps the worst resume lateness against the
+ * requested deadline. The difference is priority: all sequences share the
+ * executor's, where dedicated tasks could each have their own.
+ *
+ * Tests/bench_sequencer.cpp measures both designs on eight sequences.
+ */
+
+#include "Interfaces/IPressureControl.h"
+#include "ThresholdWatch.h"
+
+#include <atomic>
+#include <coroutine>
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(__cpp_impl_coroutine)
+#error "Sequencer.h needs coroutine support: build this translation unit with -fcoroutines"
+#endif
+
+class Sequencer;
+
+class Sequence {
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    /**
+     * @brief What a suspended sequence is waiting for, set by the awaiters
+     * and checked by Sequencer::service().
+     */
+    struct Wait {
+        enum class Kind : uint8_t {
+            None,    // resume on the next service()
+            Time,    // until duration_us have passed
+            Pressure, // until the source crosses target_bar, or timeout
+            Crossing  // until the watch fires, or timeout
+        };
+
+        Kind kind;
+        bool rising;            // Pressure: wait for >= target (else <=)
+        bool reached;           // Pressure, Crossing: result handed back to co_await
+        uint32_t start_us;
+        uint32_t duration_us;   // Time: delay, Pressure/Crossing: timeout (0 = none)
+        IPressureControl* source;
+        float target_bar;
+        ThresholdWatch* watch;
+        uint32_t firedBefore;   // Crossing: watch->fired() when armed
+    };
+
+    struct promise_type {
+        Wait wait{};
+
+        Sequence get_return_object() { return Sequence(Handle::from_promise(*this)); }
+        static Sequence get_return_object_on_allocation_failure() { return Sequence(); }
+        std::suspend_always initial_suspend() noexcept { return {}; } // starts in spawn()
+        std::suspend_always final_suspend() noexcept { return {}; }   // freed by the executor
+        void return_void() {}
+        void unhandled_exception() {} // built with -fno-exceptions
+
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* frame, size_t size) noexcept;
+    };
+
+    Sequence() : m_handle(nullptr) {}
+    Sequence(Sequence&& other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+    Sequence(const Sequence&) = delete;
+    Sequence& operator=(const Sequence&) = delete;
+    Sequence& operator=(Sequence&&) = delete;
+    ~Sequence()
+    {
+        if (m_handle)
+        {
+            m_handle.destroy(); // never spawned
+        }
+    }
+
+    /**
+     * @brief False if the frame could not be allocated.
+     */
+    bool valid() const { return static_cast<bool>(m_handle); }
+
+private:
+    friend class Sequencer;
+
+    explicit Sequence(Handle handle) : m_handle(handle) {}
+
+    Handle m_handle;
+};
+
+/**
+ * @brief co_await delay_ms(ms): resumes on the first service() at least
+ * @p ms after the co_await.
+ */
+struct DelayAwaiter {
+    uint32_t ms;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(Sequence::Handle handle) const noexcept;
+    void await_resume() const noexcept {}
+};
+
+/**
+ * @brief co_await pressureReaches(...): true once the pressure got there,
+ * false on timeout.
+ */
+struct PressureAwaiter {
+    IPressureControl& source;
+    float target_bar;
+    uint32_t timeout_us;
+
+    Sequence::Handle handle;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(Sequence::Handle suspended) noexcept;
+    bool await_resume() const noexcept { return handle.promise().wait.reached; }
+};
+
+/**
+ * @brief co_await crossing(...): true once the watch fired, false on
+ * timeout (the watch is then disarmed).
+ */
+struct CrossingAwaiter {
+    ThresholdWatch& watch;
+    ThresholdWatch::Edge edge;
+    float threshold_volts;
+    float hysteresis_volts;
+    uint32_t timeout_us;
+
+    Sequence::Handle handle;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(Sequence::Handle suspended) noexcept;
+    bool await_resume() const noexcept { return handle.promise().wait.reached; }
+};
+
+/**
+ * Whole milliseconds because that is what the executor can do: startTask()
+ * runs service() once per 1 ms RTOS tick, so a delay ends between @p ms
+ * and @p ms + 1 ticks after the co_await, like osDelay(). 0 resumes on the
+ * next service().
+ */
+inline DelayAwaiter delay_ms(uint32_t ms)
+{
+    return DelayAwaiter{ms};
+}
+
+/**
+ * @brief Waits until the measured pressure crosses @p target_bar, from
+ * whichever side it is on when the wait starts.
+ * @param timeout_us 0 = wait forever.
+ */
+inline PressureAwaiter pressureReaches(IPressureControl& source, float target_bar, uint32_t timeout_us)
+{
+    return PressureAwaiter{source, target_bar, timeout_us, nullptr};
+}
+
+/**
+ * @brief Arms @p watch and waits for the crossing, without reading the
+ * samples: service() only checks a counter. The sequence takes the event
+ * out of the watch's queue, so the watch should have no other consumer.
+ * @param timeout_us 0 = wait forever.
+ */
+inline CrossingAwaiter crossing(ThresholdWatch& watch, ThresholdWatch::Edge edge, float threshold_volts,
+                                float hysteresis_volts, uint32_t timeout_us)
+{
+    return CrossingAwaiter{watch, edge, threshold_volts, hysteresis_volts, timeout_us, nullptr};
+}
+
+class Sequencer {
+public:
+    static constexpr uint32_t kMaxSequences = 8;
+    static constexpr uint32_t kFrames = 8;
+    static constexpr size_t kFrameSize = 256;
+
+    struct Stats {
+        uint32_t resumes;
+        uint32_t completed;
+        uint32_t maxLateness_us;     // worst resume after a Time deadline
+        uint32_t framesInUse;
+        uint32_t framesHighWater;
+        uint32_t largestFrame_bytes; // largest frame requested, even if refused
+        uint32_t allocationFailures;
+    };
+
+    Sequencer();
+
+    /**
+     * @brief Takes over a sequence. It runs to its first co_await on the
+     * next service(). Safe from any task.
+     * @return false if the sequence is empty (pool exhausted) or all
+     * kMaxSequences slots are busy; the sequence is then destroyed.
+     */
+    bool spawn(Sequence&& sequence);
+
+    /**
+     * @brief Resumes every sequence whose wait is over.
+     * @return number of sequences still running.
+     */
+    uint32_t service();
+
+    Stats stats() const;
+
+#if defined(USE_HAL_DRIVER)
+    /**
+     * @brief Starts a static task calling service() every tick.
+     */
+    void startTask(int32_t priority);
+#endif
+
+private:
+    enum Slot : uint8_t {
+        Free,
+        Claimed, // spawn() is filling it in
+        Running
+    };
+
+    static bool isDue(Sequence::Wait& wait, uint32_t now);
+
+    Sequence::Handle m_handles[kMaxSequences];
+    std::atomic<uint8_t> m_slots[kMaxSequences];
+    uint32_t m_resumes;
+    uint32_t m_completed;
+    uint32_t m_maxLateness_us;
+};
+
+#endif //FIRMWARE_SEQUENCER_H
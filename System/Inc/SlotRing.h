@@ -0,0 +1,121 @@
+#ifndef FIRMWARE_SLOTRING_H
+#define FIRMWARE_SLOTRING_H
+
+#pragma once
+
+/**
+ * @file SlotRing.h
+ * @brief Lock-free ring of fixed-size records: any number of writers, one
+ * reader. TraceRecorder and DeferredLog both sit on it.
+ *
+ * A writer reserves an index with fetch_add, marks the slot busy
+ * (seq = 0), fills it and publishes it with seq = index + 1, so tasks and
+ * ISRs of any priority push without a critical section. When the ring is
+ * full the oldest records are overwritten. The reader copies a slot and
+ * re-checks seq to catch an overwrite that raced with the copy; records
+ * lost either way are counted, not silently skipped.
+ */
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+template <typename T, uint32_t Size>
+class SlotRing {
+public:
+    static_assert((Size & (Size - 1U)) == 0U, "SlotRing size must be a power of two");
+
+    /**
+     * @brief Stores one record; @p fill(T&) writes its fields into the slot.
+     */
+    template <typename Fill>
+    void push(Fill&& fill)
+    {
+        uint32_t index = m_head.fetch_add(1U, std::memory_order_relaxed);
+        Slot& slot = m_slots[index & kMask];
+
+        slot.seq.store(0U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        fill(slot.value);
+        slot.seq.store(index + 1U, std::memory_order_release);
+    }
+
+    /**
+     * @brief Moves up to @p capacity committed records into @p out, which
+     * may be unaligned (a byte buffer). Single reader only.
+     */
+    size_t pop(T* out, size_t capacity)
+    {
+        uint32_t end = m_head.load(std::memory_order_acquire);
+        if (end - m_tail > Size)
+        {
+            // The writers lapped us; everything older than one ring is gone.
+            m_dropped += (end - m_tail) - Size;
+            m_tail = end - Size;
+        }
+
+        size_t count = 0;
+        while (m_tail != end && count < capacity)
+        {
+            const Slot& slot = m_slots[m_tail & kMask];
+            uint32_t expected = m_tail + 1U;
+            uint32_t before = slot.seq.load(std::memory_order_acquire);
+            if (before == 0U || (int32_t)(before - expected) < 0)
+            {
+                break; // a writer has reserved this slot but not finished yet
+            }
+
+            T copy = slot.value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint32_t after = slot.seq.load(std::memory_order_relaxed);
+            if (before == expected && after == expected)
+            {
+                memcpy(&out[count], &copy, sizeof(T));
+                count++;
+            }
+            else
+            {
+                m_dropped++; // overwritten before or while we read it
+            }
+            m_tail++;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Records lost since the last takeDropped(). Reader only.
+     */
+    uint32_t dropped() const { return m_dropped; }
+
+    uint32_t takeDropped()
+    {
+        uint32_t dropped = m_dropped;
+        m_dropped = 0;
+        return dropped;
+    }
+
+    /**
+     * @brief Forgets everything pushed so far. Reader only.
+     */
+    void skipPending()
+    {
+        m_tail = m_head.load(std::memory_order_relaxed);
+        m_dropped = 0;
+    }
+
+private:
+    static constexpr uint32_t kMask = Size - 1U;
+
+    struct Slot {
+        std::atomic<uint32_t> seq{0}; // index + 1 once complete, 0 while being filled
+        T value{};
+    };
+
+    Slot m_slots[Size];
+    std::atomic<uint32_t> m_head{0}; // next index to hand out
+    uint32_t m_tail = 0;             // next index to read (reader only)
+    uint32_t m_dropped = 0;          // reader only
+};
+
+#endif //FIRMWARE_SLOTRING_H
@@ -0,0 +1,57 @@
+#ifndef FIRMWARE_STATICTHREAD_H
+#define FIRMWARE_STATICTHREAD_H
+
+#pragma once
+
+/**
+ * @file StaticThread.h
+ * @brief Control block and stack for one CMSIS-RTOS2 thread, in static
+ * storage, with the osThreadNew() call that uses them.
+ *
+ *   StaticThread<> s_thread;
+ *   if (s_thread.start("Spectrum", osPriorityIdle, spectrumTask, this) == nullptr)
+ *   {
+ *       Error_Handler();
+ *   }
+ *
+ * Target only: the host builds have no kernel.
+ */
+
+#if defined(USE_HAL_DRIVER)
+
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+
+template <uint32_t StackWords = 256>
+class StaticThread {
+public:
+    static constexpr uint32_t kStackWords = StackWords;
+
+    /**
+     * @brief Creates the thread on this storage. Call once, after
+     * osKernelInitialize().
+     * @return its id, nullptr if the kernel refused it.
+     */
+    osThreadId_t start(const char* name, osPriority_t priority, osThreadFunc_t function, void* argument)
+    {
+        osThreadAttr_t attributes = {};
+        attributes.name = name;
+        attributes.priority = priority;
+        attributes.cb_mem = &m_controlBlock;
+        attributes.cb_size = sizeof(m_controlBlock);
+        attributes.stack_mem = m_stack;
+        attributes.stack_size = sizeof(m_stack);
+        return osThreadNew(function, argument, &attributes);
+    }
+
+private:
+    StaticTask_t m_controlBlock;
+    StackType_t m_stack[StackWords];
+};
+
+#endif
+
+#endif //FIRMWARE_STATICTHREAD_H
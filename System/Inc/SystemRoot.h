@@ -0,0 +1,110 @@
+#ifndef FIRMWARE_SYSTEMROOT_H
+#define FIRMWARE_SYSTEMROOT_H
+
+#pragma once
+
+/**
+ * @file SystemRoot.h
+ * @brief Composition root: builds the driver graph once, in a fixed order,
+ * in static storage, and hands out the pieces by their concrete types.
+ *
+ *   System::init();                      // main(), before the kernel starts
+ *   System::start();                     // after osKernelInitialize()
+ *   System::regulator().setPressure(1.0f);
+ *
+ * Board is a compile-time description of the hardware (Stm32Board on the
+ * target, HostBoard on a PC): its types, its constexpr configuration and
+ * its own construction order. Everything is typed all the way down, and
+ * the peripheral classes are final, so regulator() -> DAC/ADC calls are
+ * direct, inlinable calls with no vtable in the path. Nothing is
+ * heap-allocated. The same application code compiles against either
+ * board.
+ *
+ * Modules that take IPressureControl& (SmithPredictor, WaveformPlayer, ...)
+ * still work: regulator() is one, at the cost of one indirect call at that
+ * seam.
+ *
+ * The spectrum analyser watches the pressure pair (ventricle on channel 0,
+ * aorta on channel 1). An EventScheduler event every kSpectrumFeed_us
+ * moves the pairs the board has collected into it; its own idle-priority
+ * task does the FFTs. It is the pair's only reader.
+ */
+
+#include "EventScheduler.h"
+#include "Interfaces/IAnalogPairSensor.h"
+#include "PressureRegulatorDriver.h"
+#include "SpectrumAnalyzer.h"
+#include "StaticInstance.h"
+
+template <typename Board>
+class SystemRoot {
+public:
+    using Regulator = BasicPressureRegulator<typename Board::Output, typename Board::Feedback>;
+
+    /**
+     * @brief Brings up the board, then the drivers built on it. Once.
+     */
+    static void init()
+    {
+        Board::init();
+        s_regulator.constructWith([] {
+            return Regulator(Board::output(), Board::feedback(), Board::kOverpressure.max_setpoint_bar);
+        });
+        s_spectrum.constructWith([] { return SpectrumAnalyzer(1e6f / (float)Board::kPairPeriod_us); });
+    }
+
+    /**
+     * @brief Starts what runs on its own: the analyser task (target only)
+     * and the event feeding it. After init() and osKernelInitialize().
+     */
+    static void start()
+    {
+#if defined(USE_HAL_DRIVER)
+        s_spectrum->startTask();
+#endif
+        EventScheduler::scheduleIn(kSpectrumFeed_us, feedSpectrum, nullptr);
+    }
+
+    static Regulator& regulator() { return *s_regulator; }
+    static SpectrumAnalyzer& spectrum() { return *s_spectrum; }
+    static typename Board::Feedback& feedback() { return Board::feedback(); }
+    static typename Board::Output& output() { return Board::output(); }
+
+    // 100 pairs at 10 kHz: well inside the board's pair buffer.
+    static constexpr uint32_t kSpectrumFeed_us = 10000;
+
+private:
+    /**
+     * @brief Moves the pairs collected since the last call into the
+     * analyser, then books the next call from this one's due time.
+     */
+    static void feedSpectrum(void*, uint32_t due_us)
+    {
+        auto& pair = Board::pressurePair();
+        float voltsPerCount = pair.voltsPerCount();
+        uint32_t pairs[32];
+        size_t count;
+        while ((count = pair.readPairs(pairs, 32)) > 0U)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                s_spectrum->pushSample(0, (float)PackedPair::first(pairs[i]) * voltsPerCount);
+                s_spectrum->pushSample(1, (float)PackedPair::second(pairs[i]) * voltsPerCount);
+            }
+        }
+        EventScheduler::schedule(due_us + kSpectrumFeed_us, feedSpectrum, nullptr);
+    }
+
+    static inline StaticInstance<Regulator> s_regulator;
+    static inline StaticInstance<SpectrumAnalyzer> s_spectrum;
+};
+
+#if defined(USE_HAL_DRIVER)
+#include "Stm32Board.h"
+using System = SystemRoot<Stm32Board>;
+#else
+#include "HostBoard.h"
+using System = SystemRoot<HostBoard>;
+#endif
+
+#endif //FIRMWARE_SYSTEMROOT_H
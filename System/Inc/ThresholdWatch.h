@@ -0,0 +1,115 @@
+#ifndef FIRMWARE_THRESHOLDWATCH_H
+#define FIRMWARE_THRESHOLDWATCH_H
+
+#pragma once
+
+/**
+ * @file ThresholdWatch.h
+ * @brief Threshold crossings (end of ejection, start of filling...) from
+ * an ADC analog watchdog, without reading the samples.
+ *
+ * arm() sets up one crossing; the watchdog window is placed so that the
+ * hardware only interrupts at that crossing, and the window is then opened
+ * up again. So the CPU sees one or two interrupts per arm(), not one per
+ * sample, and the beat sequencer re-arms for the next phase.
+ *
+ * With hysteresis, a crossing only counts if the signal first was at least
+ * hysteresis_volts on the other side: the watch primes (window on the far
+ * side) and then arms (window at the threshold). Noise around the
+ * threshold, or a signal already past it when armed, does not fire. With
+ * 0 hysteresis the watch arms straight away and fires on the first sample
+ * past the threshold, already being there included.
+ *
+ * Events carry the interrupt's timestamp and go into a small queue read by
+ * one task with poll(), or wait() which sleeps until an event arrives. On
+ * the target the handler runs in the ADC interrupt (NVIC priority 5).
+ */
+
+#include "Interfaces/IAnalogWatchdog.h"
+
+#include <atomic>
+#include <stdint.h>
+
+class ThresholdWatch {
+public:
+    static constexpr uint32_t kQueueDepth = 8;
+    static constexpr uint32_t kEventFlag = 0x0100U; // thread flag set by the event
+
+    enum class Edge : uint8_t {
+        Rising,
+        Falling
+    };
+
+    struct Event {
+        uint32_t time_us;
+        uint16_t counts;
+        Edge edge;
+    };
+
+    /**
+     * @brief Attaches to @p watchdog and leaves it idle.
+     */
+    explicit ThresholdWatch(IAnalogWatchdog& watchdog);
+
+    /**
+     * @brief Watches for one crossing of @p threshold_volts. Replaces
+     * whatever was armed. Safe from any task.
+     */
+    void arm(Edge edge, float threshold_volts, float hysteresis_volts);
+
+    /**
+     * @brief Stops watching.
+     */
+    void disarm();
+
+    bool isArmed() const { return m_state.load(std::memory_order_acquire) != State::Idle; }
+
+    /**
+     * @brief Takes the oldest event, if any. One consumer.
+     */
+    bool poll(Event& event);
+
+    /**
+     * @brief Crossings seen so far, queued or not.
+     */
+    uint32_t fired() const { return m_fired.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Events dropped because the queue was full.
+     */
+    uint32_t lost() const { return m_lost; }
+
+#if defined(USE_HAL_DRIVER)
+    /**
+     * @brief Sleeps until an event arrives (kEventFlag), then takes it.
+     * @return false on timeout.
+     */
+    bool wait(Event& event, uint32_t timeout_ms);
+#endif
+
+private:
+    enum class State : uint8_t {
+        Idle,
+        Priming, // waiting to be hysteresis past the threshold, on the start side
+        Armed    // waiting for the crossing
+    };
+
+    static void onWindow(void* context, uint16_t counts, uint32_t time_us);
+    void handle(uint16_t counts, uint32_t time_us);
+    void placeWindow();
+
+    IAnalogWatchdog& m_watchdog;
+    std::atomic<State> m_state;
+    Edge m_edge;
+    uint16_t m_threshold;  // counts
+    uint16_t m_primeLevel; // counts, threshold -/+ hysteresis
+
+    Event m_queue[kQueueDepth];
+    std::atomic<uint32_t> m_head; // written by the handler
+    std::atomic<uint32_t> m_tail; // written by the consumer
+    std::atomic<uint32_t> m_fired;
+    uint32_t m_lost;
+    void* m_waiter; // task in wait(), if any
+};
+
+#endif //FIRMWARE_THRESHOLDWATCH_H
@@ -0,0 +1,129 @@
+#ifndef FIRMWARE_TRACERECORDER_H
+#define FIRMWARE_TRACERECORDER_H
+
+#pragma once
+
+/**
+ * @file TraceRecorder.h
+ * @brief Kernel event trace into a lock-free RAM ring.
+ *
+ * The FreeRTOS trace macros (FreeRTOSConfig.h) and the ISR wrappers in
+ * stm32g4xx_it.c call the C hooks below. Each event is 8 bytes
+ * (timestamp + type + object + payload) stamped with Timebase::now_us().
+ *
+ * The ring is a SlotRing (SlotRing.h): writers reserve a slot with one
+ * atomic fetch_add and publish it by writing the slot sequence last, so
+ * tasks and ISRs of any priority can record without a critical section. When the ring is full the oldest
+ * events are overwritten; the single reader (drain()) notices and counts
+ * them as dropped.
+ *
+ * Drained chunks are converted on the PC by Tools/trace_to_chrome.py into
+ * Chrome trace JSON, which chrome://tracing and Perfetto both open.
+ * Nothing here depends on the ARM port, so the same recorder runs under a
+ * host build with the Timebase host clock.
+ */
+
+#include <stdint.h>
+
+#ifndef TRACE_RECORDER_EVENTS
+#define TRACE_RECORDER_EVENTS 256U   /* ring size, power of two */
+#endif
+
+/* Event types, shared with Tools/trace_to_chrome.py */
+#define TRACE_EVT_TASK_SWITCH      1U   /* object = task number */
+#define TRACE_EVT_ISR_ENTER        2U   /* object = ISR id */
+#define TRACE_EVT_ISR_EXIT         3U   /* object = ISR id */
+#define TRACE_EVT_QUEUE_SEND       4U   /* object = queue number */
+#define TRACE_EVT_QUEUE_RECEIVE    5U
+#define TRACE_EVT_QUEUE_BLOCK      6U   /* blocked on receive */
+#define TRACE_EVT_NOTIFY           7U   /* object = target task number */
+#define TRACE_EVT_NOTIFY_WAIT      8U   /* object = waiting task number */
+#define TRACE_EVT_USER             9U   /* object/payload chosen by the caller */
+
+#define TRACE_FROM_ISR             0x80U /* OR-ed into the type */
+
+/* ISR ids */
+#define TRACE_ISR_HAL_TICK         1U
+#define TRACE_ISR_TIMEBASE         2U
+#define TRACE_ISR_OVERPRESSURE     3U   /* reserved: the priority-0 trip is not traced */
+#define TRACE_ISR_EXECUTIVE        4U
+#define TRACE_ISR_LATENCY_BENCH    5U
+#define TRACE_ISR_ANALOG_WATCHDOG  6U
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void TraceRecorder_Record(uint8_t type, uint8_t object, uint16_t payload);
+void TraceRecorder_TaskCreated(uint32_t taskNumber, const char* name);
+uint32_t TraceRecorder_NextQueueNumber(void);
+
+#define TraceRecorder_IsrEnter(id) TraceRecorder_Record(TRACE_EVT_ISR_ENTER, (id), 0U)
+#define TraceRecorder_IsrExit(id)  TraceRecorder_Record(TRACE_EVT_ISR_EXIT, (id), 0U)
+
+#ifdef __cplusplus
+}
+
+#include <stddef.h>
+
+// FreeRTOSConfig.h pulls this header in from inside FreeRTOS.h's extern "C"
+// block; keep the C++ API C++.
+extern "C++" {
+
+namespace TraceRecorder {
+
+constexpr uint32_t kChunkMagic = 0x45435254U; // "TRCE"
+constexpr uint16_t kChunkEvents = 1;
+constexpr uint16_t kChunkTaskNames = 2;
+constexpr uint32_t kMaxTaskNames = 16;
+constexpr uint32_t kNameLength = 16;
+
+#pragma pack(push, 1)
+struct Event {
+    uint32_t t_us;
+    uint8_t type;
+    uint8_t object;
+    uint16_t payload;
+};
+
+/**
+ * @brief Every drained chunk starts with this header.
+ */
+struct ChunkHeader {
+    uint32_t magic;   // kChunkMagic
+    uint16_t kind;    // kChunkEvents / kChunkTaskNames
+    uint16_t count;   // entries following
+    uint32_t dropped; // events lost to overwrite since the last chunk
+};
+
+struct TaskName {
+    uint8_t taskNumber;
+    char name[kNameLength];
+};
+#pragma pack(pop)
+
+/**
+ * @brief Starts recording. Safe to call before the scheduler.
+ */
+void start();
+void stop();
+
+/**
+ * @brief Copies committed events into @p buf as one kChunkEvents chunk.
+ * Single reader only.
+ * @return Bytes written (0 if nothing to drain or @p len too small).
+ */
+size_t drain(uint8_t* buf, size_t len);
+
+/**
+ * @brief Writes the task-number to name table as a kChunkTaskNames chunk.
+ */
+size_t encodeTaskNames(uint8_t* buf, size_t len);
+
+} // namespace TraceRecorder
+
+} // extern "C++"
+
+#endif
+
+#endif //FIRMWARE_TRACERECORDER_H
@@ -0,0 +1,453 @@
+/**
+ * @file BlackBox.cpp
+ * @brief Page ring, record format and recovery of the black-box recorder.
+ */
+
+#include "BlackBox.h"
+#include "Timebase.h"
+
+#include <string.h>
+
+namespace {
+
+constexpr uint32_t kPageMagic = 0x31584242U; // "BBX1"
+constexpr uint8_t kRecordMagic = 0xB5U;
+constexpr uint64_t kErased = 0xFFFFFFFFFFFFFFFFULL;
+constexpr uint32_t kPageHeaderSize = 8U;
+constexpr uint32_t kMaxPayload = sizeof(BlackBox::RawPressureHeader)
+                                 + BlackBox::kSamplesPerRawRecord * sizeof(uint16_t);
+static_assert(kMaxPayload % 8U == 0U, "largest payload should fill whole double-words");
+
+uint16_t crc16(const uint8_t* data, uint32_t length, uint16_t crc = 0xFFFFU)
+{
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint32_t bit = 0; bit < 8U; ++bit)
+        {
+            crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint64_t loadDoubleWord(const uint8_t* data, uint32_t offset)
+{
+    uint64_t value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+struct RecordHeader {
+    uint8_t magic;
+    uint8_t type;
+    uint8_t lengthDW; // whole record, header included
+    uint8_t check;
+    uint16_t crc;
+    uint16_t sequence;
+
+    uint8_t computeCheck() const
+    {
+        return (uint8_t)(magic ^ type ^ lengthDW ^ (crc & 0xFFU) ^ (crc >> 8)
+                         ^ (sequence & 0xFFU) ^ (sequence >> 8) ^ 0x5AU);
+    }
+
+    bool isValid() const
+    {
+        return magic == kRecordMagic && lengthDW >= 1U && check == computeCheck();
+    }
+};
+static_assert(sizeof(RecordHeader) == 8U, "record header must be one double-word");
+
+} // namespace
+
+
+BlackBox::BlackBox(IFlashPages& flash, uint16_t samplePeriod_us)
+        : m_flash(flash),
+          m_samplePeriod_us(samplePeriod_us),
+          m_page(0),
+          m_offset(kPageHeaderSize),
+          m_pageSequence(0),
+          m_recordSequence(0),
+          m_eraseAheadPending(true),
+          m_budget(0),
+          m_beats{},
+          m_beatHead(0),
+          m_beatTail(0),
+          m_droppedBeats(0),
+          m_samples{},
+          m_sampleHead(0),
+          m_lastSample_us(0),
+          m_frozen(false),
+          m_faultCode(0),
+          m_faultTime_us(0),
+          m_faultHead(0),
+          m_faultWritten(0)
+{
+
+}
+
+uint32_t BlackBox::pageSequence(uint32_t page) const
+{
+    uint64_t header;
+    if (!m_flash.readDoubleWord(page, 0, header) || (uint32_t)header != kPageMagic)
+    {
+        return 0; // erased, foreign, or a header torn by a reset
+    }
+    return (uint32_t)(header >> 32);
+}
+
+/**
+ * @brief Offset just past the last record of a page, skipping torn records
+ * by their declared length. @p nextSequence is left alone if the page holds
+ * no records.
+ */
+uint32_t BlackBox::recordsEnd(uint32_t page, uint16_t& nextSequence) const
+{
+    uint32_t size = m_flash.pageSize();
+    uint32_t offset = kPageHeaderSize;
+    while (offset + 8U <= size)
+    {
+        uint64_t raw;
+        if (!m_flash.readDoubleWord(page, offset, raw))
+        {
+            return size; // torn header: nothing after it can be trusted
+        }
+        if (raw == kErased)
+        {
+            return offset;
+        }
+        RecordHeader header;
+        memcpy(&header, &raw, sizeof(header));
+        if (!header.isValid())
+        {
+            return size; // unknown content: treat the page as full
+        }
+        nextSequence = (uint16_t)(header.sequence + 1U);
+        offset += header.lengthDW * 8U;
+    }
+    return size;
+}
+
+bool BlackBox::init()
+{
+    uint32_t count = m_flash.pageCount();
+    if (count < 2U)
+    {
+        return false;
+    }
+
+    uint32_t best = 0;
+    uint32_t bestSequence = 0;
+    for (uint32_t page = 0; page < count; ++page)
+    {
+        uint32_t sequence = pageSequence(page);
+        if (sequence != 0xFFFFFFFFU && sequence > bestSequence)
+        {
+            bestSequence = sequence;
+            best = page;
+        }
+    }
+
+    if (bestSequence == 0U)
+    {
+        // Blank or foreign content: start the ring on page 0.
+        m_page = count - 1U;
+        m_pageSequence = 0;
+        m_eraseAheadPending = true;
+        m_budget = 1;
+        return openNextPage();
+    }
+
+    m_page = best;
+    m_pageSequence = bestSequence;
+    // The newest page may hold no record yet: carry the sequence on from
+    // the page before it.
+    uint32_t previous = (best + count - 1U) % count;
+    if (pageSequence(previous) == bestSequence - 1U)
+    {
+        recordsEnd(previous, m_recordSequence);
+    }
+    m_offset = recordsEnd(best, m_recordSequence);
+    m_eraseAheadPending = true;
+    return true;
+}
+
+bool BlackBox::logBeat(const BeatSummary& summary)
+{
+    uint32_t head = m_beatHead.load(std::memory_order_relaxed);
+    if (head - m_beatTail.load(std::memory_order_acquire) >= kBeatQueue)
+    {
+        m_droppedBeats++;
+        return false;
+    }
+    m_beats[head % kBeatQueue] = summary;
+    m_beatHead.store(head + 1U, std::memory_order_release);
+    return true;
+}
+
+void BlackBox::pushPressure(uint16_t mbar)
+{
+    if (m_frozen.load(std::memory_order_acquire))
+    {
+        return; // keep the pre-fault window intact until it is in flash
+    }
+    uint32_t head = m_sampleHead.load(std::memory_order_relaxed);
+    m_samples[head % kPreFaultSamples] = mbar;
+    m_lastSample_us = Timebase::now_us();
+    m_sampleHead.store(head + 1U, std::memory_order_release);
+}
+
+void BlackBox::fault(uint32_t code)
+{
+    if (m_frozen.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    m_faultCode = code;
+    m_faultTime_us = Timebase::now_us();
+    m_faultHead = m_sampleHead.load(std::memory_order_acquire);
+    m_faultWritten = 0;
+    m_frozen.store(true, std::memory_order_release);
+}
+
+bool BlackBox::eraseAhead()
+{
+    uint32_t next = (m_page + 1U) % m_flash.pageCount();
+    uint32_t size = m_flash.pageSize();
+    for (uint32_t offset = 0; offset < size; offset += 8U)
+    {
+        uint64_t raw;
+        if (!m_flash.readDoubleWord(next, offset, raw) || raw != kErased)
+        {
+            if (!m_flash.erasePage(next))
+            {
+                return false;
+            }
+            break;
+        }
+    }
+    m_eraseAheadPending = false;
+    return true;
+}
+
+bool BlackBox::openNextPage()
+{
+    if (m_eraseAheadPending && !eraseAhead())
+    {
+        return false;
+    }
+    uint32_t next = (m_page + 1U) % m_flash.pageCount();
+    uint64_t header = ((uint64_t)(m_pageSequence + 1U) << 32) | kPageMagic;
+    if (!m_flash.programDoubleWord(next, 0, header))
+    {
+        m_eraseAheadPending = true; // the header may be half-written: erase again
+        return false;
+    }
+    m_budget--;
+    m_page = next;
+    m_pageSequence++;
+    m_offset = kPageHeaderSize;
+    m_eraseAheadPending = true; // done on the next service(), not here
+    return true;
+}
+
+bool BlackBox::program(uint64_t value)
+{
+    if (!m_flash.programDoubleWord(m_page, m_offset, value))
+    {
+        return false;
+    }
+    m_offset += 8U;
+    m_budget--;
+    return true;
+}
+
+bool BlackBox::appendRecord(uint8_t type, const void* payload, uint32_t length)
+{
+    uint32_t payloadDW = (length + 7U) / 8U;
+    uint32_t recordDW = 1U + payloadDW;
+    uint32_t size = m_flash.pageSize();
+    if (length > kMaxPayload || recordDW * 8U > size - kPageHeaderSize)
+    {
+        return false;
+    }
+
+    bool newPage = (m_offset + recordDW * 8U > size);
+    if (m_budget < recordDW + (newPage ? 1U : 0U))
+    {
+        return false; // next service() call
+    }
+    if (newPage && !openNextPage())
+    {
+        return false;
+    }
+
+    uint8_t padded[kMaxPayload];
+    memset(padded, 0xFF, payloadDW * 8U);
+    memcpy(padded, payload, length);
+
+    RecordHeader header;
+    header.magic = kRecordMagic;
+    header.type = type;
+    header.lengthDW = (uint8_t)recordDW;
+    header.crc = crc16(padded, payloadDW * 8U);
+    header.sequence = m_recordSequence;
+    header.check = header.computeCheck();
+
+    uint64_t raw;
+    memcpy(&raw, &header, sizeof(raw));
+    uint32_t start = m_offset;
+    if (!program(raw))
+    {
+        // The word may be half-written and cannot be programmed again;
+        // readers stop at it, so continue on a fresh page.
+        m_offset = size;
+        return false;
+    }
+    m_recordSequence++;
+    for (uint32_t i = 0; i < payloadDW; ++i)
+    {
+        if (!program(loadDoubleWord(padded, i * 8U)))
+        {
+            m_offset = start + recordDW * 8U; // readers skip the declared span
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the next slice of the frozen pre-fault window.
+ * @return true once the whole window and the fault record are in flash.
+ */
+bool BlackBox::writeFaultChunk()
+{
+    uint32_t total = (m_faultHead < kPreFaultSamples) ? m_faultHead : kPreFaultSamples;
+    uint32_t oldest = m_faultHead - total;
+
+    while (m_faultWritten < total)
+    {
+        uint32_t count = total - m_faultWritten;
+        if (count > kSamplesPerRawRecord)
+        {
+            count = kSamplesPerRawRecord;
+        }
+
+        uint8_t payload[sizeof(RawPressureHeader) + kSamplesPerRawRecord * sizeof(uint16_t)];
+        RawPressureHeader header;
+        uint32_t samplesBeforeEnd = total - 1U - m_faultWritten;
+        header.t0_us = m_lastSample_us - samplesBeforeEnd * m_samplePeriod_us;
+        header.period_us = m_samplePeriod_us;
+        header.count = (uint16_t)count;
+        memcpy(payload, &header, sizeof(header));
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint16_t sample = m_samples[(oldest + m_faultWritten + i) % kPreFaultSamples];
+            memcpy(payload + sizeof(header) + i * sizeof(uint16_t), &sample, sizeof(sample));
+        }
+
+        if (!appendRecord(RecordRawPressure, payload, sizeof(header) + count * sizeof(uint16_t)))
+        {
+            return false;
+        }
+        m_faultWritten += count;
+    }
+
+    FaultInfo info = {m_faultTime_us, m_faultCode};
+    return appendRecord(RecordFault, &info, sizeof(info));
+}
+
+bool BlackBox::service()
+{
+    m_budget = kDoubleWordsPerService;
+
+    if (m_eraseAheadPending && !eraseAhead())
+    {
+        return true;
+    }
+
+    uint32_t tail = m_beatTail.load(std::memory_order_relaxed);
+    while (tail != m_beatHead.load(std::memory_order_acquire))
+    {
+        if (!appendRecord(RecordBeat, &m_beats[tail % kBeatQueue], sizeof(BeatSummary)))
+        {
+            m_beatTail.store(tail, std::memory_order_release);
+            return true;
+        }
+        tail++;
+    }
+    m_beatTail.store(tail, std::memory_order_release);
+
+    if (m_frozen.load(std::memory_order_acquire))
+    {
+        if (!writeFaultChunk())
+        {
+            return true;
+        }
+        m_sampleHead.store(0, std::memory_order_relaxed);
+        m_frozen.store(false, std::memory_order_release);
+    }
+    return m_eraseAheadPending;
+}
+
+bool BlackBox::readNext(Cursor& cursor, RecordView& out) const
+{
+    uint32_t count = m_flash.pageCount();
+    uint32_t size = m_flash.pageSize();
+
+    while (cursor.pageIndex < count)
+    {
+        uint32_t page = (m_page + 1U + cursor.pageIndex) % count;
+        if (pageSequence(page) == 0U)
+        {
+            cursor.pageIndex++;
+            cursor.offset = 0;
+            continue;
+        }
+        if (cursor.offset < kPageHeaderSize)
+        {
+            cursor.offset = kPageHeaderSize;
+        }
+
+        uint64_t raw = kErased;
+        if (cursor.offset + 8U <= size && !m_flash.readDoubleWord(page, cursor.offset, raw))
+        {
+            raw = kErased; // torn header: the rest of the page is unknown
+        }
+        RecordHeader header;
+        memcpy(&header, &raw, sizeof(header));
+        if (raw == kErased || !header.isValid() || cursor.offset + header.lengthDW * 8U > size)
+        {
+            cursor.pageIndex++;
+            cursor.offset = 0;
+            continue;
+        }
+
+        // CRC over ECC-checked reads, so a torn payload word marks the
+        // record invalid instead of faulting.
+        uint32_t payloadOffset = cursor.offset + 8U;
+        uint16_t crc = 0xFFFFU;
+        bool readable = true;
+        for (uint32_t i = 1; i < header.lengthDW && readable; ++i)
+        {
+            uint64_t word;
+            readable = m_flash.readDoubleWord(page, cursor.offset + i * 8U, word);
+            if (readable)
+            {
+                uint8_t bytes[8];
+                memcpy(bytes, &word, sizeof(bytes));
+                crc = crc16(bytes, sizeof(bytes), crc);
+            }
+        }
+
+        out.type = header.type;
+        out.sequence = header.sequence;
+        out.payload = m_flash.pageData(page) + payloadOffset;
+        out.length = (header.lengthDW - 1U) * 8U;
+        out.valid = readable && (crc == header.crc);
+        cursor.offset += header.lengthDW * 8U;
+        return true;
+    }
+    return false;
+}
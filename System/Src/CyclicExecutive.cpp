@@ -0,0 +1,242 @@
+/**
+ * @file CyclicExecutive.cpp
+ * @brief Frame dispatch, overrun accounting and the TIM7 / task drivers.
+ */
+
+#include "CyclicExecutive.h"
+#include "Timebase.h"
+
+#include <string.h>
+
+#if defined(USE_HAL_DRIVER)
+#include "StaticThread.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+
+
+CyclicExecutive::CyclicExecutive(const Slot* table, uint32_t count, uint32_t frame_us)
+        : m_table(table),
+          m_count((count > kMaxSlots) ? kMaxSlots : count),
+          m_frame_us(frame_us),
+          m_mode(Mode::Interrupt),
+          m_frame(0),
+          m_slots{},
+          m_frameOverruns(0),
+          m_missedFrames(0),
+          m_latencyMin_us(UINT32_MAX),
+          m_latencyMax_us(0),
+          m_latencySum_us(0),
+          m_frameMax_us(0),
+          m_seq(0)
+#if defined(USE_HAL_DRIVER)
+          , m_task(nullptr)
+#endif
+{
+
+}
+
+void CyclicExecutive::runFrame(uint32_t latency_us, uint32_t missed)
+{
+    uint32_t durations[kMaxSlots];
+    uint32_t frameStart = Timebase::now_us();
+    uint32_t slotStart = frameStart;
+    for (uint32_t i = 0; i < m_count; ++i)
+    {
+        const Slot& slot = m_table[i];
+        if (m_frame % slot.period != slot.offset)
+        {
+            durations[i] = UINT32_MAX; // not this frame
+            continue;
+        }
+        slot.run(slot.context);
+        uint32_t now = Timebase::now_us();
+        durations[i] = now - slotStart;
+        slotStart = now;
+    }
+    uint32_t frameTime = slotStart - frameStart;
+
+    // Only the bookkeeping is inside the seqlock, so a reader retries for
+    // a few hundred cycles at most.
+    uint32_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (uint32_t i = 0; i < m_count; ++i)
+    {
+        if (durations[i] == UINT32_MAX)
+        {
+            continue;
+        }
+        SlotStats& stats = m_slots[i];
+        stats.runs++;
+        stats.overruns += (durations[i] > m_table[i].budget_us) ? 1U : 0U;
+        stats.max_us = (durations[i] > stats.max_us) ? durations[i] : stats.max_us;
+    }
+    m_latencyMin_us = (latency_us < m_latencyMin_us) ? latency_us : m_latencyMin_us;
+    m_latencyMax_us = (latency_us > m_latencyMax_us) ? latency_us : m_latencyMax_us;
+    m_latencySum_us += latency_us;
+    m_frameMax_us = (frameTime > m_frameMax_us) ? frameTime : m_frameMax_us;
+    m_frameOverruns += (latency_us + frameTime > m_frame_us) ? 1U : 0U;
+    m_missedFrames += missed;
+    m_frame++;
+
+    m_seq.store(seq + 2U, std::memory_order_release);
+}
+
+size_t CyclicExecutive::encode(uint8_t* buf, size_t len) const
+{
+    size_t needed = sizeof(RecordHeader) + m_count * sizeof(SlotRow);
+    if (buf == nullptr || len < needed)
+    {
+        return 0;
+    }
+
+    for (uint32_t attempt = 0; attempt < kReadAttempts; ++attempt)
+    {
+        uint32_t before = m_seq.load(std::memory_order_acquire);
+        if ((before & 1U) != 0U)
+        {
+            continue;
+        }
+
+        RecordHeader header;
+        header.magic = kRecordMagic;
+        header.mode = (uint8_t)m_mode;
+        header.slotCount = (uint8_t)m_count;
+        header.frame_us = (uint16_t)m_frame_us;
+        header.frames = m_frame;
+        header.frameOverruns = m_frameOverruns;
+        header.missedFrames = m_missedFrames;
+        header.latencyMin_us = (uint16_t)((m_frame > 0U) ? m_latencyMin_us : 0U);
+        header.latencyMax_us = (uint16_t)m_latencyMax_us;
+        header.latencyMean_us = (uint16_t)((m_frame > 0U) ? m_latencySum_us / m_frame : 0U);
+        header.frameMax_us = (uint16_t)m_frameMax_us;
+        memcpy(buf, &header, sizeof(header));
+
+        for (uint32_t i = 0; i < m_count; ++i)
+        {
+            SlotRow row;
+            row.runs = m_slots[i].runs;
+            row.overruns = m_slots[i].overruns;
+            row.budget_us = m_table[i].budget_us;
+            row.max_us = (uint16_t)m_slots[i].max_us;
+            memcpy(buf + sizeof(header) + i * sizeof(SlotRow), &row, sizeof(row));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_seq.load(std::memory_order_relaxed) == before)
+        {
+            return needed;
+        }
+    }
+    return 0; // a frame kept updating the stats: the caller preempted it
+}
+
+#if defined(USE_HAL_DRIVER)
+
+CyclicExecutive* CyclicExecutive::s_instance = nullptr;
+
+namespace {
+
+// Frames in the interrupt: above the kernel, below the TIM2 timebase.
+constexpr uint32_t kInterruptPriority = 2;
+
+StaticThread<> s_thread;
+
+} // namespace
+
+bool CyclicExecutive::start(Mode mode)
+{
+    if (s_instance != nullptr || m_frame_us < 2U || m_frame_us > kMaxFrame_us
+        || !fits(m_table, m_count, m_frame_us))
+    {
+        return false;
+    }
+    m_mode = mode;
+    s_instance = this;
+
+    uint32_t priority = kInterruptPriority;
+    if (mode == Mode::Task)
+    {
+        m_task = s_thread.start("Executive", osPriorityRealtime7, frameTask, this);
+        if (m_task == nullptr)
+        {
+            Error_Handler();
+        }
+        priority = configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY; // may notify
+    }
+
+    __HAL_RCC_TIM7_CLK_ENABLE();
+
+    TIM7->CR1 = 0U;
+    TIM7->PSC = (Timebase::apb1TimerClock_hz() / 1000000U) - 1U;
+    TIM7->ARR = m_frame_us - 1U;
+    TIM7->CNT = 0U;
+    TIM7->EGR = TIM_EGR_UG; // load PSC now
+    TIM7->SR = 0U;          // UG sets UIF, clear it
+    TIM7->DIER = TIM_DIER_UIE;
+
+    HAL_NVIC_SetPriority(TIM7_DAC_IRQn, priority, 0);
+    HAL_NVIC_EnableIRQ(TIM7_DAC_IRQn);
+
+    TIM7->CR1 = TIM_CR1_CEN;
+    return true;
+}
+
+void CyclicExecutive::stop()
+{
+    TIM7->CR1 = 0U;
+    HAL_NVIC_DisableIRQ(TIM7_DAC_IRQn);
+}
+
+/**
+ * @brief TIM7 update. The counter restarted at the update, so its value
+ * at vector entry is how late this frame starts.
+ */
+void CyclicExecutive::onTimerIrq(uint32_t entry)
+{
+    if ((TIM7->SR & TIM_SR_UIF) == 0U)
+    {
+        return;
+    }
+    TIM7->SR = (uint32_t)~TIM_SR_UIF;
+
+    if (m_mode == Mode::Interrupt)
+    {
+        runFrame(entry);
+        return;
+    }
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR((TaskHandle_t)m_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void CyclicExecutive::frameTask(void* argument)
+{
+    CyclicExecutive* executive = static_cast<CyclicExecutive*>(argument);
+    for (;;)
+    {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t latency = TIM7->CNT;
+        executive->runFrame(latency, pending - 1U); // only the latest is run
+    }
+}
+
+extern "C" void CyclicExecutive_IRQHandler(uint32_t entryCount)
+{
+    CyclicExecutive* executive = CyclicExecutive::instance();
+    if (executive != nullptr)
+    {
+        executive->onTimerIrq(entryCount);
+    }
+    else
+    {
+        TIM7->SR = (uint32_t)~TIM_SR_UIF;
+    }
+}
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * @file DataBus.cpp
+ * @brief Topic definitions, registry and cost measurement.
+ */
+
+#include "BusTopics.h"
+
+#if defined(USE_HAL_DRIVER)
+#include "main.h"
+#endif
+
+namespace Bus {
+
+DataBus::Topic<Pressure> pressure("pressure");
+DataBus::Topic<Setpoint> setpoint("setpoint");
+DataBus::Topic<Valves> valves("valves");
+DataBus::HistoryTopic<PressureBlock, 4> pressureBlocks("pressureBlocks");
+
+} // namespace Bus
+
+namespace {
+
+const DataBus::TopicBase* const kRegistry[] = {
+        &Bus::pressure,
+        &Bus::setpoint,
+        &Bus::valves,
+        &Bus::pressureBlocks,
+};
+
+constexpr uint32_t kRegistrySize = sizeof(kRegistry) / sizeof(kRegistry[0]);
+
+DataBus::Costs s_costs = {};
+
+} // namespace
+
+
+uint32_t DataBus::topicCount()
+{
+    return kRegistrySize;
+}
+
+const DataBus::TopicBase* DataBus::topic(uint32_t index)
+{
+    return (index < kRegistrySize) ? kRegistry[index] : nullptr;
+}
+
+const DataBus::TopicBase* DataBus::find(const char* name)
+{
+    for (const TopicBase* t : kRegistry)
+    {
+        if (strcmp(t->name(), name) == 0)
+        {
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+void DataBus::measureCosts()
+{
+#if defined(USE_HAL_DRIVER)
+    constexpr uint32_t kRuns = 32;
+    static Topic<Bus::Pressure> scratch("scratch");
+    static HistoryTopic<Bus::PressureBlock, 2> scratchBlocks("scratchBlocks");
+    Bus::Pressure value = {0, 0.0f};
+
+    uint32_t start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kRuns; ++i)
+    {
+        scratch.publish(value);
+    }
+    s_costs.publish_cycles = (uint16_t)((DWT->CYCCNT - start) / kRuns);
+
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kRuns; ++i)
+    {
+        scratch.read(value);
+    }
+    s_costs.read_cycles = (uint16_t)((DWT->CYCCNT - start) / kRuns);
+
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kRuns; ++i)
+    {
+        scratchBlocks.beginPublish().count = i;
+        scratchBlocks.endPublish();
+    }
+    s_costs.blockPublish_cycles = (uint16_t)((DWT->CYCCNT - start) / kRuns);
+#endif
+}
+
+DataBus::Costs DataBus::costs()
+{
+    return s_costs;
+}
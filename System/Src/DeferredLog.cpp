@@ -0,0 +1,72 @@
+/**
+ * @file DeferredLog.cpp
+ * @brief The two record rings behind the LOG_* macros: SlotRings, the same
+ * as the trace recorder's.
+ */
+
+#include "DeferredLog.h"
+#include "SlotRing.h"
+#include "Timebase.h"
+
+namespace {
+
+using Ring = SlotRing<DeferredLog::Record, DEFERRED_LOG_RECORDS>;
+
+Ring s_urgent; // errors and warnings
+Ring s_normal; // info and debug
+
+} // namespace
+
+
+void DeferredLog::write(uint8_t level, uint32_t id, const uint32_t* args, uint32_t argCount)
+{
+    if (argCount > kMaxArgs)
+    {
+        argCount = kMaxArgs;
+    }
+    Ring& ring = (level <= LOG_LEVEL_WARN) ? s_urgent : s_normal;
+    ring.push([&](Record& r) {
+        r.t_us = Timebase::now_us();
+        r.id = id;
+        r.level = level;
+        r.argCount = (uint8_t)argCount;
+        r.reserved = 0;
+        for (uint32_t i = 0; i < argCount; ++i)
+        {
+            r.args[i] = args[i];
+        }
+    });
+}
+
+size_t DeferredLog::drain(uint8_t* buf, size_t len)
+{
+    if (buf == nullptr || len < sizeof(ChunkHeader) + sizeof(Record))
+    {
+        return 0;
+    }
+
+    size_t capacity = (len - sizeof(ChunkHeader)) / sizeof(Record);
+    if (capacity > 0xFFFFU)
+    {
+        capacity = 0xFFFFU;
+    }
+    Record* out = (Record*)(buf + sizeof(ChunkHeader));
+
+    size_t count = s_urgent.pop(out, capacity);
+    count += s_normal.pop(out + count, capacity - count);
+
+    uint32_t dropped = s_urgent.dropped() + s_normal.dropped();
+    if (count == 0U && dropped == 0U)
+    {
+        return 0;
+    }
+
+    ChunkHeader header;
+    header.magic = kChunkMagic;
+    header.count = (uint16_t)count;
+    header.dropped = (uint16_t)(dropped > 0xFFFFU ? 0xFFFFU : dropped);
+    memcpy(buf, &header, sizeof(header));
+    s_urgent.takeDropped();
+    s_normal.takeDropped();
+    return sizeof(ChunkHeader) + count * sizeof(Record);
+}
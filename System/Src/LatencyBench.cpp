@@ -0,0 +1,325 @@
+/**
+ * @file LatencyBench.cpp
+ * @brief Histograms, the TIM6 trigger and the benchmark task.
+ */
+
+#include "LatencyBench.h"
+
+#include <string.h>
+
+#if defined(USE_HAL_DRIVER)
+#include "StaticThread.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "queue.h"
+#include "stream_buffer.h"
+#endif
+
+namespace {
+
+LatencyBench::Histogram s_histograms[LatencyBench::kPathCount];
+uint32_t s_missed[LatencyBench::kPathCount];
+uint32_t s_samplesPerPath = 0;
+
+uint32_t cpuHz();
+
+} // namespace
+
+
+void LatencyBench::Histogram::reset()
+{
+    *this = Histogram();
+}
+
+void LatencyBench::Histogram::add(uint32_t cycles)
+{
+    uint32_t index = cycles / kBucket_cycles;
+    index = (index < kBuckets) ? index : kBuckets - 1U;
+    if (m_buckets[index] < UINT16_MAX)
+    {
+        m_buckets[index]++;
+    }
+    m_min = (cycles < m_min) ? cycles : m_min;
+    m_max = (cycles > m_max) ? cycles : m_max;
+    m_sum += cycles;
+    m_count++;
+}
+
+size_t LatencyBench::encode(uint8_t* buf, size_t len)
+{
+    size_t needed = sizeof(RecordHeader) + kPathCount * sizeof(PathRow);
+    if (buf == nullptr || len < needed)
+    {
+        return 0;
+    }
+
+    RecordHeader header;
+    header.magic = kRecordMagic;
+    header.pathCount = (uint8_t)kPathCount;
+    header.buckets = (uint8_t)kBuckets;
+    header.bucket_cycles = (uint16_t)kBucket_cycles;
+    header.cpu_hz = cpuHz();
+    header.samplesPerPath = s_samplesPerPath;
+    memcpy(buf, &header, sizeof(header));
+
+    for (uint32_t p = 0; p < kPathCount; ++p)
+    {
+        const Histogram& h = s_histograms[p];
+        PathRow row;
+        row.path = (uint8_t)p;
+        memset(row.reserved, 0, sizeof(row.reserved));
+        row.count = h.count();
+        row.missed = s_missed[p];
+        row.min_cycles = h.min();
+        row.max_cycles = h.max();
+        row.mean_cycles = h.mean();
+        for (uint32_t b = 0; b < kBuckets; ++b)
+        {
+            row.buckets[b] = h.bucket(b);
+        }
+        memcpy(buf + sizeof(header) + p * sizeof(PathRow), &row, sizeof(row));
+    }
+    return needed;
+}
+
+#if defined(USE_HAL_DRIVER)
+
+namespace {
+
+// At the syscall limit: the ISR has to use the FromISR API.
+constexpr uint32_t kTimerPriority = configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY;
+
+StaticThread<> s_thread;
+TaskHandle_t s_task = nullptr;
+
+StaticSemaphore_t s_semaphoreStorage;
+SemaphoreHandle_t s_semaphore = nullptr;
+
+StaticQueue_t s_queueStorage;
+uint8_t s_queueItems[sizeof(uint32_t)];
+QueueHandle_t s_queue = nullptr;
+
+StaticStreamBuffer_t s_streamStorage;
+uint8_t s_streamBytes[2 * sizeof(uint32_t) + 1U];
+StreamBufferHandle_t s_stream = nullptr;
+
+volatile LatencyBench::Path s_path = LatencyBench::Path::Isr;
+volatile uint32_t s_giveCycles = 0; // Semaphore / Notification stamp
+volatile bool s_stampPending = false; // s_giveCycles not read by the task yet
+volatile uint32_t s_pathMissed = 0;   // events the ISR could not deliver on s_path
+volatile uint32_t s_isrSamples = 0; // Isr path: taken inside the ISR
+volatile bool s_done = false;
+
+uint32_t cpuHz()
+{
+    return SystemCoreClock;
+}
+
+void startTrigger()
+{
+    __HAL_RCC_TIM6_CLK_ENABLE();
+
+    // Unprescaled, it counts Timebase::apb1TimerClock_hz(): CPU cycles, as
+    // long as AHB and APB1 are undivided.
+    TIM6->CR1 = 0U;
+    TIM6->PSC = 0U;
+    TIM6->ARR = 0xFFFFU;
+    TIM6->CNT = 0U;
+    TIM6->EGR = TIM_EGR_UG;
+    TIM6->SR = 0U;
+    TIM6->DIER = TIM_DIER_UIE;
+
+    HAL_NVIC_SetPriority(TIM6_DAC_IRQn, kTimerPriority, 0);
+    HAL_NVIC_EnableIRQ(TIM6_DAC_IRQn);
+    TIM6->CR1 = TIM_CR1_CEN;
+}
+
+void stopTrigger()
+{
+    TIM6->CR1 = 0U;
+    HAL_NVIC_DisableIRQ(TIM6_DAC_IRQn);
+}
+
+/**
+ * @brief Waits for one event on the current path.
+ * @return cycles from the ISR's stamp to now.
+ */
+uint32_t waitOne(LatencyBench::Path path)
+{
+    uint32_t stamp = 0;
+    switch (path)
+    {
+        case LatencyBench::Path::Semaphore:
+            xSemaphoreTake(s_semaphore, portMAX_DELAY);
+            stamp = s_giveCycles;
+            s_stampPending = false; // after the read: the ISR may stamp again
+            break;
+
+        case LatencyBench::Path::Notification:
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            stamp = s_giveCycles;
+            s_stampPending = false;
+            break;
+
+        case LatencyBench::Path::Queue:
+            xQueueReceive(s_queue, &stamp, portMAX_DELAY);
+            break;
+
+        default:
+            xStreamBufferReceive(s_stream, &stamp, sizeof(stamp), portMAX_DELAY);
+            break;
+    }
+    return DWT->CYCCNT - stamp;
+}
+
+void benchTask(void* argument)
+{
+    (void)argument;
+    for (uint32_t p = 0; p < LatencyBench::kPathCount; ++p)
+    {
+        LatencyBench::Path path = (LatencyBench::Path)p;
+        s_histograms[p].reset();
+        s_missed[p] = 0;
+        s_isrSamples = 0;
+        s_stampPending = false;
+        s_pathMissed = 0;
+        s_path = path;
+        startTrigger();
+
+        if (path == LatencyBench::Path::Isr)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // the ISR counts and wakes us at the end
+        }
+        else
+        {
+            for (uint32_t i = 0; i < s_samplesPerPath; ++i)
+            {
+                s_histograms[p].add(waitOne(path));
+            }
+        }
+        s_missed[p] = s_pathMissed; // before anything sent after the last sample
+
+        stopTrigger();
+        // Drain anything sent after the last sample.
+        xSemaphoreTake(s_semaphore, 0);
+        ulTaskNotifyTake(pdTRUE, 0);
+        xQueueReset(s_queue);
+        xStreamBufferReset(s_stream);
+    }
+    s_done = true;
+    vTaskSuspend(nullptr);
+}
+
+} // namespace
+
+
+bool LatencyBench::start(uint32_t samplesPerPath)
+{
+    if (s_task != nullptr || samplesPerPath == 0U)
+    {
+        return false;
+    }
+    s_samplesPerPath = samplesPerPath;
+    s_done = false;
+
+    s_semaphore = xSemaphoreCreateBinaryStatic(&s_semaphoreStorage);
+    s_queue = xQueueCreateStatic(1, sizeof(uint32_t), s_queueItems, &s_queueStorage);
+    s_stream = xStreamBufferCreateStatic(sizeof(s_streamBytes) - 1U, sizeof(uint32_t),
+                                         s_streamBytes, &s_streamStorage);
+
+    s_task = (TaskHandle_t)s_thread.start("LatencyBench", osPriorityRealtime7, benchTask, nullptr);
+    if (s_task == nullptr)
+    {
+        Error_Handler();
+    }
+    return true;
+}
+
+bool LatencyBench::isDone()
+{
+    return s_done;
+}
+
+void LatencyBench::onTimerIrq(uint32_t entry)
+{
+    if ((TIM6->SR & TIM_SR_UIF) == 0U)
+    {
+        return;
+    }
+    TIM6->SR = (uint32_t)~TIM_SR_UIF;
+
+    BaseType_t woken = pdFALSE;
+    uint32_t stamp = DWT->CYCCNT;
+    Path path = s_path;
+    switch (path)
+    {
+        case Path::Isr:
+            if (s_isrSamples < s_samplesPerPath)
+            {
+                s_histograms[(uint32_t)Path::Isr].add(entry);
+                s_isrSamples = s_isrSamples + 1U;
+                if (s_isrSamples == s_samplesPerPath)
+                {
+                    vTaskNotifyGiveFromISR(s_task, &woken);
+                }
+            }
+            break;
+
+        case Path::Semaphore:
+        case Path::Notification:
+            // The previous stamp is still unread: giving again would merge
+            // this event into that wake-up and overwrite its stamp.
+            if (s_stampPending)
+            {
+                s_pathMissed = s_pathMissed + 1U;
+                break;
+            }
+            s_giveCycles = stamp;
+            s_stampPending = true;
+            if (path == Path::Semaphore)
+            {
+                xSemaphoreGiveFromISR(s_semaphore, &woken);
+            }
+            else
+            {
+                vTaskNotifyGiveFromISR(s_task, &woken);
+            }
+            break;
+
+        case Path::Queue:
+            if (xQueueSendFromISR(s_queue, &stamp, &woken) != pdPASS)
+            {
+                s_pathMissed = s_pathMissed + 1U;
+            }
+            break;
+
+        default:
+            if (xStreamBufferSendFromISR(s_stream, &stamp, sizeof(stamp), &woken) != sizeof(stamp))
+            {
+                s_pathMissed = s_pathMissed + 1U;
+            }
+            break;
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+extern "C" void LatencyBench_IRQHandler(uint32_t entryCycles)
+{
+    LatencyBench::onTimerIrq(entryCycles);
+}
+
+#else
+
+namespace {
+
+uint32_t cpuHz()
+{
+    return 0;
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,467 @@
+/**
+ * @file MemoryPools.cpp
+ * @brief Pool free lists, boot arena and the global operator new/delete.
+ */
+
+#include "MemoryPools.h"
+#include "InterruptLock.h"
+
+#include <new>
+#include <string.h>
+
+#if defined(USE_HAL_DRIVER)
+#include "main.h"
+#else
+extern "C" void Error_Handler(void); // from the test that routes new
+#endif
+
+namespace {
+
+struct PoolConfig {
+    uint16_t blockSize;
+    uint16_t blocks;
+};
+
+// Sized for a few dozen small objects; adjust from the usage report.
+constexpr PoolConfig kConfig[MemoryPools::kPoolCount] = {
+        {16, 32},
+        {32, 32},
+        {64, 16},
+        {128, 8},
+        {256, 4},
+};
+
+constexpr size_t poolBytes()
+{
+    size_t total = 0;
+    for (const PoolConfig& c : kConfig)
+    {
+        total += (size_t)c.blockSize * c.blocks;
+    }
+    return total;
+}
+
+/**
+ * @brief True if every pool starts at a multiple of its block size, so
+ * with the memory aligned to kMaxAlignment each block is aligned to its
+ * size.
+ */
+constexpr bool blocksSelfAligned()
+{
+    size_t offset = 0;
+    for (const PoolConfig& c : kConfig)
+    {
+        if (offset % c.blockSize != 0U || MemoryPools::kMaxAlignment % c.blockSize != 0U)
+        {
+            return false;
+        }
+        offset += (size_t)c.blockSize * c.blocks;
+    }
+    return true;
+}
+
+static_assert(blocksSelfAligned(), "each pool must start on a multiple of its power-of-two block size");
+static_assert(kConfig[MemoryPools::kPoolCount - 1U].blockSize == MemoryPools::kMaxAlignment, "largest block");
+
+constexpr bool blocksFitTheBitmap()
+{
+    for (const PoolConfig& c : kConfig)
+    {
+        if (c.blocks > 32U)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(blocksFitTheBitmap(), "Pool::used has one bit per block");
+
+constexpr size_t kArenaSize = 4096;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct Pool {
+    uint8_t* begin;
+    uint8_t* end;
+    FreeBlock* free;
+    uint32_t used;      // bit i set while block i is handed out
+    uint16_t inUse;
+    uint16_t peak;
+    uint32_t allocations;
+    uint32_t failures;
+};
+
+alignas(MemoryPools::kMaxAlignment) uint8_t s_poolMemory[poolBytes()];
+alignas(8) uint8_t s_arena[kArenaSize];
+Pool s_pools[MemoryPools::kPoolCount];
+size_t s_arenaUsed = 0;
+uint32_t s_arenaDeletes = 0;
+uint32_t s_badReleases = 0;
+bool s_initialised = false;
+bool s_running = false;
+MemoryPools::Mode s_mode = MemoryPools::Mode::Pools;
+
+/**
+ * @brief Threads every pool's free list. Runs on first use, so objects
+ * constructed before main() can already allocate.
+ */
+void initialise()
+{
+    uint8_t* memory = s_poolMemory;
+    for (uint32_t p = 0; p < MemoryPools::kPoolCount; ++p)
+    {
+        Pool& pool = s_pools[p];
+        pool.begin = memory;
+        pool.free = nullptr;
+        for (uint32_t i = kConfig[p].blocks; i-- > 0U;)
+        {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(memory + (size_t)i * kConfig[p].blockSize);
+            block->next = pool.free;
+            pool.free = block;
+        }
+        memory += (size_t)kConfig[p].blockSize * kConfig[p].blocks;
+        pool.end = memory;
+        pool.used = 0;
+        pool.inUse = 0;
+        pool.peak = 0;
+        pool.allocations = 0;
+        pool.failures = 0;
+    }
+    s_initialised = true;
+}
+
+} // namespace
+
+
+void MemoryPools::onSchedulerStart(Mode mode)
+{
+    InterruptLock lock;
+    s_mode = mode;
+    s_running = true;
+}
+
+void* MemoryPools::allocate(size_t size)
+{
+    InterruptLock lock;
+    if (!s_initialised)
+    {
+        initialise();
+    }
+    for (uint32_t p = 0; p < kPoolCount; ++p)
+    {
+        if (size > kConfig[p].blockSize)
+        {
+            continue;
+        }
+        Pool& pool = s_pools[p];
+        if (pool.free == nullptr)
+        {
+            pool.failures++; // no spilling into the next size: keeps the report honest
+            return nullptr;
+        }
+        FreeBlock* block = pool.free;
+        pool.free = block->next;
+        pool.used |= 1UL << ((reinterpret_cast<uint8_t*>(block) - pool.begin) / kConfig[p].blockSize);
+        pool.inUse++;
+        pool.peak = (pool.inUse > pool.peak) ? pool.inUse : pool.peak;
+        pool.allocations++;
+        return block;
+    }
+    s_pools[kPoolCount - 1U].failures++;
+    return nullptr;
+}
+
+bool MemoryPools::release(void* block)
+{
+    if (block == nullptr)
+    {
+        return true;
+    }
+    uint8_t* address = static_cast<uint8_t*>(block);
+    InterruptLock lock;
+    for (uint32_t p = 0; p < kPoolCount; ++p)
+    {
+        Pool& pool = s_pools[p];
+        if (address < pool.begin || address >= pool.end)
+        {
+            continue;
+        }
+        size_t offset = (size_t)(address - pool.begin);
+        uint32_t bit = 1UL << (offset / kConfig[p].blockSize);
+        if (offset % kConfig[p].blockSize != 0U || (pool.used & bit) == 0U)
+        {
+            break; // inside a block, or already free: pushing it would corrupt the list
+        }
+        pool.used &= ~bit;
+        FreeBlock* freed = static_cast<FreeBlock*>(block);
+        freed->next = pool.free;
+        pool.free = freed;
+        pool.inUse--;
+        return true;
+    }
+    s_badReleases++;
+    return false;
+}
+
+void* MemoryPools::allocateBoot(size_t size, size_t alignment)
+{
+    InterruptLock lock;
+    alignment = (alignment < 8U) ? 8U : alignment;
+    uintptr_t next = (uintptr_t)(s_arena + s_arenaUsed);
+    size_t padding = (size_t)((alignment - (next & (alignment - 1U))) & (alignment - 1U));
+    size_t aligned = (size + 7U) & ~(size_t)7U;
+    if (padding > kArenaSize - s_arenaUsed || aligned > kArenaSize - s_arenaUsed - padding)
+    {
+        return nullptr;
+    }
+    void* block = s_arena + s_arenaUsed + padding;
+    s_arenaUsed += padding + aligned;
+    return block;
+}
+
+bool MemoryPools::ownsPoolBlock(const void* pointer)
+{
+    const uint8_t* address = static_cast<const uint8_t*>(pointer);
+    return address >= s_poolMemory && address < s_poolMemory + sizeof(s_poolMemory);
+}
+
+bool MemoryPools::ownsArenaBlock(const void* pointer)
+{
+    const uint8_t* address = static_cast<const uint8_t*>(pointer);
+    return address >= s_arena && address < s_arena + kArenaSize;
+}
+
+MemoryPools::RecordHeader MemoryPools::usage(PoolRow* rows)
+{
+    InterruptLock lock;
+    if (!s_initialised)
+    {
+        initialise();
+    }
+    RecordHeader header;
+    header.magic = kRecordMagic;
+    header.poolCount = (uint8_t)kPoolCount;
+    header.mode = (uint8_t)s_mode;
+    header.running = s_running ? 1U : 0U;
+    header.reserved = 0;
+    header.arenaSize = (uint32_t)kArenaSize;
+    header.arenaUsed = (uint32_t)s_arenaUsed;
+    header.arenaDeletes = s_arenaDeletes;
+    header.badReleases = s_badReleases;
+    for (uint32_t p = 0; p < kPoolCount; ++p)
+    {
+        rows[p].blockSize = kConfig[p].blockSize;
+        rows[p].blocks = kConfig[p].blocks;
+        rows[p].inUse = s_pools[p].inUse;
+        rows[p].peak = s_pools[p].peak;
+        rows[p].allocations = s_pools[p].allocations;
+        rows[p].failures = s_pools[p].failures;
+    }
+    return header;
+}
+
+size_t MemoryPools::encode(uint8_t* buf, size_t len)
+{
+    size_t needed = sizeof(RecordHeader) + kPoolCount * sizeof(PoolRow);
+    if (buf == nullptr || len < needed)
+    {
+        return 0;
+    }
+    PoolRow rows[kPoolCount];
+    RecordHeader header = usage(rows);
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), rows, sizeof(rows));
+    return needed;
+}
+
+namespace {
+
+/**
+ * @brief The last fatal new or delete. Look here from the debugger once
+ * Error_Handler() is hit.
+ */
+struct TrapRecord {
+    size_t size;
+    void* caller;
+    void* pointer;
+};
+
+volatile TrapRecord s_trap = {0, nullptr, nullptr};
+
+} // namespace
+
+MemoryPools::Trap MemoryPools::lastTrap()
+{
+    return Trap{s_trap.size, s_trap.caller, s_trap.pointer};
+}
+
+#if defined(USE_HAL_DRIVER) || defined(MEMORY_POOLS_ROUTE_NEW)
+
+namespace {
+
+constexpr size_t kDefaultAlignment = 8; // what plain new guarantees here
+
+[[noreturn]] void fatal(size_t size, void* caller, void* pointer = nullptr)
+{
+    s_trap.size = size;
+    s_trap.caller = caller;
+    s_trap.pointer = pointer;
+    Error_Handler();
+    for (;;)
+    {
+    }
+}
+
+void* routedNew(size_t size, size_t alignment, void* caller, bool mayFail)
+{
+    void* block;
+    if (s_running && s_mode == MemoryPools::Mode::Trap)
+    {
+        fatal(size, caller);
+    }
+    else if (alignment > MemoryPools::kMaxAlignment)
+    {
+        block = nullptr;
+    }
+    else if (!s_running)
+    {
+        block = MemoryPools::allocateBoot(size, alignment);
+    }
+    else
+    {
+        block = MemoryPools::allocate((size > alignment) ? size : alignment);
+    }
+    if (block == nullptr && !mayFail)
+    {
+        fatal(size, caller);
+    }
+    return block;
+}
+
+/**
+ * @brief A delete the pools refuse (not a block start, already free, not
+ * ours at all) is heap corruption in the making: fatal, like a failed new.
+ */
+void routedDelete(void* pointer, void* caller)
+{
+    if (MemoryPools::ownsArenaBlock(pointer))
+    {
+        InterruptLock lock;
+        s_arenaDeletes++;
+        return;
+    }
+    if (!MemoryPools::release(pointer))
+    {
+        fatal(0, caller, pointer);
+    }
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    return routedNew(size, kDefaultAlignment, __builtin_return_address(0), false);
+}
+
+void* operator new[](size_t size)
+{
+    return routedNew(size, kDefaultAlignment, __builtin_return_address(0), false);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return routedNew(size, kDefaultAlignment, __builtin_return_address(0), true);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return routedNew(size, kDefaultAlignment, __builtin_return_address(0), true);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return routedNew(size, (size_t)alignment, __builtin_return_address(0), false);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return routedNew(size, (size_t)alignment, __builtin_return_address(0), false);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return routedNew(size, (size_t)alignment, __builtin_return_address(0), true);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return routedNew(size, (size_t)alignment, __builtin_return_address(0), true);
+}
+
+// Every form of delete, sized, aligned or nothrow, ends in the same place:
+// the block knows where it came from.
+
+void operator delete(void* pointer) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    routedDelete(pointer, __builtin_return_address(0));
+}
+
+#endif
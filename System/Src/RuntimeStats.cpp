@@ -0,0 +1,489 @@
+/**
+ * @file RuntimeStats.cpp
+ * @brief Window bookkeeping and binary encoding for the run-time statistics.
+ */
+
+#include "RuntimeStats.h"
+#include "StaticThread.h"
+#include "Timebase.h"
+
+#include "main.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+
+#include <atomic>
+#include <string.h>
+
+namespace {
+
+using RuntimeStats::kMaxTasks;
+using RuntimeStats::Window;
+
+constexpr uint32_t kNoSlot = kMaxTasks;
+constexpr uint32_t kStatusCapacity = 32; // tasks uxTaskGetSystemState() can list
+constexpr uint32_t kBeatPoll_ms = 5;
+constexpr uint32_t kSecond_us = 1000000U;
+constexpr size_t kMaxRecordBytes = sizeof(RuntimeStats::RecordHeader)
+                                   + kMaxTasks * sizeof(RuntimeStats::TaskRow);
+
+struct TaskSnapshot {
+    uint8_t number;
+    uint8_t slot;     // counter slot, kNoSlot if the task never got one
+    uint8_t priority;
+    uint16_t stackFree;
+    uint32_t run_us;
+    uint32_t switches;
+};
+
+struct Snapshot {
+    uint32_t t_us;
+    uint32_t isr_us;
+    uint32_t idle_us;
+    uint32_t count;
+    uint32_t omitted; // alive but not in tasks[]
+    TaskSnapshot tasks[kMaxTasks];
+};
+
+struct WindowResult {
+    uint32_t length_us;
+    uint32_t isr_us;
+    uint16_t load_permille;
+    uint32_t count;
+    uint32_t omitted;
+    RuntimeStats::TaskRow rows[kMaxTasks];
+};
+
+// Written from the switch hook / ISRs, read by take(). Slot i counts for
+// the task whose TCB number is s_slotOwner[i]; 0 marks a free slot (FreeRTOS
+// numbers TCBs from 1). Slots are claimed on a task's first switch-in and
+// released by traceTASK_DELETE, both inside the kernel's critical section.
+volatile uint32_t s_slotOwner[kMaxTasks];
+volatile uint32_t s_switches[kMaxTasks];
+volatile uint32_t s_unmappedSwitches = 0; // more than kMaxTasks tasks alive
+
+// ISRs of any priority, nesting: the depth and total are updated with
+// LDREX/STREX, so a preempting handler cannot lose an update.
+std::atomic<uint32_t> s_isrDepth{0};
+volatile uint32_t s_isrStart_us = 0;
+std::atomic<uint32_t> s_isrTotal_us{0};
+
+// Bumped by notifyBeat(), picked up by the stats task.
+std::atomic<uint32_t> s_beats{0};
+
+// Only touched from the task calling onBeatBoundary()/onSecondTick()/encode().
+TaskStatus_t s_status[kStatusCapacity];
+Snapshot s_current; // scratch, kept off the caller's stack
+Snapshot s_prevBeat;
+Snapshot s_prevSecond;
+WindowResult s_beat;
+WindowResult s_second;
+
+uint64_t s_bootRun_us[kMaxTasks];
+uint32_t s_bootOwner[kMaxTasks]; // task s_bootRun_us[i] belongs to
+uint64_t s_bootIsr_us = 0;
+uint64_t s_bootIdle_us = 0;
+Snapshot s_bootLast; // latest totals, for the since-boot rows
+
+uint16_t s_hookCost_cycles = 0;
+uint16_t s_isrCost_cycles = 0;
+uint16_t s_sampleCost_us = 0;
+
+// The stats task and its output.
+StaticThread<> s_thread;
+osThreadId_t s_task = nullptr;
+RuntimeStats::RecordSink s_sink = nullptr;
+void* s_sinkContext = nullptr;
+uint8_t s_records[3][kMaxRecordBytes];
+size_t s_recordLength[3];
+
+uint32_t slotOf(uint32_t tcbNumber)
+{
+    for (uint32_t i = 0; i < kMaxTasks; ++i)
+    {
+        if (s_slotOwner[i] == tcbNumber)
+        {
+            return i;
+        }
+    }
+    return kNoSlot;
+}
+
+/**
+ * @brief Samples every task into @p snap, up to kMaxTasks rows; the rest
+ * are counted in omitted. uxTaskGetSystemState() lists nothing at all when
+ * the array is too short, so it gets kStatusCapacity entries, and with more
+ * tasks alive than that the snapshot has no rows and omits them all. Idle
+ * time comes from its own counter, so the load stays right either way.
+ */
+void take(Snapshot& snap)
+{
+    uint32_t start = Timebase::now_us();
+
+    UBaseType_t alive = uxTaskGetNumberOfTasks();
+    UBaseType_t n = (alive <= kStatusCapacity) ? uxTaskGetSystemState(s_status, kStatusCapacity, nullptr) : 0U;
+    snap.t_us = Timebase::now_us();
+    snap.isr_us = s_isrTotal_us.load(std::memory_order_relaxed);
+    snap.idle_us = ulTaskGetIdleRunTimeCounter();
+    uint32_t rows = (n < kMaxTasks) ? n : kMaxTasks;
+    snap.count = rows;
+    snap.omitted = (n != 0U) ? n - rows : uxTaskGetNumberOfTasks();
+    for (uint32_t i = 0; i < rows; ++i)
+    {
+        const TaskStatus_t& st = s_status[i];
+        TaskSnapshot& t = snap.tasks[i];
+        t.number = (uint8_t)st.xTaskNumber;
+        t.priority = (uint8_t)st.uxCurrentPriority;
+        t.stackFree = (uint16_t)st.usStackHighWaterMark;
+        t.run_us = st.ulRunTimeCounter;
+        uint32_t slot = slotOf(st.xTaskNumber);
+        t.slot = (uint8_t)slot;
+        t.switches = (slot != kNoSlot) ? s_switches[slot] : 0U;
+    }
+    s_sampleCost_us = (uint16_t)(Timebase::now_us() - start);
+}
+
+const TaskSnapshot* find(const Snapshot& snap, uint8_t number)
+{
+    for (uint32_t i = 0; i < snap.count; ++i)
+    {
+        if (snap.tasks[i].number == number)
+        {
+            return &snap.tasks[i];
+        }
+    }
+    return nullptr;
+}
+
+uint16_t loadFrom(uint32_t idle_us, uint32_t length_us)
+{
+    if (length_us == 0U)
+    {
+        return 0;
+    }
+    uint32_t idle = (uint32_t)(((uint64_t)idle_us * 1000U) / length_us);
+    return (uint16_t)(idle >= 1000U ? 0U : 1000U - idle);
+}
+
+/**
+ * @brief Fills @p out with cur - prev for every task alive in @p cur.
+ * @return Idle time inside the window.
+ */
+uint32_t diff(const Snapshot& prev, const Snapshot& cur, WindowResult& out)
+{
+    uint32_t idle_us = cur.idle_us - prev.idle_us;
+    out.length_us = cur.t_us - prev.t_us;
+    out.isr_us = cur.isr_us - prev.isr_us;
+    out.count = cur.count;
+    out.omitted = cur.omitted;
+    for (uint32_t i = 0; i < cur.count; ++i)
+    {
+        const TaskSnapshot& c = cur.tasks[i];
+        const TaskSnapshot* p = find(prev, c.number);
+        RuntimeStats::TaskRow& row = out.rows[i];
+        row.taskNumber = c.number;
+        row.priority = c.priority;
+        row.stackFree_words = c.stackFree;
+        row.run_time = c.run_us - (p != nullptr ? p->run_us : 0U);
+        row.switches = c.switches - (p != nullptr ? p->switches : 0U);
+    }
+    out.load_permille = loadFrom(idle_us, out.length_us);
+    return idle_us;
+}
+
+void publish(Window window)
+{
+    uint32_t w = (uint32_t)window;
+    s_recordLength[w] = RuntimeStats::encode(window, s_records[w], kMaxRecordBytes);
+    if (s_sink != nullptr && s_recordLength[w] != 0U)
+    {
+        s_sink(s_sinkContext, s_records[w], s_recordLength[w]);
+    }
+}
+
+/**
+ * @brief Every kBeatPoll_ms: closes the beat window if notifyBeat() was
+ * called since the last look, and the second window on the timebase.
+ * Polling keeps notifyBeat() free of kernel calls.
+ */
+void statsTask(void*)
+{
+    uint32_t nextSecond = Timebase::now_us() + kSecond_us;
+    uint32_t beatsSeen = s_beats.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        osDelay(pdMS_TO_TICKS(kBeatPoll_ms));
+        uint32_t beats = s_beats.load(std::memory_order_relaxed);
+        if (beats != beatsSeen)
+        {
+            beatsSeen = beats;
+            RuntimeStats::onBeatBoundary();
+            publish(Window::LastBeat);
+        }
+        if ((int32_t)(Timebase::now_us() - nextSecond) >= 0)
+        {
+            nextSecond += kSecond_us;
+            RuntimeStats::onSecondTick();
+            publish(Window::LastSecond);
+            publish(Window::SinceBoot);
+        }
+    }
+}
+
+void enableCycleCounter()
+{
+    SET_BIT(CoreDebug->DEMCR, CoreDebug_DEMCR_TRCENA_Msk);
+    DWT->CYCCNT = 0U;
+    SET_BIT(DWT->CTRL, DWT_CTRL_CYCCNTENA_Msk);
+}
+
+} // namespace
+
+
+extern "C" void RuntimeStats_TaskSwitchedIn(uint32_t tcbNumber)
+{
+    uint32_t free = kNoSlot;
+    for (uint32_t i = 0; i < kMaxTasks; ++i)
+    {
+        uint32_t owner = s_slotOwner[i];
+        if (owner == tcbNumber)
+        {
+            s_switches[i] = s_switches[i] + 1U;
+            return;
+        }
+        if (owner == 0U && free == kNoSlot)
+        {
+            free = i;
+        }
+    }
+    if (free == kNoSlot)
+    {
+        s_unmappedSwitches = s_unmappedSwitches + 1U;
+        return;
+    }
+    s_slotOwner[free] = tcbNumber;
+    s_switches[free] = 1U;
+}
+
+extern "C" void RuntimeStats_TaskDeleted(uint32_t tcbNumber)
+{
+    uint32_t slot = slotOf(tcbNumber);
+    if (slot != kNoSlot)
+    {
+        s_slotOwner[slot] = 0U;
+    }
+}
+
+// The time is read before the depth changes: a handler that preempts
+// between the two is then inside the outer one's interval, not counted twice.
+extern "C" void RuntimeStats_IsrEnter(void)
+{
+    uint32_t now = Timebase::now_us();
+    if (s_isrDepth.fetch_add(1U, std::memory_order_relaxed) == 0U)
+    {
+        s_isrStart_us = now;
+    }
+}
+
+extern "C" void RuntimeStats_IsrExit(void)
+{
+    uint32_t now = Timebase::now_us();
+    if (s_isrDepth.fetch_sub(1U, std::memory_order_relaxed) == 1U)
+    {
+        s_isrTotal_us.fetch_add(now - s_isrStart_us, std::memory_order_relaxed);
+    }
+}
+
+
+void RuntimeStats::init()
+{
+    constexpr uint32_t kRuns = 32;
+    enableCycleCounter();
+
+    uint32_t start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kRuns; ++i)
+    {
+        RuntimeStats_TaskSwitchedIn(1U);
+    }
+    s_hookCost_cycles = (uint16_t)((DWT->CYCCNT - start) / kRuns);
+
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < kRuns; ++i)
+    {
+        RuntimeStats_IsrEnter();
+        RuntimeStats_IsrExit();
+    }
+    s_isrCost_cycles = (uint16_t)((DWT->CYCCNT - start) / kRuns);
+
+    memset((void*)s_slotOwner, 0, sizeof(s_slotOwner));
+    memset((void*)s_switches, 0, sizeof(s_switches));
+    memset(s_bootOwner, 0, sizeof(s_bootOwner));
+    s_unmappedSwitches = 0;
+    s_isrTotal_us.store(0U, std::memory_order_relaxed);
+    memset(&s_prevBeat, 0, sizeof(s_prevBeat));
+    memset(&s_prevSecond, 0, sizeof(s_prevSecond));
+    memset(&s_bootLast, 0, sizeof(s_bootLast));
+    s_prevBeat.t_us = Timebase::now_us();
+    s_prevSecond.t_us = s_prevBeat.t_us;
+}
+
+void RuntimeStats::onBeatBoundary()
+{
+    take(s_current);
+    diff(s_prevBeat, s_current, s_beat);
+    s_prevBeat = s_current;
+}
+
+void RuntimeStats::onSecondTick()
+{
+    const Snapshot& cur = s_current;
+    take(s_current);
+    uint32_t idle_us = diff(s_prevSecond, cur, s_second);
+
+    // Fold the second into 64-bit totals so since-boot survives the
+    // 32-bit counter wrap (~71 min).
+    // A slot handed to a new task starts its total again.
+    for (uint32_t i = 0; i < s_second.count; ++i)
+    {
+        const TaskSnapshot& t = cur.tasks[i];
+        if (t.slot == kNoSlot)
+        {
+            continue;
+        }
+        if (s_bootOwner[t.slot] != t.number)
+        {
+            s_bootOwner[t.slot] = t.number;
+            s_bootRun_us[t.slot] = 0;
+        }
+        s_bootRun_us[t.slot] += s_second.rows[i].run_time;
+    }
+    s_bootIsr_us += s_second.isr_us;
+    s_bootIdle_us += idle_us;
+    s_bootLast = cur;
+    s_prevSecond = cur;
+}
+
+uint16_t RuntimeStats::cpuLoad_permille(Window window)
+{
+    switch (window)
+    {
+        case Window::LastBeat:
+            return s_beat.load_permille;
+        case Window::LastSecond:
+            return s_second.load_permille;
+        default:
+        {
+            uint64_t up_us = Timebase::now_us64();
+            if (up_us == 0U)
+            {
+                return 0;
+            }
+            uint64_t idle = (s_bootIdle_us * 1000U) / up_us;
+            return (uint16_t)(idle >= 1000U ? 0U : 1000U - idle);
+        }
+    }
+}
+
+size_t RuntimeStats::encode(Window window, uint8_t* buf, size_t len)
+{
+    const WindowResult* result = nullptr;
+    uint32_t count = 0;
+    uint32_t omitted = 0;
+    if (window == Window::LastBeat)
+    {
+        result = &s_beat;
+        count = s_beat.count;
+        omitted = s_beat.omitted;
+    }
+    else if (window == Window::LastSecond)
+    {
+        result = &s_second;
+        count = s_second.count;
+        omitted = s_second.omitted;
+    }
+    else
+    {
+        count = s_bootLast.count;
+        omitted = s_bootLast.omitted;
+    }
+
+    size_t needed = sizeof(RecordHeader) + count * sizeof(TaskRow);
+    if (buf == nullptr || len < needed)
+    {
+        return 0;
+    }
+
+    RecordHeader header;
+    header.magic = kRecordMagic;
+    header.window = (uint8_t)window;
+    header.taskCount = (uint8_t)count;
+    header.cpuLoad_permille = cpuLoad_permille(window);
+    header.hookCost_cycles = s_hookCost_cycles;
+    header.isrCost_cycles = s_isrCost_cycles;
+    header.sampleCost_us = s_sampleCost_us;
+    header.tasksOmitted = (uint8_t)((omitted > 0xFFU) ? 0xFFU : omitted);
+
+    uint8_t* out = buf + sizeof(RecordHeader);
+    if (result != nullptr)
+    {
+        header.timeShift = 0;
+        header.window_time = result->length_us;
+        header.isr_time = result->isr_us;
+        memcpy(out, result->rows, count * sizeof(TaskRow));
+    }
+    else
+    {
+        // Since boot: 1024us units, good for ~49 days in 32 bits.
+        constexpr uint8_t kShift = 10;
+        header.timeShift = kShift;
+        header.window_time = (uint32_t)(Timebase::now_us64() >> kShift);
+        header.isr_time = (uint32_t)(s_bootIsr_us >> kShift);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const TaskSnapshot& t = s_bootLast.tasks[i];
+            TaskRow row;
+            row.taskNumber = t.number;
+            row.priority = t.priority;
+            row.stackFree_words = t.stackFree;
+            uint64_t run_us = (t.slot != kNoSlot && s_bootOwner[t.slot] == t.number)
+                              ? s_bootRun_us[t.slot] : 0U;
+            row.run_time = (uint32_t)(run_us >> kShift);
+            row.switches = t.switches;
+            memcpy(out + i * sizeof(TaskRow), &row, sizeof(TaskRow));
+        }
+    }
+    memcpy(buf, &header, sizeof(RecordHeader));
+    return needed;
+}
+
+void RuntimeStats::start(RecordSink sink, void* context)
+{
+    if (s_task != nullptr)
+    {
+        return;
+    }
+    s_sink = sink;
+    s_sinkContext = context;
+
+    s_task = s_thread.start("RuntimeStats", osPriorityLow, statsTask, nullptr);
+    if (s_task == nullptr)
+    {
+        Error_Handler();
+    }
+}
+
+void RuntimeStats::notifyBeat()
+{
+    s_beats.fetch_add(1U, std::memory_order_relaxed);
+}
+
+const uint8_t* RuntimeStats::lastRecord(Window window, size_t* length)
+{
+    uint32_t w = (uint32_t)window;
+    if (length != nullptr)
+    {
+        *length = s_recordLength[w];
+    }
+    return s_records[w];
+}
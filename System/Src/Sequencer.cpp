@@ -0,0 +1,276 @@
+/**
+ * @file Sequencer.cpp
+ * @brief Frame pool, awaiters and the executor loop.
+ */
+
+#include "Sequencer.h"
+#include "Timebase.h"
+
+#if defined(USE_HAL_DRIVER)
+#include "StaticThread.h"
+#include "cmsis_os.h"
+#endif
+
+namespace {
+
+/**
+ * @brief kFrames fixed blocks with a lock-free allocation bitmap, so
+ * sequences can be created from any task.
+ */
+struct FramePool {
+    alignas(8) uint8_t blocks[Sequencer::kFrames][Sequencer::kFrameSize];
+    std::atomic<uint32_t> used;
+    std::atomic<uint32_t> highWater;
+    std::atomic<uint32_t> largest;
+    std::atomic<uint32_t> failures;
+};
+
+static_assert(Sequencer::kFrames <= 32, "one bitmap word");
+
+FramePool s_pool;
+
+uint32_t countBits(uint32_t bits)
+{
+    uint32_t n = 0;
+    for (; bits != 0U; bits &= bits - 1U)
+    {
+        n++;
+    }
+    return n;
+}
+
+} // namespace
+
+
+void* Sequence::promise_type::operator new(size_t size) noexcept
+{
+    uint32_t largest = s_pool.largest.load(std::memory_order_relaxed);
+    while (size > largest && !s_pool.largest.compare_exchange_weak(largest, (uint32_t)size))
+    {
+    }
+
+    if (size <= Sequencer::kFrameSize)
+    {
+        uint32_t used = s_pool.used.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint32_t index = 0;
+            while (index < Sequencer::kFrames && (used & (1UL << index)) != 0U)
+            {
+                index++;
+            }
+            if (index == Sequencer::kFrames)
+            {
+                break;
+            }
+            uint32_t next = used | (1UL << index);
+            if (s_pool.used.compare_exchange_weak(used, next, std::memory_order_acquire))
+            {
+                uint32_t count = countBits(next);
+                uint32_t high = s_pool.highWater.load(std::memory_order_relaxed);
+                while (count > high && !s_pool.highWater.compare_exchange_weak(high, count))
+                {
+                }
+                return s_pool.blocks[index];
+            }
+        }
+    }
+
+    s_pool.failures.fetch_add(1U, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void Sequence::promise_type::operator delete(void* frame, size_t size) noexcept
+{
+    (void)size;
+    uint32_t index = (uint32_t)((static_cast<uint8_t*>(frame) - &s_pool.blocks[0][0]) / Sequencer::kFrameSize);
+    s_pool.used.fetch_and(~(1UL << index), std::memory_order_release);
+}
+
+void DelayAwaiter::await_suspend(Sequence::Handle handle) const noexcept
+{
+    Sequence::Wait& wait = handle.promise().wait;
+    wait.kind = Sequence::Wait::Kind::Time;
+    wait.start_us = Timebase::now_us();
+    wait.duration_us = ms * 1000U;
+}
+
+void PressureAwaiter::await_suspend(Sequence::Handle suspended) noexcept
+{
+    handle = suspended;
+    Sequence::Wait& wait = suspended.promise().wait;
+    wait.kind = Sequence::Wait::Kind::Pressure;
+    wait.rising = (source.getActualPressure() < target_bar);
+    wait.reached = false;
+    wait.start_us = Timebase::now_us();
+    wait.duration_us = timeout_us;
+    wait.source = &source;
+    wait.target_bar = target_bar;
+}
+
+void CrossingAwaiter::await_suspend(Sequence::Handle suspended) noexcept
+{
+    handle = suspended;
+    Sequence::Wait& wait = suspended.promise().wait;
+    wait.kind = Sequence::Wait::Kind::Crossing;
+    wait.reached = false;
+    wait.start_us = Timebase::now_us();
+    wait.duration_us = timeout_us;
+    wait.watch = &watch;
+    wait.firedBefore = watch.fired();
+    watch.arm(edge, threshold_volts, hysteresis_volts);
+}
+
+
+
+Sequencer::Sequencer()
+        : m_handles{},
+          m_resumes(0),
+          m_completed(0),
+          m_maxLateness_us(0)
+{
+    for (std::atomic<uint8_t>& slot : m_slots)
+    {
+        slot.store(Free, std::memory_order_relaxed);
+    }
+}
+
+bool Sequencer::spawn(Sequence&& sequence)
+{
+    if (!sequence.valid())
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < kMaxSequences; ++i)
+    {
+        uint8_t expected = Free;
+        if (m_slots[i].compare_exchange_strong(expected, Claimed, std::memory_order_acquire))
+        {
+            m_handles[i] = sequence.m_handle;
+            sequence.m_handle = nullptr;
+            m_slots[i].store(Running, std::memory_order_release);
+            return true;
+        }
+    }
+    return false; // ~Sequence() frees the frame
+}
+
+bool Sequencer::isDue(Sequence::Wait& wait, uint32_t now)
+{
+    uint32_t elapsed = now - wait.start_us;
+    switch (wait.kind)
+    {
+        case Sequence::Wait::Kind::Time:
+            return elapsed >= wait.duration_us;
+
+        case Sequence::Wait::Kind::Pressure:
+        {
+            float bar = wait.source->getActualPressure();
+            wait.reached = wait.rising ? (bar >= wait.target_bar) : (bar <= wait.target_bar);
+            return wait.reached || (wait.duration_us != 0U && elapsed >= wait.duration_us);
+        }
+
+        case Sequence::Wait::Kind::Crossing:
+        {
+            wait.reached = (wait.watch->fired() != wait.firedBefore);
+            if (wait.reached)
+            {
+                ThresholdWatch::Event event;
+                wait.watch->poll(event);
+                return true;
+            }
+            if (wait.duration_us != 0U && elapsed >= wait.duration_us)
+            {
+                wait.watch->disarm();
+                return true;
+            }
+            return false;
+        }
+
+        default:
+            return true;
+    }
+}
+
+uint32_t Sequencer::service()
+{
+    uint32_t running = 0;
+    for (uint32_t i = 0; i < kMaxSequences; ++i)
+    {
+        if (m_slots[i].load(std::memory_order_acquire) != Running)
+        {
+            continue;
+        }
+        Sequence::Handle handle = m_handles[i];
+        Sequence::Wait& wait = handle.promise().wait;
+        uint32_t now = Timebase::now_us();
+        if (!isDue(wait, now))
+        {
+            running++;
+            continue;
+        }
+
+        if (wait.kind == Sequence::Wait::Kind::Time)
+        {
+            uint32_t lateness = (now - wait.start_us) - wait.duration_us;
+            m_maxLateness_us = (lateness > m_maxLateness_us) ? lateness : m_maxLateness_us;
+        }
+        wait.kind = Sequence::Wait::Kind::None;
+        m_resumes++;
+        handle.resume();
+
+        if (handle.done())
+        {
+            handle.destroy();
+            m_handles[i] = nullptr;
+            m_completed++;
+            m_slots[i].store(Free, std::memory_order_release);
+        }
+        else
+        {
+            running++;
+        }
+    }
+    return running;
+}
+
+Sequencer::Stats Sequencer::stats() const
+{
+    Stats stats;
+    stats.resumes = m_resumes;
+    stats.completed = m_completed;
+    stats.maxLateness_us = m_maxLateness_us;
+    stats.framesInUse = countBits(s_pool.used.load(std::memory_order_relaxed));
+    stats.framesHighWater = s_pool.highWater.load(std::memory_order_relaxed);
+    stats.largestFrame_bytes = s_pool.largest.load(std::memory_order_relaxed);
+    stats.allocationFailures = s_pool.failures.load(std::memory_order_relaxed);
+    return stats;
+}
+
+#if defined(USE_HAL_DRIVER)
+
+namespace {
+
+StaticThread<> s_thread;
+
+void sequencerTask(void* argument)
+{
+    Sequencer* sequencer = static_cast<Sequencer*>(argument);
+    for (;;)
+    {
+        sequencer->service();
+        osDelay(1);
+    }
+}
+
+} // namespace
+
+void Sequencer::startTask(int32_t priority)
+{
+    if (s_thread.start("Sequencer", (osPriority_t)priority, sequencerTask, this) == nullptr)
+    {
+        Error_Handler();
+    }
+}
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file ThresholdWatch.cpp
+ * @brief Window placement for priming/arming, and the event queue.
+ */
+
+#include "ThresholdWatch.h"
+#include "InterruptLock.h"
+
+#if defined(USE_HAL_DRIVER)
+#include "main.h"
+#include "cmsis_os.h"
+#endif
+
+namespace {
+
+constexpr uint16_t kMaxCounts = 4095;
+
+uint16_t toCounts(float volts, float voltsPerCount)
+{
+    float counts = volts / voltsPerCount + 0.5f;
+    return (counts <= 0.0f) ? 0U : (counts >= (float)kMaxCounts) ? kMaxCounts : (uint16_t)counts;
+}
+
+} // namespace
+
+
+ThresholdWatch::ThresholdWatch(IAnalogWatchdog& watchdog)
+        : m_watchdog(watchdog),
+          m_state(State::Idle),
+          m_edge(Edge::Rising),
+          m_threshold(0),
+          m_primeLevel(0),
+          m_queue{},
+          m_head(0),
+          m_tail(0),
+          m_fired(0),
+          m_lost(0),
+          m_waiter(nullptr)
+{
+    m_watchdog.setWindow(0, kMaxCounts);
+    m_watchdog.attach(&ThresholdWatch::onWindow, this);
+}
+
+void ThresholdWatch::arm(Edge edge, float threshold_volts, float hysteresis_volts)
+{
+    float scale = m_watchdog.voltsPerCount();
+    float primeVolts = (edge == Edge::Rising) ? threshold_volts - hysteresis_volts : threshold_volts + hysteresis_volts;
+
+    InterruptLock lock;
+    m_edge = edge;
+    m_threshold = toCounts(threshold_volts, scale);
+    m_primeLevel = toCounts(primeVolts, scale);
+    // A prime level clamped to the end of the range could never be passed.
+    bool canPrime = (edge == Edge::Rising) ? (m_primeLevel > 0U) : (m_primeLevel < kMaxCounts);
+    bool prime = (hysteresis_volts > 0.0f) && canPrime;
+    m_state.store(prime ? State::Priming : State::Armed, std::memory_order_release);
+    placeWindow();
+}
+
+void ThresholdWatch::disarm()
+{
+    InterruptLock lock;
+    m_state.store(State::Idle, std::memory_order_release);
+    placeWindow();
+}
+
+/**
+ * @brief The window holds the side the signal is expected to leave:
+ *   Rising  priming [prime, max]  -> fires below prime
+ *           armed   [0, threshold] -> fires above threshold
+ *   Falling priming [0, prime]    -> fires above prime
+ *           armed   [threshold, max] -> fires below threshold
+ */
+void ThresholdWatch::placeWindow()
+{
+    State state = m_state.load(std::memory_order_relaxed);
+    bool rising = (m_edge == Edge::Rising);
+    if (state == State::Priming)
+    {
+        m_watchdog.setWindow(rising ? m_primeLevel : 0U, rising ? kMaxCounts : m_primeLevel);
+    }
+    else if (state == State::Armed)
+    {
+        m_watchdog.setWindow(rising ? 0U : m_threshold, rising ? m_threshold : kMaxCounts);
+    }
+    else
+    {
+        m_watchdog.setWindow(0, kMaxCounts);
+    }
+}
+
+void ThresholdWatch::onWindow(void* context, uint16_t counts, uint32_t time_us)
+{
+    static_cast<ThresholdWatch*>(context)->handle(counts, time_us);
+}
+
+void ThresholdWatch::handle(uint16_t counts, uint32_t time_us)
+{
+    State state = m_state.load(std::memory_order_relaxed);
+    if (state == State::Priming)
+    {
+        m_state.store(State::Armed, std::memory_order_release);
+        placeWindow();
+        return;
+    }
+    if (state != State::Armed)
+    {
+        placeWindow(); // stale: disarmed while the conversion was in flight
+        return;
+    }
+
+    m_state.store(State::Idle, std::memory_order_release);
+    placeWindow();
+
+    uint32_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= kQueueDepth)
+    {
+        m_lost++;
+    }
+    else
+    {
+        m_queue[head % kQueueDepth] = Event{time_us, counts, m_edge};
+        m_head.store(head + 1U, std::memory_order_release);
+    }
+    m_fired.fetch_add(1U, std::memory_order_release);
+
+#if defined(USE_HAL_DRIVER)
+    void* waiter = m_waiter;
+    if (waiter != nullptr)
+    {
+        osThreadFlagsSet((osThreadId_t)waiter, kEventFlag);
+    }
+#endif
+}
+
+bool ThresholdWatch::poll(Event& event)
+{
+    uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    event = m_queue[tail % kQueueDepth];
+    m_tail.store(tail + 1U, std::memory_order_release);
+    return true;
+}
+
+#if defined(USE_HAL_DRIVER)
+
+bool ThresholdWatch::wait(Event& event, uint32_t timeout_ms)
+{
+    m_waiter = osThreadGetId();
+    bool got = poll(event);
+    while (!got)
+    {
+        uint32_t flags = osThreadFlagsWait(kEventFlag, osFlagsWaitAny, timeout_ms);
+        if ((flags & osFlagsError) != 0U)
+        {
+            break; // timeout
+        }
+        got = poll(event);
+    }
+    m_waiter = nullptr;
+    return got;
+}
+
+#endif
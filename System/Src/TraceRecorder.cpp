@@ -0,0 +1,125 @@
+/**
+ * @file TraceRecorder.cpp
+ * @brief Lock-free event ring (SlotRing) behind the FreeRTOS trace hooks.
+ */
+
+#include "TraceRecorder.h"
+#include "SlotRing.h"
+#include "Timebase.h"
+
+#include <atomic>
+#include <string.h>
+
+namespace {
+
+SlotRing<TraceRecorder::Event, TRACE_RECORDER_EVENTS> s_ring;
+std::atomic<bool> s_enabled{false};
+std::atomic<uint32_t> s_queueNumber{0};
+
+TraceRecorder::TaskName s_names[TraceRecorder::kMaxTaskNames];
+
+} // namespace
+
+
+extern "C" void TraceRecorder_Record(uint8_t type, uint8_t object, uint16_t payload)
+{
+    if (!s_enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    s_ring.push([&](TraceRecorder::Event& event) {
+        event.t_us = Timebase::now_us();
+        event.type = type;
+        event.object = object;
+        event.payload = payload;
+    });
+}
+
+extern "C" void TraceRecorder_TaskCreated(uint32_t taskNumber, const char* name)
+{
+    TraceRecorder::TaskName& entry = s_names[taskNumber % TraceRecorder::kMaxTaskNames];
+    entry.taskNumber = (uint8_t)taskNumber;
+    strncpy(entry.name, name, TraceRecorder::kNameLength - 1U);
+    entry.name[TraceRecorder::kNameLength - 1U] = '\0';
+}
+
+extern "C" uint32_t TraceRecorder_NextQueueNumber(void)
+{
+    return s_queueNumber.fetch_add(1U, std::memory_order_relaxed) + 1U;
+}
+
+
+void TraceRecorder::start()
+{
+    s_ring.skipPending();
+    s_enabled.store(true, std::memory_order_release);
+}
+
+void TraceRecorder::stop()
+{
+    s_enabled.store(false, std::memory_order_release);
+}
+
+size_t TraceRecorder::drain(uint8_t* buf, size_t len)
+{
+    if (buf == nullptr || len < sizeof(ChunkHeader) + sizeof(Event))
+    {
+        return 0;
+    }
+
+    size_t capacity = (len - sizeof(ChunkHeader)) / sizeof(Event);
+    if (capacity > 0xFFFFU)
+    {
+        capacity = 0xFFFFU;
+    }
+    size_t count = s_ring.pop((Event*)(buf + sizeof(ChunkHeader)), capacity);
+    if (count == 0U && s_ring.dropped() == 0U)
+    {
+        return 0;
+    }
+
+    ChunkHeader header;
+    header.magic = kChunkMagic;
+    header.kind = kChunkEvents;
+    header.count = (uint16_t)count;
+    header.dropped = s_ring.takeDropped();
+    memcpy(buf, &header, sizeof(header));
+    return sizeof(ChunkHeader) + count * sizeof(Event);
+}
+
+size_t TraceRecorder::encodeTaskNames(uint8_t* buf, size_t len)
+{
+    uint16_t count = 0;
+    for (const TaskName& entry : s_names)
+    {
+        if (entry.name[0] != '\0')
+        {
+            count++;
+        }
+    }
+
+    size_t needed = sizeof(ChunkHeader) + count * sizeof(TaskName);
+    if (buf == nullptr || len < needed)
+    {
+        return 0;
+    }
+
+    ChunkHeader header;
+    header.magic = kChunkMagic;
+    header.kind = kChunkTaskNames;
+    header.count = count;
+    header.dropped = 0;
+    memcpy(buf, &header, sizeof(header));
+
+    uint8_t* out = buf + sizeof(ChunkHeader);
+    for (const TaskName& entry : s_names)
+    {
+        if (entry.name[0] != '\0')
+        {
+            memcpy(out, &entry, sizeof(TaskName));
+            out += sizeof(TaskName);
+        }
+    }
+    return needed;
+}
@@ -0,0 +1,51 @@
+#ifndef FIRMWARE_TESTS_CHECK_H
+#define FIRMWARE_TESTS_CHECK_H
+
+#pragma once
+
+/**
+ * @file Check.h
+ * @brief The smallest assert kit that does the job: no exceptions, no
+ * framework to install, so the tests build wherever the firmware sources do.
+ *
+ * A failed CHECK prints file:line and carries on; main() returns
+ * Check::finish() so ctest sees the failure.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+namespace Check {
+
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char* file, int line, const char* what)
+{
+    printf("%s:%d: CHECK(%s) failed\n", file, line, what);
+    failures()++;
+}
+
+inline int finish()
+{
+    if (failures() != 0)
+    {
+        printf("%d check(s) failed\n", failures());
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
+
+} // namespace Check
+
+#define CHECK(cond) \
+    do { if (!(cond)) Check::fail(__FILE__, __LINE__, #cond); } while (0)
+
+#define CHECK_NEAR(a, b, tol) \
+    do { if (fabs((double)(a) - (double)(b)) > (double)(tol)) Check::fail(__FILE__, __LINE__, #a " ~= " #b); } while (0)
+
+#endif //FIRMWARE_TESTS_CHECK_H
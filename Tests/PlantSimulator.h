@@ -0,0 +1,134 @@
+#ifndef FIRMWARE_TESTS_PLANTSIMULATOR_H
+#define FIRMWARE_TESTS_PLANTSIMULATOR_H
+
+#pragma once
+
+/**
+ * @file PlantSimulator.h
+ * @brief Host model of the VPPE and the chamber it feeds, seen through
+ * IPressureControl: setPressure() is the setpoint, getActualPressure() the
+ * measured feedback.
+ *
+ * Setpoint -> dead time -> valve lag -> chamber lag -> pressure, plus
+ * Gaussian sensor noise on the reading. Both lags are first order and
+ * discretised exactly for the fixed step, so the model is stable at any
+ * step size. step() advances it by one step; the caller owns time.
+ *
+ * The parameters can be changed while it runs (setParams), e.g. to make the
+ * valve drift under an identifier.
+ */
+
+#include "Interfaces/IPressureControl.h"
+
+#include <math.h>
+#include <stdint.h>
+
+class PlantSimulator final : public IPressureControl {
+public:
+    struct Params {
+        float gain;         // steady-state bar per bar of setpoint
+        float deadTime_s;   // transport delay of the pneumatics
+        float valveTau_s;   // VPPE response
+        float chamberTau_s; // volume filling through the line
+        float noise_bar;    // sensor noise, standard deviation
+    };
+
+    // A VPPE on a small chamber: ~12 ms dead time, ~25 ms + 8 ms lags.
+    static constexpr Params kVppe = {1.0f, 0.012f, 0.025f, 0.008f, 0.0f};
+
+    static constexpr uint32_t kMaxDelaySteps = 4096;
+
+    PlantSimulator(const Params& params, float dt_s)
+            : m_dt_s(dt_s)
+    {
+        setParams(params);
+    }
+
+    void setParams(const Params& params)
+    {
+        m_params = params;
+        m_delaySteps = (uint32_t)(params.deadTime_s / m_dt_s + 0.5f);
+        if (m_delaySteps >= kMaxDelaySteps)
+        {
+            m_delaySteps = kMaxDelaySteps - 1U;
+        }
+        m_valveAlpha = 1.0f - expf(-m_dt_s / params.valveTau_s);
+        m_chamberAlpha = 1.0f - expf(-m_dt_s / params.chamberTau_s);
+    }
+
+    const Params& params() const { return m_params; }
+
+    bool setPressure(float bar) override
+    {
+        m_setpoint = (bar < 0.0f) ? 0.0f : (bar > 2.0f) ? 2.0f : bar;
+        return true;
+    }
+
+    float getActualPressure() override
+    {
+        return m_pressure + m_params.noise_bar * gaussian();
+    }
+
+    /**
+     * @brief Advances the model by one step.
+     */
+    void step()
+    {
+        m_delay[m_head] = m_setpoint;
+        float delayed = m_delay[(m_head + kMaxDelaySteps - m_delaySteps) % kMaxDelaySteps];
+        m_head = (m_head + 1U) % kMaxDelaySteps;
+
+        m_valve += (m_params.gain * delayed - m_valve) * m_valveAlpha;
+        m_pressure += (m_valve - m_pressure) * m_chamberAlpha;
+    }
+
+    /**
+     * @brief Noise-free chamber pressure.
+     */
+    float pressure() const { return m_pressure; }
+    float setpoint() const { return m_setpoint; }
+    float dt_s() const { return m_dt_s; }
+
+private:
+    /**
+     * @brief Standard normal deviate, deterministic (LCG + Box-Muller).
+     */
+    float gaussian()
+    {
+        if (m_haveSpare)
+        {
+            m_haveSpare = false;
+            return m_spare;
+        }
+        float u1 = uniform();
+        float u2 = uniform();
+        float r = sqrtf(-2.0f * logf(u1));
+        m_spare = r * sinf(6.2831853f * u2);
+        m_haveSpare = true;
+        return r * cosf(6.2831853f * u2);
+    }
+
+    float uniform()
+    {
+        m_seed = m_seed * 1664525U + 1013904223U;
+        return ((float)(m_seed >> 8) + 0.5f) * (1.0f / 16777216.0f);
+    }
+
+    Params m_params;
+    float m_dt_s;
+    uint32_t m_delaySteps = 0;
+    float m_valveAlpha = 1.0f;
+    float m_chamberAlpha = 1.0f;
+
+    float m_delay[kMaxDelaySteps] = {};
+    uint32_t m_head = 0;
+    float m_setpoint = 0.0f;
+    float m_valve = 0.0f;
+    float m_pressure = 0.0f;
+
+    uint32_t m_seed = 2463534242U;
+    bool m_haveSpare = false;
+    float m_spare = 0.0f;
+};
+
+#endif //FIRMWARE_TESTS_PLANTSIMULATOR_H
@@ -0,0 +1,347 @@
+/**
+ * @file bench_cyclic_executive.cpp
+ * @brief Release latency and jitter of the cyclic executive run from the
+ * timer "interrupt" against the same table run from a task it wakes.
+ *
+ * A POSIX timer stands in for TIM7: every kFrame_us it signals the
+ * background thread, which is always busy, the way the MCU is always
+ * running some lower-priority task. The signal handler is the interrupt.
+ *   - Interrupt mode: the handler runs the frame itself.
+ *   - Task mode: the handler posts a semaphore and a higher-priority
+ *     executive thread runs the frame, i.e. CyclicExecutive::frameTask().
+ * Every thread is pinned to one CPU, like the Cortex-M4. Latency is the
+ * time from the timer's nominal expiry to the start of the frame, which is
+ * what TIM7->CNT gives on the target. Host numbers are larger than the
+ * target's, but both modes pay the same timer and signal delivery, so the
+ * difference between the rows is the scheduler's wake-up path.
+ */
+
+#include "Check.h"
+#include "CyclicExecutive.h"
+#include "Timebase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t kFrame_us = 1000;
+constexpr uint32_t kFrames = 2000;
+constexpr uint64_t kFrame_ns = kFrame_us * 1000ULL;
+
+// Small fixed amounts of work standing in for the fast loop.
+struct Loop {
+    float raw[16];
+    float filtered[16];
+    float command;
+    float published;
+    uint32_t cycles;
+};
+
+void acquire(void* context)
+{
+    Loop& loop = *static_cast<Loop*>(context);
+    for (uint32_t i = 0; i < 16U; ++i)
+    {
+        loop.raw[i] = 0.5f + 0.01f * (float)((loop.cycles + i) % 7U);
+    }
+    loop.cycles++;
+}
+
+void filter(void* context)
+{
+    Loop& loop = *static_cast<Loop*>(context);
+    for (uint32_t i = 0; i < 16U; ++i)
+    {
+        loop.filtered[i] += 0.2f * (loop.raw[i] - loop.filtered[i]);
+    }
+}
+
+void control(void* context)
+{
+    Loop& loop = *static_cast<Loop*>(context);
+    float mean = 0.0f;
+    for (uint32_t i = 0; i < 16U; ++i)
+    {
+        mean += loop.filtered[i];
+    }
+    loop.command = 1.0f - mean / 16.0f;
+}
+
+void actuate(void* context)
+{
+    Loop& loop = *static_cast<Loop*>(context);
+    loop.command = std::clamp(loop.command, 0.0f, 1.0f);
+}
+
+void publish(void* context)
+{
+    Loop& loop = *static_cast<Loop*>(context);
+    loop.published = loop.command;
+}
+
+Loop s_loop = {};
+
+constexpr CyclicExecutive::Slot kTable[] = {
+    {"acquire", acquire, &s_loop, 1, 0, 100},
+    {"filter", filter, &s_loop, 1, 0, 100},
+    {"control", control, &s_loop, 1, 0, 200},
+    {"actuate", actuate, &s_loop, 1, 0, 100},
+    {"publish", publish, &s_loop, 10, 5, 100},
+};
+constexpr uint32_t kSlots = sizeof(kTable) / sizeof(kTable[0]);
+static_assert(CyclicExecutive::fits(kTable, kSlots, kFrame_us), "fast loop does not fit the frame");
+
+uint64_t monotonic_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Shared between the handler, the executive thread and main().
+CyclicExecutive* s_executive = nullptr;
+CyclicExecutive::Mode s_mode = CyclicExecutive::Mode::Interrupt;
+timer_t s_timer;
+uint64_t s_firstRelease_ns = 0;
+std::atomic<uint32_t> s_released{0};
+sem_t s_wake;
+uint32_t s_latency_ns[kFrames];
+std::atomic<uint32_t> s_recorded{0};
+std::atomic<bool> s_stop{false};
+
+/**
+ * @brief Start of frame, as both drivers do it: latency since the latest
+ * release, then the frame.
+ */
+void startFrame(uint32_t released, uint32_t missed)
+{
+    uint64_t due = s_firstRelease_ns + (uint64_t)(released - 1U) * kFrame_ns;
+    uint64_t latency = monotonic_ns() - due;
+    uint32_t index = s_recorded.load(std::memory_order_relaxed);
+    if (index < kFrames)
+    {
+        s_latency_ns[index] = (uint32_t)latency;
+        s_recorded.store(index + 1U, std::memory_order_release);
+    }
+    s_executive->runFrame((uint32_t)(latency / 1000U), missed);
+}
+
+void onTimer(int)
+{
+    int overrun = timer_getoverrun(s_timer); // expiries folded into this one
+    uint32_t released = s_released.load(std::memory_order_relaxed) + 1U + (uint32_t)overrun;
+    s_released.store(released, std::memory_order_release);
+
+    if (s_mode == CyclicExecutive::Mode::Interrupt)
+    {
+        startFrame(released, (uint32_t)overrun);
+        return;
+    }
+    sem_post(&s_wake);
+}
+
+void pinToThisCpu(pthread_t thread, int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+int s_cpu = 0;
+std::atomic<pid_t> s_backgroundTid{0};
+volatile float s_sink = 0.0f;
+
+void* background(void*)
+{
+    pinToThisCpu(pthread_self(), s_cpu);
+    sigset_t alarm;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    pthread_sigmask(SIG_UNBLOCK, &alarm, nullptr);
+    s_backgroundTid.store(gettid(), std::memory_order_release);
+
+    float x = 1.0f;
+    while (!s_stop.load(std::memory_order_relaxed))
+    {
+        x = x * 0.999f + 0.001f;
+    }
+    s_sink = x;
+    return nullptr;
+}
+
+bool s_realtime = false;
+
+void* executiveTask(void*)
+{
+    pinToThisCpu(pthread_self(), s_cpu);
+    uint32_t consumed = 0;
+    while (!s_stop.load(std::memory_order_relaxed))
+    {
+        while (sem_wait(&s_wake) != 0)
+        {
+        }
+        while (sem_trywait(&s_wake) == 0)
+        {
+            // ulTaskNotifyTake(pdTRUE, ...) clears every pending give
+        }
+        uint32_t released = s_released.load(std::memory_order_acquire);
+        if (released == consumed)
+        {
+            continue; // stop request
+        }
+        startFrame(released, released - consumed - 1U);
+        consumed = released;
+    }
+    return nullptr;
+}
+
+struct Result {
+    uint32_t min_ns;
+    uint32_t mean_ns;
+    uint32_t median_ns;
+    uint32_t p99_ns;
+    uint32_t max_ns;
+    CyclicExecutive::RecordHeader header;
+    CyclicExecutive::SlotRow rows[kSlots];
+};
+
+Result run(CyclicExecutive::Mode mode)
+{
+    static CyclicExecutive interruptExecutive(kTable, kSlots, kFrame_us);
+    static CyclicExecutive taskExecutive(kTable, kSlots, kFrame_us);
+    s_executive = (mode == CyclicExecutive::Mode::Interrupt) ? &interruptExecutive : &taskExecutive;
+    s_mode = mode;
+    s_released.store(0);
+    s_recorded.store(0);
+    s_stop.store(false);
+    s_backgroundTid.store(0);
+
+    pthread_t backgroundThread;
+    pthread_create(&backgroundThread, nullptr, background, nullptr);
+    pthread_t executiveThread;
+    if (mode == CyclicExecutive::Mode::Task)
+    {
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        sched_param param = {};
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+        pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attributes, SCHED_FIFO);
+        pthread_attr_setschedparam(&attributes, &param);
+        s_realtime = pthread_create(&executiveThread, &attributes, executiveTask, nullptr) == 0;
+        if (!s_realtime)
+        {
+            pthread_create(&executiveThread, nullptr, executiveTask, nullptr); // no CAP_SYS_NICE
+        }
+        pthread_attr_destroy(&attributes);
+    }
+    while (s_backgroundTid.load(std::memory_order_acquire) == 0)
+    {
+        sched_yield();
+    }
+
+    sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGALRM;
+    event._sigev_un._tid = s_backgroundTid.load();
+    timer_create(CLOCK_MONOTONIC, &event, &s_timer);
+
+    s_firstRelease_ns = monotonic_ns() + kFrame_ns;
+    itimerspec period = {};
+    period.it_value.tv_sec = (time_t)(s_firstRelease_ns / 1000000000ULL);
+    period.it_value.tv_nsec = (long)(s_firstRelease_ns % 1000000000ULL);
+    period.it_interval.tv_nsec = (long)kFrame_ns;
+    timer_settime(s_timer, TIMER_ABSTIME, &period, nullptr);
+
+    while (s_recorded.load(std::memory_order_acquire) < kFrames)
+    {
+        usleep(10000);
+    }
+    timer_delete(s_timer);
+    s_stop.store(true);
+    pthread_join(backgroundThread, nullptr);
+    if (mode == CyclicExecutive::Mode::Task)
+    {
+        sem_post(&s_wake);
+        pthread_join(executiveThread, nullptr);
+    }
+
+    Result result = {};
+    uint8_t record[sizeof(CyclicExecutive::RecordHeader) + kSlots * sizeof(CyclicExecutive::SlotRow)];
+    CHECK(s_executive->encode(record, sizeof(record)) == sizeof(record));
+    memcpy(&result.header, record, sizeof(result.header));
+    memcpy(result.rows, record + sizeof(result.header), sizeof(result.rows));
+
+    std::sort(s_latency_ns, s_latency_ns + kFrames);
+    uint64_t sum = 0;
+    for (uint32_t latency : s_latency_ns)
+    {
+        sum += latency;
+    }
+    result.min_ns = s_latency_ns[0];
+    result.mean_ns = (uint32_t)(sum / kFrames);
+    result.median_ns = s_latency_ns[kFrames / 2U];
+    result.p99_ns = s_latency_ns[kFrames * 99U / 100U];
+    result.max_ns = s_latency_ns[kFrames - 1U];
+    return result;
+}
+
+void print(const char* name, const Result& r)
+{
+    printf("  %-9s %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %7u %7u\n", name, r.min_ns / 1000.0,
+           r.median_ns / 1000.0, r.mean_ns / 1000.0, r.p99_ns / 1000.0, r.max_ns / 1000.0, (r.p99_ns - r.min_ns) / 1000.0,
+           (r.max_ns - r.min_ns) / 1000.0, r.header.missedFrames, r.header.frameOverruns);
+}
+
+} // namespace
+
+int main()
+{
+    Timebase::setHostMode(Timebase::HostMode::Wall);
+    Timebase::init();
+
+    s_cpu = sched_getcpu();
+    sem_init(&s_wake, 0, 0);
+    sigset_t alarm;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarm, nullptr); // only the background thread takes it
+    struct sigaction action = {};
+    action.sa_handler = onTimer;
+    sigaction(SIGALRM, &action, nullptr);
+
+    Result interrupt = run(CyclicExecutive::Mode::Interrupt);
+    Result task = run(CyclicExecutive::Mode::Task);
+
+    printf("Release latency over %u frames of %u us, one CPU, busy background (us)\n", kFrames, kFrame_us);
+    printf("  %-9s %8s %8s %8s %8s %8s %8s %8s %7s %7s\n", "mode", "min", "median", "mean", "p99", "max",
+           "jit p99", "jit max", "missed", "overrun");
+    print("interrupt", interrupt);
+    print("task", task);
+    printf("  executive thread %s\n", s_realtime ? "SCHED_FIFO" : "SCHED_OTHER (no permission for FIFO)");
+
+    for (const Result* r : {&interrupt, &task})
+    {
+        CHECK(r->header.magic == CyclicExecutive::kRecordMagic);
+        CHECK(r->header.slotCount == kSlots);
+        // The record keeps counting until the timer is deleted.
+        CHECK(r->header.frames >= kFrames);
+        CHECK(r->rows[0].runs == r->header.frames);
+        CHECK(r->rows[4].runs * 10U + 10U >= r->header.frames && r->rows[4].runs * 10U <= r->header.frames + 5U);
+        CHECK(r->header.latencyMin_us <= r->header.latencyMean_us);
+        CHECK(r->header.latencyMean_us <= r->header.latencyMax_us);
+    }
+    // Which mode wins is printed above, not checked: on a loaded host the
+    // scheduler, not the executive, decides the latencies.
+
+    return Check::finish();
+}
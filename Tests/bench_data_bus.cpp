@@ -0,0 +1,92 @@
+/**
+ * @file bench_data_bus.cpp
+ * @brief Host timing of the bus hot paths against the mutex-guarded copy
+ * they replace. DataBus::measureCosts() gives the target cycle counts in
+ * a MEASURE_COSTS build; this shows the relative cost on any machine.
+ */
+
+#include "BusTopics.h"
+#include "Check.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace {
+
+constexpr uint32_t kRuns = 1000000;
+
+/**
+ * @brief The obvious alternative: latest value behind a mutex. On the
+ * target this is the priority-inheritance mutex the bus avoids.
+ */
+template <typename T>
+class LockedValue {
+public:
+    void publish(const T& value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_value = value;
+    }
+
+    bool read(T& out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        out = m_value;
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    T m_value{};
+};
+
+template <typename Body>
+double nsPerRun(Body body)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kRuns; ++i)
+    {
+        body(i);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / kRuns;
+}
+
+} // namespace
+
+int main()
+{
+    static DataBus::Topic<Bus::Pressure> topic("benchPressure");
+    static DataBus::HistoryTopic<Bus::PressureBlock, 4> blocks("benchBlocks");
+    static LockedValue<Bus::Pressure> locked;
+    static LockedValue<Bus::PressureBlock> lockedBlock;
+    static Bus::PressureBlock block = {};
+    Bus::Pressure value = {0, 1.0f};
+    uint32_t sink = 0;
+
+    double publish = nsPerRun([&](uint32_t i) { value.t_us = i; topic.publish(value); });
+    double read = nsPerRun([&](uint32_t) { sink += topic.read(value) ? 1U : 0U; });
+    double blockInPlace = nsPerRun([&](uint32_t i) {
+        blocks.beginPublish().count = i;
+        blocks.endPublish();
+    });
+    double blockCopy = nsPerRun([&](uint32_t i) { block.count = i; blocks.publish(block); });
+    double lockedPublish = nsPerRun([&](uint32_t i) { value.t_us = i; locked.publish(value); });
+    double lockedRead = nsPerRun([&](uint32_t) { sink += locked.read(value) ? 1U : 0U; });
+    double lockedBlockPublish = nsPerRun([&](uint32_t i) { block.count = i; lockedBlock.publish(block); });
+
+    printf("%-34s %8s %8s\n", "ns per call (host)", "bus", "mutex");
+    printf("%-34s %8.1f %8.1f\n", "Pressure publish", publish, lockedPublish);
+    printf("%-34s %8.1f %8.1f\n", "Pressure read", read, lockedRead);
+    printf("%-34s %8.1f %8s\n", "PressureBlock begin/endPublish", blockInPlace, "-");
+    printf("%-34s %8.1f %8.1f\n", "PressureBlock publish (copy)", blockCopy, lockedBlockPublish);
+    printf("(%u reads)\n", sink);
+
+    // Timings are for reading, not for gating: under a parallel ctest run the
+    // ratios say more about the machine's load than about the bus.
+    Bus::Pressure last = {};
+    CHECK(topic.read(last));
+    CHECK(last.t_us == value.t_us);
+
+    return Check::finish();
+}
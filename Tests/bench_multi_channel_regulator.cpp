@@ -0,0 +1,214 @@
+/**
+ * @file bench_multi_channel_regulator.cpp
+ * @brief Cost of MultiChannelRegulator::tick() for 1..8 channels, the
+ * per-channel phase offset, the setpoint cap and preset crossfades.
+ *
+ * Every channel runs on a FakeAnalogOut looped back into a FakeAnalogIn,
+ * so the numbers are the framework's own cost (three passes over the
+ * arrays, one virtual read and write per channel), without the converters.
+ * Each count is timed several times and the fastest repetition kept, to
+ * stay clear of the host's scheduling noise. The timings are printed, not
+ * checked: a loaded machine (ctest -j) can make any ratio come out wrong.
+ * The checks are on what the loop did, which does not depend on the clock.
+ */
+
+#include "Check.h"
+#include "HostBoard.h"
+#include "Interfaces/ISolenoidValve.h"
+#include "MultiChannelRegulator.h"
+#include "VppeCalibration.h"
+#include "WaveformPresetTable.h"
+
+#include <chrono>
+
+namespace {
+
+constexpr uint32_t kChannels = MultiChannelRegulator::kMaxChannels;
+constexpr uint32_t kTicks = 20000;
+constexpr uint32_t kRepetitions = 7;
+constexpr float kTick_s = 0.001f;
+
+FakeAnalogOut s_outputs[kChannels];
+FakeAnalogIn s_inputs[kChannels] = {
+    FakeAnalogIn(&s_outputs[0]), FakeAnalogIn(&s_outputs[1]), FakeAnalogIn(&s_outputs[2]), FakeAnalogIn(&s_outputs[3]),
+    FakeAnalogIn(&s_outputs[4]), FakeAnalogIn(&s_outputs[5]), FakeAnalogIn(&s_outputs[6]), FakeAnalogIn(&s_outputs[7]),
+};
+
+class CountingValve final : public ISolenoidValve {
+public:
+    void activate() override { m_opens++; }
+    void deactivate() override {}
+    uint32_t opens() const { return m_opens; }
+
+private:
+    uint32_t m_opens = 0;
+};
+
+CountingValve s_valves[kChannels];
+
+MultiChannelRegulator::Channel channel(uint32_t i, uint32_t count)
+{
+    return {&s_inputs[i], &s_outputs[i], &s_valves[i], (float)i / (float)count, 1.0f, 0.5f, 5.0f, 0.0f, 0.35f};
+}
+
+double tickCost_ns(uint32_t count)
+{
+    double best = 1e30;
+    for (uint32_t repetition = 0; repetition < kRepetitions; ++repetition)
+    {
+        MultiChannelRegulator regulator(kTick_s);
+        regulator.play(&WaveformPresetTable::kPresets[WaveformPresetTable::Rest], 1.0f);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            regulator.addChannel(channel(i, count));
+        }
+        regulator.tick(); // warm up
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t t = 0; t < kTicks; ++t)
+        {
+            regulator.tick();
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        double cost = elapsed.count() / kTicks;
+        best = (cost < best) ? cost : best;
+    }
+    return best;
+}
+
+/**
+ * @brief A channel offset by a quarter beat sees the first channel's
+ * reference a quarter beat later.
+ */
+void phaseOffset()
+{
+    constexpr uint32_t kBeatTicks = 1000; // rate scaled to 60 bpm at 1 kHz
+    const WaveformPreset& rest = WaveformPresetTable::kPresets[WaveformPresetTable::Rest];
+    MultiChannelRegulator regulator(kTick_s);
+    regulator.play(&rest, 60.0f / rest.rate_bpm, 0);
+    CHECK(regulator.addChannel(channel(0, 4)) == 0);
+    CHECK(regulator.addChannel(channel(1, 4)) == 1);
+
+    static float first[2 * kBeatTicks];
+    static float second[2 * kBeatTicks];
+    for (uint32_t t = 0; t < 2U * kBeatTicks; ++t)
+    {
+        regulator.tick();
+        first[t] = regulator.target(0);
+        second[t] = regulator.target(1);
+    }
+    float worst = 0.0f;
+    for (uint32_t t = 0; t < kBeatTicks; ++t)
+    {
+        float error = fabsf(second[t] - first[t + kBeatTicks / 4U]);
+        worst = (error > worst) ? error : worst;
+    }
+    CHECK(worst < 0.01f);
+
+    regulator.setPhaseOffset(1, 0.0f);
+    regulator.tick();
+    CHECK(regulator.target(1) == regulator.target(0));
+}
+
+/**
+ * @brief Doubling the exercise pulse asks for 3 bar; the channel stops at
+ * the configured setpoint cap, under the 1.9 bar trip.
+ */
+void setpointCapped()
+{
+    constexpr float kCap_bar = OverpressureThreshold::kDefaultConfig.max_setpoint_bar;
+    FakeAnalogOut output;
+    FakeAnalogIn input(&output);
+    MultiChannelRegulator regulator(kTick_s);
+    regulator.play(&WaveformPresetTable::kPresets[WaveformPresetTable::Exercise], 1.0f, 0);
+    regulator.addChannel({&input, &output, nullptr, 0.0f, 2.0f, 0.5f, 5.0f, 0.0f, 0.0f});
+
+    float highest = 0.0f;
+    float highestTarget = 0.0f;
+    for (uint32_t t = 0; t < 2000U; ++t)
+    {
+        regulator.tick();
+        highest = (output.voltage() > highest) ? output.voltage() : highest;
+        highestTarget = (regulator.target(0) > highestTarget) ? regulator.target(0) : highestTarget;
+    }
+    CHECK(highestTarget > 2.5f);
+    CHECK_NEAR(VppeCalibration::voltsToBar(highest), kCap_bar, 1e-4f);
+}
+
+/**
+ * @brief A preset change requested mid-beat waits for the boundary and
+ * fades in: the reference moves no faster than the presets themselves do.
+ */
+void presetSwitchIsSmooth()
+{
+    const WaveformPreset& rest = WaveformPresetTable::kPresets[WaveformPresetTable::Rest];
+    const WaveformPreset& failure = WaveformPresetTable::kPresets[WaveformPresetTable::HeartFailure];
+    FakeAnalogOut output;
+    FakeAnalogIn input(&output);
+    MultiChannelRegulator regulator(kTick_s);
+    regulator.play(&rest, 1.0f, 0);
+    regulator.addChannel({&input, &output, nullptr, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f});
+
+    float steadyStep = 0.0f;
+    float previous = 0.0f;
+    for (uint32_t t = 0; t < 3000U; ++t)
+    {
+        regulator.tick();
+        float step = fabsf(regulator.target(0) - previous);
+        steadyStep = (t > 0U && step > steadyStep) ? step : steadyStep;
+        previous = regulator.target(0);
+    }
+
+    regulator.play(&failure, 1.0f); // mid-beat, default fade
+    float switchStep = 0.0f;
+    float phaseAtRequest = regulator.phase();
+    bool tookOver = false;
+    for (uint32_t t = 0; t < 5000U; ++t)
+    {
+        regulator.tick();
+        float step = fabsf(regulator.target(0) - previous);
+        switchStep = (step > switchStep) ? step : switchStep;
+        previous = regulator.target(0);
+        tookOver = tookOver || (regulator.phase() < phaseAtRequest);
+    }
+    CHECK(phaseAtRequest > 0.1f);
+    CHECK(tookOver);
+    CHECK(switchStep <= 1.1f * steadyStep);
+    // Heart failure pressures by now: diastolic 0.3 bar at the beat start.
+    regulator.play(nullptr, 1.0f, 0);
+    for (uint32_t t = 0; t < 1000U; ++t)
+    {
+        regulator.tick();
+    }
+    CHECK(regulator.target(0) == 0.0f);
+}
+
+} // namespace
+
+int main()
+{
+    double cost[kChannels + 1] = {};
+    printf("tick() on fake IO, best of %u x %u ticks\n", kRepetitions, kTicks);
+    printf("  channels  ns/tick  ns/channel\n");
+    for (uint32_t count = 1; count <= kChannels; ++count)
+    {
+        cost[count] = tickCost_ns(count);
+        printf("  %8u %8.1f %11.1f\n", count, cost[count], cost[count] / count);
+    }
+    double perChannel = (cost[kChannels] - cost[1]) / (kChannels - 1U);
+    printf("  fixed ~%.1f ns, each further channel ~%.1f ns\n", cost[1] - perChannel, perChannel);
+
+    // Channel i took part in the sweeps for i + 1..kChannels channels: one
+    // setpoint write per tick, plus the write from the warm-up tick.
+    for (uint32_t i = 0; i < kChannels; ++i)
+    {
+        CHECK(s_outputs[i].writes() == (kChannels - i) * kRepetitions * (kTicks + 1U));
+        CHECK(s_valves[i].opens() > 0U);
+    }
+
+    phaseOffset();
+    setpointCapped();
+    presetSwitchIsSmooth();
+
+    return Check::finish();
+}
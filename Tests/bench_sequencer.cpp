@@ -0,0 +1,218 @@
+/**
+ * @file bench_sequencer.cpp
+ * @brief RAM and latency of the coroutine Sequencer against one FreeRTOS
+ * task per sequence.
+ *
+ * RAM: eight representative sequences (beat phases, valve pulse trains,
+ * a calibration ramp) run concurrently on the plant simulator; their frame
+ * sizes come from the Sequencer's own stats. Host frames hold 8-byte
+ * pointers, so they are an upper bound for the Cortex-M4. The task design
+ * is costed with the target's numbers: sizeof(StaticTask_t) for this
+ * FreeRTOSConfig and the 256-word stack every task in this tree gets.
+ *
+ * Latency: lateness of every delay on the 1 ms executor tick, which is
+ * what osDelay() gives a dedicated task too, and the cost of handing the
+ * CPU to a sequence: a coroutine resume against a thread switch. The
+ * switch is a host one, heavier than a FreeRTOS context switch, but it is
+ * the same kind of work (save, schedule, restore) the resume avoids.
+ */
+
+#include "Check.h"
+#include "Interfaces/ISolenoidValve.h"
+#include "PlantSimulator.h"
+#include "Sequencer.h"
+#include "Timebase.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+constexpr uint32_t kTick_us = 1000;
+constexpr size_t kTcbBytes = 96;        // sizeof(StaticTask_t), CM4F port, this config
+constexpr size_t kTaskStackBytes = 256 * 4;
+
+class CountingValve final : public ISolenoidValve {
+public:
+    void activate() override { m_cycles++; }
+    void deactivate() override {}
+    uint32_t cycles() const { return m_cycles; }
+
+private:
+    uint32_t m_cycles = 0;
+};
+
+Sequence beatPhases(IPressureControl& plant, uint32_t beats, float systolic_bar, float diastolic_bar)
+{
+    for (uint32_t beat = 0; beat < beats; ++beat)
+    {
+        plant.setPressure(systolic_bar);
+        co_await pressureReaches(plant, 0.9f * systolic_bar, 300000);
+        co_await delay_ms(270);
+        plant.setPressure(diastolic_bar);
+        co_await delay_ms(500);
+    }
+}
+
+Sequence valvePulses(ISolenoidValve& valve, uint32_t pulses, uint32_t on_ms, uint32_t off_ms)
+{
+    for (uint32_t i = 0; i < pulses; ++i)
+    {
+        valve.activate();
+        co_await delay_ms(on_ms);
+        valve.deactivate();
+        co_await delay_ms(off_ms);
+    }
+}
+
+Sequence calibration(IPressureControl& plant, float& gain)
+{
+    float sumSet = 0.0f;
+    float sumMeasured = 0.0f;
+    for (uint32_t step = 1; step <= 5U; ++step)
+    {
+        float setpoint = 0.2f * (float)step;
+        plant.setPressure(setpoint);
+        co_await delay_ms(200); // settle
+        float measured = 0.0f;
+        for (uint32_t i = 0; i < 10U; ++i)
+        {
+            measured += plant.getActualPressure();
+            co_await delay_ms(5);
+        }
+        sumSet += setpoint;
+        sumMeasured += measured / 10.0f;
+    }
+    gain = sumMeasured / sumSet;
+}
+
+Sequence spin(uint32_t resumes)
+{
+    for (uint32_t i = 0; i < resumes; ++i)
+    {
+        co_await delay_ms(0);
+    }
+}
+
+/**
+ * @brief ns per coroutine hand-over: one sequence re-suspending at once,
+ * resumed by service() in a loop.
+ */
+double resumeCost_ns(Sequencer& sequencer)
+{
+    constexpr uint32_t kResumes = 200000;
+    CHECK(sequencer.spawn(spin(kResumes)));
+    auto start = std::chrono::steady_clock::now();
+    while (sequencer.service() != 0U)
+    {
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / kResumes;
+}
+
+/**
+ * @brief ns per thread hand-over: two threads passing a turn back and
+ * forth, each wake-up a full block/schedule/restore.
+ */
+double threadSwitchCost_ns()
+{
+    constexpr uint32_t kRounds = 20000;
+    std::mutex mutex;
+    std::condition_variable turn;
+    bool ping = true;
+    auto start = std::chrono::steady_clock::now();
+    std::thread other([&] {
+        for (uint32_t i = 0; i < kRounds; ++i)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            turn.wait(lock, [&] { return !ping; });
+            ping = true;
+            turn.notify_one();
+        }
+    });
+    for (uint32_t i = 0; i < kRounds; ++i)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        turn.wait(lock, [&] { return ping; });
+        ping = false;
+        turn.notify_one();
+    }
+    other.join();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (2.0 * kRounds);
+}
+
+} // namespace
+
+int main()
+{
+    Timebase::setHostMode(Timebase::HostMode::Virtual);
+    Timebase::init();
+
+    static Sequencer sequencer;
+    PlantSimulator left(PlantSimulator::kVppe, kTick_us * 1e-6f);
+    PlantSimulator right(PlantSimulator::kVppe, kTick_us * 1e-6f);
+    PlantSimulator bench(PlantSimulator::kVppe, kTick_us * 1e-6f);
+    PlantSimulator rig[2] = {{PlantSimulator::kVppe, kTick_us * 1e-6f}, {PlantSimulator::kVppe, kTick_us * 1e-6f}};
+    CountingValve valves[3];
+    float gain[2] = {0.0f, 0.0f};
+
+    constexpr uint32_t kSequences = 8;
+    CHECK(sequencer.spawn(beatPhases(left, 5, 1.2f, 0.8f)));
+    CHECK(sequencer.spawn(beatPhases(right, 5, 1.0f, 0.6f)));
+    CHECK(sequencer.spawn(beatPhases(bench, 5, 0.8f, 0.4f)));
+    CHECK(sequencer.spawn(valvePulses(valves[0], 40, 20, 30)));
+    CHECK(sequencer.spawn(valvePulses(valves[1], 100, 3, 7)));
+    CHECK(sequencer.spawn(valvePulses(valves[2], 7, 150, 150)));
+    CHECK(sequencer.spawn(calibration(rig[0], gain[0])));
+    CHECK(sequencer.spawn(calibration(rig[1], gain[1])));
+
+    // One RTOS tick per pass, as in Sequencer::startTask().
+    while (sequencer.service() != 0U)
+    {
+        Timebase::advance(kTick_us);
+        left.step();
+        right.step();
+        bench.step();
+        rig[0].step();
+        rig[1].step();
+    }
+    Sequencer::Stats stats = sequencer.stats();
+
+    size_t frames = Sequencer::kFrames * Sequencer::kFrameSize;
+    size_t executorRam = frames + sizeof(Sequencer) + kTcbBytes + kTaskStackBytes;
+    size_t tasksRam = kSequences * (kTcbBytes + kTaskStackBytes);
+    size_t trimmedFrames = Sequencer::kFrames * ((stats.largestFrame_bytes + 7U) & ~7U);
+    printf("RAM for %u sequences\n", kSequences);
+    printf("  executor: %zu B pool (%u B largest frame, %u in use at most) + %zu B Sequencer"
+           " + %zu B task = %zu B\n", frames, stats.largestFrame_bytes, stats.framesHighWater,
+           sizeof(Sequencer), kTcbBytes + kTaskStackBytes, executorRam);
+    printf("  executor, pool trimmed to the largest frame: %zu B\n",
+           executorRam - frames + trimmedFrames);
+    printf("  one task per sequence: %u x (%zu B TCB + %zu B stack) = %zu B (heap: %u B)\n",
+           kSequences, kTcbBytes, kTaskStackBytes, tasksRam, 3072U);
+
+    double resume_ns = resumeCost_ns(sequencer);
+    double switch_ns = threadSwitchCost_ns();
+    printf("Latency\n");
+    printf("  worst delay lateness on the %u us tick: %u us over %u resumes\n", kTick_us,
+           stats.maxLateness_us, stats.resumes);
+    printf("  hand-over: coroutine resume %.0f ns, thread switch %.0f ns (host)\n", resume_ns, switch_ns);
+    printf("  calibration gains %.3f %.3f, valve cycles %u %u %u\n", (double)gain[0], (double)gain[1],
+           valves[0].cycles(), valves[1].cycles(), valves[2].cycles());
+
+    CHECK(stats.completed == kSequences);
+    CHECK(stats.allocationFailures == 0U);
+    CHECK(stats.largestFrame_bytes <= Sequencer::kFrameSize);
+    CHECK(stats.framesHighWater == kSequences);
+    CHECK(stats.maxLateness_us < kTick_us);
+    CHECK(valves[0].cycles() == 40U && valves[1].cycles() == 100U && valves[2].cycles() == 7U);
+    CHECK_NEAR(gain[0], 1.0f, 0.02f);
+    CHECK_NEAR(gain[1], 1.0f, 0.02f);
+    CHECK(executorRam * 2U < tasksRam);
+    // The hand-over costs are wall-clock and only printed.
+
+    return Check::finish();
+}
@@ -0,0 +1,237 @@
+/**
+ * @file bench_smith_predictor.cpp
+ * @brief Step and cardiac-waveform benchmarks of SmithPredictor on the
+ * plant simulator: the best plain PI against the harder PI the dead-time
+ * compensation allows, plus the same Smith loop on a mismatched plant.
+ *
+ * The PI tuning is the fastest found with under 6% step overshoot; the
+ * Smith tuning is the fastest without overshoot, and the same gains are
+ * also run in plain PI mode to show they are out of reach without the
+ * compensation.
+ */
+
+#include "Check.h"
+#include "PlantSimulator.h"
+#include "SmithPredictor.h"
+#include "WaveformPlayer.h"
+#include "WaveformPresetTable.h"
+
+#include <math.h>
+
+namespace {
+
+constexpr float kPeriod_s = 0.001f;
+
+const SmithPredictor::Gains kPiGains = {1.0f, 20.0f, 0.0f, 2.0f};
+const SmithPredictor::Gains kSmithGains = {4.0f, 80.0f, 0.0f, 2.0f};
+
+/**
+ * @brief Exact discrete model of the simulator's two lags at kPeriod_s.
+ */
+void modelOf(const PlantSimulator::Params& p, float a[2], float b[2], uint32_t& delay)
+{
+    float valve = expf(-kPeriod_s / p.valveTau_s);
+    float chamber = expf(-kPeriod_s / p.chamberTau_s);
+    a[0] = -(valve + chamber);
+    a[1] = valve * chamber;
+    b[0] = (1.0f - valve) * (1.0f - chamber) * p.gain;
+    b[1] = 0.0f;
+    delay = (uint32_t)(p.deadTime_s / kPeriod_s + 0.5f);
+}
+
+struct Loop {
+    PlantSimulator plant;
+    SmithPredictor controller;
+
+    Loop(const PlantSimulator::Params& plantParams, const PlantSimulator::Params& modelParams,
+         SmithPredictor::Mode mode, const SmithPredictor::Gains& gains)
+            : plant(plantParams, kPeriod_s),
+              controller(plant, kPeriod_s, gains)
+    {
+        float a[2];
+        float b[2];
+        uint32_t delay;
+        modelOf(modelParams, a, b, delay);
+        controller.setModel(a, b, delay);
+        controller.setMode(mode);
+    }
+
+    float step(float reference)
+    {
+        controller.step(reference);
+        plant.step();
+        return plant.pressure();
+    }
+};
+
+struct StepResult {
+    float rise_ms;      // 10% -> 90%
+    float overshoot;    // fraction of the step
+    float settle_ms;    // last time outside +-2%
+    float iae_mbar_s;
+};
+
+StepResult stepResponse(Loop& loop)
+{
+    constexpr float kFrom = 0.5f;
+    constexpr float kTo = 1.0f;
+    for (uint32_t i = 0; i < 1000U; ++i)
+    {
+        loop.step(kFrom);
+    }
+    StepResult r = {-1.0f, 0.0f, 0.0f, 0.0f};
+    float t10 = -1.0f;
+    float peak = 0.0f;
+    for (uint32_t i = 0; i < 1000U; ++i)
+    {
+        float y = loop.step(kTo);
+        float x = (y - kFrom) / (kTo - kFrom);
+        float t_ms = (float)(i + 1U) * kPeriod_s * 1000.0f;
+        if (t10 < 0.0f && x >= 0.1f)
+        {
+            t10 = t_ms;
+        }
+        if (r.rise_ms < 0.0f && x >= 0.9f)
+        {
+            r.rise_ms = t_ms - t10;
+        }
+        if (fabsf(x - 1.0f) > 0.02f)
+        {
+            r.settle_ms = t_ms;
+        }
+        peak = fmaxf(peak, x);
+        r.iae_mbar_s += fabsf(kTo - y) * kPeriod_s * 1000.0f;
+    }
+    r.overshoot = fmaxf(0.0f, peak - 1.0f);
+    return r;
+}
+
+/**
+ * @brief Records the player's setpoints as the reference.
+ */
+class Reference final : public IPressureControl {
+public:
+    bool setPressure(float bar) override
+    {
+        m_bar = bar;
+        return true;
+    }
+    float getActualPressure() override { return m_bar; }
+
+private:
+    float m_bar = 0.0f;
+};
+
+struct CardiacResult {
+    float rms_mbar;      // tracking error, dead time taken out
+    float peak_mbar;     // systolic peak error
+    float dpdtRatio;     // achieved / commanded dP/dt max
+};
+
+/**
+ * @brief 10 beats of the rest preset at 72 bpm. The error is taken
+ * against the reference delayed by the plant's dead time, which no
+ * causal controller can remove.
+ */
+CardiacResult cardiac(Loop& loop)
+{
+    const WaveformPreset& rest = WaveformPresetTable::kPresets[WaveformPresetTable::Rest];
+    Reference reference;
+    WaveformPlayer player(reference, kPeriod_s);
+    player.select({&rest, 72.0f / rest.rate_bpm, 1.0f}, 0);
+
+    constexpr uint32_t kDelay = 64;
+    float history[kDelay] = {};
+    uint32_t lag = (uint32_t)(loop.plant.params().deadTime_s / kPeriod_s + 0.5f);
+
+    CardiacResult r = {0.0f, 0.0f, 0.0f};
+    double squares = 0.0;
+    uint32_t count = 0;
+    float refPeak = 0.0f;
+    float outPeak = 0.0f;
+    float refDpdt = 0.0f;
+    float outDpdt = 0.0f;
+    float prevRef = 0.0f;
+    float prevOut = 0.0f;
+    uint32_t ticks = (uint32_t)(12.0f * 60.0f / 72.0f / kPeriod_s);
+    for (uint32_t i = 0; i < ticks; ++i)
+    {
+        float ref = player.tick();
+        history[i % kDelay] = ref;
+        float out = loop.step(ref);
+        if (i < (uint32_t)(2.0f * 60.0f / 72.0f / kPeriod_s))
+        {
+            prevRef = ref;
+            prevOut = out;
+            continue; // first two beats: settling
+        }
+        float delayed = history[(i + kDelay - lag) % kDelay];
+        squares += (double)((out - delayed) * (out - delayed));
+        count++;
+        refPeak = fmaxf(refPeak, ref);
+        outPeak = fmaxf(outPeak, out);
+        refDpdt = fmaxf(refDpdt, (ref - prevRef) / kPeriod_s);
+        outDpdt = fmaxf(outDpdt, (out - prevOut) / kPeriod_s);
+        prevRef = ref;
+        prevOut = out;
+    }
+    r.rms_mbar = (float)sqrt(squares / (double)count) * 1000.0f;
+    r.peak_mbar = (outPeak - refPeak) * 1000.0f;
+    r.dpdtRatio = outDpdt / refDpdt;
+    return r;
+}
+
+void report(const char* name, Loop&& stepLoop, Loop&& cardiacLoop, StepResult& s, CardiacResult& c)
+{
+    s = stepResponse(stepLoop);
+    c = cardiac(cardiacLoop);
+    printf("%-24s %8.0f %9.1f %9.0f %10.1f | %8.1f %9.1f %9.2f\n", name, s.rise_ms,
+           s.overshoot * 100.0f, s.settle_ms, s.iae_mbar_s, c.rms_mbar, c.peak_mbar, c.dpdtRatio);
+}
+
+} // namespace
+
+int main()
+{
+    const PlantSimulator::Params plant = PlantSimulator::kVppe;
+    PlantSimulator::Params mismatched = plant; // the real valve vs the model
+    mismatched.deadTime_s *= 1.2f;
+    mismatched.gain *= 0.9f;
+    mismatched.valveTau_s *= 1.2f;
+
+    printf("%-24s %8s %9s %9s %10s | %8s %9s %9s\n", "0.5 -> 1.0 bar step", "rise ms", "over %",
+           "settle ms", "IAE mbar*s", "rms mbar", "peak mbar", "dP/dt");
+    StepResult pi;
+    StepResult smith;
+    StepResult hardPi;
+    StepResult robust;
+    CardiacResult piC;
+    CardiacResult smithC;
+    CardiacResult hardPiC;
+    CardiacResult robustC;
+    report("PI (best tuning)",
+           Loop(plant, plant, SmithPredictor::Mode::Pi, kPiGains),
+           Loop(plant, plant, SmithPredictor::Mode::Pi, kPiGains), pi, piC);
+    report("Smith",
+           Loop(plant, plant, SmithPredictor::Mode::Smith, kSmithGains),
+           Loop(plant, plant, SmithPredictor::Mode::Smith, kSmithGains), smith, smithC);
+    report("PI with Smith gains",
+           Loop(plant, plant, SmithPredictor::Mode::Pi, kSmithGains),
+           Loop(plant, plant, SmithPredictor::Mode::Pi, kSmithGains), hardPi, hardPiC);
+    report("Smith, 20% model error",
+           Loop(mismatched, plant, SmithPredictor::Mode::Smith, kSmithGains),
+           Loop(mismatched, plant, SmithPredictor::Mode::Smith, kSmithGains), robust, robustC);
+
+    // Dead-time compensation buys bandwidth...
+    CHECK(smith.rise_ms < 0.7f * pi.rise_ms);
+    CHECK(smith.iae_mbar_s < 0.8f * pi.iae_mbar_s);
+    CHECK(smith.overshoot < 0.02f);
+    CHECK(smithC.rms_mbar < 0.7f * piC.rms_mbar);
+    CHECK(smithC.dpdtRatio > piC.dpdtRatio);
+    // ...that plain PI cannot reach with the same gains...
+    CHECK(hardPi.overshoot > 0.2f || hardPi.settle_ms > 900.0f);
+    // ...and survives a realistic model error.
+    CHECK(robust.overshoot < 0.2f && robust.settle_ms < 500.0f);
+
+    return Check::finish();
+}
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""
+Round trip of DeferredLog records through Tools/log_decode.py.
+
+    python3 Tests/check_log_decode.py build/test_deferred_log build/deferred_log.bin
+
+The dump is written by test_deferred_log and decoded against that same
+executable, a 64-bit host ELF. The expected text follows the calls there.
+Exits 1 on the first mismatch.
+"""
+
+import io
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Tools"))
+import log_decode  # noqa: E402
+
+RECORDS = 64  # DEFERRED_LOG_RECORDS
+
+
+def line(t_us, level, text):
+    return "%12.6f %-5s %s" % (t_us / 1e6, level, text)
+
+
+def expected():
+    lines = [
+        line(1010, "WARN", "retry -1 of 4"),
+        line(1020, "ERROR", "overpressure trip #2, threshold code 3890"),
+        line(1000, "INFO", "setpoint 1.250000 bar, valve 3"),
+        line(1030, "INFO", "no arguments"),
+        line(1040, "INFO", "code 0000beef, channel A, gain 0.50"),
+        "-- 5 records dropped --",
+        line(1070, "WARN", "pressure low during burst"),
+    ]
+    for i in range(5, RECORDS + 5):
+        lines.append(line(1040 + 10 * (i + 1), "INFO", "burst %d" % i))
+    return lines
+
+
+def main():
+    out = io.StringIO()
+    log_decode.decode(sys.argv[1], sys.argv[2], out)
+    got = out.getvalue().splitlines()
+    want = expected()
+    for n, (g, w) in enumerate(zip(got, want)):
+        if g != w:
+            print("FAILED at line %d:\n  got  %r\n  want %r" % (n + 1, g, w))
+            sys.exit(1)
+    if len(got) != len(want):
+        print("FAILED: %d lines decoded, %d expected" % (len(got), len(want)))
+        sys.exit(1)
+    print("log_decode round trip: %d lines OK" % len(got))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""
+Round trip of a TraceRecorder dump through Tools/trace_to_chrome.py.
+
+    python3 Tests/check_trace_to_chrome.py build/trace_dump.bin
+
+The dump is written by test_trace_recorder; the expectations below follow
+the sequence recorded there. Exits 1 on the first mismatch.
+"""
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Tools"))
+import trace_to_chrome  # noqa: E402
+
+WRAP = 1 << 32
+
+
+def expect(condition, what):
+    if not condition:
+        print("FAILED: %s" % what)
+        sys.exit(1)
+
+
+def main():
+    with open(sys.argv[1], "rb") as f:
+        trace = trace_to_chrome.convert(f.read())
+    events = trace["traceEvents"]
+
+    stamps = [e["ts"] for e in events if "ts" in e]
+    expect(stamps == sorted(stamps), "timestamps unwrapped into one increasing time line")
+
+    cpu = [(e["ts"], e["name"]) for e in events if e.get("tid") == trace_to_chrome.TID_CPU and e["ph"] == "B"]
+    expect(cpu == [(1000, "IDLE"), (1200, "Control"), (1300, "TelemetryUplink"),
+                   (0xFFFFFF00, "Control"), (WRAP + 0x100, "IDLE")],
+           "task slices with their names: %s" % cpu)
+    ends = [e["ts"] for e in events if e.get("tid") == trace_to_chrome.TID_CPU and e["ph"] == "E"]
+    expect(ends == [1200, 1300, 0xFFFFFF00, WRAP + 0x100], "each task slice ends at the next switch")
+
+    isr = [(e["ph"], e["ts"], e.get("name")) for e in events
+           if e.get("tid") == trace_to_chrome.TID_ISR and e["ph"] != "M"]
+    expect(isr == [("B", 1100, "Timebase (TIM2)"), ("E", 1110, None),
+                   ("B", 0xFFFFFFF0, "HAL tick (TIM1)"), ("E", WRAP + 0x10, None)],
+           "ISR slices, the second across the wrap: %s" % isr)
+
+    instants = [e for e in events if e["ph"] == "i"]
+    send = [e for e in instants if e["name"] == "queue send"]
+    expect(len(send) == 1 and send[0]["ts"] == 1210 and send[0]["args"]["from_isr"]
+           and send[0]["args"]["object"] == 1 and send[0]["args"]["payload"] == 3, "queue send from an ISR")
+    notify = [e for e in instants if e["name"] == "notify"]
+    expect(len(notify) == 1 and notify[0]["args"]["task"] == "TelemetryUplink", "notify names its task")
+    user = [e for e in instants if e["name"] == "user"]
+    expect(len(user) == 1 + 256, "the user event plus one ring of the overwrite burst")
+    expect(user[0]["args"]["payload"] == 42 and user[1]["args"]["payload"] == 44,
+           "the burst starts at its oldest surviving event")
+
+    expect(trace["otherData"]["dropped_events"] == 44, "dropped events carried through")
+    print("trace_to_chrome round trip: %d events OK" % len(events))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,215 @@
+/**
+ * @file test_analog_blocks.cpp
+ * @brief Block reads and paced block writes: the interface defaults and
+ * the host fakes.
+ */
+
+#include "Check.h"
+#include "HostBoard.h"
+#include "Timebase.h"
+
+namespace {
+
+/**
+ * @brief Uses the interface default. Each conversion takes 10 us of
+ * virtual time and returns a ramp; the sample at @p failAt reports -1.
+ */
+class RampSensor final : public IAnalogSensor {
+public:
+    explicit RampSensor(int failAt = -1) : m_failAt(failAt) {}
+
+    float readVoltage() override
+    {
+        Timebase::advance(10);
+        if (m_reads == m_failAt)
+        {
+            return -1.0f;
+        }
+        return 0.1f * (float)m_reads++;
+    }
+
+private:
+    int m_failAt;
+    int m_reads = 0;
+};
+
+void defaultBlockIsStampedWithTimebase()
+{
+    Timebase::init();
+    Timebase::advance(1000);
+
+    RampSensor sensor;
+    float buf[8] = {};
+    SampleStamp stamp = {0, 0};
+    CHECK(sensor.readVoltageBlock(buf, 8, &stamp) == 8);
+    CHECK_NEAR(buf[0], 0.0f, 1e-6);
+    CHECK_NEAR(buf[7], 0.7f, 1e-6);
+    CHECK(stamp.first_us == 1000);
+    CHECK(stamp.last_us == 1080);
+}
+
+void defaultBlockStopsAtFirstError()
+{
+    Timebase::init();
+
+    RampSensor sensor(3);
+    float buf[8] = {};
+    SampleStamp stamp = {0, 0};
+    CHECK(sensor.readVoltageBlock(buf, 8, &stamp) == 3);
+    CHECK(stamp.last_us == 40);
+}
+
+void defaultRawBlockIsUnsupported()
+{
+    RampSensor sensor;
+    uint16_t raw[4] = {};
+    CHECK(sensor.readRawBlock(raw, 4) == 0);
+}
+
+void fakeBlocksFollowTheLoopback()
+{
+    Timebase::init();
+    Timebase::advance(500);
+
+    FakeAnalogOut out;
+    FakeAnalogIn in(&out);
+    out.setVoltage(1.65f);
+
+    float volts[4] = {};
+    SampleStamp stamp = {0, 0};
+    CHECK(in.readVoltageBlock(volts, 4, &stamp) == 4);
+    CHECK_NEAR(volts[3], 1.65f, 1e-6);
+    CHECK(stamp.first_us == 500);
+    CHECK(stamp.last_us == 500);
+
+    uint16_t raw[4] = {};
+    CHECK(in.readRawBlock(raw, 4) == 4);
+    CHECK(raw[0] >= 2047 && raw[0] <= 2048); // mid-scale
+
+    in.setVoltage(5.0f); // past full scale
+    CHECK(in.readRawBlock(raw, 4) == 4);
+    CHECK(raw[2] == 4095);
+}
+
+/**
+ * @brief An actuator with no sample clock: the default refuses blocks.
+ */
+class PlainOutput final : public IAnalogActuator {
+public:
+    bool setVoltage(float voltage) override
+    {
+        m_voltage = voltage;
+        return true;
+    }
+
+    float m_voltage = 0.0f;
+};
+
+void defaultBlockWriteIsUnsupported()
+{
+    PlainOutput out;
+    const float volts[3] = {1.0f, 2.0f, 3.0f};
+    const uint16_t raw[3] = {1, 2, 3};
+    CHECK(out.writeVoltageBlock(volts, 3, 100) == 0);
+    CHECK(out.writeRawBlock(raw, 3, 100) == 0);
+    CHECK(out.m_voltage == 0.0f);
+}
+
+void fakeBlockIsPacedOnTheTimebase()
+{
+    Timebase::init();
+    Timebase::advance(1000);
+
+    FakeAnalogOut out;
+    out.setVoltage(0.5f);
+    const float volts[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+    SampleStamp stamp = {0, 0};
+    CHECK(out.writeVoltageBlock(volts, 4, 250, &stamp) == 4);
+    CHECK(stamp.first_us == 1250);
+    CHECK(stamp.last_us == 2000);
+    CHECK(out.isBlockPlaying());
+
+    CHECK(out.voltage() == 0.5f); // nothing before the first period
+    Timebase::advance(249);
+    CHECK(out.voltage() == 0.5f);
+    Timebase::advance(1);
+    CHECK(out.voltage() == 1.0f);
+    Timebase::advance(500);
+    CHECK(out.voltage() == 3.0f);
+
+    // A second block waits for the first.
+    CHECK(out.writeVoltageBlock(volts, 2, 250) == 0);
+    Timebase::advance(250);
+    CHECK(!out.isBlockPlaying());
+    CHECK(out.voltage() == 4.0f); // the last sample stays
+    Timebase::advance(10000);
+    CHECK(out.voltage() == 4.0f);
+
+    CHECK(out.writeVoltageBlock(volts, 2, 100) == 2);
+    CHECK(out.voltage() == 4.0f); // held until the new block's first sample
+    Timebase::advance(100);
+    CHECK(out.voltage() == 1.0f);
+    CHECK(out.writes() == 1U + 4U + 2U);
+}
+
+void fakeBlockRejectsBadArguments()
+{
+    Timebase::init();
+    FakeAnalogOut out;
+    static float volts[IAnalogActuator::kMaxBlock + 1];
+    CHECK(out.writeVoltageBlock(volts, IAnalogActuator::kMaxBlock + 1U, 100) == 0);
+    CHECK(out.writeVoltageBlock(volts, 0, 100) == 0);
+    CHECK(out.writeVoltageBlock(volts, 4, 0) == 0);
+    CHECK(out.writeVoltageBlock(nullptr, 4, 100) == 0);
+    CHECK(out.writeVoltageBlock(volts, IAnalogActuator::kMaxBlock, 100) == IAnalogActuator::kMaxBlock);
+}
+
+void setVoltageCutsABlockShort()
+{
+    Timebase::init();
+    FakeAnalogOut out;
+    const float volts[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+    CHECK(out.writeVoltageBlock(volts, 4, 100) == 4);
+    Timebase::advance(150);
+    CHECK(out.voltage() == 1.0f);
+    out.setVoltage(0.25f);
+    CHECK(!out.isBlockPlaying());
+    Timebase::advance(1000);
+    CHECK(out.voltage() == 0.25f);
+}
+
+void fakeRawBlockRoundTripsThroughTheInput()
+{
+    Timebase::init();
+    FakeAnalogOut out;
+    FakeAnalogIn in(&out);
+    const uint16_t codes[3] = {0, 2048, 5000};
+    CHECK(out.writeRawBlock(codes, 3, 10) == 3);
+
+    uint16_t raw[1] = {};
+    Timebase::advance(10);
+    CHECK(in.readRawBlock(raw, 1) == 1 && raw[0] == 0);
+    Timebase::advance(10);
+    CHECK(in.readRawBlock(raw, 1) == 1 && raw[0] == 2048);
+    Timebase::advance(10);
+    CHECK(in.readRawBlock(raw, 1) == 1 && raw[0] == 4095); // clamped on the way out
+}
+
+} // namespace
+
+int main()
+{
+    Timebase::setHostMode(Timebase::HostMode::Virtual);
+
+    defaultBlockIsStampedWithTimebase();
+    defaultBlockStopsAtFirstError();
+    defaultRawBlockIsUnsupported();
+    fakeBlocksFollowTheLoopback();
+    defaultBlockWriteIsUnsupported();
+    fakeBlockIsPacedOnTheTimebase();
+    fakeBlockRejectsBadArguments();
+    setVoltageCutsABlockShort();
+    fakeRawBlockRoundTripsThroughTheInput();
+
+    return Check::finish();
+}
@@ -0,0 +1,108 @@
+/**
+ * @file test_analog_pair.cpp
+ * @brief PackedPair arithmetic and the FakeAnalogPairIn ring.
+ */
+
+#include "Check.h"
+#include "HostBoard.h"
+
+namespace {
+
+constexpr float kVoltsPerCount = 3.3f / 4095.0f;
+
+void packedPairLayout()
+{
+    // Same layout as the dual-ADC common data register: first in the low half.
+    uint32_t pair = PackedPair::make(0x0123, 0x0FED);
+    CHECK(pair == 0x0FED0123U);
+    CHECK(PackedPair::first(pair) == 0x0123);
+    CHECK(PackedPair::second(pair) == 0x0FED);
+
+    CHECK(PackedPair::difference(PackedPair::make(4095, 0)) == 4095);
+    CHECK(PackedPair::difference(PackedPair::make(0, 4095)) == -4095);
+    CHECK(PackedPair::difference(PackedPair::make(2000, 2000)) == 0);
+}
+
+void packedPairDifferenceVolts()
+{
+    const uint32_t pairs[] = {
+        PackedPair::make(2048, 2048),
+        PackedPair::make(3000, 1000),
+        PackedPair::make(100, 4000),
+    };
+    float volts[3];
+    PackedPair::differenceVolts(pairs, 3, kVoltsPerCount, volts);
+    CHECK(volts[0] == 0.0f);
+    CHECK_NEAR(volts[1], 2000.0f * kVoltsPerCount, 1e-6f);
+    CHECK_NEAR(volts[2], -3900.0f * kVoltsPerCount, 1e-6f);
+}
+
+void fakePairReadsInOrderWithStamps()
+{
+    FakeAnalogPairIn pair(250, kVoltsPerCount);
+    CHECK(pair.voltsPerCount() == kVoltsPerCount);
+
+    uint32_t out[8];
+    SampleStamp stamp = {};
+    CHECK(pair.readPairs(out, 8, &stamp) == 0U);
+
+    pair.setVoltages(1.0f, 0.5f);
+    pair.produce(3);
+    pair.setVoltages(2.0f, 2.5f);
+    pair.produce(2);
+
+    CHECK(pair.readPairs(out, 4, &stamp) == 4U);
+    CHECK(stamp.first_us == 0U && stamp.last_us == 3U * 250U);
+    CHECK_NEAR(PackedPair::first(out[0]) * kVoltsPerCount, 1.0f, kVoltsPerCount);
+    CHECK_NEAR(PackedPair::second(out[0]) * kVoltsPerCount, 0.5f, kVoltsPerCount);
+    CHECK(out[2] == out[0]);
+    CHECK_NEAR(PackedPair::first(out[3]) * kVoltsPerCount, 2.0f, kVoltsPerCount);
+
+    // The fifth pair stayed for the next call.
+    CHECK(pair.readPairs(out, 8, &stamp) == 1U);
+    CHECK(stamp.first_us == 4U * 250U && stamp.last_us == 4U * 250U);
+    CHECK_NEAR(PackedPair::second(out[0]) * kVoltsPerCount, 2.5f, kVoltsPerCount);
+    CHECK(pair.dropped() == 0U);
+}
+
+void fakePairClampsToTheConverterRange()
+{
+    FakeAnalogPairIn pair(100, kVoltsPerCount);
+    pair.setVoltages(-0.2f, 5.0f);
+    pair.produce(1);
+    uint32_t out = 0;
+    CHECK(pair.readPairs(&out, 1) == 1U);
+    CHECK(PackedPair::first(out) == 0U);
+    CHECK(PackedPair::second(out) == 4095U);
+}
+
+void fakePairDropsTheOldestWhenFull()
+{
+    constexpr uint32_t kDepth = FakeAnalogPairIn::kDepth;
+    FakeAnalogPairIn pair(100, kVoltsPerCount);
+    pair.setVoltages(0.1f, 0.1f);
+    pair.produce(10);
+    pair.setVoltages(0.2f, 0.2f);
+    pair.produce(kDepth); // overwrites the ten older pairs
+
+    static uint32_t out[FakeAnalogPairIn::kDepth + 1];
+    SampleStamp stamp = {};
+    CHECK(pair.readPairs(out, kDepth + 1U, &stamp) == kDepth);
+    CHECK(pair.dropped() == 10U);
+    CHECK(stamp.first_us == 10U * 100U);
+    CHECK(stamp.last_us == (10U + kDepth - 1U) * 100U);
+    CHECK(out[0] == out[kDepth - 1U]);
+    CHECK_NEAR(PackedPair::first(out[0]) * kVoltsPerCount, 0.2f, kVoltsPerCount);
+}
+
+} // namespace
+
+int main()
+{
+    packedPairLayout();
+    packedPairDifferenceVolts();
+    fakePairReadsInOrderWithStamps();
+    fakePairClampsToTheConverterRange();
+    fakePairDropsTheOldestWhenFull();
+    return Check::finish();
+}
@@ -0,0 +1,294 @@
+/**
+ * @file test_arx_identifier.cpp
+ * @brief RLS convergence against the plant simulator: the identified model
+ * must match the plant's gain and step response, find a dead time, follow
+ * a gain drift and stay put while the input is not exciting. At the 1 kHz
+ * control rate it must find the VPPE's 12 ms dead time and run a
+ * SmithPredictor through updateModel().
+ */
+
+#include "ArxIdentifier.h"
+#include "Check.h"
+#include "PlantSimulator.h"
+#include "SmithPredictor.h"
+
+#include <math.h>
+#include <signal.h>
+#include <sys/time.h>
+
+namespace {
+
+constexpr float kPlant_s = 0.001f;         // plant integration step
+constexpr uint32_t kDecimation = 5;        // identifier runs at 200 Hz
+constexpr float kPeriod_s = kPlant_s * kDecimation;
+
+const PlantSimulator::Params kPlantParams = {1.0f, 0.010f, 0.025f, 0.008f, 0.001f};
+
+/**
+ * @brief Random telegraph between 0.5 and 1.0 bar, 20..100 ms dwell at
+ * 200 Hz; stretch scales the dwell for a faster identifier.
+ */
+struct Prbs {
+    uint32_t seed = 1;
+    uint32_t dwell = 0;
+    uint32_t stretch = 1;
+    float level = 0.5f;
+
+    float next()
+    {
+        if (dwell == 0U)
+        {
+            seed = seed * 1103515245U + 12345U;
+            level = ((seed >> 16) & 1U) ? 1.0f : 0.5f;
+            dwell = (4U + ((seed >> 20) % 17U)) * stretch; // identifier periods
+        }
+        dwell--;
+        return level;
+    }
+};
+
+/**
+ * @brief Drives plant and identifier for @p seconds. @p input gives the
+ * setpoint each identifier period.
+ */
+template <typename Input>
+void run(PlantSimulator& plant, ArxIdentifier& id, float seconds, Input input)
+{
+    uint32_t periods = (uint32_t)(seconds / kPeriod_s);
+    for (uint32_t k = 0; k < periods; ++k)
+    {
+        id.update(plant.setpoint(), plant.getActualPressure());
+        plant.setPressure(input());
+        for (uint32_t i = 0; i < kDecimation; ++i)
+        {
+            plant.step();
+        }
+    }
+}
+
+/**
+ * @brief Largest gap between the model's and the plant's noise-free
+ * response to a 0.5 -> 1.0 bar step, over 300 ms.
+ */
+float stepMismatch(const ArxIdentifier::ArxModel& m, PlantSimulator::Params params)
+{
+    params.noise_bar = 0.0f;
+    PlantSimulator plant(params, kPlant_s);
+
+    // Settle both at 0.5 bar.
+    float y[2] = {0.5f * m.dcGain, 0.5f * m.dcGain};
+    float u[ArxIdentifier::kMaxDelay + ArxIdentifier::kNb];
+    for (float& v : u)
+    {
+        v = 0.5f;
+    }
+    plant.setPressure(0.5f);
+    for (uint32_t i = 0; i < 2000U; ++i)
+    {
+        plant.step();
+    }
+    float offset = plant.pressure() - y[0]; // the bias term, taken out
+
+    float worst = 0.0f;
+    for (uint32_t k = 0; k < 60U; ++k)
+    {
+        float yk = -m.a[0] * y[0] - m.a[1] * y[1]
+                   + m.b[0] * u[m.delay] + m.b[1] * u[m.delay + 1U] + m.bias;
+        y[1] = y[0];
+        y[0] = yk;
+        for (uint32_t i = ArxIdentifier::kMaxDelay + ArxIdentifier::kNb - 1U; i > 0U; --i)
+        {
+            u[i] = u[i - 1U];
+        }
+        u[0] = 1.0f;
+
+        plant.setPressure(1.0f);
+        for (uint32_t i = 0; i < kDecimation; ++i)
+        {
+            plant.step();
+        }
+        worst = fmaxf(worst, fabsf(plant.pressure() - offset - yk));
+    }
+    return worst;
+}
+
+void convergesToThePlant()
+{
+    PlantSimulator plant(kPlantParams, kPlant_s);
+    ArxIdentifier::Config config = ArxIdentifier::kDefaultConfig;
+    config.period_s = kPeriod_s;
+    config.warmupSamples = 200;
+    ArxIdentifier id(config);
+    Prbs prbs;
+
+    ArxIdentifier::ArxModel m;
+    run(plant, id, 0.5f, [&] { return prbs.next(); });
+    CHECK(id.model(m));
+    CHECK(!m.valid); // still warming up
+
+    run(plant, id, 20.0f, [&] { return prbs.next(); });
+    CHECK(id.model(m));
+    float mismatch = stepMismatch(m, plant.params());
+    printf("identified: gain %.3f, delay %u x %.0f ms, a = %.3f %.3f, b = %.3f %.3f, "
+           "rms error %.2f mbar, step mismatch %.1f mbar\n",
+           m.dcGain, m.delay, m.period_s * 1000.0f, m.a[0], m.a[1], m.b[0], m.b[1],
+           sqrtf(m.errorVariance) * 1000.0f, mismatch * 1000.0f);
+    CHECK(m.valid);
+    CHECK_NEAR(m.dcGain, 1.0f, 0.03f);
+    CHECK(m.delay == 1U); // 10 ms: the one-sample delay of u[k-1-d], plus d = 1
+    CHECK(sqrtf(m.errorVariance) < 0.004f);
+    CHECK(mismatch < 0.03f);
+
+    // The valve loses 15% gain (supply pressure drop): the forgetting
+    // factor must let the model follow.
+    PlantSimulator::Params drifted = plant.params();
+    drifted.gain = 0.85f;
+    plant.setParams(drifted);
+    run(plant, id, 10.0f, [&] { return prbs.next(); });
+    CHECK(id.model(m));
+    printf("after drift: gain %.3f\n", m.dcGain);
+    CHECK_NEAR(m.dcGain, 0.85f, 0.03f);
+
+    // No excitation for a minute. Gain and bias cannot be told apart on a
+    // constant input, so only the operating point is observable: it must
+    // stay right, and nothing may wind up.
+    run(plant, id, 60.0f, [] { return 0.8f; });
+    CHECK(id.model(m));
+    float steady = m.dcGain * 0.8f + m.bias / (1.0f + m.a[0] + m.a[1]);
+    printf("after 60 s constant input: gain %.3f, steady state %.3f bar\n", m.dcGain, steady);
+    CHECK_NEAR(steady, 0.85f * 0.8f, 0.01f);
+    CHECK(isfinite(m.dcGain) && isfinite(m.bias));
+
+    // Excitation comes back: the gain is found again within seconds.
+    run(plant, id, 5.0f, [&] { return prbs.next(); });
+    CHECK(id.model(m));
+    printf("5 s after excitation resumed: gain %.3f\n", m.dcGain);
+    CHECK_NEAR(m.dcGain, 0.85f, 0.03f);
+}
+
+/**
+ * @brief kVppe at 1 kHz, in the composition's order: read the feedback,
+ * send the setpoint, give both to the identifier. The dead time then comes
+ * out in SmithPredictor's convention, 12 samples, and the model runs the
+ * Smith loop with the bench's no-overshoot gains.
+ */
+void identifiesTheVppeForTheSmithPredictor()
+{
+    constexpr uint32_t kDelay = 12; // kVppe's 12 ms at 1 kHz
+    static_assert(kDelay <= ArxIdentifier::kMaxDelay, "the VPPE's dead time is in range");
+    PlantSimulator::Params params = PlantSimulator::kVppe;
+    PlantSimulator plant(params, kPlant_s);
+    ArxIdentifier id(ArxIdentifier::kDefaultConfig);
+    Prbs prbs;
+    prbs.stretch = kDecimation;
+
+    for (uint32_t k = 0; k < 20000U; ++k)
+    {
+        float y = plant.getActualPressure();
+        float u = prbs.next();
+        plant.setPressure(u);
+        id.update(u, y);
+        plant.step();
+    }
+    ArxIdentifier::ArxModel m;
+    CHECK(id.model(m));
+    printf("at 1 kHz: gain %.3f, delay %u x %.0f ms, a = %.4f %.4f, b = %.5f %.5f, rms error %.2f mbar\n",
+           m.dcGain, m.delay, m.period_s * 1000.0f, m.a[0], m.a[1], m.b[0], m.b[1],
+           sqrtf(m.errorVariance) * 1000.0f);
+    CHECK(m.valid);
+    // kVppe has no zero, so d = 12 with b2 = 0 and d = 11 with b1 = 0 are
+    // the same model; the lower candidate wins the tie.
+    uint32_t deadTime = m.delay + ((fabsf(m.b[0]) < 0.1f * fabsf(m.b[1])) ? 1U : 0U);
+    CHECK(deadTime == kDelay);
+    CHECK_NEAR(m.dcGain, 1.0f, 0.03f);
+    CHECK_NEAR(m.a[0], -(expf(-kPlant_s / params.valveTau_s) + expf(-kPlant_s / params.chamberTau_s)), 0.01f);
+
+    // The Smith loop on the identified model: 0.5 -> 1.0 bar.
+    const SmithPredictor::Gains gains = {4.0f, 80.0f, 0.0f, 2.0f};
+    params.noise_bar = 0.0f;
+    PlantSimulator loopPlant(params, kPlant_s);
+    SmithPredictor controller(loopPlant, kPlant_s, gains);
+    CHECK(controller.updateModel(id));
+    controller.setMode(SmithPredictor::Mode::Smith);
+    for (uint32_t k = 0; k < 1000U; ++k)
+    {
+        controller.step(0.5f);
+        loopPlant.step();
+    }
+    float peak = 0.0f;
+    uint32_t settled = 0;
+    for (uint32_t k = 0; k < 1000U; ++k)
+    {
+        controller.step(1.0f);
+        loopPlant.step();
+        peak = fmaxf(peak, loopPlant.pressure());
+        settled = (fabsf(loopPlant.pressure() - 1.0f) > 0.01f) ? k + 1U : settled;
+    }
+    printf("Smith loop on the identified model: overshoot %.1f%%, settled to 2%% in %u ms\n",
+           (peak - 1.0f) / 0.5f * 100.0f, settled);
+    CHECK(peak < 1.0f + 0.05f * 0.5f);
+    CHECK(settled < 200U);
+    CHECK_NEAR(loopPlant.pressure(), 1.0f, 0.002f);
+
+    // A 200 Hz model is refused by a 1 kHz controller.
+    ArxIdentifier::Config slow = ArxIdentifier::kDefaultConfig;
+    slow.period_s = kPeriod_s;
+    slow.warmupSamples = 1;
+    ArxIdentifier slowId(slow);
+    slowId.update(0.5f, 0.5f);
+    CHECK(slowId.model(m) && m.valid);
+    CHECK(!controller.updateModel(slowId));
+}
+
+// A controller task outranking the identifier: model() from a timer
+// signal sometimes lands inside publish(), which cannot finish until the
+// reader returns.
+ArxIdentifier* s_identifier;
+uint32_t s_models;
+uint32_t s_gaveUp;
+
+void controllerIsr(int)
+{
+    ArxIdentifier::ArxModel m;
+    if (s_identifier->model(m))
+    {
+        s_models++;
+    }
+    else
+    {
+        s_gaveUp++;
+    }
+}
+
+void readerPreemptsPublish()
+{
+    PlantSimulator plant(kPlantParams, kPlant_s);
+    ArxIdentifier id(ArxIdentifier::kDefaultConfig);
+    Prbs prbs;
+    run(plant, id, 1.0f, [&] { return prbs.next(); }); // past warm-up
+
+    s_identifier = &id;
+    signal(SIGALRM, controllerIsr);
+    itimerval timer = {{0, 20}, {0, 20}};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+    for (uint32_t i = 0; i < 200U && s_gaveUp == 0U; ++i)
+    {
+        run(plant, id, 1.0f, [&] { return prbs.next(); });
+    }
+    timer = {};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    printf("preempting reader: %u models read, %u gave up mid-publish\n", s_models, s_gaveUp);
+    CHECK(s_models > 0U);
+    CHECK(s_gaveUp > 0U);
+}
+
+} // namespace
+
+int main()
+{
+    convergesToThePlant();
+    identifiesTheVppeForTheSmithPredictor();
+    readerPreemptsPublish();
+    return Check::finish();
+}
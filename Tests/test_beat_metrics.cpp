@@ -0,0 +1,152 @@
+/**
+ * @file test_beat_metrics.cpp
+ * @brief Feature segmentation on a noisy recording: a 72 bpm waveform
+ * played through the plant simulator and read back with sensor noise at
+ * 1 kHz. Two shapes: the rest preset, whose diastole keeps decaying, and
+ * one with a flat diastolic floor, where noise alone decides which sample
+ * is lowest.
+ */
+
+#include "BeatMetrics.h"
+#include "Check.h"
+#include "PlantSimulator.h"
+#include "WaveformPlayer.h"
+#include "WaveformPresetTable.h"
+
+#include <math.h>
+
+namespace {
+
+constexpr float kTick_s = 0.001f;
+constexpr uint32_t kTick_us = 1000;
+constexpr float kRate_bpm = 72.0f;
+
+/**
+ * @brief Half-sine systole over the first 40% of the beat, then flat.
+ */
+struct PlateauShape {
+    int16_t q15[64];
+
+    PlateauShape()
+    {
+        for (uint32_t i = 0; i < 64U; ++i)
+        {
+            q15[i] = (i < 26U) ? (int16_t)(32767.0f * sinf(3.14159265f * (float)i / 26.0f)) : 0;
+        }
+    }
+};
+
+const PlateauShape kPlateauShape;
+const WaveformPreset kPlateau = {"plateau", 72.0f, 0.2f, 1.2f, 64, kPlateauShape.q15};
+
+struct Rig {
+    PlantSimulator plant;
+    WaveformPlayer player;
+    BeatMetrics metrics;
+    uint32_t t_us = 0;
+
+    Rig(const WaveformPreset& preset, float noise_bar)
+            : plant(PlantSimulator::Params{1.0f, 0.012f, 0.025f, 0.008f, noise_bar}, kTick_s),
+              player(plant, kTick_s)
+    {
+        player.select({&preset, kRate_bpm / preset.rate_bpm, 1.0f}, 0);
+    }
+
+    /**
+     * @brief Runs @p seconds; calls @p onBeat for each completed beat.
+     */
+    template <typename F>
+    void run(float seconds, F onBeat, bool pumping = true)
+    {
+        uint32_t ticks = (uint32_t)(seconds / kTick_s);
+        for (uint32_t i = 0; i < ticks; ++i)
+        {
+            if (pumping)
+            {
+                player.tick();
+            }
+            plant.step();
+            t_us += kTick_us;
+            if (metrics.addSample(plant.getActualPressure(), t_us))
+            {
+                onBeat(metrics.lastBeat());
+            }
+        }
+    }
+};
+
+/**
+ * @brief Every beat after the first few must read 72 bpm and agree with
+ * its neighbours on pressure, whatever the noise on the diastolic floor.
+ */
+void steadyRateUnderNoise(const WaveformPreset& preset, float noise_bar)
+{
+    Rig rig(preset, noise_bar);
+    uint32_t beats = 0;
+    float minRate = 1000.0f;
+    float maxRate = 0.0f;
+    float minSys = 10.0f;
+    float maxSys = 0.0f;
+    float minDia = 10.0f;
+    float maxDia = 0.0f;
+    rig.run(30.0f, [&](const BeatMetrics::BeatRecord& r) {
+        if (++beats <= 3U)
+        {
+            return; // settling
+        }
+        minRate = fminf(minRate, r.rate_bpm);
+        maxRate = fmaxf(maxRate, r.rate_bpm);
+        minSys = fminf(minSys, r.systolic_bar);
+        maxSys = fmaxf(maxSys, r.systolic_bar);
+        minDia = fminf(minDia, r.diastolic_bar);
+        maxDia = fmaxf(maxDia, r.diastolic_bar);
+    });
+
+    printf("%s, noise %.1f mbar: %u beats, %.1f..%.1f bpm, sys %.3f..%.3f, dia %.3f..%.3f bar\n",
+           preset.name, noise_bar * 1000.0f, beats, minRate, maxRate, minSys, maxSys, minDia, maxDia);
+    CHECK(beats >= 34U && beats <= 37U);
+    CHECK(minRate > kRate_bpm * 0.97f);
+    CHECK(maxRate < kRate_bpm * 1.03f);
+    CHECK(maxSys - minSys < 8.0f * noise_bar + 0.01f);
+    CHECK(maxDia - minDia < 8.0f * noise_bar + 0.01f);
+}
+
+/**
+ * @brief A pause longer than maxBeatInterval drops the running beat and
+ * re-learns the threshold, but beat numbers keep counting up.
+ */
+void beatCountSurvivesLostRhythm()
+{
+    Rig rig(kPlateau, 0.002f);
+    uint32_t last = 0;
+    bool monotonic = true;
+    auto check = [&](const BeatMetrics::BeatRecord& r) {
+        monotonic = monotonic && r.beat == last + 1U;
+        last = r.beat;
+    };
+    rig.run(10.0f, check);
+    uint32_t before = last;
+    rig.run(4.0f, check, false); // pump stopped: no beats
+    CHECK(last == before);
+    rig.run(10.0f, check);
+
+    CHECK(monotonic);
+    CHECK(before >= 10U);
+    CHECK(last > before + 8U);
+    CHECK(rig.metrics.beatCount() == last);
+}
+
+} // namespace
+
+int main()
+{
+    const WaveformPreset& rest = WaveformPresetTable::kPresets[WaveformPresetTable::Rest];
+    for (float noise_bar : {0.0f, 0.002f, 0.005f})
+    {
+        steadyRateUnderNoise(rest, noise_bar);
+        steadyRateUnderNoise(kPlateau, noise_bar);
+    }
+    beatCountSurvivesLostRhythm();
+
+    return Check::finish();
+}
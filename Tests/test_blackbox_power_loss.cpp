@@ -0,0 +1,220 @@
+/**
+ * @file test_blackbox_power_loss.cpp
+ * @brief Cuts the power at every flash operation of a recording session and
+ * checks that the black box comes back: init() succeeds, readNext()
+ * terminates without touching a torn word, what it returns is in order, and
+ * recording carries on without programming any double-word twice.
+ */
+
+#include "BlackBox.h"
+#include "Check.h"
+#include "HostBoard.h"
+#include "Timebase.h"
+
+namespace {
+
+// Small pages so a session wraps the ring several times.
+using Flash = FakeFlashPages<4, 256>;
+
+constexpr uint16_t kPeriod_us = 1000;
+
+BlackBox::BeatSummary beat(uint32_t n)
+{
+    BlackBox::BeatSummary b = {};
+    b.beat = n;
+    b.t_ms = n * 1000U;
+    b.systolic_mbar = (uint16_t)(200U + n);
+    b.diastolic_mbar = (uint16_t)(80U + n);
+    b.mean_mbar = (uint16_t)(120U + n);
+    b.rate_cpm_x10 = 720;
+    return b;
+}
+
+void drain(BlackBox& box)
+{
+    for (int i = 0; i < 64 && box.service(); ++i)
+    {
+    }
+}
+
+/**
+ * @brief Beats, a fault with its pre-fault window, more beats.
+ * @return false if init() failed (power already gone).
+ */
+bool session(BlackBox& box, uint32_t firstBeat)
+{
+    if (!box.init())
+    {
+        return false;
+    }
+    for (uint32_t n = 0; n < 24; ++n)
+    {
+        box.logBeat(beat(firstBeat + n));
+        Timebase::advance(kPeriod_us);
+        box.pushPressure((uint16_t)(100U + n));
+        if (n % 3U == 2U)
+        {
+            drain(box);
+        }
+    }
+    for (uint32_t n = 0; n < 60; ++n)
+    {
+        Timebase::advance(kPeriod_us);
+        box.pushPressure((uint16_t)n);
+    }
+    box.fault(7);
+    drain(box);
+    for (uint32_t n = 24; n < 30; ++n)
+    {
+        box.logBeat(beat(firstBeat + n));
+    }
+    drain(box);
+    return true;
+}
+
+struct Readback {
+    uint32_t records = 0;
+    uint32_t valid = 0;
+    uint32_t lastBeat = 0;
+    bool consecutive = true; // every sequence is the previous one + 1
+    bool beatsInOrder = true;
+    bool beatsIntact = true;
+};
+
+Readback readAll(const BlackBox& box)
+{
+    Readback r;
+    BlackBox::Cursor cursor = {0, 0};
+    BlackBox::RecordView view;
+    uint16_t previous = 0;
+    while (r.records < 1000U && box.readNext(cursor, view))
+    {
+        if (r.records > 0U && view.sequence != (uint16_t)(previous + 1U))
+        {
+            r.consecutive = false;
+        }
+        previous = view.sequence;
+        r.records++;
+        if (!view.valid)
+        {
+            continue;
+        }
+        r.valid++;
+        if (view.type == BlackBox::RecordBeat)
+        {
+            BlackBox::BeatSummary b;
+            memcpy(&b, view.payload, sizeof(b));
+            BlackBox::BeatSummary expected = beat(b.beat);
+            r.beatsIntact = r.beatsIntact && memcmp(&b, &expected, sizeof(b)) == 0;
+            r.beatsInOrder = r.beatsInOrder && b.beat > r.lastBeat;
+            r.lastBeat = b.beat;
+        }
+    }
+    CHECK(r.records < 1000U);
+    return r;
+}
+
+/**
+ * @brief Number of flash operations in one uninterrupted session.
+ */
+uint32_t operationsPerSession()
+{
+    Flash flash;
+    BlackBox box(flash, kPeriod_us);
+    session(box, 1);
+    Readback r = readAll(box);
+    CHECK(r.consecutive);
+    CHECK(r.beatsInOrder && r.beatsIntact);
+    CHECK(flash.reprograms() == 0U);
+    return flash.operations();
+}
+
+/**
+ * @brief Reset after the cut: a new BlackBox on the same flash.
+ */
+void cutAndReboot(uint32_t cut)
+{
+    Flash flash;
+    flash.cutPowerAfter(cut);
+    {
+        BlackBox box(flash, kPeriod_us);
+        session(box, 1);
+    }
+    flash.powerOn();
+
+    BlackBox rebooted(flash, kPeriod_us);
+    CHECK(rebooted.init());
+    Readback before = readAll(rebooted);
+    CHECK(before.consecutive);
+    CHECK(before.beatsInOrder && before.beatsIntact);
+
+    // Recording resumes after whatever the cut left behind.
+    session(rebooted, 1000);
+    Readback after = readAll(rebooted);
+    CHECK(after.consecutive);
+    CHECK(after.beatsInOrder && after.beatsIntact);
+    CHECK(after.lastBeat == 1029U);
+    CHECK(flash.reprograms() == 0U);
+    if (Check::failures() != 0)
+    {
+        printf("  (power cut after %u operations)\n", (unsigned)cut);
+    }
+}
+
+/**
+ * @brief A failed operation without a reset (the flash comes back, the
+ * same BlackBox carries on): no sequence number may be skipped.
+ */
+void cutAndContinue(uint32_t cut)
+{
+    Flash flash;
+    BlackBox box(flash, kPeriod_us);
+    if (!box.init())
+    {
+        flash.powerOn();
+        CHECK(box.init());
+    }
+    flash.cutPowerAfter(cut);
+    for (uint32_t n = 0; n < 24; ++n)
+    {
+        box.logBeat(beat(n + 1U));
+        drain(box);
+        if (flash.isOff())
+        {
+            flash.powerOn();
+        }
+    }
+    drain(box);
+
+    Readback r = readAll(box);
+    CHECK(r.consecutive);
+    CHECK(r.beatsInOrder && r.beatsIntact);
+    CHECK(r.lastBeat == 24U);
+    CHECK(flash.reprograms() == 0U);
+    if (Check::failures() != 0)
+    {
+        printf("  (transient failure after %u operations)\n", (unsigned)cut);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    Timebase::setHostMode(Timebase::HostMode::Virtual);
+    Timebase::init();
+
+    uint32_t total = operationsPerSession();
+    CHECK(total > 50U);
+    for (uint32_t cut = 0; cut <= total && Check::failures() == 0; ++cut)
+    {
+        cutAndReboot(cut);
+    }
+    for (uint32_t cut = 0; cut < 80U && Check::failures() == 0; ++cut)
+    {
+        cutAndContinue(cut);
+    }
+    printf("%u cut points per session\n", (unsigned)total);
+
+    return Check::finish();
+}
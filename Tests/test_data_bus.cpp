@@ -0,0 +1,205 @@
+/**
+ * @file test_data_bus.cpp
+ * @brief DataBus topics under concurrent readers: reader threads checking
+ * every copy for tearing, and a reader that preempts the producer in the
+ * middle of a publish the way a higher-priority task or ISR would.
+ */
+
+#include "Check.h"
+#include "DataBus.h"
+
+#include <atomic>
+#include <signal.h>
+#include <sys/time.h>
+#include <thread>
+
+namespace {
+
+/**
+ * @brief Every word carries the publish number: a copy mixing two
+ * publishes shows up as words that differ.
+ */
+struct Frame {
+    uint32_t word[1024];
+};
+
+bool intact(const Frame& frame)
+{
+    for (uint32_t i = 1; i < 1024U; ++i)
+    {
+        if (frame.word[i] != frame.word[0])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void fill(Frame& frame, uint32_t n)
+{
+    for (uint32_t& word : frame.word)
+    {
+        word = n;
+    }
+}
+
+void testBasics()
+{
+    static DataBus::Topic<uint32_t> topic("basic");
+    uint32_t value = 0;
+    uint32_t seen = 0;
+    CHECK(!topic.read(value));
+    CHECK(!topic.readIfNew(value, seen));
+    topic.publish(7U);
+    CHECK(topic.read(value) && value == 7U);
+    CHECK(topic.readIfNew(value, seen) && value == 7U && seen == 1U);
+    CHECK(!topic.readIfNew(value, seen));
+    topic.publish(8U);
+    CHECK(topic.readIfNew(value, seen) && value == 8U && seen == 2U);
+
+    static DataBus::HistoryTopic<uint32_t, 4> history("basicHistory");
+    DataBus::HistoryTopic<uint32_t, 4>::Cursor cursor = history.subscribe();
+    for (uint32_t i = 0; i < 6U; ++i)
+    {
+        history.publish(i);
+    }
+    CHECK(history.latest(value) && value == 5U);
+    CHECK(history.next(cursor, value) && value == 3U); // 0..2 overwritten
+    CHECK(cursor.dropped == 3U);
+    CHECK(history.next(cursor, value) && value == 4U);
+    CHECK(history.next(cursor, value) && value == 5U);
+    CHECK(!history.next(cursor, value));
+}
+
+// --- Reader preempting the producer -----------------------------------
+
+DataBus::Topic<Frame> s_latest("preempted");
+DataBus::HistoryTopic<Frame, 4> s_history("preemptedHistory");
+DataBus::HistoryTopic<Frame, 4>::Cursor s_cursor;
+Frame s_readerFrame;
+uint32_t s_reads;
+uint32_t s_gaveUp;
+uint32_t s_torn;
+uint32_t s_historyReads;
+
+void preemptingReader(int)
+{
+    // Returns even when it lands between the producer's two counter
+    // stores, where the producer cannot finish until this handler does.
+    if (s_latest.read(s_readerFrame))
+    {
+        s_reads++;
+        s_torn += intact(s_readerFrame) ? 0U : 1U;
+    }
+    else
+    {
+        s_gaveUp++;
+    }
+    while (s_history.next(s_cursor, s_readerFrame))
+    {
+        s_historyReads++;
+        s_torn += intact(s_readerFrame) ? 0U : 1U;
+    }
+}
+
+void testReaderPreemptsProducer()
+{
+    static Frame frame;
+    s_cursor = s_history.subscribe();
+    signal(SIGALRM, preemptingReader);
+    itimerval timer = {{0, 50}, {0, 50}};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+    for (uint32_t n = 1; n <= 200000U && (s_gaveUp == 0U || n < 20000U); ++n)
+    {
+        fill(frame, n);
+        s_latest.publish(frame);
+        s_history.publish(frame);
+    }
+    timer = {};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    printf("preempting reader: %u reads, %u gave up mid-publish, %u history reads, %u torn\n", s_reads,
+           s_gaveUp, s_historyReads, s_torn);
+    CHECK(s_reads > 0U);
+    CHECK(s_gaveUp > 0U);
+    CHECK(s_historyReads > 0U);
+    CHECK(s_torn == 0U);
+}
+
+// --- Reader threads ---------------------------------------------------
+
+void testReaderThreads()
+{
+    static DataBus::Topic<Frame> latest("threaded");
+    static DataBus::HistoryTopic<Frame, 4> history("threadedHistory");
+    constexpr uint32_t kPublishes = 100000;
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> torn{0};
+    std::atomic<uint32_t> reads{0};
+
+    auto latestReader = [&] {
+        static thread_local Frame frame;
+        while (!done.load(std::memory_order_relaxed))
+        {
+            if (latest.read(frame))
+            {
+                reads++;
+                torn += intact(frame) ? 0U : 1U;
+            }
+        }
+    };
+    auto historyReader = [&] {
+        static thread_local Frame frame;
+        DataBus::HistoryTopic<Frame, 4>::Cursor cursor = history.subscribe();
+        uint32_t last = 0;
+        while (!done.load(std::memory_order_relaxed))
+        {
+            if (history.next(cursor, frame))
+            {
+                reads++;
+                torn += (intact(frame) && frame.word[0] > last) ? 0U : 1U;
+                last = frame.word[0];
+            }
+            const Frame* inPlace = history.peek(cursor);
+            if (inPlace != nullptr)
+            {
+                uint32_t first = inPlace->word[0];
+                bool same = intact(*inPlace);
+                if (history.consume(cursor))
+                {
+                    reads++;
+                    torn += (same && first > last) ? 0U : 1U;
+                    last = first;
+                }
+            }
+        }
+    };
+
+    std::thread readers[3] = {std::thread(latestReader), std::thread(latestReader), std::thread(historyReader)};
+    static Frame frame;
+    for (uint32_t n = 1; n <= kPublishes; ++n)
+    {
+        fill(frame, n);
+        latest.publish(frame);
+        history.publish(frame);
+    }
+    done = true;
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+
+    printf("reader threads: %u reads over %u publishes, %u torn\n", reads.load(), kPublishes, torn.load());
+    CHECK(reads.load() > 0U);
+    CHECK(torn.load() == 0U);
+}
+
+} // namespace
+
+int main()
+{
+    testBasics();
+    testReaderPreemptsProducer();
+    testReaderThreads();
+    return Check::finish();
+}
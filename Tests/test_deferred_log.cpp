@@ -0,0 +1,179 @@
+/**
+ * @file test_deferred_log.cpp
+ * @brief DeferredLog on the host: record encoding, errors and warnings
+ * drained first, compiled-out levels, overwrite counting, and pointer
+ * arguments on a 64-bit build.
+ *
+ * It also writes deferred_log.bin into the working directory.
+ * check_log_decode.py decodes that dump with Tools/log_decode.py against
+ * this executable and compares the text with what the calls below log.
+ */
+
+#include "Check.h"
+#include "DeferredLog.h"
+#include "Timebase.h"
+
+#include <initializer_list>
+#include <string.h>
+
+namespace {
+
+constexpr size_t kChunkBytes = sizeof(DeferredLog::ChunkHeader) + 2U * DEFERRED_LOG_RECORDS * sizeof(DeferredLog::Record);
+
+uint8_t s_dump[3 * kChunkBytes];
+size_t s_dumpBytes = 0;
+
+struct Chunk {
+    DeferredLog::ChunkHeader header;
+    DeferredLog::Record records[2 * DEFERRED_LOG_RECORDS];
+};
+
+Chunk parse(const uint8_t* buf, size_t bytes)
+{
+    Chunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    memcpy(&chunk, buf, bytes);
+    return chunk;
+}
+
+Chunk drainToDump()
+{
+    uint8_t* at = s_dump + s_dumpBytes;
+    size_t bytes = DeferredLog::drain(at, sizeof(s_dump) - s_dumpBytes);
+    CHECK(bytes > 0U);
+    s_dumpBytes += bytes;
+    return parse(at, bytes);
+}
+
+const char* formatOf(const DeferredLog::Record& record)
+{
+    return __start_logstr + record.id;
+}
+
+float floatOf(uint32_t word)
+{
+    float value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+void at(uint32_t t_us)
+{
+    Timebase::advance(t_us - Timebase::now_us());
+}
+
+void urgentRecordsComeFirst()
+{
+    at(1000);
+    LOG_INFO("setpoint %f bar, valve %u", 1.25f, 3U);
+    at(1010);
+    LOG_WARN("retry %d of %d", -1, 4);
+    at(1020);
+    LOG_ERROR("overpressure trip #%u, threshold code %u", 2U, 3890U);
+    at(1030);
+    LOG_INFO("no arguments");
+    at(1040);
+    LOG_INFO("code %08x, channel %c, gain %.2f", 0xBEEFU, 'A', 0.5);
+    LOG_DEBUG("compiled out at the default level %u", 1U);
+
+    Chunk chunk = drainToDump();
+    CHECK(chunk.header.magic == DeferredLog::kChunkMagic);
+    CHECK(chunk.header.count == 5U);
+    CHECK(chunk.header.dropped == 0U);
+
+    const DeferredLog::Record* r = chunk.records;
+    CHECK(r[0].level == LOG_LEVEL_WARN && r[0].t_us == 1010U);
+    CHECK(r[0].argCount == 2U && (int32_t)r[0].args[0] == -1 && r[0].args[1] == 4U);
+    CHECK(strcmp(formatOf(r[0]), "retry %d of %d") == 0);
+    CHECK(r[1].level == LOG_LEVEL_ERROR && r[1].t_us == 1020U);
+    CHECK(r[2].level == LOG_LEVEL_INFO && r[2].t_us == 1000U);
+    CHECK(floatOf(r[2].args[0]) == 1.25f && r[2].args[1] == 3U);
+    CHECK(r[3].argCount == 0U && strcmp(formatOf(r[3]), "no arguments") == 0);
+    CHECK(r[4].args[1] == (uint32_t)'A' && floatOf(r[4].args[2]) == 0.5f); // doubles go as float
+
+    uint8_t buf[64];
+    CHECK(DeferredLog::drain(buf, sizeof(buf)) == 0U); // nothing new
+    CHECK(DeferredLog::drain(buf, sizeof(DeferredLog::ChunkHeader)) == 0U);
+}
+
+/**
+ * @brief An info burst past one ring: the oldest go and are counted, and
+ * the warning logged during the burst survives in its own ring.
+ */
+void burstDropsTheOldestInfo()
+{
+    constexpr uint32_t kExtra = 5;
+    for (uint32_t i = 0; i < DEFERRED_LOG_RECORDS + kExtra; ++i)
+    {
+        Timebase::advance(10);
+        LOG_INFO("burst %u", i);
+        if (i == 2U)
+        {
+            LOG_WARN("pressure low during burst");
+        }
+    }
+
+    Chunk chunk = drainToDump();
+    CHECK(chunk.header.count == DEFERRED_LOG_RECORDS + 1U);
+    CHECK(chunk.header.dropped == kExtra);
+    CHECK(chunk.records[0].level == LOG_LEVEL_WARN);
+    CHECK(chunk.records[1].args[0] == kExtra);
+    CHECK(chunk.records[DEFERRED_LOG_RECORDS].args[0] == DEFERRED_LOG_RECORDS + kExtra - 1U);
+}
+
+/**
+ * @brief A small buffer takes what fits; the rest waits for the next drain.
+ */
+void smallBufferDrainsInPieces()
+{
+    for (uint32_t i = 0; i < 5U; ++i)
+    {
+        LOG_INFO("piece %u", i);
+    }
+    uint8_t buf[sizeof(DeferredLog::ChunkHeader) + 2U * sizeof(DeferredLog::Record)];
+    uint32_t next = 0;
+    for (uint32_t expected : {2U, 2U, 1U})
+    {
+        size_t bytes = DeferredLog::drain(buf, sizeof(buf));
+        Chunk chunk = parse(buf, bytes);
+        CHECK(chunk.header.count == expected);
+        for (uint32_t i = 0; i < chunk.header.count; ++i)
+        {
+            CHECK(chunk.records[i].args[0] == next++);
+        }
+    }
+    CHECK(DeferredLog::drain(buf, sizeof(buf)) == 0U);
+}
+
+void pointerArgumentKeepsTheLowBits()
+{
+    static uint32_t object;
+    LOG_INFO("object at %x", &object);
+    uint8_t buf[sizeof(DeferredLog::ChunkHeader) + sizeof(DeferredLog::Record)];
+    Chunk chunk = parse(buf, DeferredLog::drain(buf, sizeof(buf)));
+    CHECK(chunk.header.count == 1U);
+    CHECK(chunk.records[0].args[0] == (uint32_t)(uintptr_t)&object);
+}
+
+} // namespace
+
+int main()
+{
+    Timebase::setHostMode(Timebase::HostMode::Virtual);
+    Timebase::init();
+
+    urgentRecordsComeFirst();
+    burstDropsTheOldestInfo();
+
+    FILE* f = fopen("deferred_log.bin", "wb");
+    CHECK(f != nullptr);
+    if (f != nullptr)
+    {
+        CHECK(fwrite(s_dump, 1, s_dumpBytes, f) == s_dumpBytes);
+        fclose(f);
+    }
+
+    smallBufferDrainsInPieces();
+    pointerArgumentKeepsTheLowBits();
+    return Check::finish();
+}
@@ -0,0 +1,282 @@
+/**
+ * @file test_ensemble_averager.cpp
+ * @brief EnsembleAverager: the average of identical beats is the beat, the
+ * first beat is warm-up, false and missed triggers are rejected, a real
+ * rate change is followed, an overlong beat is kept at half rate, the noise
+ * floor reads the added noise, and encode() from a reader that preempted
+ * the beat update returns instead of waiting for it.
+ */
+
+#include "Check.h"
+#include "EnsembleAverager.h"
+
+#include <math.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+namespace {
+
+constexpr uint32_t kBeat = 833; // samples per beat: 72 bpm at 1 kHz
+constexpr size_t kRecord = sizeof(EnsembleAverager::Header) + EnsembleAverager::kBins * sizeof(EnsembleAverager::Bin);
+
+float beatShape(float phase)
+{
+    float s = sinf(3.14159265f * phase);
+    return 0.8f + 0.4f * s * s;
+}
+
+/**
+ * @brief Uniform noise in [-amplitude, amplitude], repeatable.
+ */
+float noise(float amplitude)
+{
+    static uint32_t seed = 1;
+    seed = seed * 1664525U + 1013904223U;
+    return amplitude * ((float)(seed >> 8) / (float)(1U << 23) - 1.0f);
+}
+
+/**
+ * @brief Feeds @p beats beats of @p samples samples each, 1 ms apart, and
+ * marks each start.
+ * @return beats accepted into the average.
+ */
+uint32_t feed(EnsembleAverager& averager, uint32_t beats, uint32_t& t_us, uint32_t samples = kBeat,
+              float noiseAmplitude = 0.0f)
+{
+    uint32_t accepted = 0;
+    for (uint32_t beat = 0; beat < beats; ++beat)
+    {
+        accepted += averager.markBeatStart(t_us) ? 1U : 0U;
+        for (uint32_t i = 0; i < samples; ++i)
+        {
+            averager.addSample(beatShape((float)i / (float)samples) + noise(noiseAmplitude));
+            t_us += 1000U;
+        }
+    }
+    return accepted;
+}
+
+struct Record {
+    EnsembleAverager::Header header;
+    EnsembleAverager::Bin bins[EnsembleAverager::kBins];
+};
+
+Record encoded(const EnsembleAverager& averager)
+{
+    static uint8_t buf[kRecord];
+    Record record;
+    memset(&record, 0, sizeof(record));
+    CHECK(averager.encode(buf, sizeof(buf)) == kRecord);
+    memcpy(&record, buf, sizeof(record));
+    return record;
+}
+
+/**
+ * @brief Largest distance of the averaged bins from the beat shape.
+ */
+float shapeError(const Record& record)
+{
+    float worst = 0.0f;
+    for (uint32_t bin = 0; bin < EnsembleAverager::kBins; ++bin)
+    {
+        float expected = beatShape((float)bin / (float)EnsembleAverager::kBins);
+        worst = fmaxf(worst, fabsf(record.bins[bin].mean_bar - expected));
+    }
+    return worst;
+}
+
+void averagesIdenticalBeats()
+{
+    static EnsembleAverager averager;
+    uint32_t t_us = 0;
+    feed(averager, 11, t_us);
+    averager.markBeatStart(t_us);
+
+    Record record = encoded(averager);
+    CHECK(record.header.magic == EnsembleAverager::kMagic);
+    CHECK(record.header.beats == 10U);
+    CHECK(record.header.warmup == 1U);
+    CHECK(record.header.rejected == 0U);
+    CHECK(record.header.meanPeriod_us == kBeat * 1000U);
+    CHECK(record.header.noiseFloor_bar < 1e-3f);
+    CHECK(shapeError(record) < 0.01f);
+}
+
+/**
+ * @brief The first closed beat only sets the period: it is neither
+ * averaged nor rejected, and reset() starts the warm-up again.
+ */
+void firstBeatIsWarmUp()
+{
+    static EnsembleAverager averager;
+    uint32_t t_us = 0;
+    CHECK(encoded(averager).header.warmup == 0U);
+    CHECK(feed(averager, 2, t_us) == 0U); // the first mark closes nothing
+    Record record = encoded(averager);
+    CHECK(record.header.warmup == 1U);
+    CHECK(record.header.beats == 0U && record.header.rejected == 0U);
+    CHECK(averager.markBeatStart(t_us));
+    CHECK(averager.beats() == 1U && averager.rejected() == 0U);
+
+    averager.reset();
+    CHECK(encoded(averager).header.warmup == 0U);
+    CHECK(feed(averager, 2, t_us) == 0U);
+    CHECK(averager.markBeatStart(t_us));
+    CHECK(averager.beats() == 1U && averager.rejected() == 0U);
+}
+
+/**
+ * @brief A false trigger splits a beat in two short ones and a missed
+ * trigger merges two into one long one: all three are thrown away and the
+ * average is unchanged by them.
+ */
+void rejectsFalseAndMissedTriggers()
+{
+    static EnsembleAverager averager;
+    uint32_t t_us = 0;
+    feed(averager, 9, t_us);
+    CHECK(averager.markBeatStart(t_us));
+    CHECK(averager.beats() == 8U);
+
+    // Each feed() closes the beat fed before it.
+    feed(averager, 1, t_us, kBeat / 2U); // false trigger half way
+    CHECK(feed(averager, 1, t_us, kBeat - kBeat / 2U) == 0U);
+    CHECK(feed(averager, 1, t_us, 2U * kBeat) == 0U); // missed trigger
+    CHECK(feed(averager, 3, t_us) == 2U); // the first closes the double beat
+    CHECK(averager.markBeatStart(t_us));
+    CHECK(averager.rejected() == 3U);
+
+    Record record = encoded(averager);
+    CHECK(record.header.beats == 11U);
+    CHECK(shapeError(record) < 0.01f);
+    CHECK(record.header.noiseFloor_bar < 1e-3f);
+}
+
+/**
+ * @brief 72 to 120 bpm, far outside the tolerance: a couple of beats are
+ * rejected while the period moves towards the new rate, then the new
+ * beats are accepted and the period settles on them. The phase bins keep
+ * the average the same shape.
+ */
+void followsAHeartRateChange()
+{
+    static EnsembleAverager averager;
+    constexpr uint32_t kFast = 500;
+    uint32_t t_us = 0;
+    feed(averager, 6, t_us);
+    uint32_t before = averager.rejected();
+
+    feed(averager, 40, t_us, kFast);
+    averager.markBeatStart(t_us);
+    uint32_t rejected = averager.rejected() - before;
+    printf("rate change: %u beats rejected before the period caught up\n", rejected);
+    CHECK(rejected >= 1U && rejected <= 3U);
+    Record record = encoded(averager);
+    CHECK_NEAR(record.header.meanPeriod_us, kFast * 1000U, 5000U);
+    CHECK(shapeError(record) < 0.01f);
+
+    // Back to 72 bpm one step at a time, each within the tolerance: nothing is lost.
+    before = averager.rejected();
+    for (uint32_t samples = kFast + 50U; samples <= kBeat; samples += 50U)
+    {
+        feed(averager, 8, t_us, samples);
+    }
+    averager.markBeatStart(t_us);
+    CHECK(averager.rejected() == before);
+}
+
+/**
+ * @brief 40 bpm at 1 kHz is 1500 samples, more than the beat buffer: the
+ * beat is kept at half rate and still lands on the right bins.
+ */
+void overlongBeatIsHalved()
+{
+    static EnsembleAverager averager;
+    constexpr uint32_t kSlow = 1500;
+    static_assert(kSlow > EnsembleAverager::kBeatSamples, "must overflow the beat buffer");
+    uint32_t t_us = 0;
+    CHECK(feed(averager, 6, t_us, kSlow) == 4U);
+    CHECK(averager.markBeatStart(t_us));
+
+    Record record = encoded(averager);
+    CHECK(record.header.beats == 5U && record.header.rejected == 0U);
+    CHECK(record.header.meanPeriod_us == kSlow * 1000U);
+    CHECK(shapeError(record) < 0.01f);
+}
+
+/**
+ * @brief Uniform noise of +-a has a standard deviation of a / sqrt(3);
+ * averaged over enough beats, the noise floor reads it and the mean is
+ * the clean beat.
+ */
+void noiseFloorReadsTheNoise()
+{
+    static EnsembleAverager averager;
+    constexpr float kNoise = 0.05f;
+    uint32_t t_us = 0;
+    feed(averager, 201, t_us, kBeat, kNoise);
+    averager.markBeatStart(t_us);
+
+    Record record = encoded(averager);
+    CHECK(record.header.beats == 200U);
+    CHECK_NEAR(record.header.noiseFloor_bar, kNoise / sqrtf(3.0f), 0.002f);
+    CHECK_NEAR(averager.noiseFloor(), record.header.noiseFloor_bar, 1e-6f);
+    CHECK(shapeError(record) < 0.015f);
+    for (uint32_t bin = 0; bin < EnsembleAverager::kBins; bin += 16U)
+    {
+        CHECK_NEAR(record.bins[bin].stddev_bar, kNoise / sqrtf(3.0f), 0.01f);
+    }
+}
+
+// Telemetry outranking the averaging task, from a timer signal.
+EnsembleAverager* s_averager;
+uint32_t s_encodes;
+uint32_t s_gaveUp;
+
+void telemetryIsr(int)
+{
+    static uint8_t buf[kRecord];
+    if (s_averager->encode(buf, sizeof(buf)) != 0U)
+    {
+        s_encodes++;
+    }
+    else
+    {
+        s_gaveUp++;
+    }
+}
+
+void readerPreemptsBeatUpdate()
+{
+    static EnsembleAverager averager;
+    s_averager = &averager;
+    uint32_t t_us = 0;
+    signal(SIGALRM, telemetryIsr);
+    itimerval timer = {{0, 20}, {0, 20}};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+    for (uint32_t i = 0; i < 2000U && s_gaveUp == 0U; ++i)
+    {
+        feed(averager, 10, t_us);
+    }
+    timer = {};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    printf("preempting encode: %u encoded, %u gave up mid-update\n", s_encodes, s_gaveUp);
+    CHECK(s_encodes > 0U);
+    CHECK(s_gaveUp > 0U);
+}
+
+} // namespace
+
+int main()
+{
+    averagesIdenticalBeats();
+    firstBeatIsWarmUp();
+    rejectsFalseAndMissedTriggers();
+    followsAHeartRateChange();
+    overlongBeatIsHalved();
+    noiseFloorReadsTheNoise();
+    readerPreemptsBeatUpdate();
+    return Check::finish();
+}
@@ -0,0 +1,277 @@
+/**
+ * @file test_event_scheduler.cpp
+ * @brief EventScheduler on virtual time: dispatch order, the per-interrupt
+ * cap, cancel and stale handles, the full pool, and due times across the
+ * 32-bit wrap of the TIM2 count.
+ *
+ * The scheduler is one static pool, so every case leaves it empty for the
+ * next and compares stats() before and after.
+ */
+
+#include "Check.h"
+#include "EventScheduler.h"
+#include "Timebase.h"
+
+namespace {
+
+struct Ran {
+    uint32_t id;
+    uint32_t due_us;
+    uint32_t at_us;
+};
+
+constexpr uint32_t kLogSize = 512;
+Ran s_log[kLogSize];
+uint32_t s_ran = 0;
+
+void record(void* context, uint32_t due_us)
+{
+    if (s_ran < kLogSize)
+    {
+        s_log[s_ran++] = {(uint32_t)(uintptr_t)context, due_us, Timebase::now_us()};
+    }
+}
+
+void* id(uint32_t n)
+{
+    return (void*)(uintptr_t)n;
+}
+
+/**
+ * @brief Moves virtual time in @p step_us steps, dispatching after each,
+ * as the compare interrupt would.
+ */
+void runFor(uint32_t us, uint32_t step_us = 1)
+{
+    for (uint32_t t = 0; t < us; t += step_us)
+    {
+        Timebase::advance(step_us);
+        EventScheduler::dispatch();
+    }
+}
+
+void clearLog()
+{
+    s_ran = 0;
+}
+
+void runsInDueOrder()
+{
+    clearLog();
+    uint32_t now = Timebase::now_us();
+    uint32_t seed = 7;
+    constexpr uint32_t kEvents = 100;
+    for (uint32_t i = 0; i < kEvents; ++i)
+    {
+        seed = seed * 1103515245U + 12345U;
+        uint32_t at = now + 10U + (seed >> 16) % 5000U;
+        CHECK(EventScheduler::schedule(at, record, id(i)) != EventScheduler::kNoEvent);
+    }
+    CHECK(EventScheduler::stats().pending == kEvents);
+
+    runFor(6000);
+    CHECK(s_ran == kEvents);
+    for (uint32_t i = 0; i < s_ran; ++i)
+    {
+        CHECK(s_log[i].at_us == s_log[i].due_us); // 1 us steps: on time
+        if (i > 0U)
+        {
+            CHECK((int32_t)(s_log[i].due_us - s_log[i - 1U].due_us) >= 0);
+        }
+    }
+    CHECK(EventScheduler::stats().pending == 0U);
+}
+
+/**
+ * @brief Overdue events run at most kMaxPerIrq per dispatch(), earliest
+ * first, and report how late they were.
+ */
+void burstIsCappedPerInterrupt()
+{
+    clearLog();
+    EventScheduler::Stats before = EventScheduler::stats();
+    uint32_t now = Timebase::now_us();
+    constexpr uint32_t kEvents = 2U * EventScheduler::kMaxPerIrq + 5U;
+    for (uint32_t i = 0; i < kEvents; ++i)
+    {
+        EventScheduler::schedule(now + 1U + i, record, id(i));
+    }
+    Timebase::advance(kEvents + 100U);
+
+    EventScheduler::dispatch();
+    CHECK(s_ran == EventScheduler::kMaxPerIrq);
+    EventScheduler::dispatch();
+    CHECK(s_ran == 2U * EventScheduler::kMaxPerIrq);
+    EventScheduler::dispatch();
+    CHECK(s_ran == kEvents);
+    for (uint32_t i = 0; i < kEvents; ++i)
+    {
+        CHECK(s_log[i].id == i);
+    }
+
+    EventScheduler::Stats after = EventScheduler::stats();
+    CHECK(after.dispatched - before.dispatched == kEvents);
+    CHECK(after.maxLateness_us >= kEvents + 99U);
+    CHECK(after.maxPending >= kEvents);
+}
+
+struct Pattern {
+    uint32_t edges;
+    uint32_t period_us;
+    uint32_t lastDue_us;
+};
+
+void nextEdge(void* context, uint32_t due_us)
+{
+    Pattern& p = *static_cast<Pattern*>(context);
+    p.lastDue_us = due_us;
+    if (++p.edges < 10U)
+    {
+        EventScheduler::schedule(due_us + p.period_us, nextEdge, &p);
+    }
+}
+
+/**
+ * @brief A callback schedules the next edge from its due time, so the
+ * pattern keeps its period whatever the dispatch latency.
+ */
+void callbackSchedulesTheNextEdge()
+{
+    Pattern pattern = {0, 250, 0};
+    uint32_t start = Timebase::now_us() + 100U;
+    EventScheduler::schedule(start, nextEdge, &pattern);
+    runFor(5000, 7); // coarse steps: each edge runs a little late
+    CHECK(pattern.edges == 10U);
+    CHECK(pattern.lastDue_us == start + 9U * 250U);
+    CHECK(EventScheduler::stats().pending == 0U);
+}
+
+void cancelRemovesOnlyThatEvent()
+{
+    clearLog();
+    EventScheduler::Stats before = EventScheduler::stats();
+    uint32_t now = Timebase::now_us();
+    EventScheduler::Handle first = EventScheduler::schedule(now + 100U, record, id(1));
+    EventScheduler::Handle second = EventScheduler::schedule(now + 200U, record, id(2));
+    EventScheduler::Handle third = EventScheduler::schedule(now + 300U, record, id(3));
+    EventScheduler::Handle fourth = EventScheduler::schedule(now + 400U, record, id(4));
+
+    CHECK(EventScheduler::cancel(second));
+    CHECK(!EventScheduler::cancel(second)); // already cancelled
+    CHECK(EventScheduler::cancel(first));   // the earliest: the compare moves on
+    CHECK(EventScheduler::stats().pending == 2U);
+
+    runFor(500);
+    CHECK(s_ran == 2U);
+    CHECK(s_log[0].id == 3U && s_log[0].at_us == now + 300U);
+    CHECK(s_log[1].id == 4U && s_log[1].at_us == now + 400U);
+    CHECK(!EventScheduler::cancel(third)); // already ran
+    CHECK(!EventScheduler::cancel(fourth));
+    CHECK(EventScheduler::stats().cancelled - before.cancelled == 2U);
+}
+
+/**
+ * @brief A handle whose node was released and reused does not cancel the
+ * new event; malformed handles are refused.
+ */
+void staleHandleIsANoOp()
+{
+    clearLog();
+    uint32_t now = Timebase::now_us();
+    EventScheduler::Handle old = EventScheduler::schedule(now + 10U, record, id(1));
+    runFor(20);
+    CHECK(s_ran == 1U);
+
+    // The pool is a stack: the next event reuses the node.
+    EventScheduler::Handle reused = EventScheduler::schedule(now + 100U, record, id(2));
+    CHECK((reused & 0xFFFFU) == (old & 0xFFFFU));
+    CHECK(reused != old);
+    CHECK(!EventScheduler::cancel(old));
+    CHECK(EventScheduler::stats().pending == 1U);
+
+    CHECK(!EventScheduler::cancel(EventScheduler::kNoEvent));
+    CHECK(!EventScheduler::cancel(EventScheduler::kMaxEvents + 1U));
+    CHECK(!EventScheduler::cancel(0xFFFF0000U)); // no index
+
+    runFor(100);
+    CHECK(s_ran == 2U && s_log[1].id == 2U);
+}
+
+void fullPoolRejects()
+{
+    clearLog();
+    EventScheduler::Stats before = EventScheduler::stats();
+    uint32_t now = Timebase::now_us();
+    static EventScheduler::Handle handles[EventScheduler::kMaxEvents];
+    for (uint32_t i = 0; i < EventScheduler::kMaxEvents; ++i)
+    {
+        handles[i] = EventScheduler::schedule(now + 1000U + i, record, id(i));
+        CHECK(handles[i] != EventScheduler::kNoEvent);
+    }
+    CHECK(EventScheduler::schedule(now + 10U, record, id(999)) == EventScheduler::kNoEvent);
+    CHECK(EventScheduler::stats().rejected - before.rejected == 1U);
+    CHECK(EventScheduler::stats().pending == EventScheduler::kMaxEvents);
+    CHECK(EventScheduler::stats().maxPending == EventScheduler::kMaxEvents);
+
+    // One freed slot is enough for the next.
+    CHECK(EventScheduler::cancel(handles[100]));
+    CHECK(EventScheduler::schedule(now + 10U, record, id(999)) != EventScheduler::kNoEvent);
+
+    for (uint32_t i = 0; i < EventScheduler::kMaxEvents; ++i)
+    {
+        EventScheduler::cancel(handles[i]);
+    }
+    runFor(20);
+    CHECK(s_ran == 1U && s_log[0].id == 999U);
+    CHECK(EventScheduler::stats().pending == 0U);
+}
+
+/**
+ * @brief Events on both sides of the TIM2 wrap: order is by time to go,
+ * not by the raw count, so the one at 0x00000010 waits for the ones at
+ * 0xFFFFFFxx.
+ */
+void dueTimesAcrossTheWrap()
+{
+    clearLog();
+    Timebase::advance(0xFFFFFE00U - Timebase::now_us()); // 512 us before the wrap
+    uint32_t now = Timebase::now_us();
+    CHECK(now == 0xFFFFFE00U);
+
+    EventScheduler::schedule(0x00000010U, record, id(3));   // after the wrap
+    EventScheduler::schedule(0xFFFFFF00U, record, id(1));
+    EventScheduler::scheduleIn(0x300U, record, id(4));      // 0x00000100
+    EventScheduler::schedule(0xFFFFFFF0U, record, id(2));
+
+    runFor(0x100U);
+    CHECK(s_ran == 1U && s_log[0].id == 1U); // 0x0010 is not taken for overdue
+
+    runFor(0x400U);
+    CHECK(s_ran == 4U);
+    for (uint32_t i = 0; i < s_ran; ++i)
+    {
+        CHECK(s_log[i].id == i + 1U);
+        CHECK(s_log[i].at_us == s_log[i].due_us);
+    }
+    CHECK(s_log[2].due_us == 0x00000010U);
+    CHECK(s_log[3].due_us == 0x00000100U);
+    CHECK(EventScheduler::stats().pending == 0U);
+}
+
+} // namespace
+
+int main()
+{
+    Timebase::setHostMode(Timebase::HostMode::Virtual);
+    Timebase::init();
+    EventScheduler::init();
+
+    runsInDueOrder();
+    burstIsCappedPerInterrupt();
+    callbackSchedulesTheNextEdge();
+    cancelRemovesOnlyThatEvent();
+    staleHandleIsANoOp();
+    fullPoolRejects();
+    dueTimesAcrossTheWrap();
+    return Check::finish();
+}
@@ -0,0 +1,173 @@
+/**
+ * @file test_explicit_mpc.cpp
+ * @brief The generated MpcLawTable against the plant simulator: the model
+ * in the table is kVppe at the control rate, the law holds an equilibrium,
+ * and the loop closed through ExplicitMpc tracks steps within the limits.
+ *
+ * That the header is what Tools/mpc_generate.py produces today is checked
+ * by the mpc_law_table_up_to_date test next to this one.
+ */
+
+#include "Check.h"
+#include "ExplicitMpc.h"
+#include "MpcLawTable.h"
+#include "PlantSimulator.h"
+
+#include <math.h>
+
+namespace {
+
+const ExplicitMpc::Table& kTable = MpcLawTable::kTable;
+
+void tableIsTheVppeAtTheControlRate()
+{
+    const PlantSimulator::Params& p = PlantSimulator::kVppe;
+    float valve = expf(-kTable.period_s / p.valveTau_s);
+    float chamber = expf(-kTable.period_s / p.chamberTau_s);
+
+    CHECK(kTable.period_s == 0.001f);
+    CHECK_NEAR(kTable.a[0], -(valve + chamber), 1e-6f);
+    CHECK_NEAR(kTable.a[1], valve * chamber, 1e-6f);
+    CHECK_NEAR(kTable.b[0], (1.0f - valve) * (1.0f - chamber) * p.gain, 1e-7f);
+    CHECK(kTable.b[1] == 0.0f);
+    CHECK(kTable.delay == (uint16_t)(p.deadTime_s / kTable.period_s + 0.5f));
+    CHECK(kTable.delay <= ExplicitMpc::kMaxDelay);
+    CHECK(kTable.u_max <= 1.8f); // the setpoint cap, under the overpressure trip
+}
+
+void lawHoldsAnEquilibrium()
+{
+    PlantSimulator plant(PlantSimulator::kVppe, kTable.period_s);
+    ExplicitMpc mpc(plant, kTable);
+    const float levels[] = {0.2f, 0.5f, 1.0f, 1.5f};
+    for (float r : levels)
+    {
+        CHECK_NEAR(mpc.compute(r, r, r, r), r, 0.01f);
+    }
+}
+
+struct StepResult {
+    float overshoot;  // bar past the reference, in the step's direction
+    float error;      // |y - r| at the end
+    uint32_t settle;  // last period outside +-2% of the step
+    float maxMove;    // largest |u[k] - u[k-1]|
+    float lowest;
+    float highest;
+};
+
+/**
+ * @param uPrev the setpoint the controller sent last; updated.
+ */
+StepResult runStep(ExplicitMpc& mpc, PlantSimulator& plant, float from, float to, uint32_t periods, float& uPrev)
+{
+    StepResult result = {0.0f, 0.0f, 0, 0.0f, 1e9f, -1e9f};
+    float band = 0.02f * fabsf(to - from);
+    float direction = (to > from) ? 1.0f : -1.0f;
+    for (uint32_t k = 0; k < periods; ++k)
+    {
+        float u = mpc.step(to);
+        plant.step();
+        float y = plant.pressure();
+
+        float past = (y - to) * direction;
+        result.overshoot = (past > result.overshoot) ? past : result.overshoot;
+        result.settle = (fabsf(y - to) > band) ? k : result.settle;
+        float move = fabsf(u - uPrev);
+        result.maxMove = (move > result.maxMove) ? move : result.maxMove;
+        result.lowest = (u < result.lowest) ? u : result.lowest;
+        result.highest = (u > result.highest) ? u : result.highest;
+        uPrev = u;
+    }
+    result.error = fabsf(plant.pressure() - to);
+    return result;
+}
+
+/**
+ * @brief Up 0 -> 1 bar and down to 0.3 bar on kVppe, 12 ms dead time
+ * included. The steps are slew limited (0.05 bar per period), so most of
+ * the 2% settling time is the ramp and the plant's lags behind it.
+ */
+void closedLoopOnTheSimulator()
+{
+    PlantSimulator plant(PlantSimulator::kVppe, kTable.period_s);
+    ExplicitMpc mpc(plant, kTable);
+    mpc.reset(0.0f, 0.0f);
+    float u = 0.0f;
+
+    StepResult up = runStep(mpc, plant, 0.0f, 1.0f, 400, u);
+    printf("0 -> 1 bar:   overshoot %.1f mbar, settled in %u ms, error %.2f mbar\n",
+           up.overshoot * 1000.0f, up.settle + 1U, up.error * 1000.0f);
+    CHECK(up.error < 0.01f);
+    CHECK(up.overshoot < 0.05f);
+    CHECK(up.settle < 200U);
+
+    StepResult down = runStep(mpc, plant, 1.0f, 0.3f, 400, u);
+    printf("1 -> 0.3 bar: overshoot %.1f mbar, settled in %u ms, error %.2f mbar\n",
+           down.overshoot * 1000.0f, down.settle + 1U, down.error * 1000.0f);
+    CHECK(down.error < 0.01f);
+    CHECK(down.overshoot < 0.05f);
+    CHECK(down.settle < 200U);
+
+    const StepResult* both[] = {&up, &down};
+    for (const StepResult* r : both)
+    {
+        CHECK(r->maxMove <= kTable.slew + 1e-6f);
+        CHECK(r->lowest >= kTable.u_min && r->highest <= kTable.u_max);
+    }
+}
+
+/**
+ * @brief The same law without the dead-time compensation: it was solved
+ * for a plant 12 periods faster, and rings.
+ */
+void compensationIsWhatKeepsItStable()
+{
+    ExplicitMpc::Table bare = kTable;
+    bare.delay = 0;
+    PlantSimulator plant(PlantSimulator::kVppe, kTable.period_s);
+    ExplicitMpc mpc(plant, bare);
+    mpc.reset(0.0f, 0.0f);
+    float u = 0.0f;
+
+    StepResult up = runStep(mpc, plant, 0.0f, 1.0f, 400, u);
+    printf("uncompensated 0 -> 1 bar: overshoot %.1f mbar, settled in %u ms\n",
+           up.overshoot * 1000.0f, up.settle + 1U);
+    CHECK(up.overshoot > 0.05f || up.settle >= 200U);
+}
+
+/**
+ * @brief reset() to a settled plant: no bump when the MPC takes over.
+ */
+void bumplessTakeOver()
+{
+    PlantSimulator plant(PlantSimulator::kVppe, kTable.period_s);
+    plant.setPressure(0.8f);
+    for (uint32_t k = 0; k < 1000U; ++k)
+    {
+        plant.step();
+    }
+    ExplicitMpc mpc(plant, kTable);
+    mpc.reset(plant.getActualPressure(), 0.8f);
+
+    float worst = 0.0f;
+    for (uint32_t k = 0; k < 200U; ++k)
+    {
+        mpc.step(0.8f);
+        plant.step();
+        float error = fabsf(plant.pressure() - 0.8f);
+        worst = (error > worst) ? error : worst;
+    }
+    CHECK(worst < 0.005f);
+}
+
+} // namespace
+
+int main()
+{
+    tableIsTheVppeAtTheControlRate();
+    lawHoldsAnEquilibrium();
+    closedLoopOnTheSimulator();
+    compensationIsWhatKeepsItStable();
+    bumplessTakeOver();
+    return Check::finish();
+}
@@ -0,0 +1,338 @@
+/**
+ * @file test_memory_pools.cpp
+ * @brief MemoryPools on the host: block alignment, the arena's aligned
+ * bump allocation, the usage accounting, the checks in release(), and the
+ * global new/delete routed as on the target (MEMORY_POOLS_ROUTE_NEW):
+ * arena at boot, pools once running, and Trap mode.
+ *
+ * Error_Handler() is this file's: it jumps back into the case that
+ * expected the trap. The routed operators handle every new in this
+ * executable, so the cases only measure differences.
+ */
+
+#include "Check.h"
+#include "MemoryPools.h"
+
+#include <new>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace {
+
+jmp_buf s_trapped;
+bool s_trapExpected = false;
+
+} // namespace
+
+extern "C" void Error_Handler(void)
+{
+    if (!s_trapExpected)
+    {
+        printf("unexpected trap: size %zu, pointer %p\n", MemoryPools::lastTrap().size,
+               MemoryPools::lastTrap().pointer);
+        abort();
+    }
+    longjmp(s_trapped, 1);
+}
+
+namespace {
+
+// Stores keep new/delete pairs from being elided.
+void* volatile s_sink;
+
+/**
+ * @brief True if @p action ended in Error_Handler().
+ */
+template <typename Action>
+bool traps(Action action)
+{
+    s_trapExpected = true;
+    bool trapped = (setjmp(s_trapped) != 0);
+    if (!trapped)
+    {
+        action();
+    }
+    s_trapExpected = false;
+    return trapped;
+}
+
+struct Small {
+    uint32_t words[3];
+};
+
+struct alignas(64) Aligned {
+    float m[4];
+};
+
+struct alignas(512) TooAligned {
+    uint8_t bytes[16];
+};
+
+MemoryPools::PoolRow row(uint32_t pool)
+{
+    MemoryPools::PoolRow rows[MemoryPools::kPoolCount];
+    MemoryPools::usage(rows);
+    return rows[pool];
+}
+
+bool alignedTo(const void* pointer, size_t alignment)
+{
+    return ((uintptr_t)pointer & (alignment - 1U)) == 0U;
+}
+
+void blocksAreAlignedToTheirSize()
+{
+    MemoryPools::PoolRow rows[MemoryPools::kPoolCount];
+    MemoryPools::usage(rows);
+    for (const MemoryPools::PoolRow& row : rows)
+    {
+        void* blocks[32];
+        for (uint32_t i = 0; i < row.blocks; ++i)
+        {
+            blocks[i] = MemoryPools::allocate(row.blockSize);
+            CHECK(blocks[i] != nullptr);
+            CHECK(alignedTo(blocks[i], row.blockSize));
+            CHECK(MemoryPools::ownsPoolBlock(blocks[i]));
+        }
+        for (uint32_t i = 0; i < row.blocks; ++i)
+        {
+            MemoryPools::release(blocks[i]);
+        }
+    }
+
+    // What the aligned operator new asks for: max(size, alignment).
+    struct alignas(64) Matrix {
+        float m[4];
+    };
+    void* matrix = MemoryPools::allocate(alignof(Matrix));
+    CHECK(alignedTo(matrix, alignof(Matrix)));
+    MemoryPools::release(matrix);
+    void* widest = MemoryPools::allocate(MemoryPools::kMaxAlignment);
+    CHECK(alignedTo(widest, MemoryPools::kMaxAlignment));
+    MemoryPools::release(widest);
+}
+
+void arenaPadsToTheAlignment()
+{
+    MemoryPools::PoolRow rows[MemoryPools::kPoolCount];
+    uint32_t before = MemoryPools::usage(rows).arenaUsed;
+
+    void* a = MemoryPools::allocateBoot(3);
+    CHECK(a != nullptr && alignedTo(a, 8));
+    void* b = MemoryPools::allocateBoot(24, 64);
+    CHECK(b != nullptr && alignedTo(b, 64));
+    CHECK(MemoryPools::ownsArenaBlock(b));
+    void* c = MemoryPools::allocateBoot(8, 4); // below 8: still 8
+    CHECK(c != nullptr && alignedTo(c, 8));
+    CHECK((uint8_t*)c >= (uint8_t*)b + 24);
+
+    MemoryPools::RecordHeader header = MemoryPools::usage(rows);
+    CHECK(header.arenaUsed > before + 8U + 24U);
+    CHECK(header.arenaUsed <= before + 8U + 64U + 24U + 8U);
+
+    // Padding counts against the space left.
+    uint32_t left = header.arenaSize - header.arenaUsed;
+    CHECK(MemoryPools::allocateBoot(left + 1U) == nullptr);
+    CHECK(MemoryPools::allocateBoot(left - 8U, 256) == nullptr || left >= 256U);
+    CHECK(MemoryPools::allocateBoot(left) != nullptr);
+    CHECK(MemoryPools::allocateBoot(1) == nullptr);
+}
+
+void accountsAndRefusesWhenEmpty()
+{
+    MemoryPools::PoolRow rows[MemoryPools::kPoolCount];
+    MemoryPools::usage(rows);
+    const MemoryPools::PoolRow largest = rows[MemoryPools::kPoolCount - 1U];
+
+    void* blocks[32];
+    for (uint32_t i = 0; i < largest.blocks; ++i)
+    {
+        blocks[i] = MemoryPools::allocate(largest.blockSize);
+    }
+    CHECK(MemoryPools::allocate(largest.blockSize) == nullptr); // no spilling
+    CHECK(MemoryPools::allocate(largest.blockSize + 1U) == nullptr);
+    MemoryPools::usage(rows);
+    CHECK(rows[MemoryPools::kPoolCount - 1U].inUse == largest.blocks);
+    CHECK(rows[MemoryPools::kPoolCount - 1U].peak == largest.blocks);
+    CHECK(rows[MemoryPools::kPoolCount - 1U].failures == largest.failures + 2U);
+
+    for (uint32_t i = 0; i < largest.blocks; ++i)
+    {
+        MemoryPools::release(blocks[i]);
+    }
+    MemoryPools::release(nullptr);
+    MemoryPools::usage(rows);
+    CHECK(rows[MemoryPools::kPoolCount - 1U].inUse == 0U);
+}
+
+/**
+ * @brief The free list is only pushed for a block start that is handed
+ * out; anything else is refused and counted.
+ */
+void releaseRefusesWhatIsNotAHandedOutBlock()
+{
+    MemoryPools::PoolRow rows[MemoryPools::kPoolCount];
+    uint32_t before = MemoryPools::usage(rows).badReleases;
+    uint8_t* block = static_cast<uint8_t*>(MemoryPools::allocate(32));
+    uint32_t inUse = row(1).inUse;
+
+    CHECK(!MemoryPools::release(block + 8));          // inside the block
+    uint32_t onTheStack = 0;
+    CHECK(!MemoryPools::release(&onTheStack));        // not pool memory
+    void* boot = MemoryPools::allocateBoot(8);
+    CHECK(!MemoryPools::release(boot));               // arena
+    CHECK(row(1).inUse == inUse);
+
+    CHECK(MemoryPools::release(block));
+    CHECK(!MemoryPools::release(block));              // double free
+    CHECK(row(1).inUse == inUse - 1U);
+    CHECK(MemoryPools::release(nullptr));
+    CHECK(MemoryPools::usage(rows).badReleases == before + 4U);
+
+    // The list is intact: every block comes out once more, and no more.
+    void* blocks[32];
+    uint32_t count = row(1).blocks;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        blocks[i] = MemoryPools::allocate(32);
+        CHECK(blocks[i] != nullptr);
+        for (uint32_t j = 0; j < i; ++j)
+        {
+            CHECK(blocks[j] != blocks[i]);
+        }
+    }
+    CHECK(MemoryPools::allocate(32) == nullptr);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        CHECK(MemoryPools::release(blocks[i]));
+    }
+}
+
+/**
+ * @brief Before onSchedulerStart(): new takes from the arena, aligned
+ * types included, and delete leaves the arena alone.
+ */
+void bootNewTakesFromTheArena()
+{
+    MemoryPools::PoolRow rows[MemoryPools::kPoolCount];
+    MemoryPools::RecordHeader before = MemoryPools::usage(rows);
+    CHECK(before.running == 0U);
+
+    Small* small = new Small();
+    s_sink = small;
+    CHECK(MemoryPools::ownsArenaBlock(small));
+    Aligned* aligned = new Aligned();
+    s_sink = aligned;
+    CHECK(MemoryPools::ownsArenaBlock(aligned) && alignedTo(aligned, 64));
+    uint8_t* bytes = new uint8_t[40];
+    s_sink = bytes;
+    CHECK(MemoryPools::ownsArenaBlock(bytes));
+
+    MemoryPools::RecordHeader after = MemoryPools::usage(rows);
+    CHECK(after.arenaUsed >= before.arenaUsed + sizeof(Small) + sizeof(Aligned) + 40U);
+    delete small;
+    delete aligned;
+    delete[] bytes;
+    MemoryPools::RecordHeader deleted = MemoryPools::usage(rows);
+    CHECK(deleted.arenaUsed == after.arenaUsed);
+    CHECK(deleted.arenaDeletes == before.arenaDeletes + 3U);
+
+    CHECK(new (std::nothrow) TooAligned() == nullptr);
+    CHECK(traps([] { s_sink = new TooAligned(); }));
+    CHECK(MemoryPools::lastTrap().size == sizeof(TooAligned));
+}
+
+/**
+ * @brief Mode::Pools: new takes the smallest pool block that fits (at
+ * least the alignment), delete gives it back, and running out is fatal
+ * unless nothrow.
+ */
+void runningNewTakesFromThePools()
+{
+    MemoryPools::onSchedulerStart(MemoryPools::Mode::Pools);
+    MemoryPools::PoolRow rows[MemoryPools::kPoolCount];
+    CHECK(MemoryPools::usage(rows).running == 1U);
+    uint32_t arenaUsed = MemoryPools::usage(rows).arenaUsed;
+
+    MemoryPools::PoolRow sixteen = row(0);
+    Small* small = new Small();
+    s_sink = small;
+    CHECK(MemoryPools::ownsPoolBlock(small));
+    CHECK(row(0).inUse == sixteen.inUse + 1U && row(0).allocations == sixteen.allocations + 1U);
+    delete small;
+    CHECK(row(0).inUse == sixteen.inUse);
+
+    MemoryPools::PoolRow sixtyFour = row(2);
+    Aligned* aligned = new Aligned(); // 16 bytes, but 64-aligned: a 64-byte block
+    s_sink = aligned;
+    CHECK(alignedTo(aligned, 64) && row(2).inUse == sixtyFour.inUse + 1U);
+    delete aligned;
+
+    MemoryPools::PoolRow oneTwentyEight = row(3);
+    uint8_t* bytes = new uint8_t[100];
+    s_sink = bytes;
+    CHECK(row(3).inUse == oneTwentyEight.inUse + 1U);
+    delete[] bytes;
+    CHECK(MemoryPools::usage(rows).arenaUsed == arenaUsed);
+
+    uint32_t failures = row(MemoryPools::kPoolCount - 1U).failures;
+    CHECK(new (std::nothrow) uint8_t[MemoryPools::kMaxAlignment + 1U] == nullptr);
+    CHECK(row(MemoryPools::kPoolCount - 1U).failures == failures + 1U);
+    CHECK(traps([] { s_sink = new uint8_t[MemoryPools::kMaxAlignment + 1U]; }));
+    CHECK(MemoryPools::lastTrap().size == MemoryPools::kMaxAlignment + 1U);
+    CHECK(MemoryPools::lastTrap().caller != nullptr);
+}
+
+/**
+ * @brief A delete the pools refuse stops the firmware instead of
+ * corrupting a free list.
+ */
+void badDeleteTraps()
+{
+    static Small* small;
+    small = new Small();
+    s_sink = small;
+    uint32_t inUse = row(0).inUse;
+    delete small;
+
+    CHECK(traps([] { delete small; })); // double delete
+    CHECK(MemoryPools::lastTrap().size == 0U && MemoryPools::lastTrap().pointer == small);
+    CHECK(row(0).inUse == inUse - 1U);
+
+    static uint32_t notFromNew;
+    s_sink = &notFromNew; // through the sink, so the compiler does not see what it is
+    CHECK(traps([] { ::operator delete(s_sink); }));
+    CHECK(MemoryPools::lastTrap().pointer == &notFromNew);
+}
+
+void trapModeTrapsEveryNew()
+{
+    Small* before = new Small(); // from the pools, still Mode::Pools
+    s_sink = before;
+    MemoryPools::onSchedulerStart(MemoryPools::Mode::Trap);
+
+    CHECK(traps([] { s_sink = new Small(); }));
+    CHECK(MemoryPools::lastTrap().size == sizeof(Small));
+    CHECK(traps([] { s_sink = new (std::nothrow) uint32_t(1); })); // nothrow is no way round it
+    CHECK(MemoryPools::lastTrap().size == sizeof(uint32_t));
+
+    uint32_t inUse = row(0).inUse;
+    delete before; // deletes still work
+    CHECK(row(0).inUse == inUse - 1U);
+}
+
+} // namespace
+
+int main()
+{
+    blocksAreAlignedToTheirSize();
+    accountsAndRefusesWhenEmpty();
+    releaseRefusesWhatIsNotAHandedOutBlock();
+    bootNewTakesFromTheArena();
+    runningNewTakesFromThePools();
+    badDeleteTraps();
+    trapModeTrapsEveryNew();
+    arenaPadsToTheAlignment(); // fills the arena: last
+    return Check::finish();
+}
@@ -0,0 +1,104 @@
+/**
+ * @file test_overpressure_threshold.cpp
+ * @brief The overpressure configuration checks, the DAC3 code for the trip
+ * and the setpoint cap in BasicPressureRegulator.
+ */
+
+#include "Check.h"
+#include "HostBoard.h"
+#include "OverpressureThreshold.h"
+#include "PressureRegulatorDriver.h"
+#include "VppeCalibration.h"
+
+namespace {
+
+using namespace OverpressureThreshold;
+
+constexpr float kMultiplier = 10.0f / 3.3f;
+
+void defaultConfigIsValid()
+{
+    CHECK(isValid(kDefaultConfig));
+    CHECK(kDefaultConfig.trip_bar >= kDefaultConfig.max_setpoint_bar + kMarginBar);
+}
+
+void invalidConfigsAreRejected()
+{
+    // Trip too close to (or under) the highest setpoint.
+    CHECK(!isValid({1.82f, 1.8f, kMultiplier, 2U}));
+    CHECK(!isValid({1.5f, 1.8f, kMultiplier, 2U}));
+    // Trip past the VPPE range.
+    CHECK(!isValid({2.1f, 1.8f, kMultiplier, 2U}));
+    // No divider: the pin would see the full 0-10V feedback.
+    CHECK(!isValid({1.9f, 1.8f, 1.0f, 2U}));
+    CHECK(!isValid({1.9f, 1.8f, 0.0f, 2U}));
+    // HYST is a 3-bit field.
+    CHECK(!isValid({1.9f, 1.8f, kMultiplier, 8U}));
+    CHECK(!isValid({1.9f, -0.1f, kMultiplier, 2U}));
+
+    CHECK(isValid({1.0f, 0.5f, kMultiplier, 0U}));
+    CHECK(isValid({1.9f, 1.8f, kMultiplier, 7U}));
+}
+
+void dacCodeMatchesThePinVoltage()
+{
+    // 1.9 bar -> 9.5 V feedback -> 3.135 V on the pin -> 3890 of 4095.
+    CHECK_NEAR(barToFeedbackVolts(1.9f), 9.5f, 1e-5f);
+    CHECK_NEAR(barToPinVolts(1.9f, kMultiplier), 3.135f, 1e-4f);
+    CHECK(dacCode(1.9f, kMultiplier) == 3890U);
+
+    CHECK(dacCode(0.02f, kMultiplier) == 41U); // 0.1 V feedback, the VPPE floor
+    CHECK(dacCode(0.0f, kMultiplier) == 0U);
+    CHECK(dacCode(2.0f, 1.0f) == 4095U);       // clamped to the top
+    CHECK(dacCode(-1.0f, kMultiplier) == 0U);   // and to the bottom
+}
+
+void regulatorCapsTheSetpoint()
+{
+    constexpr float kCap_bar = kDefaultConfig.max_setpoint_bar;
+    FakeAnalogOut output;
+    FakeAnalogIn feedback(&output);
+    BasicPressureRegulator<FakeAnalogOut, FakeAnalogIn> regulator(output, feedback);
+    CHECK(regulator.maxSetpoint() == kCap_bar);
+    CHECK(output.writes() == 1U); // the 0 bar written at construction
+
+    CHECK(regulator.setPressure(1.0f));
+    CHECK_NEAR(output.voltage(), VppeCalibration::barToVolts(1.0f), 1e-6f);
+    CHECK_NEAR(regulator.getActualPressure(), 1.0f, 1e-5f);
+
+    CHECK(regulator.setPressure(kCap_bar));
+    CHECK_NEAR(output.voltage(), VppeCalibration::barToVolts(kCap_bar), 1e-6f);
+
+    // Past the cap, and past the trip: written as the cap.
+    CHECK(regulator.setPressure(1.85f));
+    CHECK_NEAR(output.voltage(), VppeCalibration::barToVolts(kCap_bar), 1e-6f);
+    CHECK(regulator.setPressure(5.0f));
+    CHECK_NEAR(output.voltage(), VppeCalibration::barToVolts(kCap_bar), 1e-6f);
+    CHECK(VppeCalibration::voltsToBar(output.voltage()) < kDefaultConfig.trip_bar - kMarginBar + 1e-5f);
+
+    BasicPressureRegulator<FakeAnalogOut, FakeAnalogIn> lower(output, feedback, 0.5f);
+    CHECK(lower.setPressure(1.0f));
+    CHECK_NEAR(output.voltage(), VppeCalibration::barToVolts(0.5f), 1e-6f);
+}
+
+void runtimeWiredRegulatorCapsToo()
+{
+    FakeAnalogOut output;
+    FakeAnalogIn feedback(&output);
+    PressureRegulatorDriver regulator(output, feedback, 1.2f);
+    IPressureControl& control = regulator;
+    CHECK(control.setPressure(1.9f));
+    CHECK_NEAR(output.voltage(), VppeCalibration::barToVolts(1.2f), 1e-6f);
+}
+
+} // namespace
+
+int main()
+{
+    defaultConfigIsValid();
+    invalidConfigsAreRejected();
+    dacCodeMatchesThePinVoltage();
+    regulatorCapsTheSetpoint();
+    runtimeWiredRegulatorCapsToo();
+    return Check::finish();
+}
@@ -0,0 +1,200 @@
+/**
+ * @file test_spectrum_analyzer.cpp
+ * @brief SpectrumAnalyzer: amplitude scaling, overrun accounting, and a
+ * producer lapping service() mid-copy without torn blocks reaching the
+ * averages.
+ */
+
+#include "Check.h"
+#include "SpectrumAnalyzer.h"
+
+#include <math.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+namespace {
+
+constexpr float kRate_hz = 1000.0f;
+constexpr float kBinWidth_hz = kRate_hz / (float)SpectrumAnalyzer::kFftSize;
+constexpr uint32_t kBin = 20;
+constexpr float kAmplitude = 0.3f;
+
+/**
+ * @brief Sample @p n of a tone @p bins bins up, phase kept exact for any n.
+ */
+float sine(uint64_t n, double bins = kBin)
+{
+    double cycles = fmod((double)n * bins / (double)SpectrumAnalyzer::kFftSize, 1.0);
+    return kAmplitude * (float)sin(2.0 * 3.141592653589793 * cycles);
+}
+
+uint32_t overruns(const SpectrumAnalyzer& analyzer)
+{
+    static uint8_t buf[sizeof(SpectrumAnalyzer::Header)
+                       + (SpectrumAnalyzer::kHarmonics + SpectrumAnalyzer::kBins) * sizeof(float)];
+    SpectrumAnalyzer::Header header;
+    CHECK(analyzer.encode(0, buf, sizeof(buf)) == sizeof(buf));
+    memcpy(&header, buf, sizeof(header));
+    return header.overruns;
+}
+
+/**
+ * @brief Largest amplitude more than @p guard bins away from the tone. A
+ * block spliced from two stretches of the sine has a phase jump that leaks
+ * into every bin; intact blocks keep the Hann sidelobes far down.
+ */
+float leakage(const SpectrumAnalyzer& analyzer, uint32_t guard = 4)
+{
+    float worst = 0.0f;
+    for (uint32_t k = 1; k < SpectrumAnalyzer::kBins; ++k)
+    {
+        if (k + guard < kBin || k > kBin + guard)
+        {
+            worst = fmaxf(worst, analyzer.amplitude(0, k));
+        }
+    }
+    return worst;
+}
+
+void testAmplitude()
+{
+    static SpectrumAnalyzer analyzer(kRate_hz);
+    for (uint32_t n = 0; n < 20U * SpectrumAnalyzer::kFftSize; ++n)
+    {
+        analyzer.pushSample(0, sine(n));
+        analyzer.service();
+    }
+    CHECK_NEAR(analyzer.amplitude(0, kBin), kAmplitude, 0.01f);
+    SpectrumAnalyzer::Peak peak = analyzer.dominantPeak(0, 1.0f);
+    CHECK_NEAR(peak.frequency_hz, kBin * kBinWidth_hz, 0.1f);
+    CHECK(leakage(analyzer) < 1e-3f);
+    CHECK(overruns(analyzer) == 0U);
+}
+
+void testFallingBehind()
+{
+    static SpectrumAnalyzer analyzer(kRate_hz);
+    for (uint32_t n = 0; n < 3U * SpectrumAnalyzer::kRingSize; ++n)
+    {
+        analyzer.pushSample(0, sine(n));
+    }
+    CHECK(analyzer.service() == 1U); // only the newest block is left
+    CHECK(overruns(analyzer) == 1U);
+    CHECK_NEAR(analyzer.amplitude(0, kBin), kAmplitude, 0.01f);
+}
+
+// The control loop preempting the idle-priority analyser task: a timer
+// signal pushes more than the ring's slack in one go, so whenever it lands
+// inside a block copy the copy is lapped.
+constexpr uint32_t kPeriod = 2048;
+constexpr uint32_t kBurst = SpectrumAnalyzer::kRingSize - SpectrumAnalyzer::kFftSize + 64U;
+SpectrumAnalyzer* s_lapped;
+float s_table[kPeriod];
+uint32_t s_produced;
+
+constexpr uint32_t kBursts = 5000;
+volatile sig_atomic_t s_bursts;
+uint32_t s_ticks;
+
+void controlLoopIsr(int)
+{
+    // Ten back-to-back bursts swamp service(), ten quiet ticks let it
+    // return so the test can look at the averages.
+    if (s_bursts >= (sig_atomic_t)kBursts || (s_ticks++ % 20U) >= 10U)
+    {
+        return;
+    }
+    s_bursts = s_bursts + 1;
+    for (uint32_t i = 0; i < kBurst; ++i)
+    {
+        s_lapped->pushSample(0, s_table[s_produced++ % kPeriod]);
+    }
+}
+
+void testLappedMidCopy()
+{
+    static SpectrumAnalyzer analyzer(kRate_hz);
+    s_lapped = &analyzer;
+    // 20.375 bins repeats every 2048 samples, not every ring length, so an
+    // overwritten slot really changes the block.
+    for (uint32_t n = 0; n < kPeriod; ++n)
+    {
+        s_table[n] = sine(n, kBin + 0.375);
+    }
+    signal(SIGALRM, controlLoopIsr);
+    itimerval timer = {{0, 20}, {0, 20}};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    // A torn block only stays in the running average for a few blocks, so
+    // watch it after every pass.
+    uint32_t processed = 0;
+    float worst = 0.0f;
+    while (s_bursts < (sig_atomic_t)kBursts)
+    {
+        if (analyzer.service() != 0U)
+        {
+            processed++;
+            worst = fmaxf(worst, leakage(analyzer, 12));
+        }
+    }
+    timer = {};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    printf("lapped producer: %u service passes, %u overruns, worst leakage %.2e\n", processed,
+           overruns(analyzer), (double)worst);
+    CHECK(overruns(analyzer) > 0U);
+    CHECK(worst < 1e-4f);
+}
+
+// Telemetry outranking the idle-priority analyser: encode() from a timer
+// signal lands in the middle of processBlock() now and then, and must
+// return instead of waiting for an update that cannot finish under it.
+SpectrumAnalyzer* s_encoded;
+uint32_t s_encodes;
+uint32_t s_encodeGaveUp;
+
+void telemetryIsr(int)
+{
+    static uint8_t buf[sizeof(SpectrumAnalyzer::Header)
+                       + (SpectrumAnalyzer::kHarmonics + SpectrumAnalyzer::kBins) * sizeof(float)];
+    if (s_encoded->encode(0, buf, sizeof(buf)) != 0U)
+    {
+        s_encodes++;
+    }
+    else
+    {
+        s_encodeGaveUp++;
+    }
+}
+
+void testEncodePreemptsService()
+{
+    static SpectrumAnalyzer analyzer(kRate_hz);
+    s_encoded = &analyzer;
+    signal(SIGALRM, telemetryIsr);
+    itimerval timer = {{0, 50}, {0, 50}};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+    for (uint32_t n = 0; n < 4000000U && (s_encodeGaveUp == 0U || n < 400000U); ++n)
+    {
+        analyzer.pushSample(0, sine(n));
+        analyzer.service();
+    }
+    timer = {};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    printf("preempting encode: %u encoded, %u gave up mid-update\n", s_encodes, s_encodeGaveUp);
+    CHECK(s_encodes > 0U);
+    CHECK(s_encodeGaveUp > 0U);
+}
+
+} // namespace
+
+int main()
+{
+    testAmplitude();
+    testFallingBehind();
+    testLappedMidCopy();
+    testEncodePreemptsService();
+    return Check::finish();
+}
@@ -0,0 +1,94 @@
+/**
+ * @file test_system_root.cpp
+ * @brief SystemRoot<HostBoard>, the composition root main() uses, brought
+ * up on the host: init() wires the regulator to the fake DAC and ADC, and
+ * start() books the event that feeds the pressure pair into the spectrum
+ * analyser, which then sees the tone put on the pair.
+ */
+
+#include "Check.h"
+#include "SystemRoot.h"
+#include "Timebase.h"
+
+#include <math.h>
+#include <type_traits>
+
+static_assert(std::is_same_v<System, SystemRoot<HostBoard>>, "host builds compose the HostBoard");
+
+namespace {
+
+constexpr uint32_t kBin = 16;
+constexpr float kPulse_V = 0.4f;
+
+void regulatorDrivesTheBoard()
+{
+    uint32_t writes = System::output().writes();
+    CHECK(System::regulator().setPressure(1.0f));
+    CHECK(System::output().writes() == writes + 1U);
+    CHECK_NEAR(System::feedback().readVoltage(), System::output().voltage(), 1e-6f);
+    CHECK_NEAR(System::regulator().getActualPressure(), 1.0f, 1e-3f);
+
+    System::regulator().setPressure(100.0f); // capped, not refused
+    CHECK(System::regulator().getActualPressure() <= HostBoard::kOverpressure.max_setpoint_bar + 1e-3f);
+}
+
+/**
+ * @brief One pair per pair period, as the dual ADC produces them: a tone
+ * kBin bins up on the first sensor, a steady level on the second.
+ */
+void runPairs(uint32_t pairs, uint64_t& n)
+{
+    for (uint32_t i = 0; i < pairs; ++i, ++n)
+    {
+        double cycles = fmod((double)n * kBin / (double)SpectrumAnalyzer::kFftSize, 1.0);
+        float first = 1.2f + kPulse_V * (float)sin(2.0 * 3.141592653589793 * cycles);
+        HostBoard::pressurePair().setVoltages(first, 0.8f);
+        HostBoard::pressurePair().produce(1);
+        Timebase::advance(HostBoard::kPairPeriod_us);
+        EventScheduler::dispatch();
+    }
+}
+
+void startFeedsTheSpectrumAnalyzer()
+{
+    EventScheduler::Stats before = EventScheduler::stats();
+    System::start();
+    CHECK(EventScheduler::stats().pending == before.pending + 1U);
+
+    uint64_t n = 0;
+    constexpr uint32_t kPairsPerFeed = System::kSpectrumFeed_us / HostBoard::kPairPeriod_us;
+    runPairs(kPairsPerFeed - 1U, n);
+    CHECK(EventScheduler::stats().dispatched == before.dispatched); // not due yet
+    CHECK(System::spectrum().service() == 0U);
+
+    // 20 feeds, serviced after each as the idle task would.
+    for (uint32_t feed = 0; feed < 20U; ++feed)
+    {
+        runPairs(kPairsPerFeed, n);
+        System::spectrum().service();
+    }
+    CHECK(EventScheduler::stats().dispatched - before.dispatched == 20U);
+    CHECK(EventScheduler::stats().pending == before.pending + 1U); // rebooked each time
+    CHECK(HostBoard::pressurePair().dropped() == 0U);
+
+    const SpectrumAnalyzer& spectrum = System::spectrum();
+    float binWidth_hz = 1e6f / (float)HostBoard::kPairPeriod_us / (float)SpectrumAnalyzer::kFftSize;
+    SpectrumAnalyzer::Peak peak = spectrum.dominantPeak(0, 4.0f * binWidth_hz); // above the 1.2 V offset
+    CHECK_NEAR(peak.frequency_hz, kBin * binWidth_hz, 0.5f);
+    CHECK_NEAR(spectrum.amplitude(0, kBin), kPulse_V, 0.01f);
+    CHECK(spectrum.amplitude(1, kBin) < 0.005f); // the second sensor is steady
+}
+
+} // namespace
+
+int main()
+{
+    Timebase::setHostMode(Timebase::HostMode::Virtual);
+    Timebase::init();
+    EventScheduler::init();
+
+    System::init();
+    regulatorDrivesTheBoard();
+    startFeedsTheSpectrumAnalyzer();
+    return Check::finish();
+}
@@ -0,0 +1,240 @@
+/**
+ * @file test_threshold_watch.cpp
+ * @brief ThresholdWatch on the FakeAnalogWatchdog: window placement,
+ * hysteresis, the event queue, and crossing() in a sequence.
+ */
+
+#include "Check.h"
+#include "HostBoard.h"
+#include "Sequencer.h"
+#include "ThresholdWatch.h"
+#include "Timebase.h"
+
+#include <math.h>
+
+namespace {
+
+constexpr float kVoltsPerCount = 3.3f / 4095.0f;
+
+uint16_t counts(float volts)
+{
+    return (uint16_t)(volts / kVoltsPerCount + 0.5f);
+}
+
+void risingFiresOnceWithItsTimestamp()
+{
+    FakeAnalogWatchdog watchdog;
+    ThresholdWatch watch(watchdog);
+    CHECK(!watch.isArmed());
+    CHECK(watchdog.low() == 0U && watchdog.high() == 4095U);
+
+    watch.arm(ThresholdWatch::Edge::Rising, 2.0f, 0.0f);
+    CHECK(watch.isArmed());
+    CHECK(watchdog.low() == 0U && watchdog.high() == counts(2.0f));
+
+    watchdog.convertVolts(1.0f, 100);
+    watchdog.convertVolts(1.99f, 200);
+    CHECK(watch.fired() == 0U);
+
+    watchdog.convertVolts(2.1f, 300);
+    watchdog.convertVolts(2.5f, 400); // window opened up again: no second event
+    CHECK(watch.fired() == 1U);
+    CHECK(!watch.isArmed());
+    CHECK(watchdog.low() == 0U && watchdog.high() == 4095U);
+    CHECK(watchdog.interrupts() == 1U);
+
+    ThresholdWatch::Event event;
+    CHECK(watch.poll(event));
+    CHECK(event.time_us == 300U);
+    CHECK(event.counts == counts(2.1f));
+    CHECK(event.edge == ThresholdWatch::Edge::Rising);
+    CHECK(!watch.poll(event));
+}
+
+void zeroHysteresisFiresWhenAlreadyPast()
+{
+    FakeAnalogWatchdog watchdog;
+    ThresholdWatch watch(watchdog);
+    watch.arm(ThresholdWatch::Edge::Falling, 1.0f, 0.0f);
+    CHECK(watchdog.low() == counts(1.0f) && watchdog.high() == 4095U);
+
+    watchdog.convertVolts(0.5f, 10);
+    CHECK(watch.fired() == 1U);
+}
+
+void hysteresisIgnoresNoiseAndAStartPastTheThreshold()
+{
+    FakeAnalogWatchdog watchdog;
+    ThresholdWatch watch(watchdog);
+
+    // Falling through 1.0 V with 0.2 V hysteresis: must first be >= 1.2 V.
+    watch.arm(ThresholdWatch::Edge::Falling, 1.0f, 0.2f);
+    CHECK(watchdog.low() == 0U && watchdog.high() == counts(1.2f));
+
+    watchdog.convertVolts(0.8f, 10);  // already below: not a crossing
+    watchdog.convertVolts(1.05f, 20);
+    watchdog.convertVolts(0.95f, 30); // noise around the threshold
+    CHECK(watch.fired() == 0U);
+
+    watchdog.convertVolts(1.5f, 40);  // primed, window moves to the threshold
+    CHECK(watch.fired() == 0U);
+    CHECK(watchdog.low() == counts(1.0f) && watchdog.high() == 4095U);
+
+    watchdog.convertVolts(1.1f, 50);
+    watchdog.convertVolts(0.9f, 60);
+    CHECK(watch.fired() == 1U);
+
+    ThresholdWatch::Event event;
+    CHECK(watch.poll(event));
+    CHECK(event.time_us == 60U);
+    CHECK(event.edge == ThresholdWatch::Edge::Falling);
+}
+
+void primeLevelOutOfRangeArmsStraightAway()
+{
+    FakeAnalogWatchdog watchdog;
+    ThresholdWatch watch(watchdog);
+
+    // 0.1 V - 0.5 V clamps to 0 counts, which no sample can go under.
+    watch.arm(ThresholdWatch::Edge::Rising, 0.1f, 0.5f);
+    CHECK(watchdog.low() == 0U && watchdog.high() == counts(0.1f));
+    watchdog.convertVolts(0.2f, 5);
+    CHECK(watch.fired() == 1U);
+}
+
+void disarmAndRearm()
+{
+    FakeAnalogWatchdog watchdog;
+    ThresholdWatch watch(watchdog);
+    watch.arm(ThresholdWatch::Edge::Rising, 2.0f, 0.0f);
+    watch.disarm();
+    CHECK(!watch.isArmed());
+    CHECK(watchdog.low() == 0U && watchdog.high() == 4095U);
+    watchdog.convertVolts(3.0f, 10);
+    CHECK(watch.fired() == 0U);
+
+    // arm() replaces what was armed.
+    watch.arm(ThresholdWatch::Edge::Rising, 2.0f, 0.0f);
+    watch.arm(ThresholdWatch::Edge::Falling, 0.5f, 0.0f);
+    watchdog.convertVolts(3.0f, 20);
+    CHECK(watch.fired() == 0U);
+    watchdog.convertVolts(0.4f, 30);
+    CHECK(watch.fired() == 1U);
+}
+
+void fullQueueCountsLostEvents()
+{
+    FakeAnalogWatchdog watchdog;
+    ThresholdWatch watch(watchdog);
+    constexpr uint32_t kCrossings = ThresholdWatch::kQueueDepth + 3U;
+    for (uint32_t i = 0; i < kCrossings; ++i)
+    {
+        watch.arm(ThresholdWatch::Edge::Rising, 1.0f, 0.0f);
+        watchdog.convertVolts(2.0f, i);
+    }
+    CHECK(watch.fired() == kCrossings);
+    CHECK(watch.lost() == 3U);
+
+    ThresholdWatch::Event event;
+    uint32_t taken = 0;
+    while (watch.poll(event))
+    {
+        CHECK(event.time_us == taken); // oldest first, the late ones dropped
+        taken++;
+    }
+    CHECK(taken == ThresholdWatch::kQueueDepth);
+}
+
+/**
+ * @brief A beat waveform sampled at 10 kHz: the watch interrupts a couple
+ * of times per arm, not once per sample.
+ */
+void onlyTheCrossingInterrupts()
+{
+    FakeAnalogWatchdog watchdog;
+    ThresholdWatch watch(watchdog);
+    constexpr uint32_t kSamples = 10000; // one 1 s beat
+    constexpr double kPi = 3.14159265358979;
+
+    watch.arm(ThresholdWatch::Edge::Falling, 1.5f, 0.1f); // end of ejection
+    uint32_t firedAt = 0;
+    for (uint32_t i = 0; i < kSamples; ++i)
+    {
+        float volts = (float)(1.5 + 1.0 * sin(2.0 * kPi * i / kSamples));
+        watchdog.convertVolts(volts, i * 100U);
+        if (firedAt == 0U && watch.fired() == 1U)
+        {
+            firedAt = i;
+        }
+    }
+    CHECK(watch.fired() == 1U);
+    CHECK(firedAt >= kSamples / 2U && firedAt < kSamples / 2U + 5U);
+    CHECK(watchdog.interrupts() <= 2U);
+}
+
+Sequence waitForCrossing(ThresholdWatch& watch, bool& result, uint32_t& when)
+{
+    result = co_await crossing(watch, ThresholdWatch::Edge::Rising, 2.0f, 0.0f, 50000);
+    when = Timebase::now_us();
+}
+
+/**
+ * @brief crossing() arms the watch; service() only looks at fired(). A
+ * crossing that never comes times out and leaves the watch disarmed.
+ */
+void sequenceAwaitsCrossing()
+{
+    Timebase::setHostMode(Timebase::HostMode::Virtual);
+    Timebase::init();
+    static Sequencer sequencer;
+    FakeAnalogWatchdog watchdog;
+    ThresholdWatch watch(watchdog);
+
+    bool result = false;
+    uint32_t when = 0;
+    CHECK(sequencer.spawn(waitForCrossing(watch, result, when)));
+    sequencer.service();
+    CHECK(watch.isArmed());
+
+    for (uint32_t t = 0; t < 10U; ++t)
+    {
+        Timebase::advance(1000);
+        watchdog.convertVolts(1.0f, Timebase::now_us());
+        sequencer.service();
+    }
+    CHECK(watch.isArmed());
+    watchdog.convertVolts(2.5f, Timebase::now_us());
+    Timebase::advance(1000);
+    sequencer.service();
+    CHECK(result);
+    CHECK(when == 11000U);
+    CHECK(!watch.isArmed());
+    ThresholdWatch::Event event;
+    CHECK(!watch.poll(event)); // the sequence took it
+
+    result = true;
+    CHECK(sequencer.spawn(waitForCrossing(watch, result, when)));
+    for (uint32_t t = 0; t <= 60U; ++t)
+    {
+        sequencer.service();
+        Timebase::advance(1000);
+    }
+    CHECK(!result);
+    CHECK(!watch.isArmed());
+    CHECK(sequencer.service() == 0U);
+}
+
+} // namespace
+
+int main()
+{
+    risingFiresOnceWithItsTimestamp();
+    zeroHysteresisFiresWhenAlreadyPast();
+    hysteresisIgnoresNoiseAndAStartPastTheThreshold();
+    primeLevelOutOfRangeArmsStraightAway();
+    disarmAndRearm();
+    fullQueueCountsLostEvents();
+    onlyTheCrossingInterrupts();
+    sequenceAwaitsCrossing();
+    return Check::finish();
+}
@@ -0,0 +1,266 @@
+/**
+ * @file test_trace_recorder.cpp
+ * @brief TraceRecorder on the host: chunk layout, overwrite and drop
+ * counting, partial drains, stop(), and writers on two threads racing the
+ * reader.
+ *
+ * It also writes trace_dump.bin (task names plus three event chunks, one
+ * across the 32-bit wrap of the timestamps) into the working directory.
+ * check_trace_to_chrome.py runs that dump through Tools/trace_to_chrome.py
+ * and checks the slices and instants it expects from the sequence below.
+ */
+
+#include "Check.h"
+#include "Timebase.h"
+#include "TraceRecorder.h"
+
+#include <atomic>
+#include <string.h>
+#include <thread>
+
+namespace {
+
+constexpr uint32_t kRing = TRACE_RECORDER_EVENTS;
+constexpr size_t kChunkBytes = sizeof(TraceRecorder::ChunkHeader) + kRing * sizeof(TraceRecorder::Event);
+
+uint8_t s_dump[4 * kChunkBytes];
+size_t s_dumpBytes = 0;
+
+struct Chunk {
+    TraceRecorder::ChunkHeader header;
+    const TraceRecorder::Event* events;
+};
+
+Chunk parse(const uint8_t* buf)
+{
+    Chunk chunk;
+    memcpy(&chunk.header, buf, sizeof(chunk.header));
+    chunk.events = reinterpret_cast<const TraceRecorder::Event*>(buf + sizeof(chunk.header));
+    return chunk;
+}
+
+/**
+ * @brief Drains one chunk into the dump and returns it.
+ */
+Chunk drainToDump()
+{
+    uint8_t* at = s_dump + s_dumpBytes;
+    size_t bytes = TraceRecorder::drain(at, sizeof(s_dump) - s_dumpBytes);
+    CHECK(bytes > 0U);
+    s_dumpBytes += bytes;
+    return parse(at);
+}
+
+void at(uint32_t t_us)
+{
+    Timebase::advance(t_us - Timebase::now_us());
+}
+
+void taskNamesChunk()
+{
+    TraceRecorder_TaskCreated(1, "IDLE");
+    TraceRecorder_TaskCreated(2, "Control");
+    TraceRecorder_TaskCreated(3, "TelemetryUplink2");
+
+    size_t bytes = TraceRecorder::encodeTaskNames(s_dump, sizeof(s_dump));
+    CHECK(bytes == sizeof(TraceRecorder::ChunkHeader) + 3U * sizeof(TraceRecorder::TaskName));
+    Chunk chunk = parse(s_dump);
+    CHECK(chunk.header.magic == TraceRecorder::kChunkMagic);
+    CHECK(chunk.header.kind == TraceRecorder::kChunkTaskNames);
+    CHECK(chunk.header.count == 3U);
+    TraceRecorder::TaskName third;
+    memcpy(&third, s_dump + sizeof(TraceRecorder::ChunkHeader) + 2U * sizeof(third), sizeof(third));
+    CHECK(third.taskNumber == 3U);
+    CHECK(strcmp(third.name, "TelemetryUplink") == 0); // cut to kNameLength - 1
+    CHECK(TraceRecorder::encodeTaskNames(s_dump, bytes - 1U) == 0U);
+    s_dumpBytes = bytes;
+}
+
+void eventsInOrder()
+{
+    TraceRecorder::start();
+    at(1000);
+    TraceRecorder_Record(TRACE_EVT_TASK_SWITCH, 1, 0);
+    at(1100);
+    TraceRecorder_IsrEnter(TRACE_ISR_TIMEBASE);
+    at(1110);
+    TraceRecorder_IsrExit(TRACE_ISR_TIMEBASE);
+    at(1200);
+    TraceRecorder_Record(TRACE_EVT_TASK_SWITCH, 2, 0);
+    at(1210);
+    TraceRecorder_Record(TRACE_EVT_QUEUE_SEND | TRACE_FROM_ISR, 1, 3);
+    at(1250);
+    TraceRecorder_Record(TRACE_EVT_NOTIFY, 3, 0);
+    at(1300);
+    TraceRecorder_Record(TRACE_EVT_TASK_SWITCH, 3, 0);
+    at(1400);
+    TraceRecorder_Record(TRACE_EVT_USER, 7, 42);
+
+    Chunk chunk = drainToDump();
+    CHECK(chunk.header.magic == TraceRecorder::kChunkMagic);
+    CHECK(chunk.header.kind == TraceRecorder::kChunkEvents);
+    CHECK(chunk.header.count == 8U);
+    CHECK(chunk.header.dropped == 0U);
+    CHECK(chunk.events[0].t_us == 1000U && chunk.events[0].type == TRACE_EVT_TASK_SWITCH);
+    CHECK(chunk.events[1].type == TRACE_EVT_ISR_ENTER && chunk.events[1].object == TRACE_ISR_TIMEBASE);
+    CHECK(chunk.events[4].type == (TRACE_EVT_QUEUE_SEND | TRACE_FROM_ISR) && chunk.events[4].payload == 3U);
+    CHECK(chunk.events[7].t_us == 1400U && chunk.events[7].payload == 42U);
+
+    uint8_t empty[64];
+    CHECK(TraceRecorder::drain(empty, sizeof(empty)) == 0U); // nothing new
+}
+
+void timestampsAcrossTheWrap()
+{
+    at(0xFFFFFF00U);
+    TraceRecorder_Record(TRACE_EVT_TASK_SWITCH, 2, 0);
+    at(0xFFFFFFF0U);
+    TraceRecorder_IsrEnter(TRACE_ISR_HAL_TICK);
+    Timebase::advance(0x20); // now 0x00000010
+    TraceRecorder_IsrExit(TRACE_ISR_HAL_TICK);
+    at(0x100U);
+    TraceRecorder_Record(TRACE_EVT_TASK_SWITCH, 1, 0);
+
+    Chunk chunk = drainToDump();
+    CHECK(chunk.header.count == 4U);
+    CHECK(chunk.events[1].t_us == 0xFFFFFFF0U);
+    CHECK(chunk.events[2].t_us == 0x10U);
+}
+
+/**
+ * @brief More events than the ring holds before a drain: the oldest go,
+ * and the chunk says how many.
+ */
+void overwriteIsCountedAsDropped()
+{
+    constexpr uint32_t kExtra = 44;
+    for (uint32_t i = 0; i < kRing + kExtra; ++i)
+    {
+        Timebase::advance(1);
+        TraceRecorder_Record(TRACE_EVT_USER, 8, (uint16_t)i);
+    }
+    Chunk chunk = drainToDump();
+    CHECK(chunk.header.count == kRing);
+    CHECK(chunk.header.dropped == kExtra);
+    CHECK(chunk.events[0].payload == kExtra); // the oldest kept
+    CHECK(chunk.events[kRing - 1U].payload == kRing + kExtra - 1U);
+}
+
+void smallBufferDrainsInPieces()
+{
+    for (uint32_t i = 0; i < 10U; ++i)
+    {
+        TraceRecorder_Record(TRACE_EVT_USER, 9, (uint16_t)i);
+    }
+    uint8_t buf[sizeof(TraceRecorder::ChunkHeader) + 4U * sizeof(TraceRecorder::Event)];
+    uint32_t next = 0;
+    for (uint32_t expected : {4U, 4U, 2U})
+    {
+        size_t bytes = TraceRecorder::drain(buf, sizeof(buf));
+        Chunk chunk = parse(buf);
+        CHECK(bytes == sizeof(TraceRecorder::ChunkHeader) + expected * sizeof(TraceRecorder::Event));
+        CHECK(chunk.header.count == expected);
+        for (uint32_t i = 0; i < chunk.header.count; ++i)
+        {
+            CHECK(chunk.events[i].payload == next++);
+        }
+    }
+    CHECK(TraceRecorder::drain(buf, sizeof(buf)) == 0U);
+    CHECK(TraceRecorder::drain(buf, sizeof(TraceRecorder::ChunkHeader)) == 0U); // no room for one event
+}
+
+void stoppedRecordsNothing()
+{
+    TraceRecorder::stop();
+    TraceRecorder_Record(TRACE_EVT_USER, 1, 1);
+    uint8_t buf[64];
+    CHECK(TraceRecorder::drain(buf, sizeof(buf)) == 0U);
+}
+
+/**
+ * @brief Two writers flat out on their own threads while the reader
+ * drains: every event is either delivered, in each writer's order, or
+ * counted as dropped.
+ */
+void racingWritersLoseNothingUncounted()
+{
+    constexpr uint32_t kPerWriter = 60000; // payload is 16 bits
+    TraceRecorder::start();
+
+    static std::atomic<uint32_t> finished{0};
+    auto writer = [](uint8_t object) {
+        for (uint32_t i = 0; i < kPerWriter; ++i)
+        {
+            TraceRecorder_Record(TRACE_EVT_USER, object, (uint16_t)i);
+            if ((i & 63U) == 0U)
+            {
+                std::this_thread::yield(); // let the reader in, even on one core
+            }
+        }
+        finished.fetch_add(1U);
+    };
+    std::thread first(writer, 1);
+    std::thread second(writer, 2);
+
+    static uint8_t buf[kChunkBytes];
+    uint32_t received = 0;
+    uint32_t dropped = 0;
+    int32_t last[4] = {-1, -1, -1, -1};
+    bool ordered = true;
+    for (;;)
+    {
+        bool done = (finished.load() == 2U); // before the drain: it then sees every event
+        size_t bytes = TraceRecorder::drain(buf, sizeof(buf));
+        if (bytes == 0U)
+        {
+            if (done)
+            {
+                break;
+            }
+            continue;
+        }
+        Chunk chunk = parse(buf);
+        dropped += chunk.header.dropped;
+        for (uint32_t i = 0; i < chunk.header.count; ++i)
+        {
+            const TraceRecorder::Event& e = chunk.events[i];
+            uint32_t writer = e.object & 3U;
+            ordered = ordered && (writer == 1U || writer == 2U) && (int32_t)e.payload > last[writer];
+            last[writer] = e.payload;
+            received++;
+        }
+    }
+    first.join();
+    second.join();
+    TraceRecorder::stop();
+    printf("racing writers: %u events received, %u dropped\n", received, dropped);
+    CHECK(ordered);
+    CHECK(received + dropped == 2U * kPerWriter);
+    CHECK(received > 0U);
+}
+
+} // namespace
+
+int main()
+{
+    Timebase::setHostMode(Timebase::HostMode::Virtual);
+    Timebase::init();
+
+    taskNamesChunk();
+    eventsInOrder();
+    timestampsAcrossTheWrap();
+    overwriteIsCountedAsDropped();
+    smallBufferDrainsInPieces();
+    stoppedRecordsNothing();
+
+    FILE* f = fopen("trace_dump.bin", "wb");
+    CHECK(f != nullptr);
+    if (f != nullptr)
+    {
+        CHECK(fwrite(s_dump, 1, s_dumpBytes, f) == s_dumpBytes);
+        fclose(f);
+    }
+
+    racingWritersLoseNothingUncounted();
+    return Check::finish();
+}
@@ -0,0 +1,324 @@
+/**
+ * @file test_trajectory_generator.cpp
+ * @brief TrajectoryGenerator on a setpoint log: the S-curve limits, waypoints
+ * and spline knots on time after tick rounding, continuity when load()
+ * swaps paths (braking included), and the one-deep load queue.
+ *
+ * Velocity and acceleration are taken from the logged setpoints by finite
+ * differences, jerk from the change in acceleration over a window. The
+ * acceleration uses a stride of a few ticks: each piece boundary puts the
+ * float setpoint back on the exact state, a correction of some ubar that a
+ * one-tick second difference would turn into a spike of several bar/s^2.
+ */
+
+#include "Check.h"
+#include "TrajectoryGenerator.h"
+
+#include <math.h>
+
+namespace {
+
+using Waypoint = TrajectoryGenerator::Waypoint;
+using Shape = TrajectoryGenerator::Shape;
+
+constexpr float kTick_s = 0.001f;
+constexpr TrajectoryGenerator::Limits kLimits = {2.0f, 40.0f, 2000.0f};
+constexpr uint32_t kStride = 5;      // ticks, for the acceleration
+constexpr uint32_t kJerkWindow = 20; // ticks
+constexpr float kSlack = 1.03f;      // finite differences on float samples
+
+class SetpointLog final : public IPressureControl {
+public:
+    static constexpr uint32_t kCapacity = 4000;
+
+    bool setPressure(float bar) override
+    {
+        if (m_count < kCapacity)
+        {
+            m_samples[m_count++] = bar;
+        }
+        return true;
+    }
+
+    float getActualPressure() override { return (m_count > 0U) ? m_samples[m_count - 1U] : 0.0f; }
+
+    uint32_t count() const { return m_count; }
+    float operator[](uint32_t i) const { return m_samples[i]; }
+
+    float velocity(uint32_t i) const { return (m_samples[i + 1U] - m_samples[i]) / kTick_s; }
+
+    float acceleration(uint32_t i) const
+    {
+        constexpr float kSpan_s = (float)kStride * kTick_s;
+        return (m_samples[i + kStride] - 2.0f * m_samples[i] + m_samples[i - kStride]) / (kSpan_s * kSpan_s);
+    }
+
+private:
+    float m_samples[kCapacity] = {};
+    uint32_t m_count = 0;
+};
+
+struct Peaks {
+    float velocity;
+    float acceleration;
+    float jerk;
+};
+
+/**
+ * @brief Largest |v|, |a| and windowed |j| over samples [from, to).
+ */
+Peaks peaks(const SetpointLog& log, uint32_t from, uint32_t to)
+{
+    Peaks p = {0.0f, 0.0f, 0.0f};
+    for (uint32_t i = from; i + 1U < to; ++i)
+    {
+        p.velocity = fmaxf(p.velocity, fabsf(log.velocity(i)));
+    }
+    from = (from < kStride) ? kStride : from;
+    for (uint32_t i = from; i + kStride < to; ++i)
+    {
+        p.acceleration = fmaxf(p.acceleration, fabsf(log.acceleration(i)));
+        if (i + kJerkWindow + kStride < to)
+        {
+            float da = log.acceleration(i + kJerkWindow) - log.acceleration(i);
+            p.jerk = fmaxf(p.jerk, fabsf(da) / ((float)kJerkWindow * kTick_s));
+        }
+    }
+    return p;
+}
+
+void run(TrajectoryGenerator& generator, uint32_t ticks)
+{
+    for (uint32_t t = 0; t < ticks; ++t)
+    {
+        generator.tick();
+    }
+}
+
+uint32_t ticksOf(float seconds)
+{
+    return (uint32_t)(seconds / kTick_s + 0.5f);
+}
+
+/**
+ * @brief A long move reaches the velocity limit, a short one does not;
+ * neither goes past any limit, and each lands on its waypoint on the tick
+ * its duration rounds to.
+ */
+void sCurveStaysWithinTheLimits()
+{
+    SetpointLog log;
+    TrajectoryGenerator generator(log, kTick_s, kLimits);
+    // Durations off the tick grid: 900.4 ms and 250.6 ms.
+    const Waypoint path[] = {{1.5f, 0.9004f}, {1.4f, 0.2506f}};
+    CHECK(generator.load(path, 2, Shape::JerkLimited, false));
+
+    uint32_t first = ticksOf(path[0].duration_s);
+    uint32_t second = first + ticksOf(path[1].duration_s);
+    run(generator, second + 50U);
+    CHECK(log.count() == second + 50U);
+
+    CHECK(log[0] == 0.0f);
+    CHECK_NEAR(log[first], 1.5f, 1e-5f);
+    CHECK_NEAR(log[second], 1.4f, 1e-5f);
+    CHECK(log[second + 49U] == log[second]);
+    CHECK(generator.isIdle());
+
+    Peaks longMove = peaks(log, 0, first + 1U);
+    CHECK(longMove.velocity <= kLimits.velocity * kSlack);
+    CHECK(longMove.velocity >= kLimits.velocity * 0.95f); // it does cruise
+    CHECK(longMove.acceleration <= kLimits.acceleration * kSlack);
+    CHECK(longMove.acceleration >= kLimits.acceleration * 0.9f);
+    CHECK(longMove.jerk <= kLimits.jerk * kSlack);
+
+    Peaks shortMove = peaks(log, first, second + 1U);
+    CHECK(shortMove.velocity < kLimits.velocity);
+    CHECK(shortMove.acceleration <= kLimits.acceleration * kSlack);
+    CHECK(shortMove.jerk <= kLimits.jerk * kSlack);
+
+    // The hold: the move ends early and the setpoint stays put until the
+    // waypoint's time is up.
+    for (uint32_t i = first - 20U; i <= first; ++i)
+    {
+        CHECK_NEAR(log[i], 1.5f, 1e-5f);
+    }
+}
+
+/**
+ * @brief A move too long for its duration takes the time it needs rather
+ * than breaking a limit.
+ */
+void tooShortADurationStretches()
+{
+    SetpointLog log;
+    TrajectoryGenerator generator(log, kTick_s, kLimits);
+    const Waypoint path[] = {{1.0f, 0.1f}, {1.0f, 0.0f}};
+    CHECK(generator.load(path, 2, Shape::JerkLimited, false));
+    run(generator, 1000);
+
+    uint32_t arrived = 0;
+    while (arrived < log.count() && fabsf(log[arrived] - 1.0f) > 1e-5f)
+    {
+        arrived++;
+    }
+    CHECK(arrived > ticksOf(0.1f));
+    CHECK(arrived < log.count());
+    Peaks p = peaks(log, 0, log.count());
+    CHECK(p.velocity <= kLimits.velocity * kSlack);
+    CHECK(p.acceleration <= kLimits.acceleration * kSlack);
+    CHECK(p.jerk <= kLimits.jerk * kSlack);
+}
+
+/**
+ * @brief The spline goes through every knot on its tick, with the slope
+ * continuous across the knots.
+ */
+void splinePassesTheKnotsOnTime()
+{
+    SetpointLog log;
+    TrajectoryGenerator generator(log, kTick_s, kLimits);
+    const Waypoint path[] = {{0.5f, 0.2005f}, {1.2f, 0.15f}, {0.8f, 0.3f}, {0.3f, 0.25f}};
+    CHECK(generator.load(path, 4, Shape::CubicSpline, false));
+    run(generator, 1000);
+
+    uint32_t knot = 0;
+    for (const Waypoint& w : path)
+    {
+        knot += ticksOf(w.duration_s);
+        CHECK_NEAR(log[knot], w.bar, 1e-5f);
+        if (knot + 1U < ticksOf(0.9005f))
+        {
+            // The slope changes across the knot by as much as it does one
+            // tick earlier: no break, only the curvature.
+            float across = log.velocity(knot) - log.velocity(knot - 1U);
+            float before = log.velocity(knot - 1U) - log.velocity(knot - 2U);
+            CHECK(fabsf(across - before) < 0.01f);
+        }
+    }
+    CHECK(knot == ticksOf(0.9005f));
+    CHECK(generator.isIdle());
+    CHECK(log[999] == log[knot]);
+}
+
+/**
+ * @brief A jerk-limited path queued during a spline takes over at the end
+ * of it, with the pressure still moving: it brakes within the limits, then
+ * makes its move. Position, velocity and acceleration stay continuous
+ * across both switches.
+ */
+void hotSwapIsContinuousThroughTheBrake()
+{
+    SetpointLog log;
+    TrajectoryGenerator generator(log, kTick_s, kLimits);
+    // Ends going up at ~1.8 bar/s: the natural end keeps the slope.
+    const Waypoint rise[] = {{0.3f, 0.2f}, {0.9f, 0.3f}};
+    CHECK(generator.load(rise, 2, Shape::CubicSpline, false));
+    run(generator, 100);
+
+    const Waypoint settle[] = {{0.6f, 0.5f}};
+    CHECK(generator.load(settle, 1, Shape::JerkLimited, false));
+    run(generator, 1500);
+
+    uint32_t swap = ticksOf(0.5f);
+    CHECK_NEAR(log[swap], 0.9f, 1e-5f);
+    float arriving = log.velocity(swap - 1U);
+    CHECK(arriving > 1.0f);
+
+    // Continuity: no step in position beyond the speed limit, no step in
+    // velocity beyond a tick of the acceleration limit, around the swap.
+    for (uint32_t i = swap - 5U; i < swap + 5U; ++i)
+    {
+        CHECK(fabsf(log[i + 1U] - log[i]) <= kLimits.velocity * kTick_s * kSlack);
+        CHECK(fabsf(log.velocity(i + 1U) - log.velocity(i)) <= kLimits.acceleration * kTick_s * 1.5f);
+    }
+    // Braking: past 0.9 bar, but within every limit from the swap on.
+    float highest = 0.0f;
+    for (uint32_t i = swap; i < log.count(); ++i)
+    {
+        highest = fmaxf(highest, log[i]);
+    }
+    CHECK(highest > 0.9f);
+    Peaks brake = peaks(log, swap, log.count());
+    CHECK(brake.velocity <= kLimits.velocity * kSlack);
+    CHECK(brake.acceleration <= kLimits.acceleration * kSlack);
+    CHECK(brake.jerk <= kLimits.jerk * kSlack);
+
+    CHECK_NEAR(log[log.count() - 1U], 0.6f, 1e-5f);
+    CHECK(generator.isIdle());
+}
+
+/**
+ * @brief A looping path keeps running until the next one is loaded, which
+ * waits for the loop's end rather than cutting it.
+ */
+void loopRunsUntilReplaced()
+{
+    SetpointLog log;
+    TrajectoryGenerator generator(log, kTick_s, kLimits);
+    const Waypoint cycle[] = {{1.0f, 0.6f}, {0.5f, 0.4f}};
+    CHECK(generator.load(cycle, 2, Shape::JerkLimited, true));
+    run(generator, 2500); // two and a half cycles
+    CHECK(!generator.isIdle());
+    CHECK_NEAR(log[1600], 1.0f, 1e-5f);
+    CHECK_NEAR(log[2000], 0.5f, 1e-5f);
+
+    const Waypoint rest[] = {{0.0f, 0.6f}};
+    CHECK(generator.load(rest, 1, Shape::JerkLimited, false));
+    run(generator, 1200);
+    CHECK_NEAR(log[2600], 1.0f, 1e-5f); // the third cycle finished first
+    CHECK_NEAR(log[3000], 0.5f, 1e-5f);
+    CHECK_NEAR(log[3600], 0.0f, 1e-5f);
+    CHECK(generator.isIdle());
+}
+
+void secondLoadWaitsForTheFirst()
+{
+    SetpointLog log;
+    TrajectoryGenerator generator(log, kTick_s, kLimits);
+    const Waypoint a[] = {{1.0f, 0.6f}};
+    const Waypoint b[] = {{0.5f, 0.4f}};
+
+    CHECK(generator.load(a, 1, Shape::JerkLimited, false));
+    CHECK(!generator.load(b, 1, Shape::JerkLimited, false)); // a still queued
+    generator.tick();                                        // a taken
+    CHECK(generator.load(b, 1, Shape::JerkLimited, false));
+    CHECK(!generator.load(a, 1, Shape::CubicSpline, false)); // b queued now
+
+    run(generator, 1000);
+    CHECK_NEAR(log[ticksOf(0.6f)], 1.0f, 1e-5f);
+    CHECK_NEAR(log[ticksOf(1.0f)], 0.5f, 1e-5f); // b, not the rejected a
+    CHECK(generator.isIdle());
+}
+
+void invalidPathsAreRejected()
+{
+    SetpointLog log;
+    TrajectoryGenerator generator(log, kTick_s, kLimits);
+    const Waypoint one[] = {{1.0f, 0.2f}};
+    const Waypoint negative[] = {{1.0f, 0.2f}, {0.5f, -0.1f}};
+    const Waypoint notANumber[] = {{1.0f, NAN}};
+    static Waypoint tooMany[TrajectoryGenerator::kMaxWaypoints + 1];
+
+    CHECK(!generator.load(nullptr, 1, Shape::JerkLimited, false));
+    CHECK(!generator.load(one, 0, Shape::JerkLimited, false));
+    CHECK(!generator.load(tooMany, TrajectoryGenerator::kMaxWaypoints + 1U, Shape::JerkLimited, false));
+    CHECK(!generator.load(negative, 2, Shape::JerkLimited, false));
+    CHECK(!generator.load(notANumber, 1, Shape::CubicSpline, false));
+
+    // None of them took the queue.
+    CHECK(generator.load(tooMany, TrajectoryGenerator::kMaxWaypoints, Shape::JerkLimited, false));
+}
+
+} // namespace
+
+int main()
+{
+    sCurveStaysWithinTheLimits();
+    tooShortADurationStretches();
+    splinePassesTheKnotsOnTime();
+    hotSwapIsContinuousThroughTheBrake();
+    loopRunsUntilReplaced();
+    secondLoadWaitsForTheFirst();
+    invalidPathsAreRejected();
+    return Check::finish();
+}
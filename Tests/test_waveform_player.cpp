@@ -0,0 +1,204 @@
+/**
+ * @file test_waveform_player.cpp
+ * @brief WaveformPlayer switches: a fade-in from a held setpoint starts
+ * there rather than at 0 bar, a crossfade between presets is continuous
+ * and lands on the new preset after the requested beats, a fade to
+ * nullptr stops at 0 bar, and a hard switch waits for the beat boundary.
+ */
+
+#include "Check.h"
+#include "Interfaces/IPressureControl.h"
+#include "WaveformPlayer.h"
+
+#include <math.h>
+
+namespace {
+
+constexpr float kTick_s = 0.001f;
+constexpr uint32_t kBeatTicks = 1000; // 60 bpm
+constexpr uint32_t kPoints = 64;
+
+/**
+ * @brief Records the setpoints it is sent.
+ */
+class Recorder final : public IPressureControl {
+public:
+    bool setPressure(float bar) override
+    {
+        m_last = bar;
+        m_sent++;
+        return true;
+    }
+
+    float getActualPressure() override { return m_last; }
+
+    float last() const { return m_last; }
+    uint32_t sent() const { return m_sent; }
+
+private:
+    float m_last = 0.0f;
+    uint32_t m_sent = 0;
+};
+
+/**
+ * @brief One beat of a raised sine, 0..32767.
+ */
+struct SineShape {
+    int16_t q15[kPoints];
+
+    SineShape()
+    {
+        for (uint32_t i = 0; i < kPoints; ++i)
+        {
+            float s = sinf(3.14159265f * (float)i / (float)kPoints);
+            q15[i] = (int16_t)(32767.0f * s * s);
+        }
+    }
+};
+
+const SineShape kShape;
+const WaveformPreset kRest = {"rest", 60.0f, 0.2f, 0.6f, kPoints, kShape.q15};
+const WaveformPreset kExercise = {"exercise", 60.0f, 0.4f, 1.4f, kPoints, kShape.q15};
+
+WaveformTimeline::Selection play(const WaveformPreset& preset)
+{
+    return {&preset, 1.0f, 1.0f};
+}
+
+/**
+ * @brief Ticks @p ticks times, or up to and including the tick that starts
+ * the @p beats-th beat if @p beats is not 0.
+ * @return the largest change between two consecutive setpoints, counting
+ * from @p previous.
+ */
+float run(WaveformPlayer& player, uint32_t ticks, float& previous, uint32_t beats = 0)
+{
+    float worst = 0.0f;
+    for (uint32_t i = 0; i < ticks || beats > 0U; ++i)
+    {
+        float out = player.tick();
+        worst = fmaxf(worst, fabsf(out - previous));
+        previous = out;
+        if (beats > 0U && player.beatStarted() && --beats == 0U)
+        {
+            break;
+        }
+    }
+    return worst;
+}
+
+float runBeats(WaveformPlayer& player, uint32_t beats, float& previous)
+{
+    return run(player, 0, previous, beats);
+}
+
+// The raised sine over a 1000-tick beat moves at most pi / 1000 of its
+// pulse per tick; a fade adds its own slope on top.
+constexpr float kMaxStep_bar = 0.01f;
+
+void fadeInStartsFromTheHeldSetpoint()
+{
+    Recorder output;
+    WaveformPlayer player(output, kTick_s);
+    player.hold(1.0f);
+    CHECK(output.last() == 1.0f);
+
+    player.select(play(kRest), 2);
+    float previous = player.tick();
+    CHECK(player.beatStarted());
+    CHECK_NEAR(previous, 1.0f, 1e-3f); // not 0 bar
+    CHECK(player.isFading());
+
+    float worst = runBeats(player, 1, previous);
+    CHECK(player.isFading());
+    worst = fmaxf(worst, runBeats(player, 1, previous)); // the boundary ending the fade
+    CHECK(worst < kMaxStep_bar);
+    CHECK(!player.isFading());
+    CHECK_NEAR(previous, WaveformTimeline::sample(play(kRest), 0.0f), 2e-3f);
+}
+
+/**
+ * @brief Half way through a 2-beat crossfade, at the beat boundary, the
+ * setpoint is the average of the two presets; after it, the new preset
+ * alone.
+ */
+void crossfadeBetweenPresets()
+{
+    Recorder output;
+    WaveformPlayer player(output, kTick_s);
+    player.select(play(kRest), 0);
+    float previous = 0.0f;
+    run(player, kBeatTicks / 2U, previous);
+
+    player.select(play(kExercise), 2);
+    run(player, 1, previous);
+    CHECK(!player.isFading()); // waits for the boundary
+    float worst = runBeats(player, 1, previous);
+    CHECK(player.isFading());
+
+    worst = fmaxf(worst, runBeats(player, 1, previous));
+    CHECK(player.isFading());
+    CHECK_NEAR(output.last(), 0.5f * (kRest.diastolic_bar + kExercise.diastolic_bar), 2e-3f);
+
+    worst = fmaxf(worst, runBeats(player, 1, previous));
+    CHECK(worst < kMaxStep_bar);
+    CHECK(!player.isFading());
+    CHECK_NEAR(output.last(), WaveformTimeline::sample(play(kExercise), 0.0f), 2e-3f);
+}
+
+/**
+ * @brief The beat boundary that ends a fade to nullptr stops the player:
+ * the last setpoint sent is close to 0 bar and nothing is sent after it.
+ */
+void fadeOutStops()
+{
+    Recorder output;
+    WaveformPlayer player(output, kTick_s);
+    player.select(play(kExercise), 0);
+    float previous = 0.0f;
+    run(player, kBeatTicks / 2U, previous);
+
+    player.select({nullptr, 1.0f, 1.0f}, 2);
+    float worst = runBeats(player, 2, previous); // the boundary, then the first faded beat
+    CHECK(player.isFading());
+    uint32_t sent = output.sent();
+    worst = fmaxf(worst, run(player, kBeatTicks + 10U, previous)); // past the end of the fade
+    CHECK(!player.isFading());
+    CHECK(output.sent() > sent && output.sent() < sent + kBeatTicks + 10U);
+    CHECK(output.last() < 0.02f);
+    CHECK(previous == 0.0f);
+    CHECK(worst < kMaxStep_bar + 0.02f); // the last step, to the 0 bar tick() returns
+    sent = output.sent();
+    run(player, kBeatTicks, previous);
+    CHECK(output.sent() == sent); // stopped: nothing more is sent
+}
+
+/**
+ * @brief fade 0: the preset changes at the next beat boundary in one step.
+ */
+void hardSwitchAtTheBoundary()
+{
+    Recorder output;
+    WaveformPlayer player(output, kTick_s);
+    player.select(play(kRest), 0);
+    float previous = 0.0f;
+    run(player, kBeatTicks / 2U, previous);
+
+    player.select(play(kExercise), 0);
+    run(player, 1, previous);
+    CHECK(previous > kExercise.diastolic_bar); // still the rest beat
+    runBeats(player, 1, previous);
+    CHECK_NEAR(output.last(), kExercise.diastolic_bar, 1e-3f);
+    CHECK(!player.isFading());
+}
+
+} // namespace
+
+int main()
+{
+    fadeInStartsFromTheHeldSetpoint();
+    crossfadeBetweenPresets();
+    fadeOutStops();
+    hardSwitchAtTheBoundary();
+    return Check::finish();
+}
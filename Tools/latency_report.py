@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""
+Print the LatencyBench results: percentiles and histograms per path.
+
+    python3 Tools/latency_report.py latency.bin
+
+latency.bin is the record written by LatencyBench::encode(), as received
+over telemetry (or dumped from RAM with the debugger).
+"""
+
+import argparse
+import struct
+import sys
+
+# Must match System/Inc/LatencyBench.h
+RECORD_MAGIC = 0x4254414C
+HEADER = struct.Struct("<IBBHII")
+PATH_NAMES = {0: "ISR entry", 1: "Semaphore", 2: "Notification", 3: "Queue", 4: "Stream buffer"}
+BAR_WIDTH = 40
+
+
+def parse(data):
+    magic, path_count, buckets, bucket_cycles, cpu_hz, samples = HEADER.unpack_from(data, 0)
+    if magic != RECORD_MAGIC:
+        raise ValueError("not a LatencyBench record (magic 0x%08X)" % magic)
+    row = struct.Struct("<B3xIIIII%dH" % buckets)
+    paths = []
+    for i in range(path_count):
+        path, count, missed, lo, hi, mean, *hist = row.unpack_from(data, HEADER.size + i * row.size)
+        paths.append({"path": path, "count": count, "missed": missed, "min": lo, "max": hi, "mean": mean,
+                      "hist": hist})
+    return {"bucket_cycles": bucket_cycles, "cpu_hz": cpu_hz, "samples": samples, "paths": paths}
+
+
+def percentile(hist, bucket_cycles, fraction):
+    """Upper edge of the bucket holding the given fraction of samples."""
+    total = sum(hist)
+    if total == 0:
+        return 0
+    target = fraction * total
+    seen = 0
+    for i, n in enumerate(hist):
+        seen += n
+        if seen >= target:
+            return (i + 1) * bucket_cycles
+    return len(hist) * bucket_cycles
+
+
+def report(record, out, show_histograms):
+    hz = record["cpu_hz"] or 1
+    width = record["bucket_cycles"]
+
+    def us(cycles):
+        return "%8.2f" % (cycles * 1e6 / hz)
+
+    out.write("%d samples per path, CPU %.0f MHz, times in us\n" % (record["samples"], hz / 1e6))
+    out.write("missed: events that came before the task had taken the previous one\n\n")
+    out.write("%-14s %8s %8s %8s %8s %8s %8s %8s\n" % ("path", "min", "mean", "p50", "p99", "p99.9", "max",
+                                                     "missed"))
+    for p in record["paths"]:
+        if p["count"] == 0:
+            continue
+        hist = p["hist"]
+        out.write("%-14s %s %s %s %s %s %s %8d\n" % (
+            PATH_NAMES.get(p["path"], str(p["path"])), us(p["min"]), us(p["mean"]),
+            us(min(percentile(hist, width, 0.5), p["max"])),
+            us(min(percentile(hist, width, 0.99), p["max"])),
+            us(min(percentile(hist, width, 0.999), p["max"])), us(p["max"]), p["missed"]))
+
+    if not show_histograms:
+        return
+    for p in record["paths"]:
+        hist = p["hist"]
+        if p["count"] == 0:
+            continue
+        out.write("\n%s\n" % PATH_NAMES.get(p["path"], str(p["path"])))
+        peak = max(hist)
+        used = [i for i, n in enumerate(hist) if n]
+        for i in range(used[0], used[-1] + 1):
+            label = ">=" if i == len(hist) - 1 else "< "
+            bar = "#" * ((hist[i] * BAR_WIDTH + peak - 1) // peak)
+            out.write("  %s%s %7d %s\n" % (label, us((i + 1) * width if label == "< " else i * width), hist[i], bar))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("record", help="binary LatencyBench record")
+    parser.add_argument("--no-histograms", action="store_true", help="percentile table only")
+    args = parser.parse_args()
+    with open(args.record, "rb") as f:
+        record = parse(f.read())
+    report(record, sys.stdout, not args.no_histograms)
+
+
+if __name__ == "__main__":
+    main()
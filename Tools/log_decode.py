@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+Render DeferredLog records as text, using the format strings in the ELF.
+
+    python3 Tools/log_decode.py build/firmware.elf log.bin
+
+log.bin is the concatenation of chunks produced by DeferredLog::drain(),
+as received over telemetry. Each record's ID is the offset of its format
+string in the ELF's .logstr section, which is never loaded on the target.
+Host builds name the section "logstr"; their logs decode the same way.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+# Must match System/Inc/DeferredLog.h
+CHUNK_MAGIC = 0x44474F4C
+CHUNK = struct.Struct("<IHH")
+MAX_ARGS = 4
+RECORD = struct.Struct("<IIBBH%dI" % MAX_ARGS)
+LEVELS = {0: "ERROR", 1: "WARN", 2: "INFO", 3: "DEBUG"}
+
+SPEC = re.compile(r"%[-+ #0]*\d*(?:\.\d+)?(?:hh|h|ll|l|z)?([diuxXcfeEgG%])")
+
+
+def read_section(elf_path, wanted):
+    """Returns (address, bytes) of the first section named in wanted, for
+    ELF32 and ELF64 little-endian."""
+    with open(elf_path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF":
+        raise ValueError("%s is not an ELF file" % elf_path)
+    is64 = data[4] == 2
+    if is64:
+        shoff, = struct.unpack_from("<Q", data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x3A)
+        sh = struct.Struct("<IIQQQQIIQQ")
+    else:
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+        sh = struct.Struct("<IIIIIIIIII")
+
+    headers = [sh.unpack_from(data, shoff + i * shentsize) for i in range(shnum)]
+    names_off = headers[shstrndx][4]
+    for name, _type, _flags, addr, offset, size, *_ in headers:
+        end = data.index(b"\0", names_off + name)
+        if data[names_off + name:end].decode() in wanted:
+            return addr, data[offset:offset + size]
+    raise ValueError("no %s section in %s" % (" or ".join(wanted), elf_path))
+
+
+def python_spec(match):
+    """One C conversion as Python %-formatting takes it: no length modifier, %u as %d."""
+    spec = re.sub(r"(hh|h|ll|l|z)(?=.$)", "", match.group(0))
+    return spec[:-1] + "d" if spec.endswith("u") else spec
+
+
+def render(fmt, args):
+    """printf-style rendering from raw 32-bit words."""
+    values = []
+    index = 0
+    for match in SPEC.finditer(fmt):
+        conv = match.group(1)
+        if conv == "%":
+            continue
+        word = args[index] if index < len(args) else 0
+        index += 1
+        if conv in "di":
+            values.append(struct.unpack("<i", struct.pack("<I", word))[0])
+        elif conv in "fFeEgG":
+            values.append(struct.unpack("<f", struct.pack("<I", word))[0])
+        elif conv == "c":
+            values.append(chr(word & 0xFF))
+        else:
+            values.append(word)
+    python_fmt = SPEC.sub(python_spec, fmt)
+    try:
+        return python_fmt % tuple(values)
+    except (TypeError, ValueError):
+        return "%s %r" % (fmt, args)
+
+
+def decode(elf_path, log_path, out):
+    _addr, strings = read_section(elf_path, (".logstr", "logstr"))
+    with open(log_path, "rb") as f:
+        data = f.read()
+
+    offset = 0
+    while offset + CHUNK.size <= len(data):
+        magic, count, dropped = CHUNK.unpack_from(data, offset)
+        if magic != CHUNK_MAGIC:
+            offset += 1
+            continue
+        offset += CHUNK.size
+        if dropped:
+            out.write("-- %d records dropped --\n" % dropped)
+        for _ in range(count):
+            if offset + RECORD.size > len(data):
+                return
+            t_us, msg_id, level, argc, _res, *args = RECORD.unpack_from(data, offset)
+            offset += RECORD.size
+            if msg_id < len(strings):
+                fmt = strings[msg_id:strings.index(b"\0", msg_id)].decode("utf-8", "replace")
+                text = render(fmt, args[:argc])
+            else:
+                text = "<unknown id 0x%08x> %r" % (msg_id, args[:argc])
+            out.write("%12.6f %-5s %s\n" % (t_us / 1e6, LEVELS.get(level, "?"), text))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("elf", help="firmware ELF the log was produced by")
+    parser.add_argument("log", help="binary dump of drained log chunks")
+    args = parser.parse_args()
+    decode(args.elf, args.log, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,456 @@
+#!/usr/bin/env python3
+"""
+Generate the explicit MPC law evaluated by App/Src/ExplicitMpc.cpp.
+
+    python3 Tools/mpc_generate.py -o App/Inc/MpcLawTable.h
+    python3 Tools/mpc_generate.py --check App/Inc/MpcLawTable.h
+    python3 Tools/mpc_generate.py --a1 -1.6 --a2 0.64 --b1 0.025 --b2 0.015 ...
+
+The model defaults to the VPPE on its chamber (Tests/PlantSimulator.h,
+kVppe) at the 1 kHz control rate: two first-order lags (valve, chamber)
+discretised exactly, which gives the a/b below, and the dead time rounded
+to whole periods. The MPC is solved for the delay-free part; the dead time
+goes into the table for ExplicitMpc to compensate, Smith-predictor style.
+
+Problem, solved parametrically in theta = (y[k], y[k-1], u[k-1], r):
+    model    y[k+1] = -a1 y[k] - a2 y[k-1] + b1 u[k] + b2 u[k-1]
+    minimise sum_{i=1..Np} (y[k+i] - r)^2 + rho * sum_{i=0..N-1} du[k+i]^2
+    subject  u_min <= u[k+i] <= u_max,  |du[k+i]| <= slew,  i < N
+             (u is held after N moves)
+
+The strictly convex QP has a piecewise-affine solution. Each candidate active
+set (at most N constraints) gives an affine law and a polyhedral region of
+theta. Regions are found by solving the KKT system per active set and
+keeping those that contain sample points of the theta box (no LP solver
+needed). Regions with the same first move are merged, and a binary search
+tree over region facets is built from the samples. The result is checked
+against the exact law on fresh random points and the mismatch reported.
+
+Only the standard library is used.
+"""
+
+import argparse
+import io
+import itertools
+import math
+import random
+import sys
+
+NTHETA = 4  # y, y_prev, u_prev, r
+TOL = 1e-9
+
+
+# --- small dense linear algebra -------------------------------------------
+
+def solve(matrix, rhs_columns):
+    """Gaussian elimination with partial pivoting; None if singular."""
+    n = len(matrix)
+    m = len(rhs_columns)
+    a = [list(matrix[i]) + [rhs_columns[j][i] for j in range(m)] for i in range(n)]
+    for col in range(n):
+        pivot = max(range(col, n), key=lambda r: abs(a[r][col]))
+        if abs(a[pivot][col]) < 1e-12:
+            return None
+        a[col], a[pivot] = a[pivot], a[col]
+        inv = 1.0 / a[col][col]
+        for r in range(n):
+            if r != col and a[r][col] != 0.0:
+                factor = a[r][col] * inv
+                for c in range(col, n + m):
+                    a[r][c] -= factor * a[col][c]
+    return [[a[i][n + j] / a[i][i] for i in range(n)] for j in range(m)]
+
+
+def dot(u, v):
+    return sum(x * y for x, y in zip(u, v))
+
+
+# --- QP construction -------------------------------------------------------
+
+class Problem:
+    def __init__(self, args):
+        self.args = args
+        n = args.horizon
+        self.n = n
+        # affine expressions over z = (theta[4], U[n], 1)
+        size = NTHETA + n + 1
+        self.size = size
+
+        def theta(i):
+            e = [0.0] * size
+            e[i] = 1.0
+            return e
+
+        def move(i):
+            e = [0.0] * size
+            e[NTHETA + min(i, n - 1)] = 1.0
+            return e
+
+        def comb(*terms):
+            out = [0.0] * size
+            for w, e in terms:
+                for i in range(size):
+                    out[i] += w * e[i]
+            return out
+
+        # residuals of the cost, each with its weight
+        residuals = []
+        y, y_prev, u_prev = theta(0), theta(1), theta(2)
+        r = theta(3)
+        for i in range(args.prediction):
+            u_now = move(i)
+            y_next = comb((-args.a1, y), (-args.a2, y_prev), (args.b1, u_now), (args.b2, u_prev))
+            residuals.append((1.0, comb((1.0, y_next), (-1.0, r))))
+            y_prev, y, u_prev = y, y_next, u_now
+        last = theta(2)
+        for i in range(n):
+            residuals.append((args.rho, comb((1.0, move(i)), (-1.0, last))))
+            last = move(i)
+
+        # J = sum w (c.z)^2  ->  1/2 U'HU + (F theta + h)'U + ...
+        self.H = [[0.0] * n for _ in range(n)]
+        self.F = [[0.0] * NTHETA for _ in range(n)]
+        self.h = [0.0] * n
+        for w, c in residuals:
+            cu = c[NTHETA:NTHETA + n]
+            for i in range(n):
+                for j in range(n):
+                    self.H[i][j] += 2.0 * w * cu[i] * cu[j]
+                for j in range(NTHETA):
+                    self.F[i][j] += 2.0 * w * cu[i] * c[j]
+                self.h[i] += 2.0 * w * cu[i] * c[-1]
+
+        # G U <= W + S theta
+        self.G, self.W, self.S = [], [], []
+        self.pair = []  # index of the mutually exclusive twin constraint
+        for i in range(n):
+            e = [0.0] * n
+            e[i] = 1.0
+            ne = [-x for x in e]
+            self._add(e, args.u_max, [0.0] * NTHETA)
+            self._add(ne, -args.u_min, [0.0] * NTHETA)
+            d = list(e)
+            s = [0.0] * NTHETA
+            if i > 0:
+                d[i - 1] = -1.0
+            else:
+                s[2] = 1.0
+            self._add(d, args.slew, s)
+            self._add([-x for x in d], args.slew, [-x for x in s])
+        self.pair = [k ^ 1 for k in range(len(self.G))]
+
+    def _add(self, g, w, s):
+        self.G.append(g)
+        self.W.append(w)
+        self.S.append(s)
+
+    def region(self, active):
+        """Affine law and region rows (a, b: a.theta <= b) for an active set."""
+        n = self.n
+        k = len(active)
+        size = n + k
+        kkt = [[0.0] * size for _ in range(size)]
+        for i in range(n):
+            for j in range(n):
+                kkt[i][j] = self.H[i][j]
+        for a_i, c in enumerate(active):
+            for j in range(n):
+                kkt[n + a_i][j] = self.G[c][j]
+                kkt[j][n + a_i] = self.G[c][j]
+        columns = []
+        for t in range(NTHETA + 1):
+            col = [0.0] * size
+            for i in range(n):
+                col[i] = -(self.F[i][t] if t < NTHETA else self.h[i])
+            for a_i, c in enumerate(active):
+                col[n + a_i] = self.S[c][t] if t < NTHETA else self.W[c]
+            columns.append(col)
+        sol = solve(kkt, columns)
+        if sol is None:
+            return None
+        # sol[t][i]: coefficient of theta_t (or constant) in unknown i
+        law = [[sol[t][i] for t in range(NTHETA + 1)] for i in range(size)]
+        rows = []
+        for c in range(len(self.G)):
+            if c in active:
+                continue
+            a = [sum(self.G[c][i] * law[i][t] for i in range(n)) - self.S[c][t] for t in range(NTHETA)]
+            b = self.W[c] - sum(self.G[c][i] * law[i][NTHETA] for i in range(n))
+            rows.append((a, b))
+        for a_i in range(k):
+            lam = law[n + a_i]
+            rows.append(([-x for x in lam[:NTHETA]], lam[NTHETA]))
+        rows = [(a, b) for a, b in rows if max(abs(x) for x in a) > 1e-12 or b < 0.0]
+        return law[0], rows
+
+    def regions(self):
+        out = []
+        constraints = range(len(self.G))
+        for k in range(self.n + 1):
+            for active in itertools.combinations(constraints, k):
+                if any(self.pair[c] in active for c in active):
+                    continue
+                result = self.region(active)
+                if result is not None:
+                    out.append(result)
+        return out
+
+
+def inside(rows, theta, tol=1e-7):
+    return all(dot(a, theta) <= b + tol for a, b in rows)
+
+
+def sample_box(args, count, rng, grid=0):
+    lo = [args.y_min, args.y_min, args.u_min, args.u_min]
+    hi = [args.y_max, args.y_max, args.u_max, args.u_max]
+    points = []
+    if grid > 1:
+        axes = [[lo[i] + (hi[i] - lo[i]) * j / (grid - 1) for j in range(grid)] for i in range(NTHETA)]
+        points.extend(list(p) for p in itertools.product(*axes))
+    for _ in range(count):
+        points.append([rng.uniform(lo[i], hi[i]) for i in range(NTHETA)])
+    return points
+
+
+def sample_settled(args, count, rng, spread=0.02):
+    """Points near the equilibria y = y_prev = u_prev = r, where the loop
+    spends most of its time and a random box sample hardly ever lands."""
+    points = []
+    for _ in range(count):
+        level = rng.uniform(args.u_min, args.u_max)
+        points.append([level + rng.uniform(-spread, spread) for _ in range(NTHETA)])
+    return points
+
+
+def locate(regions, order, theta):
+    """Index of the region containing theta; keeps hot regions first."""
+    for pos, idx in enumerate(order):
+        if inside(regions[idx][1], theta):
+            if pos > 0:
+                order.insert(0, order.pop(pos))
+            return idx
+    return None
+
+
+# --- binary search tree ----------------------------------------------------
+
+def build_tree(points, labels, planes, nodes, depth, max_depth):
+    """Returns a child reference: >= 0 node index, < 0 is ~law."""
+    present = set(labels)
+    if len(present) == 1 or depth >= max_depth:
+        majority = max(present, key=labels.count)
+        return ~majority, depth
+
+    best = None
+    for p, (a, b) in enumerate(planes):
+        left = [dot(a, pt) <= b for pt in points]
+        n_left = sum(left)
+        if n_left == 0 or n_left == len(points):
+            continue
+        lset = {labels[i] for i in range(len(points)) if left[i]}
+        rset = {labels[i] for i in range(len(points)) if not left[i]}
+        score = (max(len(lset), len(rset)), len(lset) + len(rset), abs(2 * n_left - len(points)))
+        if best is None or score < best[0]:
+            best = (score, p, left)
+    if best is None:
+        majority = max(present, key=labels.count)
+        return ~majority, depth
+
+    _, p, left = best
+    index = len(nodes)
+    nodes.append(None)
+    lp = [pt for pt, l in zip(points, left) if l]
+    ll = [lb for lb, l in zip(labels, left) if l]
+    rp = [pt for pt, l in zip(points, left) if not l]
+    rl = [lb for lb, l in zip(labels, left) if not l]
+    lref, ld = build_tree(lp, ll, planes, nodes, depth + 1, max_depth)
+    rref, rd = build_tree(rp, rl, planes, nodes, depth + 1, max_depth)
+    nodes[index] = (planes[p], lref, rref)
+    return index, max(ld, rd)
+
+
+def evaluate(nodes, laws, theta):
+    ref = 0 if nodes else ~0
+    while ref >= 0:
+        (a, b), left, right = nodes[ref]
+        ref = left if dot(a, theta) <= b else right
+    law = laws[~ref]
+    return dot(law[:NTHETA], theta) + law[NTHETA]
+
+
+# --- model -----------------------------------------------------------------
+
+def plant_model(args):
+    """a1, a2, b1, b2, delay of the plant, from the lags unless given."""
+    p1 = math.exp(-args.period / args.valve_tau)
+    p2 = math.exp(-args.period / args.chamber_tau)
+    # Valve, then chamber on the valve's new value (as PlantSimulator steps):
+    #   y[k+1] = (p1 + p2) y[k] - p1 p2 y[k-1] + gain (1-p1)(1-p2) u[k-d]
+    derived = (-(p1 + p2), p1 * p2, args.gain * (1.0 - p1) * (1.0 - p2), 0.0)
+    given = (args.a1, args.a2, args.b1, args.b2)
+    a1, a2, b1, b2 = (g if g is not None else d for g, d in zip(given, derived))
+    delay = int(args.dead_time / args.period + 0.5)
+    return a1, a2, b1, b2, delay
+
+
+# --- output ----------------------------------------------------------------
+
+def fmt(x):
+    s = "%.9g" % x
+    if "." not in s and "e" not in s and "n" not in s:
+        s += ".0"
+    return s + "f"
+
+
+def emit(out, args, nodes, laws, depth, report):
+    w = out.write
+    w("/**\n")
+    w(" * @file MpcLawTable.h\n")
+    w(" * @brief Explicit MPC law, GENERATED by Tools/mpc_generate.py. Do not edit.\n")
+    w(" *\n")
+    w(" * model  a1=%.9g a2=%.9g b1=%.9g b2=%.9g, period %g s, dead time %d periods\n"
+      % (args.a1, args.a2, args.b1, args.b2, args.period, args.delay))
+    w(" * limits u in [%g, %g] bar, |du| <= %g bar per step\n" % (args.u_min, args.u_max, args.slew))
+    w(" * cost   N=%d moves, Np=%d steps, rho=%g\n" % (args.horizon, args.prediction, args.rho))
+    w(" * %s\n" % report)
+    w(" */\n\n")
+    w("#ifndef FIRMWARE_MPCLAWTABLE_H\n#define FIRMWARE_MPCLAWTABLE_H\n\n#pragma once\n\n")
+    w('#include "ExplicitMpc.h"\n\n')
+    w("namespace MpcLawTable {\n\n")
+    w("inline constexpr ExplicitMpc::Node kNodes[] = {\n")
+    for (a, b), left, right in nodes:
+        w("    {{%s}, %s, {%d, %d}},\n" % (", ".join(fmt(x) for x in a), fmt(b), left, right))
+    if not nodes:
+        w("    {{0.0f, 0.0f, 0.0f, 0.0f}, 0.0f, {-1, -1}},\n")
+    w("};\n\n")
+    w("inline constexpr ExplicitMpc::Law kLaws[] = {\n")
+    for law in laws:
+        w("    {{%s}, %s},\n" % (", ".join(fmt(x) for x in law[:NTHETA]), fmt(law[NTHETA])))
+    w("};\n\n")
+    w("inline constexpr ExplicitMpc::Table kTable = {\n")
+    w("    kNodes, %d,\n" % len(nodes))
+    w("    kLaws, %d,\n" % len(laws))
+    w("    %d, // tree depth\n" % depth)
+    w("    %s, %s, %s, %s,\n" % (fmt(args.period), fmt(args.u_min), fmt(args.u_max), fmt(args.slew)))
+    w("    {%s, %s}, {%s, %s}, // model a, b\n" % (fmt(args.a1), fmt(args.a2), fmt(args.b1), fmt(args.b2)))
+    w("    %d, // dead time, periods\n" % args.delay)
+    w("};\n\n")
+    w("} // namespace MpcLawTable\n\n#endif //FIRMWARE_MPCLAWTABLE_H\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("-o", "--output", help="header to write (default: stdout)")
+    parser.add_argument("--check", metavar="HEADER",
+                        help="regenerate and compare with HEADER; exit 1 if it differs")
+    parser.add_argument("--gain", type=float, default=1.0, help="steady-state bar per bar")
+    parser.add_argument("--valve-tau", type=float, default=0.025, help="VPPE lag, s")
+    parser.add_argument("--chamber-tau", type=float, default=0.008, help="chamber lag, s")
+    parser.add_argument("--dead-time", type=float, default=0.012, help="s")
+    parser.add_argument("--a1", type=float, help="override the model derived from the lags")
+    parser.add_argument("--a2", type=float)
+    parser.add_argument("--b1", type=float)
+    parser.add_argument("--b2", type=float)
+    parser.add_argument("--period", type=float, default=0.001, help="control period, s")
+    parser.add_argument("--u-min", type=float, default=0.0)
+    parser.add_argument("--u-max", type=float, default=1.8, help="the setpoint cap, bar")
+    parser.add_argument("--slew", type=float, default=0.05, help="max setpoint change per step, bar")
+    parser.add_argument("--y-min", type=float, default=-0.1)
+    parser.add_argument("--y-max", type=float, default=2.1)
+    parser.add_argument("--horizon", type=int, default=3, help="free moves N")
+    parser.add_argument("--prediction", type=int, default=60, help="prediction steps Np")
+    parser.add_argument("--rho", type=float, default=0.05, help="move penalty")
+    parser.add_argument("--samples", type=int, default=6000)
+    parser.add_argument("--max-depth", type=int, default=24)
+    parser.add_argument("--refine", type=int, default=8, help="tree refinement rounds")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    args.a1, args.a2, args.b1, args.b2, args.delay = plant_model(args)
+
+    rng = random.Random(args.seed)
+    problem = Problem(args)
+    regions = problem.regions()
+
+    order = list(range(len(regions)))
+    laws, law_of_region, planes = [], {}, []
+
+    def label(idx):
+        """Law index of a region; registers its law and facets on first use."""
+        if idx in law_of_region:
+            return law_of_region[idx]
+        law, rows = regions[idx]
+        for li, other in enumerate(laws):
+            if all(abs(x - y) < 1e-6 for x, y in zip(law, other)):
+                law_of_region[idx] = li  # same first move: merge
+                break
+        else:
+            law_of_region[idx] = len(laws)
+            laws.append(law)
+        for a, b in rows:
+            norm = math.sqrt(dot(a, a))
+            if norm < 1e-12:
+                continue
+            plane = [x / norm for x in a] + [b / norm]
+            if not any(all(abs(x - y) < 1e-7 for x, y in zip(plane, q[0] + [q[1]])) for q in planes):
+                planes.append((plane[:NTHETA], plane[NTHETA]))
+        return law_of_region[idx]
+
+    def misses(nodes, pts):
+        """Points the tree gets wrong, with their exact labels."""
+        bad, worst, checked = [], 0.0, 0
+        for pt in pts:
+            idx = locate(regions, order, pt)
+            if idx is None:
+                continue
+            law = regions[idx][0]
+            err = abs(evaluate(nodes, laws, pt) - (dot(law[:NTHETA], pt) + law[NTHETA])) if laws else 1.0
+            checked += 1
+            worst = max(worst, err)
+            if err > 1e-4:
+                bad.append((pt, label(idx)))
+        return bad, worst, checked
+
+    points, labels = [], []
+    for pt in sample_box(args, args.samples, rng, grid=6) + sample_settled(args, args.samples // 4, rng):
+        idx = locate(regions, order, pt)
+        if idx is not None:
+            points.append(pt)
+            labels.append(label(idx))
+
+    # Build the tree, then feed the points it gets wrong back in and rebuild.
+    for round_ in range(args.refine + 1):
+        nodes = []
+        _, depth = build_tree(points, labels, planes, nodes, 0, args.max_depth)
+        if round_ == args.refine:
+            break
+        bad, _, _ = misses(nodes, sample_box(args, 4000, rng) + sample_settled(args, 1000, rng))
+        if not bad:
+            break
+        for pt, lb in bad:
+            points.append(pt)
+            labels.append(lb)
+
+    check_rng = random.Random(args.seed + 1000)
+    bad, worst, checked = misses(nodes, sample_box(args, 4000, check_rng) + sample_settled(args, 1000, check_rng))
+    wrong = len(bad)
+    used = len(law_of_region)
+    report = ("%d regions, %d laws, %d nodes, depth %d; validation: %d/%d points off, max error %.2g bar"
+              % (used, len(laws), len(nodes), depth, wrong, checked, worst))
+    print(report, file=sys.stderr)
+
+    if args.check:
+        text = io.StringIO()
+        emit(text, args, nodes, laws, depth, report)
+        with open(args.check) as f:
+            if f.read() != text.getvalue():
+                print("%s is out of date: regenerate it with -o" % args.check, file=sys.stderr)
+                sys.exit(1)
+    elif args.output:
+        with open(args.output, "w") as f:
+            emit(f, args, nodes, laws, depth, report)
+    else:
+        emit(sys.stdout, args, nodes, laws, depth, report)
+
+
+if __name__ == "__main__":
+    main()
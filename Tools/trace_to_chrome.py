@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""
+Convert a TraceRecorder dump into Chrome trace JSON.
+
+The dump is the concatenation of chunks produced by
+TraceRecorder::encodeTaskNames() and TraceRecorder::drain(), as received
+over telemetry. The output opens in chrome://tracing and in Perfetto
+(ui.perfetto.dev -> Open trace file).
+
+    python3 Tools/trace_to_chrome.py dump.bin -o trace.json
+
+Layout in the viewer:
+    "CPU" row   - one slice per task, from switch-in to the next switch-in
+    "ISR" row   - one slice per interrupt, enter to exit
+    instants    - queue send/receive/block and task notifications
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+# Must match System/Inc/TraceRecorder.h
+CHUNK_MAGIC = 0x45435254
+CHUNK_EVENTS = 1
+CHUNK_TASK_NAMES = 2
+HEADER = struct.Struct("<IHHI")
+EVENT = struct.Struct("<IBBH")
+TASK_NAME = struct.Struct("<B16s")
+
+EVT_TASK_SWITCH = 1
+EVT_ISR_ENTER = 2
+EVT_ISR_EXIT = 3
+EVT_QUEUE_SEND = 4
+EVT_QUEUE_RECEIVE = 5
+EVT_QUEUE_BLOCK = 6
+EVT_NOTIFY = 7
+EVT_NOTIFY_WAIT = 8
+EVT_USER = 9
+FROM_ISR = 0x80
+
+ISR_NAMES = {1: "HAL tick (TIM1)", 2: "Timebase (TIM2)", 3: "Overpressure (COMP1)",
+             4: "Executive (TIM7)", 5: "Latency bench (TIM6)",
+             6: "Analog watchdog (ADC3/4)"}
+INSTANT_NAMES = {
+    EVT_QUEUE_SEND: "queue send",
+    EVT_QUEUE_RECEIVE: "queue receive",
+    EVT_QUEUE_BLOCK: "block on queue",
+    EVT_NOTIFY: "notify",
+    EVT_NOTIFY_WAIT: "wait notify",
+    EVT_USER: "user",
+}
+
+PID = 1
+TID_CPU = 1
+TID_ISR = 2
+TID_EVENTS = 3
+
+
+def parse_chunks(data):
+    """Yields (kind, dropped, entries) for every chunk in the dump."""
+    offset = 0
+    while offset + HEADER.size <= len(data):
+        magic, kind, count, dropped = HEADER.unpack_from(data, offset)
+        if magic != CHUNK_MAGIC:
+            offset += 1  # resync after a corrupted/partial chunk
+            continue
+        offset += HEADER.size
+        if kind == CHUNK_EVENTS:
+            size = EVENT.size
+            layout = EVENT
+        elif kind == CHUNK_TASK_NAMES:
+            size = TASK_NAME.size
+            layout = TASK_NAME
+        else:
+            continue
+        entries = []
+        for _ in range(count):
+            if offset + size > len(data):
+                break
+            entries.append(layout.unpack_from(data, offset))
+            offset += size
+        yield kind, dropped, entries
+
+
+class Unwrapper:
+    """Extends the 32-bit microsecond stamps to a monotonic 64-bit time."""
+
+    def __init__(self):
+        self.high = 0
+        self.last = None
+
+    def __call__(self, t_us):
+        if self.last is not None and t_us < self.last and self.last - t_us > 0x80000000:
+            self.high += 1 << 32
+        self.last = t_us
+        return self.high + t_us
+
+
+def convert(data):
+    names = {}
+    events = []
+    dropped_total = 0
+    for kind, dropped, entries in parse_chunks(data):
+        dropped_total += dropped
+        if kind == CHUNK_TASK_NAMES:
+            for number, raw in entries:
+                names[number] = raw.split(b"\0", 1)[0].decode("ascii", "replace")
+        else:
+            events.extend(entries)
+
+    unwrap = Unwrapper()
+    out = [
+        {"ph": "M", "pid": PID, "name": "process_name", "args": {"name": "STM32G474"}},
+        {"ph": "M", "pid": PID, "tid": TID_CPU, "name": "thread_name", "args": {"name": "CPU"}},
+        {"ph": "M", "pid": PID, "tid": TID_ISR, "name": "thread_name", "args": {"name": "ISR"}},
+        {"ph": "M", "pid": PID, "tid": TID_EVENTS, "name": "thread_name", "args": {"name": "Kernel objects"}},
+    ]
+    running = None
+    isr_stack = []
+
+    def task_name(number):
+        return names.get(number, "task %d" % number)
+
+    for t_raw, type_, obj, payload in events:
+        ts = unwrap(t_raw)
+        base = type_ & ~FROM_ISR
+        from_isr = bool(type_ & FROM_ISR)
+
+        if base == EVT_TASK_SWITCH:
+            if running is not None:
+                out.append({"ph": "E", "pid": PID, "tid": TID_CPU, "ts": ts})
+            out.append({"ph": "B", "pid": PID, "tid": TID_CPU, "ts": ts, "name": task_name(obj)})
+            running = obj
+        elif base == EVT_ISR_ENTER:
+            isr_stack.append(obj)
+            out.append({"ph": "B", "pid": PID, "tid": TID_ISR, "ts": ts,
+                        "name": ISR_NAMES.get(obj, "ISR %d" % obj)})
+        elif base == EVT_ISR_EXIT:
+            if isr_stack:
+                isr_stack.pop()
+                out.append({"ph": "E", "pid": PID, "tid": TID_ISR, "ts": ts})
+        elif base in INSTANT_NAMES:
+            args = {"object": obj, "payload": payload, "from_isr": from_isr}
+            if base in (EVT_NOTIFY, EVT_NOTIFY_WAIT):
+                args["task"] = task_name(obj)
+            out.append({"ph": "i", "s": "t", "pid": PID, "tid": TID_EVENTS, "ts": ts,
+                        "name": INSTANT_NAMES[base], "args": args})
+
+    if dropped_total:
+        print("warning: %d events were dropped on the target" % dropped_total, file=sys.stderr)
+    return {"traceEvents": out, "displayTimeUnit": "ns",
+            "otherData": {"dropped_events": dropped_total}}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("dump", help="binary dump of drained trace chunks")
+    parser.add_argument("-o", "--output", default="-", help="output JSON file (default: stdout)")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as f:
+        trace = convert(f.read())
+
+    if args.output == "-":
+        json.dump(trace, sys.stdout)
+    else:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+
+
+if __name__ == "__main__":
+    main()
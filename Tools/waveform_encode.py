@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+Encode pressure waveforms into the WaveformPlayer preset table.
+
+    python3 Tools/waveform_encode.py --builtin -o App/Inc/WaveformPresetTable.h
+    python3 Tools/waveform_encode.py --csv exercise=run12.csv --csv rest=run03.csv -o ...
+
+A recording is a CSV of "time_s,pressure_bar" rows (a header row is
+allowed). Beats are found at rising crossings of the midpoint between the
+5th and 95th percentile, moved back to the foot of the upstroke. Each
+complete beat is resampled to --samples points and the beats are averaged.
+The preset gets the mean rate, the min/max of the averaged beat, and the
+beat normalised to Q15.
+
+--builtin adds the default library: parametric drive-pressure profiles
+(rest, exercise, heart failure, aortic stenosis, mitral regurgitation),
+meant as starting points until recorded profiles replace them.
+"""
+
+import argparse
+import csv
+import math
+import re
+import sys
+
+# name, rate_bpm, diastolic, systolic, systole fraction, peak position in
+# systole, dicrotic notch level, diastolic decay
+BUILTIN = [
+    ("rest", 70.0, 0.20, 1.20, 0.35, 0.40, 0.55, 3.0),
+    ("exercise", 130.0, 0.20, 1.60, 0.45, 0.35, 0.60, 2.0),
+    ("heart_failure", 95.0, 0.30, 0.80, 0.40, 0.60, 0.70, 2.5),
+    ("aortic_stenosis", 72.0, 0.20, 1.80, 0.40, 0.70, 0.45, 3.0),
+    ("mitral_regurgitation", 85.0, 0.20, 1.00, 0.30, 0.30, 0.40, 4.0),
+]
+
+
+def parametric(samples, systole, peak, notch, decay):
+    """Raised-cosine upstroke, fall to the notch, exponential run-off to 0."""
+    out = []
+    for i in range(samples):
+        x = i / samples
+        if x < systole * peak:
+            u = x / (systole * peak)
+            f = 0.5 - 0.5 * math.cos(math.pi * u)
+        elif x < systole:
+            u = (x - systole * peak) / (systole * (1.0 - peak))
+            f = 1.0 - (1.0 - notch) * (0.5 - 0.5 * math.cos(math.pi * u))
+        else:
+            u = (x - systole) / (1.0 - systole)
+            f = notch * (math.exp(-decay * u) - math.exp(-decay)) / (1.0 - math.exp(-decay))
+        out.append(f)
+    return out
+
+
+def read_csv(path):
+    t, p = [], []
+    with open(path, newline="") as f:
+        for row in csv.reader(f):
+            try:
+                t.append(float(row[0]))
+                p.append(float(row[1]))
+            except (ValueError, IndexError):
+                continue  # header or blank line
+    return t, p
+
+
+def percentile(values, q):
+    s = sorted(values)
+    return s[min(len(s) - 1, int(q * (len(s) - 1)))]
+
+
+def beat_starts(t, p):
+    lo, hi = percentile(p, 0.05), percentile(p, 0.95)
+    mid = 0.5 * (lo + hi)
+    hyst = 0.1 * (hi - lo)
+    starts, armed = [], False
+    for i in range(1, len(p)):
+        if p[i] < mid - hyst:
+            armed = True
+        elif armed and p[i - 1] < mid <= p[i]:
+            armed = False
+            j = i
+            while j > 0 and p[j - 1] <= p[j]:
+                j -= 1  # back to the foot
+            starts.append(j)
+    return starts
+
+
+def resample(t, p, start, end, samples):
+    out = []
+    k = start
+    for i in range(samples):
+        x = t[start] + (t[end] - t[start]) * i / samples
+        while k + 1 < end and t[k + 1] <= x:
+            k += 1
+        span = t[k + 1] - t[k]
+        w = (x - t[k]) / span if span > 0 else 0.0
+        out.append(p[k] + (p[k + 1] - p[k]) * w)
+    return out
+
+
+def encode_recording(name, path, samples):
+    t, p = read_csv(path)
+    starts = beat_starts(t, p)
+    if len(starts) < 2:
+        raise SystemExit("%s: fewer than two beats found" % path)
+    beats = [resample(t, p, a, b, samples) for a, b in zip(starts, starts[1:])]
+    periods = [t[b] - t[a] for a, b in zip(starts, starts[1:])]
+    mean = [sum(col) / len(beats) for col in zip(*beats)]
+    lo, hi = min(mean), max(mean)
+    shape = [(x - lo) / (hi - lo) for x in mean]
+    rate = 60.0 / (sum(periods) / len(periods))
+    print("%s: %d beats, %.1f bpm, %.3f..%.3f bar" % (name, len(beats), rate, lo, hi), file=sys.stderr)
+    return name, rate, lo, hi, shape
+
+
+def identifier(name):
+    parts = re.split(r"[^0-9A-Za-z]+", name)
+    return "".join(part[:1].upper() + part[1:] for part in parts if part)
+
+
+def fmt(x):
+    return ("%.6g" % x if "." in "%.6g" % x else "%.6g.0" % x) + "f"
+
+
+def emit(out, presets, samples):
+    w = out.write
+    w("/**\n")
+    w(" * @file WaveformPresetTable.h\n")
+    w(" * @brief Waveform presets, GENERATED by Tools/waveform_encode.py. Do not edit.\n")
+    w(" */\n\n")
+    w("#ifndef FIRMWARE_WAVEFORMPRESETTABLE_H\n#define FIRMWARE_WAVEFORMPRESETTABLE_H\n\n#pragma once\n\n")
+    w('#include "WaveformPlayer.h"\n\n')
+    w("namespace WaveformPresetTable {\n\n")
+    w("enum PresetId : uint8_t {\n")
+    for name, *_ in presets:
+        w("    %s,\n" % identifier(name))
+    w("    PresetCount\n};\n\n")
+    for name, _rate, _lo, _hi, shape in presets:
+        q15 = [max(0, min(32767, int(round(v * 32767)))) for v in shape]
+        w("inline constexpr int16_t k%sShape[%d] = {\n" % (identifier(name), samples))
+        for i in range(0, samples, 12):
+            w("    %s,\n" % ", ".join(str(v) for v in q15[i:i + 12]))
+        w("};\n\n")
+    w("inline constexpr WaveformPreset kPresets[PresetCount] = {\n")
+    for name, rate, lo, hi, _ in presets:
+        w('    {"%s", %s, %s, %s, %d, k%sShape},\n'
+          % (name, fmt(rate), fmt(lo), fmt(hi), samples, identifier(name)))
+    w("};\n\n")
+    w("} // namespace WaveformPresetTable\n\n#endif //FIRMWARE_WAVEFORMPRESETTABLE_H\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("-o", "--output", help="header to write (default: stdout)")
+    parser.add_argument("--builtin", action="store_true", help="include the parametric default presets")
+    parser.add_argument("--csv", action="append", default=[], metavar="NAME=FILE",
+                        help="encode a recording as preset NAME")
+    parser.add_argument("--samples", type=int, default=64, help="samples per beat")
+    args = parser.parse_args()
+
+    presets = []
+    if args.builtin:
+        for name, rate, lo, hi, systole, peak, notch, decay in BUILTIN:
+            presets.append((name, rate, lo, hi, parametric(args.samples, systole, peak, notch, decay)))
+    for spec in args.csv:
+        name, _, path = spec.partition("=")
+        if not path:
+            parser.error("--csv expects NAME=FILE")
+        presets.append(encode_recording(name, path, args.samples))
+    if not presets:
+        parser.error("nothing to encode (use --builtin and/or --csv)")
+
+    if args.output:
+        with open(args.output, "w") as f:
+            emit(f, presets, args.samples)
+    else:
+        emit(sys.stdout, presets, args.samples)
+
+
+if __name__ == "__main__":
+    main()